@@ -0,0 +1,92 @@
+// Benchmark of the memory consumption and of the access time of GCodeProcessor::MoveVertices
+// compared to the former std::vector<GCodeProcessor::MoveVertex> layout.
+//
+// Usage: gcodemoves [file.gcode ...]
+// Without files, 10M moves of a synthetic print are generated.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <libslic3r/libslic3r.h>
+#include <libslic3r/GCode/GCodeProcessor.hpp>
+
+using namespace Slic3r;
+
+template<typename Fn>
+static double measure(Fn &&fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void benchmark(const std::string &name, const GCodeProcessor::MoveVertices &moves)
+{
+    std::vector<GCodeProcessor::MoveVertex> vector;
+    double t_vector = measure([&]() {
+        vector.reserve(moves.size());
+        for (size_t i = 0; i < moves.size(); ++ i)
+            vector.emplace_back(moves[i]);
+    });
+    size_t vector_size = vector.size() * sizeof(GCodeProcessor::MoveVertex);
+    std::cout << name << ": " << moves.size() << " moves" << std::endl;
+    std::cout << "\tstd::vector<MoveVertex>: " << vector_size / 1048576. << " MB" << std::endl;
+    std::cout << "\tMoveVertices:            " << moves.memory_size() / 1048576. << " MB, " <<
+        100. * double(moves.memory_size()) / double(vector_size) << " %" << std::endl;
+    std::cout << "\tsequential decoding:     " << t_vector << " s" << std::endl;
+
+    // Random access as done by the sequential view slider.
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<size_t> dist(0, moves.size() - 1);
+    float sum = 0.f;
+    const size_t num_random = 1000000;
+    double t_random = measure([&]() {
+        for (size_t i = 0; i < num_random; ++ i)
+            sum += moves[dist(rng)].position.z();
+    });
+    std::cout << "\trandom access:           " << t_random * 1e9 / double(num_random) << " ns per move (" << sum << ")" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++ i) {
+            GCodeProcessor processor;
+            processor.enable_producers(true);
+            double t = measure([&]() { processor.process_file(argv[i]); });
+            std::cout << argv[i] << " processed in " << t << " s" << std::endl;
+            benchmark(argv[i], processor.get_result().moves);
+        }
+    } else {
+        // Synthetic print: extrusions along a zig-zag with travels in between, layers of 0.2mm.
+        GCodeProcessor::MoveVertices moves;
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<float> step(-2.f, 2.f);
+        Vec3f position(100.f, 100.f, 0.2f);
+        for (size_t i = 0; i < 10000000; ++ i) {
+            GCodeProcessor::MoveVertex move;
+            bool travel = i % 20 == 0;
+            move.type           = travel ? EMoveType::Travel : EMoveType::Extrude;
+            move.extrusion_role = travel ? erNone : ExtrusionRole(erPerimeter + (i / 2000) % 6);
+            position.x()        = std::round((position.x() + (travel ? 10.f * step(rng) : step(rng))) * 1000.f) / 1000.f;
+            position.y()        = std::round((position.y() + (travel ? 10.f * step(rng) : step(rng))) * 1000.f) / 1000.f;
+            if (i % 5000 == 0)
+                position.z() += 0.2f;
+            move.position       = position;
+            move.delta_extruder = travel ? -0.8f : 0.03f * std::abs(step(rng));
+            move.feedrate       = travel ? 180.f : 40.f;
+            move.width          = 0.45f;
+            move.height         = 0.2f;
+            move.mm3_per_mm     = 0.0845f;
+            move.fan_speed      = 100.f;
+            move.time           = float(i);
+            moves.emplace_back(move);
+        }
+        moves.shrink_to_fit();
+        benchmark("synthetic", moves);
+    }
+    return 0;
+}
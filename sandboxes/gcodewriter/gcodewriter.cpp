@@ -0,0 +1,78 @@
+// Benchmark of the G1 line formatting of GCodeWriter against the std::ostringstream based formatting
+// used previously. Verifies that both produce the same G-code byte-for-byte.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <libslic3r/GCodeWriter.hpp>
+
+using namespace Slic3r;
+
+// The G1 line formatting of GCodeWriter::extrude_to_xy() before the introduction of to_chars_fixed().
+static std::string extrude_to_xy_ostringstream(const Vec2d &point, double e)
+{
+    std::ostringstream gcode;
+    gcode << "G1 X" << std::fixed << std::setprecision(3) << point(0)
+          <<   " Y" << std::fixed << std::setprecision(3) << point(1)
+          <<   " E" << std::fixed << std::setprecision(5) << e;
+    gcode << "\n";
+    return gcode.str();
+}
+
+int main(int argc, char **argv)
+{
+    size_t num_moves = (argc > 1) ? size_t(std::stoul(argv[1])) : size_t(5000000);
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> dist_xy(0., 250.);
+    std::uniform_real_distribution<double> dist_e(0., 0.1);
+    std::vector<Vec2d>  points;
+    std::vector<double> de;
+    points.reserve(num_moves);
+    de.reserve(num_moves);
+    for (size_t i = 0; i < num_moves; ++ i) {
+        points.emplace_back(dist_xy(rng), dist_xy(rng));
+        de.emplace_back(dist_e(rng));
+    }
+
+    GCodeWriter writer;
+    writer.config.use_relative_e_distances.value = false;
+    writer.set_extruders({ 0 });
+    writer.set_extruder(0);
+
+    // Reference output: Accumulate the absolute E the same way as the Extruder does.
+    std::vector<std::string> reference;
+    reference.reserve(num_moves);
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        double e = 0.;
+        for (size_t i = 0; i < num_moves; ++ i) {
+            e += de[i];
+            reference.emplace_back(extrude_to_xy_ostringstream(points[i], e));
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<std::string> output;
+    output.reserve(num_moves);
+    for (size_t i = 0; i < num_moves; ++ i)
+        output.emplace_back(writer.extrude_to_xy(points[i], de[i]));
+    auto t2 = std::chrono::steady_clock::now();
+
+    size_t num_different = 0;
+    for (size_t i = 0; i < num_moves; ++ i)
+        if (reference[i] != output[i]) {
+            if (num_different ++ < 10)
+                std::cout << "Mismatch at move " << i << ": " << reference[i] << " vs. " << output[i];
+        }
+
+    std::cout << "Moves: " << num_moves << std::endl;
+    std::cout << "std::ostringstream: " << std::chrono::duration<double>(t1 - t0).count() << " s" << std::endl;
+    std::cout << "GCodeWriter:        " << std::chrono::duration<double>(t2 - t1).count() << " s" << std::endl;
+    std::cout << "Mismatches: " << num_different << std::endl;
+    return num_different == 0 ? 0 : -1;
+}
@@ -0,0 +1,63 @@
+// Benchmark of the construction of the facet neighbors (stl_check_facets_exact()), of TriangleMesh::repair()
+// and of TriangleMesh::require_shared_vertices() on large meshes.
+//
+// Usage: meshrepair [file.stl ...]
+// Without arguments, spheres of 1M, 2M and 4M facets are generated.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <libslic3r/TriangleMesh.hpp>
+
+using namespace Slic3r;
+
+template<typename Fn>
+static double measure(Fn &&fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void benchmark(const std::string &name, const TriangleMesh &input)
+{
+    std::cout << name << ": " << input.stl.stats.number_of_facets << " facets" << std::endl;
+
+    TriangleMesh mesh = input;
+    mesh.its.clear();
+    mesh.repaired = false;
+    for (stl_neighbors &neighbors : mesh.stl.neighbors_start)
+        neighbors.reset();
+    double t = measure([&mesh]() { stl_check_facets_exact(&mesh.stl); });
+    std::cout << "\tstl_check_facets_exact:  " << t << " s, connected edges: " << mesh.stl.stats.connected_edges << 
+        ", facets with 3 neighbors: " << mesh.stl.stats.connected_facets_3_edge << std::endl;
+
+    mesh = input;
+    mesh.its.clear();
+    mesh.repaired = false;
+    t = measure([&mesh]() { mesh.repair(false); });
+    std::cout << "\trepair:                  " << t << " s" << std::endl;
+    t = measure([&mesh]() { mesh.require_shared_vertices(); });
+    std::cout << "\trequire_shared_vertices: " << t << " s, vertices: " << mesh.its.vertices.size() << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++ i) {
+            TriangleMesh mesh;
+            if (! mesh.ReadSTLFile(argv[i])) {
+                std::cerr << "Failed to load " << argv[i] << std::endl;
+                return -1;
+            }
+            benchmark(argv[i], mesh);
+        }
+    } else {
+        // Sphere of n facets is tesselated with approximately 4 * PI^2 / fa^2 facets.
+        for (double num_facets : { 1e6, 2e6, 4e6 })
+            benchmark("sphere", make_sphere(10., 2. * PI / sqrt(num_facets)));
+    }
+    return 0;
+}
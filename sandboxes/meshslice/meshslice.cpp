@@ -0,0 +1,68 @@
+// Benchmark of the scaling of TriangleMeshSlicer::slice() with the number of threads, from 1 to 32 threads.
+//
+// Usage: meshslice [layer_height] [file.stl ...]
+// Without files, spheres of 1M and 4M facets are generated. The default layer height is 0.05mm.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <tbb/task_arena.h>
+
+#include <libslic3r/TriangleMesh.hpp>
+
+using namespace Slic3r;
+
+template<typename Fn>
+static double measure(Fn &&fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void benchmark(const std::string &name, TriangleMesh &mesh, double layer_height)
+{
+    mesh.repair();
+    BoundingBoxf3 bbox = mesh.bounding_box();
+    std::vector<float> z;
+    for (double zz = bbox.min.z() + 0.5 * layer_height; zz < bbox.max.z(); zz += layer_height)
+        z.emplace_back(float(zz));
+    std::cout << name << ": " << mesh.stl.stats.number_of_facets << " facets, " << z.size() << " layers" << std::endl;
+
+    TriangleMeshSlicer slicer;
+    std::cout << "\tinit: " << measure([&]() { slicer.init(&mesh, [](){}); }) << " s" << std::endl;
+    double t1 = 0.;
+    for (int num_threads : { 1, 2, 4, 8, 16, 32 }) {
+        std::vector<Polygons> layers;
+        double t = measure([&]() {
+            tbb::task_arena(num_threads).execute([&]() { slicer.slice(z, SlicingMode::Regular, &layers, [](){}); });
+        });
+        if (num_threads == 1)
+            t1 = t;
+        std::cout << "\t" << num_threads << " threads: " << t << " s, speedup " << t1 / t << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double layer_height = (argc > 1) ? std::stod(argv[1]) : 0.05;
+    if (argc > 2) {
+        for (int i = 2; i < argc; ++ i) {
+            TriangleMesh mesh;
+            if (! mesh.ReadSTLFile(argv[i])) {
+                std::cerr << "Failed to load " << argv[i] << std::endl;
+                return -1;
+            }
+            benchmark(argv[i], mesh, layer_height);
+        }
+    } else {
+        // Sphere of n facets is tesselated with approximately 4 * PI^2 / fa^2 facets.
+        for (double num_facets : { 1e6, 4e6 }) {
+            TriangleMesh mesh = make_sphere(50., 2. * PI / sqrt(num_facets));
+            benchmark("sphere", mesh, layer_height);
+        }
+    }
+    return 0;
+}
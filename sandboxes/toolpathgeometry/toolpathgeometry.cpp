@@ -0,0 +1,123 @@
+// Headless benchmark of the generation of the G-code preview toolpaths by Slic3r::ToolpathGeometry,
+// sequential (single thread arena) against parallel, for the whole geometry at once and a window of batches at a time
+// as done by GUI::GCodeViewer::load_toolpaths().
+//
+// Usage: toolpathgeometry [file.gcode ...]
+// Without files, 2M moves of a synthetic print are generated.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+#include <tbb/task_arena.h>
+
+#include <libslic3r/libslic3r.h>
+#include <libslic3r/GCode/GCodeProcessor.hpp>
+#include <libslic3r/GCode/ToolpathGeometry.hpp>
+
+using namespace Slic3r;
+
+#if ENABLE_GCODE_VIEWER
+
+template<typename Fn>
+static double measure(Fn &&fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void run(const char *label, const GCodeProcessor::MoveVertices &moves, size_t window)
+{
+    ToolpathGeometry geometry;
+    size_t peak_memory = 0;
+    double t_build = measure([&]() { geometry.build(moves); });
+    double t_generate = measure([&]() {
+        for (size_t begin = 0; begin < geometry.batches_count(); begin += window) {
+            geometry.generate(moves, begin, std::min(begin + window, geometry.batches_count()));
+            peak_memory = std::max(peak_memory, geometry.memory_size());
+        }
+    });
+    size_t vertices = 0;
+    size_t index_buffers = 0;
+    for (const ToolpathGeometry::Buffer &buffer : geometry.buffers()) {
+        vertices      += buffer.vertices_count;
+        index_buffers += buffer.index_buffers_sizes.size();
+    }
+    std::cout << "\t" << label << ": build " << t_build << " s, generate " << t_generate << " s, " <<
+        geometry.batches_count() << " batches, " << vertices << " vertices, " << index_buffers << " index buffers, peak " <<
+        peak_memory / 1048576. << " MB" << std::endl;
+}
+
+static void benchmark(const std::string &name, const GCodeProcessor::MoveVertices &moves)
+{
+    std::cout << name << ": " << moves.size() << " moves" << std::endl;
+    const size_t all = std::numeric_limits<size_t>::max();
+    tbb::task_arena sequential(1);
+    sequential.execute([&]() { run("sequential, all batches     ", moves, all); });
+    run("parallel, all batches       ", moves, all);
+    sequential.execute([&]() { run("sequential, windows of 64   ", moves, 64); });
+    run("parallel, windows of 64     ", moves, 64);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++ i) {
+            GCodeProcessor processor;
+            processor.enable_producers(true);
+            double t = measure([&]() { processor.process_file(argv[i]); });
+            std::cout << argv[i] << " processed in " << t << " s" << std::endl;
+            benchmark(argv[i], processor.get_result().moves);
+        }
+    } else {
+        // Synthetic print: extrusions along a zig-zag with travels and retractions in between, layers of 0.2mm.
+        GCodeProcessor::MoveVertices moves;
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<float> step(-2.f, 2.f);
+        Vec3f position(100.f, 100.f, 0.2f);
+        // the first move is a dummy move, see GCodeProcessor::begin_process()
+        moves.emplace_back(GCodeProcessor::MoveVertex());
+        for (size_t i = 0; i < 2000000; ++ i) {
+            GCodeProcessor::MoveVertex move;
+            bool travel = i % 20 == 0;
+            move.type           = travel ? EMoveType::Travel : EMoveType::Extrude;
+            move.extrusion_role = travel ? erNone : ExtrusionRole(erPerimeter + (i / 400) % 6);
+            position.x()        = std::round((position.x() + (travel ? 10.f * step(rng) : step(rng))) * 1000.f) / 1000.f;
+            position.y()        = std::round((position.y() + (travel ? 10.f * step(rng) : step(rng))) * 1000.f) / 1000.f;
+            if (i % 1000 == 0)
+                position.z() += 0.2f;
+            move.position       = position;
+            move.delta_extruder = travel ? -0.8f : 0.03f * std::abs(step(rng));
+            move.feedrate       = travel ? 180.f : 40.f;
+            move.width          = 0.45f;
+            move.height         = 0.2f;
+            move.mm3_per_mm     = 0.0845f;
+            move.fan_speed      = 100.f;
+            move.time           = float(i);
+            if (travel) {
+                GCodeProcessor::MoveVertex retract = move;
+                retract.type = EMoveType::Retract;
+                moves.emplace_back(retract);
+            }
+            moves.emplace_back(move);
+        }
+        moves.shrink_to_fit();
+        benchmark("synthetic", moves);
+    }
+    return 0;
+}
+
+#else // ENABLE_GCODE_VIEWER
+
+int main()
+{
+    std::cout << "ToolpathGeometry requires ENABLE_GCODE_VIEWER" << std::endl;
+    return 0;
+}
+
+#endif // ENABLE_GCODE_VIEWER
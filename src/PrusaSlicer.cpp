@@ -24,6 +24,7 @@
 #include <math.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
 #include <boost/nowide/args.hpp>
 #include <boost/nowide/cenv.hpp>
 #include <boost/nowide/iostream.hpp>
@@ -38,6 +39,7 @@
 #include "libslic3r/ModelArrange.hpp"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/SLAPrint.hpp"
+#include "libslic3r/SliceCache.hpp"
 #include "libslic3r/TriangleMesh.hpp"
 #include "libslic3r/Format/AMF.hpp"
 #include "libslic3r/Format/3mf.hpp"
@@ -60,6 +62,15 @@
 
 using namespace Slic3r;
 
+static void log_slice_cache_stats()
+{
+    if (! SliceCache::instance().enabled())
+        return;
+    SliceCache::Stats stats = SliceCache::instance().stats();
+    BOOST_LOG_TRIVIAL(info) << "Slice cache: " << stats.hits << " hits, " << stats.disk_hits << " disk hits, " << stats.misses << " misses, "
+        << stats.evictions << " evictions, " << stats.memory_used << " bytes in memory, " << stats.disk_used << " bytes on disk";
+}
+
 int CLI::run(int argc, char **argv)
 {
 #ifdef __WXGTK__
@@ -571,6 +582,8 @@ int CLI::run(int argc, char **argv)
         }
     }
 
+    log_slice_cache_stats();
+
     if (start_gui) {
 #ifdef SLIC3R_GUI
 // #ifdef USE_WX
@@ -634,6 +647,7 @@ int CLI::run(int argc, char **argv)
         });
 */
         int result = wxEntry(argc, argv);
+        log_slice_cache_stats();
         return result;
 #else /* SLIC3R_GUI */
         // No GUI support. Just print out a help.
@@ -717,6 +731,11 @@ bool CLI::setup(int argc, char **argv)
             m_config.option(optdef.first, true);
 
     set_data_dir(m_config.opt_string("datadir"));
+
+    // The slice cache is disabled by default.
+    SliceCache::instance().set_memory_limit(size_t(std::max(0, m_config.opt_int("slice_cache_memory"))) << 20);
+    if (! m_config.opt_string("slice_cache_dir").empty())
+        SliceCache::instance().set_disk_cache(m_config.opt_string("slice_cache_dir"), size_t(std::max(0, m_config.opt_int("slice_cache_disk"))) << 20);
     
     if (!validity.empty()) {
         boost::nowide::cerr << "error: " << validity << std::endl;
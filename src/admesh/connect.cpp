@@ -26,6 +26,8 @@
 #include <math.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <vector>
 
 #include <boost/predef/other/endian.h>
@@ -34,8 +36,18 @@
 #define BOOST_POOL_NO_MT
 #include <boost/pool/object_pool.hpp>
 
+#include <tbb/parallel_for.h>
+
 #include "stl.h"
 
+// Lexicographic ordering of vertices, used to orient the edges the same way independently of the facet they belong to.
+// This method is numerically robust.
+static inline bool stl_vertex_lower(const stl_vertex &a, const stl_vertex &b)
+{
+	return (a(0) != b(0)) ? (a(0) < b(0)) :
+	       ((a(1) != b(1)) ? (a(1) < b(1)) : (a(2) < b(2)));
+}
+
 struct HashEdge {
 	// Key of a hash edge: sorted vertices of the edge.
 	uint32_t       key[6];
@@ -61,7 +73,7 @@ struct HashEdge {
 
 	  	// Ensure identical vertex ordering of equal edges.
 	  	// This method is numerically robust.
-	  	if (vertex_lower(*a, *b)) {
+	  	if (stl_vertex_lower(*a, *b)) {
 	  	} else {
 	  		// This edge is loaded backwards.
 		    std::swap(a, b);
@@ -112,12 +124,6 @@ struct HashEdge {
 		}
 		return true;
 	}
-
-private:
-	inline bool vertex_lower(const stl_vertex &a, const stl_vertex &b) {
-	  	return (a(0) != b(0)) ? (a(0) < b(0)) :
-	           ((a(1) != b(1)) ? (a(1) < b(1)) : (a(2) < b(2)));
-	}
 };
 
 struct HashTableEdges {
@@ -425,9 +431,132 @@ private:
 	}
 };
 
+// Key of an edge for exact matching: Coordinates of the sorted vertices of the edge, negative zeros replaced by positive zeros.
+// Equal to HashEdge::key as loaded by HashEdge::load_exact().
+struct ExactEdgeKey {
+	uint32_t key[6];
+	// Is this edge stored backwards? Not part of the key.
+	bool     backwards;
+
+	bool operator==(const ExactEdgeKey &rhs) const { return memcmp(key, rhs.key, sizeof(key)) == 0; }
+
+	ExactEdgeKey(const stl_facet &facet, int edge_idx)
+	{
+		const stl_vertex *a = &facet.vertex[edge_idx];
+		const stl_vertex *b = &facet.vertex[(edge_idx + 1) % 3];
+		backwards = ! stl_vertex_lower(*a, *b);
+		if (backwards)
+			std::swap(a, b);
+		memcpy(&key[0], a->data(), sizeof(stl_vertex));
+		memcpy(&key[3], b->data(), sizeof(stl_vertex));
+		for (uint32_t &k : key)
+			if (k == 0x80000000u)
+				// Negative zero, switch to positive zero.
+				k = 0;
+	}
+
+	uint64_t hash() const
+	{
+		uint64_t h = 0;
+		for (uint32_t k : key) {
+			h = (h ^ k) * 0xff51afd7ed558ccdULL;
+			h ^= h >> 29;
+		}
+		return h;
+	}
+};
+
+// Edge sorted by its hash, the value is 3 * facet_idx + edge_idx.
+struct EdgeHashItem {
+	uint64_t hash;
+	uint32_t value;
+};
+
+// Parallel most significant digit radix sort of the edges by their hashes. The edges are first partitioned
+// into buckets by the top bits of their hashes, then the buckets, which mostly fit into the L1 / L2 cache, are sorted
+// and handed over to process_bucket(const EdgeHashItem *begin, const EdgeHashItem *end) in parallel.
+// The sort is stable: Items with equal hashes remain in their input order.
+template<typename ProcessBucket>
+static void stl_radix_sort_edges(std::vector<EdgeHashItem> &items, ProcessBucket process_bucket)
+{
+	static constexpr size_t num_bits    = 11;
+	static constexpr size_t num_buckets = size_t(1) << num_bits;
+	const size_t num_items  = items.size();
+	const size_t num_blocks = std::max<size_t>(1, std::min<size_t>(64, num_items / 65536));
+	const size_t block_size = (num_items + num_blocks - 1) / num_blocks;
+	auto bucket = [](const EdgeHashItem &item) { return size_t(item.hash >> (64 - num_bits)); };
+
+	// Histograms of the blocks of the input, later converted to output offsets of the blocks.
+	std::vector<std::array<size_t, num_buckets>> offsets(num_blocks);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, num_blocks, 1), [&items, &offsets, &bucket, num_items, block_size](const tbb::blocked_range<size_t> &range) {
+		for (size_t iblock = range.begin(); iblock < range.end(); ++ iblock) {
+			std::array<size_t, num_buckets> &histogram = offsets[iblock];
+			histogram.fill(0);
+			for (size_t i = iblock * block_size; i < std::min(num_items, (iblock + 1) * block_size); ++ i)
+				++ histogram[bucket(items[i])];
+		}
+	});
+	std::vector<size_t> bucket_begin(num_buckets + 1, 0);
+	for (size_t ibucket = 0; ibucket < num_buckets; ++ ibucket) {
+		size_t offset = bucket_begin[ibucket];
+		for (std::array<size_t, num_buckets> &block_offsets : offsets) {
+			size_t cnt = block_offsets[ibucket];
+			block_offsets[ibucket] = offset;
+			offset += cnt;
+		}
+		bucket_begin[ibucket + 1] = offset;
+	}
+	std::vector<EdgeHashItem> sorted(num_items);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, num_blocks, 1), [&items, &sorted, &offsets, &bucket, num_items, block_size](const tbb::blocked_range<size_t> &range) {
+		for (size_t iblock = range.begin(); iblock < range.end(); ++ iblock) {
+			std::array<size_t, num_buckets> &block_offsets = offsets[iblock];
+			for (size_t i = iblock * block_size; i < std::min(num_items, (iblock + 1) * block_size); ++ i)
+				sorted[block_offsets[bucket(items[i])] ++] = items[i];
+		}
+	});
+	items.swap(sorted);
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, num_buckets, 16), [&items, &bucket_begin, &process_bucket](const tbb::blocked_range<size_t> &range) {
+		std::vector<EdgeHashItem> tmp;
+		std::vector<size_t>       sub_offsets;
+		auto sub_bucket = [](const EdgeHashItem &item) { return size_t(item.hash >> (64 - 2 * num_bits)) & (num_buckets - 1); };
+		for (size_t ibucket = range.begin(); ibucket < range.end(); ++ ibucket) {
+			EdgeHashItem *begin = items.data() + bucket_begin[ibucket];
+			EdgeHashItem *end   = items.data() + bucket_begin[ibucket + 1];
+			if (end - begin > 64) {
+				// Second pass of a stable counting sort by the next bits of the hashes, running inside the L1 / L2 cache.
+				sub_offsets.assign(num_buckets + 1, 0);
+				for (const EdgeHashItem *it = begin; it != end; ++ it)
+					++ sub_offsets[sub_bucket(*it) + 1];
+				for (size_t i = 1; i < num_buckets; ++ i)
+					sub_offsets[i] += sub_offsets[i - 1];
+				tmp.resize(end - begin);
+				for (const EdgeHashItem *it = begin; it != end; ++ it)
+					tmp[sub_offsets[sub_bucket(*it)] ++] = *it;
+				std::copy(tmp.begin(), tmp.end(), begin);
+			}
+			// Stable insertion sort of the nearly sorted items. As the input items were sorted by value and all the radix passes were stable,
+			// the items with equal hashes remain sorted by value.
+			for (EdgeHashItem *it = begin + 1; it < end; ++ it)
+				if (it->hash < (it - 1)->hash) {
+					EdgeHashItem  item = *it;
+					EdgeHashItem *dst  = it;
+					for (; dst != begin && item.hash < (dst - 1)->hash; -- dst)
+						*dst = *(dst - 1);
+					*dst = item;
+				}
+			process_bucket(begin, end);
+		}
+	});
+}
+
 // This function builds the neighbors list.  No modifications are made
 // to any of the facets.  The edges are said to match only if all six
 // floats of the first edge matches all six floats of the second edge.
+//
+// The edges are packed into 64 bit hashes of their keys, sorted by a parallel radix sort and the runs of edges
+// with equal hashes are connected in parallel. The result is identical to inserting the edges in order of facets
+// into a hash table: Each edge is connected with the first so far unconnected equal edge of another facet.
 void stl_check_facets_exact(stl_file *stl)
 {
 	assert(stl->facet_start.size() == stl->neighbors_start.size());
@@ -438,7 +567,7 @@ void stl_check_facets_exact(stl_file *stl)
   	stl->stats.connected_facets_3_edge = 0;
 
   	// If any two of the three vertices are found to be exactally the same, call them degenerate and remove the facet.
-  	// Do it before the next step, as the next step stores references to the face indices in the hash tables and removing a facet
+  	// Do it before the next step, as the next step stores references to the face indices in the edge list and removing a facet
   	// will break the references.
   	for (uint32_t i = 0; i < stl->stats.number_of_facets;) {
 		stl_facet &facet = stl->facet_start[i];
@@ -453,21 +582,86 @@ void stl_check_facets_exact(stl_file *stl)
 		  	++ i;
   	}
 
-  	// Initialize hash table.
-  	HashTableEdges hash_table(stl->stats.number_of_facets);
 	for (auto &neighbor : stl->neighbors_start)
 		neighbor.reset();
 
-  	// Connect neighbor edges.
-	for (uint32_t i = 0; i < stl->stats.number_of_facets; ++ i) {
-		const stl_facet &facet = stl->facet_start[i];
+	const size_t num_edges = 3 * size_t(stl->stats.number_of_facets);
+	std::vector<EdgeHashItem> edges(num_edges);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, stl->stats.number_of_facets, 16384), [stl, &edges](const tbb::blocked_range<size_t> &range) {
+		for (size_t i = range.begin(); i < range.end(); ++ i)
+			for (int j = 0; j < 3; ++ j)
+				edges[3 * i + j] = { ExactEdgeKey(stl->facet_start[i], j).hash(), uint32_t(3 * i + j) };
+	});
+	// The shortest edge is accumulated in the order of the facets, as the result of std::min() depends on the order with NaNs.
+	for (const stl_facet &facet : stl->facet_start)
 		for (int j = 0; j < 3; ++ j) {
-			HashEdge edge;
-			edge.facet_number = i;
-			edge.which_edge = j;
-			edge.load_exact(stl, &facet.vertex[j], &facet.vertex[(j + 1) % 3]);
-			hash_table.insert_edge_exact(stl, edge);
+	    	stl_vertex diff = (facet.vertex[j] - facet.vertex[(j + 1) % 3]).cwiseAbs();
+	    	float max_diff = std::max(diff(0), std::max(diff(1), diff(2)));
+	    	stl->stats.shortest_edge = std::min(max_diff, stl->stats.shortest_edge);
+		}
+
+	// Connect neighbor edges.
+	auto record_neighbors = [stl](uint32_t edge_a, const ExactEdgeKey &key_a, uint32_t edge_b, const ExactEdgeKey &key_b) {
+		int j_a = int(edge_a % 3);
+		int j_b = int(edge_b % 3);
+		// If both edges are oriented the same way, the facets are oriented in opposite directions, their normals are probably messed up.
+		int flipped = key_a.backwards == key_b.backwards ? 3 : 0;
+		// Facet a's neighbor is facet b
+		stl_neighbors &na = stl->neighbors_start[edge_a / 3];
+		na.neighbor[j_a] = int(edge_b / 3);
+		na.which_vertex_not[j_a] = char((j_b + 2) % 3 + flipped);
+		// Facet b's neighbor is facet a
+		stl_neighbors &nb = stl->neighbors_start[edge_b / 3];
+		nb.neighbor[j_b] = int(edge_a / 3);
+		nb.which_vertex_not[j_b] = char((j_a + 2) % 3 + flipped);
+	};
+	std::atomic<size_t> num_connected_edges(0);
+	stl_radix_sort_edges(edges, [stl, &record_neighbors, &num_connected_edges](const EdgeHashItem *begin, const EdgeHashItem *end) {
+		// Load the keys of the whole bucket first. The facets are accessed randomly, loading them in a tight loop
+		// lets the CPU overlap the cache misses.
+		std::vector<ExactEdgeKey> keys;
+		keys.reserve(end - begin);
+		for (const EdgeHashItem *it = begin; it != end; ++ it)
+			keys.emplace_back(stl->facet_start[it->value / 3], it->value % 3);
+		size_t num_connected = 0;
+		// Edges of the current run of equal hashes not connected yet.
+		std::vector<size_t> unconnected;
+		for (size_t run_begin = 0, num_items = end - begin; run_begin < num_items;) {
+			size_t run_end = run_begin + 1;
+			while (run_end < num_items && begin[run_end].hash == begin[run_begin].hash)
+				++ run_end;
+			if (run_end - run_begin == 2 && begin[run_begin].value / 3 != begin[run_begin + 1].value / 3 && keys[run_begin] == keys[run_begin + 1]) {
+				// Manifold edge.
+				record_neighbors(begin[run_begin + 1].value, keys[run_begin + 1], begin[run_begin].value, keys[run_begin]);
+				++ num_connected;
+			} else if (run_end - run_begin > 1) {
+				// Non-manifold edge or a hash collision: Connect an edge with the first unconnected equal edge of another facet.
+				unconnected.clear();
+				for (size_t i = run_begin; i < run_end; ++ i) {
+					uint32_t edge = begin[i].value;
+					auto it_other = std::find_if(unconnected.begin(), unconnected.end(), 
+						[begin, &keys, edge, i](size_t other) { return begin[other].value / 3 != edge / 3 && keys[other] == keys[i]; });
+					if (it_other == unconnected.end())
+						unconnected.emplace_back(i);
+					else {
+						record_neighbors(edge, keys[i], begin[*it_other].value, keys[*it_other]);
+						unconnected.erase(it_other);
+						++ num_connected;
+					}
+				}
+			}
+			run_begin = run_end;
 		}
+		num_connected_edges += num_connected;
+	});
+
+	// Count successful connects.
+	stl->stats.connected_edges = int(2 * num_connected_edges);
+	for (const stl_neighbors &neighbors : stl->neighbors_start) {
+		int num_neighbors = neighbors.num_neighbors();
+		stl->stats.connected_facets_1_edge += num_neighbors >= 1;
+		stl->stats.connected_facets_2_edge += num_neighbors >= 2;
+		stl->stats.connected_facets_3_edge += num_neighbors == 3;
 	}
 
 #if 0
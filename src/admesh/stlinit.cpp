@@ -24,12 +24,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include <assert.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <boost/log/trivial.hpp>
-#include <boost/nowide/cstdio.hpp>
 #include <boost/detail/endian.hpp>
 
+#include <tbb/parallel_for.h>
+
+#include <libslic3r/FileContents.hpp>
+
 #include "stl.h"
 
 #ifndef SEEK_SET
@@ -40,206 +48,447 @@
 extern void stl_internal_reverse_quads(char *buf, size_t cnt);
 #endif /* BOOST_LITTLE_ENDIAN */
 
-static FILE* stl_open_count_facets(stl_file *stl, const char *file) 
+static bool stl_open_count_facets_binary(stl_file *stl, const Slic3r::FileContents &contents, const char *file)
+{
+	// Test if the STL file has the right size.
+	size_t file_size = contents.size();
+	if (((file_size - HEADER_SIZE) % SIZEOF_STL_FACET != 0) || (file_size < STL_MIN_FILE_SIZE)) {
+		BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets_binary: The file " << file << " has the wrong size.";
+		return false;
+	}
+	uint32_t num_facets = uint32_t((file_size - HEADER_SIZE) / SIZEOF_STL_FACET);
+
+	// Read the header.
+	memcpy(stl->stats.header, contents.data(), LABEL_SIZE);
+
+	// Read the int following the header.  This should contain # of facets.
+	uint32_t header_num_facets;
+	memcpy(&header_num_facets, contents.data() + LABEL_SIZE, sizeof(uint32_t));
+#ifndef BOOST_LITTLE_ENDIAN
+	// Convert from little endian to big endian.
+	stl_internal_reverse_quads((char*)&header_num_facets, 4);
+#endif /* BOOST_LITTLE_ENDIAN */
+	if (num_facets != header_num_facets)
+		BOOST_LOG_TRIVIAL(info) << "stl_open_count_facets_binary: Warning: File size doesn't match number of facets in the header: " << file;
+
+	stl->stats.number_of_facets += num_facets;
+	stl->stats.original_num_facets = stl->stats.number_of_facets;
+	return true;
+}
+
+// Decode the binary facets in bulk. We assume little-endian architecture!
+static void stl_read_binary(stl_file *stl, const Slic3r::FileContents &contents)
 {
-  	// Open the file in binary mode first.
-  	FILE *fp = boost::nowide::fopen(file, "rb");
-  	if (fp == nullptr) {
-		BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: Couldn't open " << file << " for reading";
-    	return nullptr;
-  	}
-  	// Find size of file.
-  	fseek(fp, 0, SEEK_END);
-  	long file_size = ftell(fp);
-
-  	// Check for binary or ASCII file.
-  	fseek(fp, HEADER_SIZE, SEEK_SET);
-	unsigned char chtest[128];
-  	if (! fread(chtest, sizeof(chtest), 1, fp)) {
-		BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: The input is an empty file: " << file;
-    	fclose(fp);
-    	return nullptr;
-  	}
-  	stl->stats.type = ascii;
-  	for (size_t s = 0; s < sizeof(chtest); s++) {
-    	if (chtest[s] > 127) {
-      		stl->stats.type = binary;
-      		break;
-    	}
-  	}
-  	rewind(fp);
-
-  	uint32_t num_facets = 0;
-
-  	// Get the header and the number of facets in the .STL file.
-  	// If the .STL file is binary, then do the following:
-  	if (stl->stats.type == binary) {
-    	// Test if the STL file has the right size.
-    	if (((file_size - HEADER_SIZE) % SIZEOF_STL_FACET != 0) || (file_size < STL_MIN_FILE_SIZE)) {
-			BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: The file " << file << " has the wrong size.";
-      		fclose(fp);
-      		return nullptr;
-    	}
-    	num_facets = (file_size - HEADER_SIZE) / SIZEOF_STL_FACET;
-
-    	// Read the header.
-    	if (fread(stl->stats.header, LABEL_SIZE, 1, fp) > 79)
-      		stl->stats.header[80] = '\0';
-
-    	// Read the int following the header.  This should contain # of facets.
-	  	uint32_t header_num_facets;
-    	bool header_num_faces_read = fread(&header_num_facets, sizeof(uint32_t), 1, fp) != 0;
+	const char *src = contents.data() + HEADER_SIZE;
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, stl->stats.number_of_facets, 65536), [stl, src](const tbb::blocked_range<size_t> &range) {
+		for (size_t i = range.begin(); i < range.end(); ++ i) {
+			stl_facet &facet = stl->facet_start[i];
+			memcpy(&facet, src + i * SIZEOF_STL_FACET, SIZEOF_STL_FACET);
 #ifndef BOOST_LITTLE_ENDIAN
-    	// Convert from little endian to big endian.
-    	stl_internal_reverse_quads((char*)&header_num_facets, 4);
+			// Convert the loaded little endian data to big endian.
+			stl_internal_reverse_quads((char*)&facet, 48);
 #endif /* BOOST_LITTLE_ENDIAN */
-    	if (! header_num_faces_read || num_facets != header_num_facets)
-			BOOST_LOG_TRIVIAL(info) << "stl_open_count_facets: Warning: File size doesn't match number of facets in the header: " << file;
-  	}
-  	// Otherwise, if the .STL file is ASCII, then do the following:
-  	else
-  	{
-    	// Reopen the file in text mode (for getting correct newlines on Windows)
-    	// fix to silence a warning about unused return value.
-    	// obviously if it fails we have problems....
-    	fp = boost::nowide::freopen(file, "r", fp);
-
-		// do another null check to be safe
-    	if (fp == nullptr) {
-			BOOST_LOG_TRIVIAL(error) << "stl_open_count_facets: Couldn't open " << file << " for reading";
-      		fclose(fp);
-      		return nullptr;
-    	}
-    
-    	// Find the number of facets.
-		char linebuf[100];
-		int num_lines = 1;
-		while (fgets(linebuf, 100, fp) != nullptr) {
-		    // Don't count short lines.
-		    if (strlen(linebuf) <= 4)
-		    	continue;
-		    // Skip solid/endsolid lines as broken STL file generators may put several of them.
-		    if (strncmp(linebuf, "solid", 5) == 0 || strncmp(linebuf, "endsolid", 8) == 0)
-		    	continue;
-		    ++ num_lines;
 		}
+	});
+}
 
-    	rewind(fp);
-    
-    	// Get the header.
-		int i = 0;
-    	for (; i < 80 && (stl->stats.header[i] = getc(fp)) != '\n'; ++ i) ;
-    	stl->stats.header[i] = '\0'; // Lose the '\n'
-    	stl->stats.header[80] = '\0';
+// The ASCII STL used to be parsed with fscanf() and fgets(). The following helpers emulate these functions
+// on a memory buffer closely enough to load the very same facets, including the broken STLs the old parser accepted.
 
-    	num_facets = num_lines / ASCII_LINES_PER_FACET;
-  	}
+// isspace() in the "C" locale.
+static inline bool stl_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-  	stl->stats.number_of_facets += num_facets;
-  	stl->stats.original_num_facets = stl->stats.number_of_facets;
-  	return fp;
+static inline const char* stl_skip_space(const char *p, const char *end)
+{
+	for (; p < end && stl_is_space(*p); ++ p) ;
+	return p;
 }
 
-/* Reads the contents of the file pointed to by fp into the stl structure,
-   starting at facet first_facet.  The second argument says if it's our first
-   time running this for the stl and therefore we should reset our max and min stats. */
-static bool stl_read(stl_file *stl, FILE *fp, int first_facet, bool first)
+// Emulates the matching of a fscanf() format without conversions: A space skips any number of white spaces,
+// other characters have to match. Stops at the first mismatch, the mismatched character is not consumed.
+static bool stl_scanf_match(const char *&p, const char *end, const char *format)
 {
-	if (stl->stats.type == binary)
-    	fseek(fp, HEADER_SIZE, SEEK_SET);
-  	else
-    	rewind(fp);
-
-  	char normal_buf[3][32];
-  	for (uint32_t i = first_facet; i < stl->stats.number_of_facets; ++ i) {
-  	  	stl_facet facet;
-
-    	if (stl->stats.type == binary) {
-      		// Read a single facet from a binary .STL file. We assume little-endian architecture!
-      		if (fread(&facet, 1, SIZEOF_STL_FACET, fp) != SIZEOF_STL_FACET)
-      			return false;
-#ifndef BOOST_LITTLE_ENDIAN
-      		// Convert the loaded little endian data to big endian.
-      		stl_internal_reverse_quads((char*)&facet, 48);
-#endif /* BOOST_LITTLE_ENDIAN */
-    	} else {
-			// Read a single facet from an ASCII .STL file
-			// skip solid/endsolid
-			// (in this order, otherwise it won't work when they are paired in the middle of a file)
-			fscanf(fp, " endsolid%*[^\n]\n");
-			fscanf(fp, " solid%*[^\n]\n");  // name might contain spaces so %*s doesn't work and it also can be empty (just "solid")
-			// Leading space in the fscanf format skips all leading white spaces including numerous new lines and tabs.
-			int res_normal     = fscanf(fp, " facet normal %31s %31s %31s", normal_buf[0], normal_buf[1], normal_buf[2]);
-			assert(res_normal == 3);
-			int res_outer_loop = fscanf(fp, " outer loop");
-			assert(res_outer_loop == 0);
-			int res_vertex1    = fscanf(fp, " vertex %f %f %f", &facet.vertex[0](0), &facet.vertex[0](1), &facet.vertex[0](2));
-			assert(res_vertex1 == 3);
-			int res_vertex2    = fscanf(fp, " vertex %f %f %f", &facet.vertex[1](0), &facet.vertex[1](1), &facet.vertex[1](2));
-			assert(res_vertex2 == 3);
-			// Trailing whitespace is there to eat all whitespaces and empty lines up to the next non-whitespace.
-			int res_vertex3    = fscanf(fp, " vertex %f %f %f ", &facet.vertex[2](0), &facet.vertex[2](1), &facet.vertex[2](2));
-			assert(res_vertex3 == 3);
-			// Some G-code generators tend to produce text after "endloop" and "endfacet". Just ignore it.
-			char buf[2048];
-			fgets(buf, 2047, fp);
-			bool endloop_ok = strncmp(buf, "endloop", 7) == 0 && (buf[7] == '\r' || buf[7] == '\n' || buf[7] == ' ' || buf[7] == '\t');
-			assert(endloop_ok);
-			// Skip the trailing whitespaces and empty lines.
-			fscanf(fp, " ");
-			fgets(buf, 2047, fp);
-			bool endfacet_ok = strncmp(buf, "endfacet", 8) == 0 && (buf[8] == '\r' || buf[8] == '\n' || buf[8] == ' ' || buf[8] == '\t');
-			assert(endfacet_ok);
-			if (res_normal != 3 || res_outer_loop != 0 || res_vertex1 != 3 || res_vertex2 != 3 || res_vertex3 != 3 || ! endloop_ok || ! endfacet_ok) {
-				BOOST_LOG_TRIVIAL(error) << "Something is syntactically very wrong with this ASCII STL! ";
-				return false;
-			}
-
-			// The facet normal has been parsed as a single string as to workaround for not a numbers in the normal definition.
-			if (sscanf(normal_buf[0], "%f", &facet.normal(0)) != 1 ||
-			    sscanf(normal_buf[1], "%f", &facet.normal(1)) != 1 ||
-			    sscanf(normal_buf[2], "%f", &facet.normal(2)) != 1) {
-			    // Normal was mangled. Maybe denormals or "not a number" were stored?
-			  	// Just reset the normal and silently ignore it.
-			  	memset(&facet.normal, 0, sizeof(facet.normal));
-			}
+	for (; *format != 0; ++ format) {
+		if (*format == ' ')
+			p = stl_skip_space(p, end);
+		else if (p < end && *p == *format)
+			++ p;
+		else
+			return false;
+	}
+	return true;
+}
+
+// Emulates fgets() into a buffer of buffer_size characters. Returns a pointer to the end of the line read (including the newline).
+static inline const char* stl_fgets(const char *p, const char *end, size_t buffer_size)
+{
+	const char *last = p + std::min<size_t>(buffer_size - 1, end - p);
+	const char *eol  = static_cast<const char*>(memchr(p, '\n', last - p));
+	return eol ? eol + 1 : last;
+}
+
+// Emulates "%<max_len>s": Skips white spaces, then returns a token of at most max_len non-white space characters.
+static bool stl_scanf_token(const char *&p, const char *end, size_t max_len, const char *&token_begin, const char *&token_end)
+{
+	p = stl_skip_space(p, end);
+	if (p == end)
+		return false;
+	token_begin = p;
+	for (; p < end && size_t(p - token_begin) < max_len && ! stl_is_space(*p); ++ p) ;
+	token_end = p;
+	return true;
+}
+
+// Parses a decimal number [+-]?[0-9]*(\.[0-9]*)?([eE][+-]?[0-9]+)? terminated by a white space or by the end of the buffer,
+// and rounds it to float exactly as strtof() does.
+// Returns nullptr if the number cannot be decided by this fast path (infinities, NaNs, hexadecimal floats, characters glued
+// to the number, more than 19 significant digits, results outside of the normalized float range or close to a rounding tie).
+static const char* stl_parse_float_fast(const char *p, const char *end, float &out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p ++ == '-';
+	uint64_t mantissa    = 0;
+	int      num_digits  = 0;
+	int      exponent    = 0;
+	bool     has_digits  = false;
+	for (; p < end && *p >= '0' && *p <= '9'; ++ p) {
+		has_digits = true;
+		if (mantissa == 0 && *p == '0')
+			// Skip leading zeros.
+			continue;
+		if (num_digits ++ == 19)
+			return nullptr;
+		mantissa = mantissa * 10 + uint64_t(*p - '0');
+	}
+	if (p < end && *p == '.')
+		for (++ p; p < end && *p >= '0' && *p <= '9'; ++ p) {
+			has_digits = true;
+			-- exponent;
+			if (mantissa == 0 && *p == '0')
+				continue;
+			if (num_digits ++ == 19)
+				return nullptr;
+			mantissa = mantissa * 10 + uint64_t(*p - '0');
+		}
+	if (! has_digits)
+		return nullptr;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++ p;
+		bool exponent_negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			exponent_negative = *p ++ == '-';
+		if (p == end || *p < '0' || *p > '9')
+			return nullptr;
+		int e = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++ p)
+			if (e < 10000)
+				e = e * 10 + (*p - '0');
+		exponent += exponent_negative ? - e : e;
+	}
+	if (p < end && ! stl_is_space(*p))
+		return nullptr;
+	if (mantissa == 0) {
+		out = negative ? -0.f : 0.f;
+		return p;
+	}
+	// Both the mantissa and the power of ten are exactly representable, thus the quotient / product is correctly rounded to double.
+	static constexpr double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	if (mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+		return nullptr;
+	double d = exponent < 0 ? double(mantissa) / pow10[- exponent] : double(mantissa) * pow10[exponent];
+	if (d < double(FLT_MIN) || d > double(FLT_MAX))
+		return nullptr;
+	// Rounding the correctly rounded double to float yields the correctly rounded float,
+	// unless the double landed exactly half way between two floats.
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(d));
+	if ((bits & ((uint64_t(1) << 29) - 1)) == (uint64_t(1) << 28))
+		return nullptr;
+	out = negative ? - float(d) : float(d);
+	return p;
+}
+
+// Emulates sscanf(token, "%f%n") on a token of non-white space characters. Returns pointer to the first character not consumed
+// or nullptr if no number was parsed.
+static const char* stl_parse_float(const char *p, const char *end, float &out)
+{
+	if (const char *p_end = stl_parse_float_fast(p, end, out); p_end != nullptr)
+		return p_end;
+	// Let the C library handle the rare cases the fast path did not decide.
+	const char *token_end = p;
+	for (; token_end < end && ! stl_is_space(*token_end); ++ token_end) ;
+	std::string token(p, token_end);
+	int num_parsed = 0;
+	return sscanf(token.c_str(), "%f%n", &out, &num_parsed) == 1 ? p + num_parsed : nullptr;
+}
+
+// Emulates fscanf(" vertex %f %f %f").
+static bool stl_scanf_vertex(const char *&p, const char *end, stl_vertex &vertex)
+{
+	if (! stl_scanf_match(p, end, " vertex"))
+		return false;
+	for (int i = 0; i < 3; ++ i) {
+		p = stl_parse_float(stl_skip_space(p, end), end, vertex(i));
+		if (p == nullptr)
+			return false;
+	}
+	return true;
+}
+
+// Parse a single facet of an ASCII STL, starting at p. Returns false if something is syntactically very wrong.
+static bool stl_read_ascii_facet(const char *&p, const char *end, stl_facet &facet)
+{
+	const char *normal_token[3][2];
+	bool res_normal = stl_scanf_match(p, end, " facet normal");
+	for (int i = 0; res_normal && i < 3; ++ i)
+		res_normal = stl_scanf_token(p, end, 31, normal_token[i][0], normal_token[i][1]);
+	if (! res_normal)
+		return false;
+	// Missing "outer loop" has always been tolerated.
+	stl_scanf_match(p, end, " outer loop");
+	if (! stl_scanf_vertex(p, end, facet.vertex[0]) ||
+		! stl_scanf_vertex(p, end, facet.vertex[1]) ||
+		! stl_scanf_vertex(p, end, facet.vertex[2]))
+		return false;
+	// Eat all whitespaces and empty lines up to the next non-whitespace.
+	p = stl_skip_space(p, end);
+	// Some G-code generators tend to produce text after "endloop" and "endfacet". Just ignore it.
+	auto line_starts_with = [](const char *begin, const char *end, const char *keyword, size_t len) {
+		return size_t(end - begin) > len && strncmp(begin, keyword, len) == 0 &&
+			(begin[len] == '\r' || begin[len] == '\n' || begin[len] == ' ' || begin[len] == '\t');
+	};
+	if (p == end)
+		return false;
+	const char *line_end = stl_fgets(p, end, 2047);
+	if (! line_starts_with(p, line_end, "endloop", 7))
+		return false;
+	// Skip the trailing whitespaces and empty lines.
+	p = stl_skip_space(line_end, end);
+	if (p == end)
+		return false;
+	line_end = stl_fgets(p, end, 2047);
+	if (! line_starts_with(p, line_end, "endfacet", 8))
+		return false;
+	p = line_end;
+
+	// The facet normal has been parsed as a single string as to workaround for not a numbers in the normal definition.
+	for (int i = 0; i < 3; ++ i)
+		if (stl_parse_float(normal_token[i][0], normal_token[i][1], facet.normal(i)) == nullptr) {
+			// Normal was mangled. Maybe denormals or "not a number" were stored?
+			// Just reset the normal and silently ignore it.
+			facet.normal = stl_normal::Zero();
+			break;
 		}
+	return true;
+}
 
-#if 0
-		// Report close to zero vertex coordinates. Due to the nature of the floating point numbers,
-		// close to zero values may be represented with singificantly higher precision than the rest of the vertices.
-		// It may be worth to round these numbers to zero during loading to reduce the number of errors reported
-		// during the STL import.
-		for (size_t j = 0; j < 3; ++ j) {
-		if (facet.vertex[j](0) > -1e-12f && facet.vertex[j](0) < 1e-12f)
-		    printf("stl_read: facet %d(0) = %e\r\n", j, facet.vertex[j](0));
-		if (facet.vertex[j](1) > -1e-12f && facet.vertex[j](1) < 1e-12f)
-		    printf("stl_read: facet %d(1) = %e\r\n", j, facet.vertex[j](1));
-		if (facet.vertex[j](2) > -1e-12f && facet.vertex[j](2) < 1e-12f)
-		    printf("stl_read: facet %d(2) = %e\r\n", j, facet.vertex[j](2));
+// Count the lines the way the old loader did: Reading with fgets() into a 100 characters buffer, not counting
+// short lines nor the solid / endsolid lines.
+static size_t stl_count_ascii_lines(const char *begin, const char *end)
+{
+	size_t num_lines = 0;
+	for (const char *line = begin; line < end;) {
+		const char *eol  = static_cast<const char*>(memchr(line, '\n', end - line));
+		const char *next = eol ? eol + 1 : end;
+		size_t      len  = next - line;
+#ifdef _WIN32
+		// The file used to be read in text mode, where CRLF was converted to LF.
+		if (eol != nullptr && eol > line && eol[-1] == '\r')
+			-- len;
+#endif /* _WIN32 */
+		for (size_t offset = 0; offset < len; offset += 99) {
+			const char *s = line + offset;
+			size_t      l = std::min<size_t>(99, len - offset);
+			// Don't count short lines.
+			// Skip solid/endsolid lines as broken STL file generators may put several of them.
+			if (l > 4 && ! (l >= 5 && strncmp(s, "solid", 5) == 0) && ! (l >= 8 && strncmp(s, "endsolid", 8) == 0))
+				++ num_lines;
 		}
-#endif
+		line = next;
+	}
+	return num_lines;
+}
 
-		// Write the facet into memory.
-		stl->facet_start[i] = facet;
-		stl_facet_stats(stl, facet, first);
-  	}
-  
-  	stl->stats.size = stl->stats.max - stl->stats.min;
-  	stl->stats.bounding_diameter = stl->stats.size.norm();
-  	return true;
+// Find start of the next line starting with "facet normal", following the line containing p.
+static const char* stl_find_facet_line(const char *p, const char *end)
+{
+	while (p < end) {
+		const char *eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (eol == nullptr)
+			break;
+		const char *line = eol + 1;
+		const char *s    = line;
+		for (; s < end && (*s == ' ' || *s == '\t'); ++ s) ;
+		if (end - s > 5 && strncmp(s, "facet", 5) == 0 && (s[5] == ' ' || s[5] == '\t')) {
+			for (s += 5; s < end && (*s == ' ' || *s == '\t'); ++ s) ;
+			if (end - s >= 6 && strncmp(s, "normal", 6) == 0)
+				return line;
+		}
+		p = line;
+	}
+	return end;
+}
+
+struct StlAsciiChunk
+{
+	const char 			   *begin;
+	const char 			   *end;
+	size_t 					num_lines { 0 };
+	std::vector<stl_facet>  facets;
+	// Parsing stopped on a syntax error.
+	bool 					error { false };
+	// Parsing of the last facet continued past the end of this chunk.
+	bool 					overrun { false };
+};
+
+static void stl_read_ascii_chunk(StlAsciiChunk &chunk, const char *file_end)
+{
+	chunk.num_lines = stl_count_ascii_lines(chunk.begin, chunk.end);
+	chunk.facets.reserve((chunk.end - chunk.begin) / 200);
+	for (const char *p = chunk.begin;;) {
+		// Skip solid/endsolid
+		// (in this order, otherwise it won't work when they are paired in the middle of a file).
+		// The solid name might contain spaces and it also can be empty (just "solid").
+		if (stl_scanf_match(p, file_end, " endsolid"))
+			for (; p < file_end && *p != '\n'; ++ p) ;
+		if (stl_scanf_match(p, file_end, " solid"))
+			for (; p < file_end && *p != '\n'; ++ p) ;
+		p = stl_skip_space(p, file_end);
+		if (p >= chunk.end)
+			break;
+		stl_facet facet {};
+		if (! stl_read_ascii_facet(p, file_end, facet)) {
+			chunk.error = true;
+			break;
+		}
+		chunk.facets.emplace_back(facet);
+		if (p > chunk.end) {
+			chunk.overrun = true;
+			break;
+		}
+	}
+}
+
+// Split the ASCII STL into chunks at the "facet normal" lines and parse them in parallel.
+// Returns false if the file did not contain enough valid facets.
+static bool stl_read_ascii(stl_file *stl, const Slic3r::FileContents &contents)
+{
+	const char *begin = contents.data();
+	const char *end   = begin + contents.size();
+
+	std::vector<StlAsciiChunk> chunks;
+	{
+		static constexpr size_t chunk_size = 4 * 1024 * 1024;
+		const char *chunk_begin = begin;
+		while (chunk_begin < end) {
+			const char *chunk_end = (size_t(end - chunk_begin) <= chunk_size) ? end : stl_find_facet_line(chunk_begin + chunk_size, end);
+			chunks.push_back({ chunk_begin, chunk_end });
+			chunk_begin = chunk_end;
+		}
+	}
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1), [&chunks, end](const tbb::blocked_range<size_t> &range) {
+		for (size_t i = range.begin(); i < range.end(); ++ i)
+			stl_read_ascii_chunk(chunks[i], end);
+	});
+	if (std::any_of(chunks.begin(), chunks.end(), [](const StlAsciiChunk &chunk) { return chunk.overrun; })) {
+		// A facet was split by a chunk boundary, this is a very broken file. Parse it serially.
+		StlAsciiChunk chunk { begin, end };
+		stl_read_ascii_chunk(chunk, end);
+		chunks = { std::move(chunk) };
+	}
+
+	// Find the number of facets.
+	size_t num_lines = 1;
+	for (const StlAsciiChunk &chunk : chunks)
+		num_lines += chunk.num_lines;
+	uint32_t num_facets = uint32_t(num_lines / ASCII_LINES_PER_FACET);
+	stl->stats.number_of_facets += num_facets;
+	stl->stats.original_num_facets = stl->stats.number_of_facets;
+	stl_allocate(stl);
+
+	// Only the first number_of_facets facets are loaded, the rest of the file is ignored.
+	std::vector<size_t> chunk_offsets;
+	size_t 				num_facets_read = 0;
+	for (const StlAsciiChunk &chunk : chunks) {
+		if (num_facets_read >= num_facets)
+			break;
+		chunk_offsets.emplace_back(num_facets_read);
+		num_facets_read += chunk.facets.size();
+		if (chunk.error)
+			break;
+	}
+	if (num_facets_read < num_facets) {
+		BOOST_LOG_TRIVIAL(error) << "Something is syntactically very wrong with this ASCII STL! ";
+		return false;
+	}
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, chunk_offsets.size(), 1), [stl, &chunks, &chunk_offsets, num_facets](const tbb::blocked_range<size_t> &range) {
+		for (size_t i = range.begin(); i < range.end(); ++ i) {
+			const std::vector<stl_facet> &facets = chunks[i].facets;
+			size_t offset = chunk_offsets[i];
+			std::copy(facets.begin(), facets.begin() + std::min(facets.size(), num_facets - offset), stl->facet_start.begin() + offset);
+		}
+	});
+	return true;
 }
 
 bool stl_open(stl_file *stl, const char *file)
 {
 	stl->clear();
-	FILE *fp = stl_open_count_facets(stl, file);
-	if (fp == nullptr)
+
+	Slic3r::FileContents contents;
+	if (! contents.open(file)) {
+		BOOST_LOG_TRIVIAL(error) << "stl_open: Couldn't open " << file << " for reading";
 		return false;
-	stl_allocate(stl);
-	bool result = stl_read(stl, fp, 0, true);
-  	fclose(fp);
-  	return result;
+	}
+
+	// Check for binary or ASCII file.
+	if (contents.size() < HEADER_SIZE + 128) {
+		BOOST_LOG_TRIVIAL(error) << "stl_open: The input is an empty file: " << file;
+		return false;
+	}
+	stl->stats.type = ascii;
+	for (size_t s = HEADER_SIZE; s < HEADER_SIZE + 128; ++ s) {
+		if ((unsigned char)contents.data()[s] > 127) {
+			stl->stats.type = binary;
+			break;
+		}
+	}
+
+	if (stl->stats.type == binary) {
+		if (! stl_open_count_facets_binary(stl, contents, file))
+			return false;
+		stl_allocate(stl);
+		stl_read_binary(stl, contents);
+	} else {
+		// Get the header.
+		const char *data = contents.data();
+		size_t      i    = 0;
+		for (; i < 80 && data[i] != '\n'; ++ i) {
+#ifdef _WIN32
+			// The file used to be read in text mode, where CRLF was converted to LF.
+			if (data[i] == '\r' && data[i + 1] == '\n')
+				break;
+#endif /* _WIN32 */
+			stl->stats.header[i] = data[i];
+		}
+		stl->stats.header[i] = '\0'; // Lose the '\n'
+		if (! stl_read_ascii(stl, contents))
+			return false;
+	}
+
+	// While we are going through all of the facets, let's find the
+	// maximum and minimum values for x, y, and z
+	bool first = true;
+	for (const stl_facet &facet : stl->facet_start)
+		stl_facet_stats(stl, facet, first);
+	stl->stats.size = stl->stats.max - stl->stats.min;
+	stl->stats.bounding_diameter = stl->stats.size.norm();
+	return true;
 }
 
 void stl_allocate(stl_file *stl) 
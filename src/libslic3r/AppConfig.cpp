@@ -106,6 +106,11 @@ void AppConfig::set_defaults()
 
         if (get("use_inches").empty())
             set("use_inches", "0");
+
+        // Keep the G-code processor state of the last export to resume the processing of the next one from the first changed layer.
+        // Disabled by default, the kept moves take about as much memory as the preview of the G-code.
+        if (get("gcode_processor_checkpoints").empty())
+            set("gcode_processor_checkpoints", "0");
 #if ENABLE_GCODE_APP_CONFIG
     }
 
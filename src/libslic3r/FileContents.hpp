@@ -0,0 +1,64 @@
+#ifndef slic3r_FileContents_hpp_
+#define slic3r_FileContents_hpp_
+
+// Header only, included by admesh as well.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/nowide/cstdio.hpp>
+
+namespace Slic3r {
+
+// Read only view of the complete content of a file, used to read the STL files, the G-code files and their indices.
+// The file is memory mapped if possible. If the memory mapping fails (for example because the memory mapping API
+// does not accept UTF-8 file names on Windows), the file is read into memory with a single fread() call.
+class FileContents
+{
+public:
+    bool open(const std::string &file)
+    {
+        try {
+            m_mapping = boost::interprocess::file_mapping(file.c_str(), boost::interprocess::read_only);
+            m_region  = boost::interprocess::mapped_region(m_mapping, boost::interprocess::read_only);
+            m_data    = static_cast<const char*>(m_region.get_address());
+            m_size    = m_region.get_size();
+            return true;
+        } catch (const std::exception &) {
+            // Empty files cannot be mapped, file names may not be supported by the memory mapping API.
+            // Fall back to reading the file.
+        }
+        FILE *fp = boost::nowide::fopen(file.c_str(), "rb");
+        if (fp == nullptr)
+            return false;
+        fseek(fp, 0, SEEK_END);
+        long file_size = ftell(fp);
+        rewind(fp);
+        bool ok = file_size >= 0;
+        if (ok) {
+            m_buffer.assign(size_t(file_size), 0);
+            ok = m_buffer.empty() || fread(m_buffer.data(), m_buffer.size(), 1, fp) == 1;
+        }
+        fclose(fp);
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+        return ok;
+    }
+
+    const char* data() const { return m_data; }
+    size_t      size() const { return m_size; }
+
+private:
+    boost::interprocess::file_mapping  m_mapping;
+    boost::interprocess::mapped_region m_region;
+    std::vector<char>                  m_buffer;
+    const char                        *m_data = nullptr;
+    size_t                             m_size = 0;
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_FileContents_hpp_
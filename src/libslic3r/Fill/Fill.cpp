@@ -12,6 +12,8 @@
 #include "FillBase.hpp"
 #include "FillRectilinear2.hpp"
 
+#include <tbb/parallel_for.h>
+
 namespace Slic3r {
 
 struct SurfaceFillParams
@@ -338,8 +340,8 @@ void Layer::make_fills(FillAdaptive::Octree* adaptive_fill_octree, FillAdaptive:
 	}
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
-    for (SurfaceFill &surface_fill : surface_fills) {
-        // Create the filler object.
+    // Create and set up the filler object of a surface fill.
+    auto new_filler = [this, &bbox, adaptive_fill_octree, support_fill_octree](const SurfaceFill &surface_fill) {
         std::unique_ptr<Fill> f = std::unique_ptr<Fill>(Fill::new_from_type(surface_fill.params.pattern));
         f->set_bounding_box(bbox);
         f->layer_id = this->id();
@@ -348,7 +350,6 @@ void Layer::make_fills(FillAdaptive::Octree* adaptive_fill_octree, FillAdaptive:
         f->adapt_fill_octree = (surface_fill.params.pattern == ipSupportCubic) ? support_fill_octree : adaptive_fill_octree;
 
         // calculate flow spacing for infill pattern generation
-        bool using_internal_flow = ! surface_fill.surface.is_solid() && ! surface_fill.params.flow.bridge;
         double link_max_length = 0.;
         if (! surface_fill.params.flow.bridge) {
 #if 0
@@ -364,47 +365,79 @@ void Layer::make_fills(FillAdaptive::Octree* adaptive_fill_octree, FillAdaptive:
         f->link_max_length = (coord_t)scale_(link_max_length);
         // Used by the concentric infill pattern to clip the loops to create extrusion paths.
         f->loop_clipping = coord_t(scale_(surface_fill.params.flow.nozzle_diameter) * LOOP_CLIPPING_LENGTH_OVER_NOZZLE_DIAMETER);
-
-        // apply half spacing using this flow's own spacing and generate infill
-        FillParams params;
-        params.density 		= float(0.01 * surface_fill.params.density);
-        params.dont_adjust 	= surface_fill.params.dont_adjust; // false
-
-        for (ExPolygon &expoly : surface_fill.expolygons) {
-			// Spacing is modified by the filler to indicate adjustments. Reset it for each expolygon.
-			f->spacing = surface_fill.params.spacing;
-			surface_fill.surface.expolygon = std::move(expoly);
-			Polylines polylines;
-			try {
-				polylines = f->fill_surface(&surface_fill.surface, params);
-			} catch (InfillFailedException &) {
-			}
-	        if (! polylines.empty()) {
-		        // calculate actual flow from spacing (which might have been adjusted by the infill
-		        // pattern generator)
-		        double flow_mm3_per_mm = surface_fill.params.flow.mm3_per_mm();
-		        double flow_width      = surface_fill.params.flow.width;
-		        if (using_internal_flow) {
-		            // if we used the internal flow we're not doing a solid infill
-		            // so we can safely ignore the slight variation that might have
-		            // been applied to f->spacing
-		        } else {
-		            Flow new_flow = Flow::new_from_spacing(float(f->spacing), surface_fill.params.flow.nozzle_diameter, surface_fill.params.flow.height, surface_fill.params.flow.bridge);
-		        	flow_mm3_per_mm = new_flow.mm3_per_mm();
-		        	flow_width      = new_flow.width;
-		        }
-		        // Save into layer.
-				ExtrusionEntityCollection* eec = nullptr;
-		        m_regions[surface_fill.region_id]->fills.entities.push_back(eec = new ExtrusionEntityCollection());
-		        // Only concentric fills are not sorted.
-		        eec->no_sort = f->no_sort();
-		        extrusion_entities_append_paths(
-		            eec->entities, std::move(polylines),
-		            surface_fill.params.extrusion_role,
-		            flow_mm3_per_mm, float(flow_width), surface_fill.params.flow.height);
-		    }
-		}
-    }
+        return f;
+    };
+
+    // A layer may consist of many small islands, thus the expolygons of all the surface fills are filled in parallel.
+    // The results are collected in the order of the expolygons to keep the output deterministic.
+    struct FillTask {
+        size_t      surface_fill_id;
+        ExPolygon  *expolygon;
+        // Spacing as adjusted by the filler.
+        coordf_t    spacing;
+        bool        no_sort;
+        Polylines   polylines;
+    };
+    std::vector<FillTask> fill_tasks;
+    for (size_t surface_fill_id = 0; surface_fill_id < surface_fills.size(); ++ surface_fill_id)
+        for (ExPolygon &expoly : surface_fills[surface_fill_id].expolygons)
+            fill_tasks.push_back({ surface_fill_id, &expoly, 0., false, Polylines() });
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, fill_tasks.size()),
+        [&surface_fills, &fill_tasks, &new_filler](const tbb::blocked_range<size_t> &range) {
+        // Filler objects are reused by the expolygons of the same surface fill processed by this task.
+        std::vector<std::unique_ptr<Fill>> fillers(surface_fills.size());
+        for (size_t task_id = range.begin(); task_id < range.end(); ++ task_id) {
+            FillTask          &task         = fill_tasks[task_id];
+            const SurfaceFill &surface_fill = surface_fills[task.surface_fill_id];
+            std::unique_ptr<Fill> &f = fillers[task.surface_fill_id];
+            if (! f)
+                f = new_filler(surface_fill);
+            // apply half spacing using this flow's own spacing and generate infill
+            FillParams params;
+            params.density 		= float(0.01 * surface_fill.params.density);
+            params.dont_adjust 	= surface_fill.params.dont_adjust; // false
+            // Spacing is modified by the filler to indicate adjustments. Reset it for each expolygon.
+            f->spacing = surface_fill.params.spacing;
+            // The expolygon of the surface fill template was moved out by group_fills(), thus copying the template is cheap.
+            Surface surface(surface_fill.surface);
+            surface.expolygon = std::move(*task.expolygon);
+            try {
+                task.polylines = f->fill_surface(&surface, params);
+            } catch (InfillFailedException &) {
+            }
+            task.spacing = f->spacing;
+            task.no_sort = f->no_sort();
+        }
+    });
+
+    for (FillTask &task : fill_tasks)
+        if (! task.polylines.empty()) {
+            const SurfaceFill &surface_fill = surface_fills[task.surface_fill_id];
+	        // calculate actual flow from spacing (which might have been adjusted by the infill
+	        // pattern generator)
+	        double flow_mm3_per_mm = surface_fill.params.flow.mm3_per_mm();
+	        double flow_width      = surface_fill.params.flow.width;
+	        bool   using_internal_flow = ! surface_fill.surface.is_solid() && ! surface_fill.params.flow.bridge;
+	        if (using_internal_flow) {
+	            // if we used the internal flow we're not doing a solid infill
+	            // so we can safely ignore the slight variation that might have
+	            // been applied to the spacing by the filler
+	        } else {
+	            Flow new_flow = Flow::new_from_spacing(float(task.spacing), surface_fill.params.flow.nozzle_diameter, surface_fill.params.flow.height, surface_fill.params.flow.bridge);
+	        	flow_mm3_per_mm = new_flow.mm3_per_mm();
+	        	flow_width      = new_flow.width;
+	        }
+	        // Save into layer.
+			ExtrusionEntityCollection* eec = nullptr;
+	        m_regions[surface_fill.region_id]->fills.entities.push_back(eec = new ExtrusionEntityCollection());
+	        // Only concentric fills are not sorted.
+	        eec->no_sort = task.no_sort;
+	        extrusion_entities_append_paths(
+	            eec->entities, std::move(task.polylines),
+	            surface_fill.params.extrusion_role,
+	            flow_mm3_per_mm, float(flow_width), surface_fill.params.flow.height);
+	    }
 
     // add thin fill regions
     // Unpacks the collection, creates multiple collections per path.
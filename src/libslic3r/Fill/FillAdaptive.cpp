@@ -14,11 +14,14 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <bitset>
 
 // Boost pool: Don't use mutexes to synchronize memory allocation.
 #define BOOST_POOL_NO_MT
 #include <boost/pool/object_pool.hpp>
 
+#include <tbb/parallel_for.h>
+
 namespace Slic3r {
 namespace FillAdaptive {
 
@@ -228,14 +231,22 @@ static constexpr std::array<std::array<int, 8>, 3> child_traversal_order {
     std::array<int, 8>{ 1, 5, 0, 4, 3, 7, 2, 6 },
 };
 
+// Cube of the octree stored in Octree::cubes.
 struct Cube
 {
-    Vec3d center;
+    Vec3d       center;
 #ifndef NDEBUG
-    Vec3d center_octree;
+    Vec3d       center_octree;
 #endif // NDEBUG
-    std::array<Cube*, 8> children {}; // initialized to nullptrs
+    // Index of the first child in Octree::cubes, the children are stored next to each other in the order of child_centers.
+    uint32_t    first_child   { 0 };
+    // Bit i is set if the i-th child is present.
+    uint8_t     children_mask { 0 };
+
     Cube(const Vec3d &center) : center(center) {}
+    // Index of the i-th child in Octree::cubes, zero (the root cube) if there is no such child.
+    size_t      child(int i) const
+        { return (children_mask & (1 << i)) ? first_child + std::bitset<8>(children_mask & ((1 << i) - 1)).count() : 0; }
 };
 
 struct CubeProperties
@@ -249,17 +260,15 @@ struct CubeProperties
 
 struct Octree
 {
-    // Octree will allocate its Cubes from the pool. The pool only supports deletion of the complete pool,
-    // perfect for building up our octree.
-    boost::object_pool<Cube>    pool;
-    Cube*                       root_cube { nullptr };
+    // Cubes in a breadth-first order, the root cube first.
+    std::vector<Cube>           cubes;
     Vec3d                       origin;
     std::vector<CubeProperties> cubes_properties;
 
     Octree(const Vec3d &origin, const std::vector<CubeProperties> &cubes_properties)
-        : root_cube(pool.construct(origin)), origin(origin), cubes_properties(cubes_properties) {}
+        : cubes{ Cube(origin) }, origin(origin), cubes_properties(cubes_properties) {}
 
-    void insert_triangle(const Vec3d &a, const Vec3d &b, const Vec3d &c, Cube *current_cube, const BoundingBoxf3 &current_bbox, int depth);
+    const Cube*                 root_cube() const { return &this->cubes.front(); }
 };
 
 void OctreeDeleter::operator()(Octree *p) {
@@ -360,6 +369,7 @@ struct FillContext
     };
 
     FillContext(const Octree &octree, double z_position, int direction_idx) :
+        cubes(octree.cubes),
         cubes_properties(octree.cubes_properties),
         z_position(z_position),
         traversal_order(child_traversal_order[direction_idx]),
@@ -373,6 +383,7 @@ struct FillContext
     // Rotate the point, uses the same convention as Point::rotate().
     Vec2d rotate(const Vec2d& v) { return Vec2d(this->cos_a * v.x() - this->sin_a * v.y(), this->sin_a * v.x() + this->cos_a * v.y()); }
 
+    const std::vector<Cube>            &cubes;
     const std::vector<CubeProperties>  &cubes_properties;
     // Top of the current layer.
     const double                        z_position;
@@ -416,7 +427,7 @@ static bool verify_traversal_order(
     for (int i = 0; i < 8; ++i) {
         int j = context.traversal_order[i];
         Vec3d cntr = to_world * (cube->center_octree + (child_centers[j] * (context.cubes_properties[depth].edge_length / 4.)));
-        assert(!cube->children[j] || cube->children[j]->center.isApprox(cntr));
+        assert(! cube->child(j) || context.cubes[cube->child(j)].center.isApprox(cntr));
         c[i] = cntr;
     }
     std::array<Vec3d, 10> dirs = {
@@ -487,9 +498,8 @@ static void generate_infill_lines_recursive(
     -- depth;
     size_t i = 0;
     for (const int child_idx : context.traversal_order) {
-        const Cube *child = cube->children[child_idx];
-        if (child != nullptr)
-            generate_infill_lines_recursive(context, child, address, depth);
+        if (size_t child = cube->child(child_idx); child != 0)
+            generate_infill_lines_recursive(context, &context.cubes[child], address, depth);
         if (++ i == 4)
             // right child index
             ++ address;
@@ -566,7 +576,7 @@ void Filler::_fill_surface_single(
         // Generate the infill lines along the octree cells, merge touching lines of the same direction.
         size_t num_lines = 0;
         for (auto &context : contexts) {
-            generate_infill_lines_recursive(context, adapt_fill_octree->root_cube, 0, int(adapt_fill_octree->cubes_properties.size()) - 1);
+            generate_infill_lines_recursive(context, adapt_fill_octree->root_cube(), 0, int(adapt_fill_octree->cubes_properties.size()) - 1);
             num_lines += context.output_lines.size() + context.temp_lines.size();
         }
         // Collect the lines.
@@ -648,15 +658,80 @@ static inline bool is_overhang_triangle(const Vec3d &a, const Vec3d &b, const Ve
     return n.dot(up) > 0.707 * n.norm();
 }
 
-static void transform_center(Cube *current_cube, const Eigen::Matrix3d &rot)
+// Cube of the octree being built, the octree is then flattened into Octree::cubes.
+struct BuildCube
+{
+    Vec3d                       center;
+    std::array<BuildCube*, 8>   children {}; // initialized to nullptrs
+    BuildCube(const Vec3d &center) : center(center) {}
+};
+
+// The octree being built will allocate its cubes from the pools. The pool only supports deletion of the complete pool,
+// perfect for building up our octree.
+using BuildCubePool = boost::object_pool<BuildCube>;
+
+// Center of the i-th child of a cube, the child is at the given depth.
+static inline Vec3d child_center(const Vec3d &center, size_t i, const std::vector<CubeProperties> &cubes_properties, int depth)
+{
+    return center + (child_centers[i] * (cubes_properties[depth].edge_length / 2.));
+}
+
+// Calculate a slightly expanded bounding box of the i-th child of a cube to cope with triangles touching a cube wall and other numeric errors.
+// We will rather densify the octree a bit more than necessary instead of missing a triangle.
+static inline BoundingBoxf3 child_bbox(const BoundingBoxf3 &bbox, const Vec3d &center, size_t i)
 {
+    const Vec3d &child_center_dir = child_centers[i];
+    BoundingBoxf3 out;
+    for (int k = 0; k < 3; ++ k) {
+        if (child_center_dir[k] == -1.) {
+            out.min[k] = bbox.min[k];
+            out.max[k] = center[k] + EPSILON;
+        } else {
+            out.min[k] = center[k] - EPSILON;
+            out.max[k] = bbox.max[k];
+        }
+    }
+    return out;
+}
+
+static void insert_triangle(
+    const Vec3d &a, const Vec3d &b, const Vec3d &c, BuildCube *current_cube, const BoundingBoxf3 &current_bbox, int depth,
+    const std::vector<CubeProperties> &cubes_properties, BuildCubePool &pool)
+{
+    assert(current_cube);
+    assert(depth > 0);
+
+    -- depth;
+    for (size_t i = 0; i < 8; ++ i) {
+        BoundingBoxf3 bbox = child_bbox(current_bbox, current_cube->center, i);
+        if (triangle_AABB_intersects(a, b, c, bbox)) {
+            if (! current_cube->children[i])
+                current_cube->children[i] = pool.construct(child_center(current_cube->center, i, cubes_properties, depth));
+            if (depth > 0)
+                insert_triangle(a, b, c, current_cube->children[i], bbox, depth, cubes_properties, pool);
+        }
+    }
+}
+
+// Store the octree being built into octree.cubes in a breadth-first order, rotate the cubes by rot.
+static void flatten_octree(const BuildCube *root, const Eigen::Matrix3d &rot, Octree &octree)
+{
+    std::vector<const BuildCube*> queue { root };
+    octree.cubes.assign(1, Cube(root->center));
+    for (size_t i = 0; i < queue.size(); ++ i) {
+        const BuildCube *build_cube = queue[i];
+        octree.cubes[i].first_child = uint32_t(octree.cubes.size());
+        for (size_t j = 0; j < 8; ++ j)
+            if (const BuildCube *child = build_cube->children[j]; child != nullptr) {
+                octree.cubes[i].children_mask |= uint8_t(1 << j);
+                queue.emplace_back(child);
+                octree.cubes.emplace_back(child->center);
+            }
 #ifndef NDEBUG
-    current_cube->center_octree = current_cube->center;
+        octree.cubes[i].center_octree = octree.cubes[i].center;
 #endif // NDEBUG
-    current_cube->center = rot * current_cube->center;
-    for (auto *child : current_cube->children)
-        if (child)
-            transform_center(child, rot);
+        octree.cubes[i].center = rot * octree.cubes[i].center;
+    }
 }
 
 OctreePtr build_octree(
@@ -677,70 +752,120 @@ OctreePtr build_octree(
     auto                        octree           = OctreePtr(new Octree(cube_center, cubes_properties));
 
     if (cubes_properties.size() > 1) {
-        Octree *octree_ptr = octree.get();
-        double edge_length_half = 0.5 * cubes_properties.back().edge_length;
-        Vec3d  diag_half(edge_length_half, edge_length_half, edge_length_half);
-        int    max_depth = int(cubes_properties.size()) - 1;
-        auto process_triangle = [octree_ptr, max_depth, diag_half](const Vec3d &a, const Vec3d &b, const Vec3d &c) {
-            octree_ptr->insert_triangle(
-                a, b, c,
-                octree_ptr->root_cube,
-                BoundingBoxf3(octree_ptr->root_cube->center - diag_half, octree_ptr->root_cube->center + diag_half),
-                max_depth);
-        };
+        // Triangles to be inserted into the octree, three vertices per triangle.
+        std::vector<Vec3d> triangles;
         auto up_vector = support_overhangs_only ? Vec3d(transform_to_octree() * Vec3d(0., 0., 1.)) : Vec3d();
         for (auto &tri : triangle_mesh.indices) {
             auto a = triangle_mesh.vertices[tri[0]].cast<double>();
             auto b = triangle_mesh.vertices[tri[1]].cast<double>();
             auto c = triangle_mesh.vertices[tri[2]].cast<double>();
-            if (! support_overhangs_only || is_overhang_triangle(a, b, c, up_vector))
-                process_triangle(a, b, c);
+            if (! support_overhangs_only || is_overhang_triangle(a, b, c, up_vector)) {
+                triangles.emplace_back(a);
+                triangles.emplace_back(b);
+                triangles.emplace_back(c);
+            }
         }
-        for (size_t i = 0; i < overhang_triangles.size(); i += 3)
-            process_triangle(overhang_triangles[i], overhang_triangles[i + 1], overhang_triangles[i + 2]);
-        {
-            // Transform the octree to world coordinates to reduce computation when extracting infill lines.
-            auto rot = transform_to_world().toRotationMatrix();
-            transform_center(octree->root_cube, rot);
-            octree->origin = rot * octree->origin;
+        append(triangles, overhang_triangles);
+        const size_t num_triangles = triangles.size() / 3;
+
+        double              edge_length_half = 0.5 * cubes_properties.back().edge_length;
+        Vec3d               diag_half(edge_length_half, edge_length_half, edge_length_half);
+        int                 max_depth = int(cubes_properties.size()) - 1;
+        BuildCubePool       pool;
+        BuildCube          *root      = pool.construct(cube_center);
+        const BoundingBoxf3 root_bbox(cube_center - diag_half, cube_center + diag_half);
+
+        // Subtrees of the cubes at the 2nd level of the octree, each allocating its cubes from its own pool.
+        struct Subtree {
+            Vec3d               center;
+            BoundingBoxf3       bbox;
+            // Triangles intersecting the bounding box of the cube.
+            std::vector<size_t> triangles;
+            BuildCubePool       pool;
+        };
+        std::vector<Subtree> subtrees(max_depth > 1 ? 64 : 0);
+
+        if (max_depth == 1) {
+            for (size_t i = 0; i < num_triangles; ++ i)
+                insert_triangle(triangles[i * 3], triangles[i * 3 + 1], triangles[i * 3 + 2], root, root_bbox, max_depth, cubes_properties, pool);
+        } else {
+            // The cubes of the two top levels are created first, collecting the triangles intersecting each cube of the 2nd level,
+            // then the subtrees of the 2nd level cubes are built in parallel. The octree does not depend on the order
+            // in which the triangles are inserted, thus it is the same as if the triangles were inserted one by one.
+            std::array<Vec3d, 8>         level1_centers;
+            std::array<BoundingBoxf3, 8> level1_bboxes;
+            for (size_t i = 0; i < 8; ++ i) {
+                level1_centers[i] = child_center(cube_center, i, cubes_properties, max_depth - 1);
+                level1_bboxes[i]  = child_bbox(root_bbox, cube_center, i);
+                for (size_t j = 0; j < 8; ++ j) {
+                    subtrees[i * 8 + j].center = child_center(level1_centers[i], j, cubes_properties, max_depth - 2);
+                    subtrees[i * 8 + j].bbox   = child_bbox(level1_bboxes[i], level1_centers[i], j);
+                }
+            }
+
+            // The triangles are classified in chunks in parallel, the chunks are then concatenated.
+            struct Chunk {
+                // Bit i is set if the i-th cube of the 1st level is intersected by a triangle.
+                uint8_t                                level1_mask { 0 };
+                std::array<std::vector<size_t>, 64>    triangles;
+            };
+            static constexpr size_t chunk_size = 4096;
+            std::vector<Chunk> chunks((num_triangles + chunk_size - 1) / chunk_size);
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()),
+                [&triangles, &level1_bboxes, &subtrees, &chunks, num_triangles](const tbb::blocked_range<size_t> &range) {
+                for (size_t chunk_idx = range.begin(); chunk_idx < range.end(); ++ chunk_idx) {
+                    Chunk &chunk = chunks[chunk_idx];
+                    for (size_t idx = chunk_idx * chunk_size; idx < std::min(num_triangles, (chunk_idx + 1) * chunk_size); ++ idx) {
+                        const Vec3d &a = triangles[idx * 3];
+                        const Vec3d &b = triangles[idx * 3 + 1];
+                        const Vec3d &c = triangles[idx * 3 + 2];
+                        for (size_t i = 0; i < 8; ++ i)
+                            if (triangle_AABB_intersects(a, b, c, level1_bboxes[i])) {
+                                chunk.level1_mask |= uint8_t(1 << i);
+                                for (size_t j = 0; j < 8; ++ j)
+                                    if (triangle_AABB_intersects(a, b, c, subtrees[i * 8 + j].bbox))
+                                        chunk.triangles[i * 8 + j].emplace_back(idx);
+                            }
+                    }
+                }
+            });
+
+            uint8_t level1_mask = 0;
+            for (const Chunk &chunk : chunks)
+                level1_mask |= chunk.level1_mask;
+            for (size_t i = 0; i < 8; ++ i)
+                if (level1_mask & (1 << i)) {
+                    root->children[i] = pool.construct(level1_centers[i]);
+                    for (size_t j = 0; j < 8; ++ j) {
+                        Subtree &subtree = subtrees[i * 8 + j];
+                        for (const Chunk &chunk : chunks)
+                            append(subtree.triangles, chunk.triangles[i * 8 + j]);
+                        if (! subtree.triangles.empty())
+                            root->children[i]->children[j] = pool.construct(subtree.center);
+                    }
+                }
+            chunks.clear();
+
+            if (max_depth > 2)
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, subtrees.size(), 1),
+                    [root, max_depth, &triangles, &subtrees, &cubes_properties](const tbb::blocked_range<size_t> &range) {
+                    for (size_t k = range.begin(); k < range.end(); ++ k)
+                        if (Subtree &subtree = subtrees[k]; ! subtree.triangles.empty()) {
+                            BuildCube *cube = root->children[k / 8]->children[k % 8];
+                            for (size_t idx : subtree.triangles)
+                                insert_triangle(triangles[idx * 3], triangles[idx * 3 + 1], triangles[idx * 3 + 2], cube, subtree.bbox, max_depth - 2, cubes_properties, subtree.pool);
+                        }
+                });
         }
+
+        // Transform the octree to world coordinates to reduce computation when extracting infill lines.
+        auto rot = transform_to_world().toRotationMatrix();
+        flatten_octree(root, rot, *octree);
+        octree->origin = rot * octree->origin;
     }
 
     return octree;
 }
 
-void Octree::insert_triangle(const Vec3d &a, const Vec3d &b, const Vec3d &c, Cube *current_cube, const BoundingBoxf3 &current_bbox, int depth)
-{
-    assert(current_cube);
-    assert(depth > 0);
-
-    // Squared radius of a sphere around the child cube.
-    const double r2_cube = Slic3r::sqr(0.5 * this->cubes_properties[-- depth].height + EPSILON);
-
-    for (size_t i = 0; i < 8; ++ i) {
-        const Vec3d &child_center_dir = child_centers[i];
-        // Calculate a slightly expanded bounding box of a child cube to cope with triangles touching a cube wall and other numeric errors.
-        // We will rather densify the octree a bit more than necessary instead of missing a triangle.
-        BoundingBoxf3 bbox;
-        for (int k = 0; k < 3; ++ k) {
-            if (child_center_dir[k] == -1.) {
-                bbox.min[k] = current_bbox.min[k];
-                bbox.max[k] = current_cube->center[k] + EPSILON;
-            } else {
-                bbox.min[k] = current_cube->center[k] - EPSILON;
-                bbox.max[k] = current_bbox.max[k];
-            }
-        }
-        Vec3d child_center = current_cube->center + (child_center_dir * (this->cubes_properties[depth].edge_length / 2.));
-        //if (dist2_to_triangle(a, b, c, child_center) < r2_cube) {
-        if (triangle_AABB_intersects(a, b, c, bbox)) {
-            if (! current_cube->children[i])
-                current_cube->children[i] = this->pool.construct(child_center);
-            if (depth > 0)
-                this->insert_triangle(a, b, c, current_cube->children[i], bbox, depth);
-        }
-    }
-}
-
 } // namespace FillAdaptive
 } // namespace Slic3r
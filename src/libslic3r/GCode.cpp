@@ -7,6 +7,7 @@
 #include "Geometry.hpp"
 #include "GCode/PrintExtents.hpp"
 #include "GCode/WipeTower.hpp"
+#include "GCode/GCodeIndex.hpp"
 #include "ShortestPath.hpp"
 #include "Print.hpp"
 #include "Utils.hpp"
@@ -14,8 +15,10 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <math.h>
 #include <string_view>
+#include <type_traits>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/find.hpp>
@@ -31,6 +34,7 @@
 #include "SVG.hpp"
 
 #include <tbb/parallel_for.h>
+#include <tbb/pipeline.h>
 
 #include <Shiny/Shiny.h>
 
@@ -716,12 +720,15 @@ void GCode::do_export(Print* print, const char* path, GCodePreviewData* preview_
 
     // Remove the old g-code if it exists.
     boost::nowide::remove(path);
+#if ENABLE_GCODE_VIEWER
+    boost::nowide::remove(GCodeIndex::path(path).c_str());
+#endif // ENABLE_GCODE_VIEWER
 
     std::string path_tmp(path);
     path_tmp += ".tmp";
 
-    FILE *file = boost::nowide::fopen(path_tmp.c_str(), "wb");
-    if (file == nullptr)
+    GCodeOutputStream file(boost::nowide::fopen(path_tmp.c_str(), "wb"));
+    if (! file.is_open())
         throw Slic3r::RuntimeError(std::string("G-code export to ") + path + " failed.\nCannot open the file for writing.\n");
 
 #if !ENABLE_GCODE_VIEWER
@@ -731,20 +738,38 @@ void GCode::do_export(Print* print, const char* path, GCodePreviewData* preview_
     try {
         m_placeholder_parser_failed_templates.clear();
         this->_do_export(*print, file, thumbnail_cb);
-        fflush(file);
-        if (ferror(file)) {
-            fclose(file);
+        file.flush();
+#if ENABLE_GCODE_VIEWER
+        // The G-code has been processed while being exported, only the time estimates remain to be finished.
+        BOOST_LOG_TRIVIAL(debug) << "Finishing processing gcode, " << log_memory_info();
+        m_processor.end_process();
+        if (m_processor.is_post_process_needed() && ! file.spilled()) {
+            // The G-code was kept in memory, write it into the file with the lines M73 and the placeholders filled in.
+            m_processor.post_process(file.release_blocks(), [&file](const std::string &str) { file.write(str); });
+            file.flush();
+        }
+#endif // ENABLE_GCODE_VIEWER
+        if (file.is_error()) {
+            file.close();
             boost::nowide::remove(path_tmp.c_str());
             throw Slic3r::RuntimeError(std::string("G-code export to ") + path + " failed\nIs the disk full?\n");
         }
+#if ENABLE_GCODE_VIEWER
+        if (m_processor.is_post_process_needed() && file.spilled()) {
+            // The G-code exceeded the memory limit and it was written into the file, post process the file in place.
+            file.close();
+            m_processor.post_process(path_tmp);
+        }
+        BOOST_LOG_TRIVIAL(debug) << "Finished processing gcode, " << log_memory_info();
+#endif // ENABLE_GCODE_VIEWER
     } catch (std::exception & /* ex */) {
         // Rethrow on any exception. std::runtime_exception and CanceledException are expected to be thrown.
         // Close and remove the file.
-        fclose(file);
+        file.close();
         boost::nowide::remove(path_tmp.c_str());
         throw;
     }
-    fclose(file);
+    file.close();
 
     if (! m_placeholder_parser_failed_templates.empty()) {
         // G-code export proceeded, but some of the PlaceholderParser substitutions failed.
@@ -760,12 +785,14 @@ void GCode::do_export(Print* print, const char* path, GCodePreviewData* preview_
     }
 
 #if ENABLE_GCODE_VIEWER
-    BOOST_LOG_TRIVIAL(debug) << "Start processing gcode, " << log_memory_info();
-    m_processor.process_file(path_tmp, [print]() { print->throw_if_canceled(); });
     DoExport::update_print_estimated_times_stats(m_processor, print->m_print_statistics);
+    if (print->config().gcode_binary_index.value) {
+        // The index is optional, it is not written if it fails, see GCodeIndex::save().
+        BOOST_LOG_TRIVIAL(debug) << "Writing G-code index, " << log_memory_info();
+        GCodeIndex::save(path_tmp, GCodeIndex::path(path), m_processor.get_result());
+    }
     if (result != nullptr)
         *result = std::move(m_processor.extract_result());
-    BOOST_LOG_TRIVIAL(debug) << "Finished processing gcode, " << log_memory_info();
 #else
     GCodeTimeEstimator::PostProcessData normal_data = m_normal_time_estimator.get_post_process_data();
     GCodeTimeEstimator::PostProcessData silent_data = m_silent_time_estimator.get_post_process_data();
@@ -1149,13 +1176,18 @@ std::vector<const PrintInstance*> sort_object_instances_by_model_order(const Pri
     return instances;
 }
 
-void GCode::_do_export(Print& print, FILE* file, ThumbnailsGeneratorCallback thumbnail_cb)
+void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGeneratorCallback thumbnail_cb)
 {
     PROFILE_FUNC();
 
 #if ENABLE_GCODE_VIEWER
     // modifies m_silent_time_estimator_enabled
     DoExport::init_gcode_processor(print.config(), m_processor, m_silent_time_estimator_enabled);
+    // the G-code is processed as it is being exported, see GCode::do_export().
+    // The processing resumes from the last checkpoint of the previous export matching the new G-code.
+    m_processor.begin_process(&print.m_gcode_processor_checkpoints);
+    // The header is kept, but not processed: it is timestamped, thus it would never match the checkpoints.
+    file.set_processor(nullptr, m_processor.is_post_process_needed());
 #else
     DoExport::init_time_estimators(print.config(),
         // modifies the following:
@@ -1229,9 +1261,13 @@ void GCode::_do_export(Print& print, FILE* file, ThumbnailsGeneratorCallback thu
     _write_format(file, "; %s\n\n", Slic3r::header_slic3r_generated().c_str());
 
     DoExport::export_thumbnails_to_file(thumbnail_cb, print.full_print_config().option<ConfigOptionPoints>("thumbnails")->values,
-        [this, file](const char* sz) { this->_write(file, sz); },
+        [this, &file](const char* sz) { this->_write(file, sz); },
         [&print]() { print.throw_if_canceled(); });
 
+#if ENABLE_GCODE_VIEWER
+    file.set_processor(&m_processor, m_processor.is_post_process_needed());
+#endif // ENABLE_GCODE_VIEWER
+
     // Write notes (content of the Print Settings tab -> Notes)
     {
         std::list<std::string> lines;
@@ -1470,12 +1506,7 @@ void GCode::_do_export(Print& print, FILE* file, ThumbnailsGeneratorCallback thu
             m_cooling_buffer->set_current_extruder(initial_extruder_id);
             // Pair the object layers with the support layers by z, extrude them.
             std::vector<LayerToPrint> layers_to_print = collect_layers_to_print(object);
-            for (const LayerToPrint &ltp : layers_to_print) {
-                std::vector<LayerToPrint> lrs;
-                lrs.emplace_back(std::move(ltp));
-                this->process_layer(file, print, lrs, tool_ordering.tools_for_layer(ltp.print_z()), nullptr, *print_object_instance_sequential_active - object.instances().data());
-                print.throw_if_canceled();
-            }
+            this->process_layers(file, print, tool_ordering, layers_to_print, *print_object_instance_sequential_active - object.instances().data());
 #ifdef HAS_PRESSURE_EQUALIZER
             if (m_pressure_equalizer)
                 _write(file, m_pressure_equalizer->process("", true));
@@ -1521,13 +1552,7 @@ void GCode::_do_export(Print& print, FILE* file, ThumbnailsGeneratorCallback thu
             print.throw_if_canceled();
         }
         // Extrude the layers.
-        for (auto &layer : layers_to_print) {
-            const LayerTools &layer_tools = tool_ordering.tools_for_layer(layer.first);
-            if (m_wipe_tower && layer_tools.has_wipe_tower)
-                m_wipe_tower->next_layer();
-            this->process_layer(file, print, layer.second, layer_tools, &print_object_instances_ordering, size_t(-1));
-            print.throw_if_canceled();
-        }
+        this->process_layers(file, print, tool_ordering, layers_to_print, print_object_instances_ordering);
 #ifdef HAS_PRESSURE_EQUALIZER
         if (m_pressure_equalizer)
             _write(file, m_pressure_equalizer->process("", true));
@@ -1698,29 +1723,29 @@ static bool custom_gcode_sets_temperature(const std::string &gcode, const int mc
 
 // Print the machine envelope G-code for the Marlin firmware based on the "machine_max_xxx" parameters.
 // Do not process this piece of G-code by the time estimator, it already knows the values through another sources.
-void GCode::print_machine_envelope(FILE *file, Print &print)
+void GCode::print_machine_envelope(GCodeOutputStream &file, Print &print)
 {
     if (print.config().gcode_flavor.value == gcfMarlin && print.config().machine_limits_usage.value == MachineLimitsUsage::EmitToGCode) {
-        fprintf(file, "M201 X%d Y%d Z%d E%d ; sets maximum accelerations, mm/sec^2\n",
+        file.write_format("M201 X%d Y%d Z%d E%d ; sets maximum accelerations, mm/sec^2\n",
             int(print.config().machine_max_acceleration_x.values.front() + 0.5),
             int(print.config().machine_max_acceleration_y.values.front() + 0.5),
             int(print.config().machine_max_acceleration_z.values.front() + 0.5),
             int(print.config().machine_max_acceleration_e.values.front() + 0.5));
-        fprintf(file, "M203 X%d Y%d Z%d E%d ; sets maximum feedrates, mm/sec\n",
+        file.write_format("M203 X%d Y%d Z%d E%d ; sets maximum feedrates, mm/sec\n",
             int(print.config().machine_max_feedrate_x.values.front() + 0.5),
             int(print.config().machine_max_feedrate_y.values.front() + 0.5),
             int(print.config().machine_max_feedrate_z.values.front() + 0.5),
             int(print.config().machine_max_feedrate_e.values.front() + 0.5));
-        fprintf(file, "M204 P%d R%d T%d ; sets acceleration (P, T) and retract acceleration (R), mm/sec^2\n",
+        file.write_format("M204 P%d R%d T%d ; sets acceleration (P, T) and retract acceleration (R), mm/sec^2\n",
             int(print.config().machine_max_acceleration_extruding.values.front() + 0.5),
             int(print.config().machine_max_acceleration_retracting.values.front() + 0.5),
             int(print.config().machine_max_acceleration_extruding.values.front() + 0.5));
-        fprintf(file, "M205 X%.2lf Y%.2lf Z%.2lf E%.2lf ; sets the jerk limits, mm/sec\n",
+        file.write_format("M205 X%.2lf Y%.2lf Z%.2lf E%.2lf ; sets the jerk limits, mm/sec\n",
             print.config().machine_max_jerk_x.values.front(),
             print.config().machine_max_jerk_y.values.front(),
             print.config().machine_max_jerk_z.values.front(),
             print.config().machine_max_jerk_e.values.front());
-        fprintf(file, "M205 S%d T%d ; sets the minimum extruding and travel feed rate, mm/sec\n",
+        file.write_format("M205 S%d T%d ; sets the minimum extruding and travel feed rate, mm/sec\n",
             int(print.config().machine_min_extruding_rate.values.front() + 0.5),
             int(print.config().machine_min_travel_rate.values.front() + 0.5));
     }
@@ -1730,7 +1755,7 @@ void GCode::print_machine_envelope(FILE *file, Print &print)
 // Only do that if the start G-code does not already contain any M-code controlling an extruder temperature.
 // M140 - Set Extruder Temperature
 // M190 - Set Extruder Temperature and Wait
-void GCode::_print_first_layer_bed_temperature(FILE *file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait)
+void GCode::_print_first_layer_bed_temperature(GCodeOutputStream &file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait)
 {
     // Initial bed temperature based on the first extruder.
     int  temp = print.config().first_layer_bed_temperature.get_at(first_printing_extruder_id);
@@ -1750,7 +1775,7 @@ void GCode::_print_first_layer_bed_temperature(FILE *file, Print &print, const s
 // Only do that if the start G-code does not already contain any M-code controlling an extruder temperature.
 // M104 - Set Extruder Temperature
 // M109 - Set Extruder Temperature and Wait
-void GCode::_print_first_layer_extruder_temperatures(FILE *file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait)
+void GCode::_print_first_layer_extruder_temperatures(GCodeOutputStream &file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait)
 {
     // Is the bed temperature set by the provided custom G-code?
     int  temp_by_gcode     = -1;
@@ -2016,137 +2041,214 @@ namespace Skirt {
 
 } // namespace Skirt
 
-// In sequential mode, process_layer is called once per each object and its copy,
-// therefore layers will contain a single entry and single_object_instance_idx will point to the copy of the object.
-// In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
-// For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
-// and performing the extruder specific extrusions together.
-void GCode::process_layer(
-    // Write into the output file.
-    FILE                            		*file,
-    const Print                    			&print,
-    // Set of object & print layers of the same PrintObject and with the same print_z.
-    const std::vector<LayerToPrint> 		&layers,
-    const LayerTools        		        &layer_tools,
-    // Pairs of PrintObject index and its instance index.
-    const std::vector<const PrintInstance*> *ordering,
-    // If set to size_t(-1), then print all copies of all objects.
-    // Otherwise print a single copy of a single object.
-    const size_t                     		 single_object_instance_idx)
+// Generation and post-processing of the layer G-code, common to process_layers() of both the sequential and the non-sequential print.
+// The layers are planned in parallel (grouping of the extrusions by the extruders, see GCode::plan_layer()), as the plan does not depend
+// on the state of the G-code generator. The G-code is then generated from the plans in order, because it depends on the state
+// left by the previous layer (position, extruder, retraction).
+// The post-processing stages are stateful (SpiralVase, CoolingBuffer, PressureEqualizer keep the state of the previous layers),
+// therefore they are executed in order, though each stage may run in parallel with the other stages
+// and with the generation of the G-code of the following layers.
+template<typename LayerPlanner, typename LayerGenerator>
+static void process_layers_pipeline(
+    size_t                               num_layers,
+    LayerPlanner                       &&planner,
+    LayerGenerator                     &&generator,
+    SpiralVase                          *spiral_vase,
+    CoolingBuffer                       *cooling_buffer,
+#ifdef HAS_PRESSURE_EQUALIZER
+    PressureEqualizer                   *pressure_equalizer,
+#endif /* HAS_PRESSURE_EQUALIZER */
+    std::function<void(const std::string&)> output)
 {
-    assert(! layers.empty());
-    // Either printing all copies of all objects, or just a single copy of a single object.
-    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
-
-    if (layer_tools.extruders.empty())
-        // Nothing to extrude.
-        return;
-
-    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
-    const Layer         *object_layer  = nullptr;
-    const SupportLayer  *support_layer = nullptr;
-    for (const LayerToPrint &l : layers) {
-        if (l.object_layer != nullptr && object_layer == nullptr)
-            object_layer = l.object_layer;
-        if (l.support_layer != nullptr && support_layer == nullptr)
-            support_layer = l.support_layer;
-    }
-    const Layer         &layer         = (object_layer != nullptr) ? *object_layer : *support_layer;
-    coordf_t             print_z       = layer.print_z;
-    bool                 first_layer   = layer.id() == 0;
-    unsigned int         first_extruder_id = layer_tools.extruders.front();
-
-    // Initialize config with the 1st object to be printed at this layer.
-    m_config.apply(layer.object()->config(), true);
+    using LayerPlan = std::invoke_result_t<LayerPlanner, size_t>;
+    size_t layer_idx = 0;
+    auto source = tbb::make_filter<void, size_t>(tbb::filter::serial_in_order,
+        [num_layers, &layer_idx](tbb::flow_control &fc) -> size_t {
+            if (layer_idx == num_layers)
+                fc.stop();
+            return layer_idx ++;
+        });
+    auto plan = tbb::make_filter<size_t, std::pair<size_t, LayerPlan>>(tbb::filter::parallel,
+        [&planner](size_t idx) -> std::pair<size_t, LayerPlan> {
+            return { idx, planner(idx) };
+        });
+    auto generate = tbb::make_filter<std::pair<size_t, LayerPlan>, GCode::LayerResult>(tbb::filter::serial_in_order,
+        [&generator](std::pair<size_t, LayerPlan> in) -> GCode::LayerResult {
+            return generator(in.first, in.second);
+        });
+    auto spiral = tbb::make_filter<GCode::LayerResult, GCode::LayerResult>(tbb::filter::serial_in_order,
+        [spiral_vase](GCode::LayerResult in) -> GCode::LayerResult {
+            // Apply spiral vase post-processing if this layer contains suitable geometry
+            // (we must feed all the G-code into the post-processor, including the first
+            // bottom non-spiral layers otherwise it will mess with positions)
+            // we apply spiral vase at this stage because it requires a full layer.
+            // Just a reminder: A spiral vase mode is allowed for a single object per layer, single material print only.
+            if (spiral_vase != nullptr && ! in.is_nop_layer_result()) {
+                spiral_vase->enable = in.spiral_vase_enable;
+                in.gcode = spiral_vase->process_layer(in.gcode);
+            }
+            return in;
+        });
+    auto cooling = tbb::make_filter<GCode::LayerResult, GCode::LayerResult>(tbb::filter::serial_in_order,
+        [cooling_buffer
+#ifdef HAS_PRESSURE_EQUALIZER
+        , pressure_equalizer
+#endif /* HAS_PRESSURE_EQUALIZER */
+        ](GCode::LayerResult in) -> GCode::LayerResult {
+            if (in.is_nop_layer_result())
+                return in;
+            // Apply cooling logic; this may alter speeds.
+            if (cooling_buffer != nullptr)
+                in.gcode = cooling_buffer->process_layer(in.gcode, in.layer_id);
+#if !ENABLE_GCODE_VIEWER
+            // add tag for analyzer
+            if (in.gcode.find(GCodeAnalyzer::Pause_Print_Tag) != in.gcode.npos)
+                in.gcode += "\n; " + GCodeAnalyzer::End_Pause_Print_Or_Custom_Code_Tag + "\n";
+            else if (in.gcode.find(GCodeAnalyzer::Custom_Code_Tag) != in.gcode.npos)
+                in.gcode += "\n; " + GCodeAnalyzer::End_Pause_Print_Or_Custom_Code_Tag + "\n";
+#endif // !ENABLE_GCODE_VIEWER
+#ifdef HAS_PRESSURE_EQUALIZER
+            // Apply pressure equalization if enabled;
+            if (pressure_equalizer != nullptr)
+                in.gcode = pressure_equalizer->process(in.gcode.c_str(), false);
+#endif /* HAS_PRESSURE_EQUALIZER */
+            return in;
+        });
+    auto write = tbb::make_filter<GCode::LayerResult, void>(tbb::filter::serial_in_order,
+        [&output](const GCode::LayerResult &in) {
+            if (! in.is_nop_layer_result())
+                output(in.gcode);
+        });
+    // Limit the number of layers in flight to bound the memory held by the G-code of the not yet written layers.
+    tbb::parallel_pipeline(12, source & plan & generate & spiral & cooling & write);
+}
 
-    // Check whether it is possible to apply the spiral vase logic for this layer.
-    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
-    if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
-        bool enable = (layer.id() > 0 || print.config().brim_width.value == 0.) && (layer.id() >= (size_t)print.config().skirt_height.value && ! print.has_infinite_skirt());
-        if (enable) {
-            for (const LayerRegion *layer_region : layer.regions())
-                if (size_t(layer_region->region()->config().bottom_solid_layers.value) > layer.id() ||
-                    layer_region->perimeters.items_count() > 1u ||
-                    layer_region->fills.items_count() > 0) {
-                    enable = false;
-                    break;
-                }
-        }
-        m_spiral_vase->enable = enable;
-    }
-    // If we're going to apply spiralvase to this layer, disable loop clipping
-    m_enable_loop_clipping = ! m_spiral_vase || ! m_spiral_vase->enable;
+// Process all layers of all objects (non-sequential mode) with a parallel pipeline:
+// Generate G-code, run the filters (vase mode, cooling buffer), write to the file.
+void GCode::process_layers(
+    GCodeOutputStream                                                   &file,
+    const Print                                                         &print,
+    ToolOrdering                                                        &tool_ordering,
+    const std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>>   &layers_to_print,
+    const std::vector<const PrintInstance*>                             &ordering)
+{
+    for (const std::pair<coordf_t, std::vector<LayerToPrint>> &layer : layers_to_print)
+        resolve_extruder_overrides(print, layer.second, tool_ordering.tools_for_layer(layer.first));
+    process_layers_pipeline(layers_to_print.size(),
+        [&print, &tool_ordering, &layers_to_print](size_t idx) -> LayerPlan {
+            const std::pair<coordf_t, std::vector<LayerToPrint>> &layer = layers_to_print[idx];
+            print.throw_if_canceled();
+            return plan_layer(print, layer.second, tool_ordering.tools_for_layer(layer.first));
+        },
+        [this, &print, &tool_ordering, &layers_to_print, &ordering](size_t idx, LayerPlan &plan) -> LayerResult {
+            const std::pair<coordf_t, std::vector<LayerToPrint>> &layer = layers_to_print[idx];
+            const LayerTools &layer_tools = tool_ordering.tools_for_layer(layer.first);
+            if (m_wipe_tower && layer_tools.has_wipe_tower)
+                m_wipe_tower->next_layer();
+            print.throw_if_canceled();
+            return this->process_layer(print, layer.second, layer_tools, plan, &ordering, size_t(-1));
+        },
+        m_spiral_vase.get(), m_cooling_buffer.get(),
+#ifdef HAS_PRESSURE_EQUALIZER
+        m_pressure_equalizer.get(),
+#endif /* HAS_PRESSURE_EQUALIZER */
+        [this, &file](const std::string &gcode) { this->_write(file, gcode); });
+    print.throw_if_canceled();
+}
 
-    std::string gcode;
+// Process all layers of a single object instance (sequential mode) with a parallel pipeline:
+// Generate G-code, run the filters (vase mode, cooling buffer), write to the file.
+void GCode::process_layers(
+    GCodeOutputStream                                                   &file,
+    const Print                                                         &print,
+    ToolOrdering                                                        &tool_ordering,
+    const std::vector<LayerToPrint>                                     &layers_to_print,
+    const size_t                                                         single_object_idx)
+{
+    for (const LayerToPrint &layer : layers_to_print)
+        resolve_extruder_overrides(print, { layer }, tool_ordering.tools_for_layer(layer.print_z()));
+    process_layers_pipeline(layers_to_print.size(),
+        [&print, &tool_ordering, &layers_to_print](size_t idx) -> LayerPlan {
+            const LayerToPrint &layer = layers_to_print[idx];
+            print.throw_if_canceled();
+            return plan_layer(print, { layer }, tool_ordering.tools_for_layer(layer.print_z()));
+        },
+        [this, &print, &tool_ordering, &layers_to_print, single_object_idx](size_t idx, LayerPlan &plan) -> LayerResult {
+            const LayerToPrint &layer = layers_to_print[idx];
+            print.throw_if_canceled();
+            return this->process_layer(print, { layer }, tool_ordering.tools_for_layer(layer.print_z()), plan, nullptr, single_object_idx);
+        },
+        m_spiral_vase.get(), m_cooling_buffer.get(),
+#ifdef HAS_PRESSURE_EQUALIZER
+        m_pressure_equalizer.get(),
+#endif /* HAS_PRESSURE_EQUALIZER */
+        [this, &file](const std::string &gcode) { this->_write(file, gcode); });
+    print.throw_if_canceled();
+}
 
-#if ENABLE_GCODE_VIEWER
-    // add tag for processor
-    gcode += "; " + GCodeProcessor::Layer_Change_Tag + "\n";
-    // export layer z
-    char buf[64];
-    sprintf(buf, ";Z:%g\n", print_z);
-    gcode += buf;
-    // export layer height
-    float height = first_layer ? static_cast<float>(print_z) : static_cast<float>(print_z) - m_last_layer_z;
-    sprintf(buf, ";%s%g\n", GCodeProcessor::Height_Tag.c_str(), height);
-    gcode += buf;
-    // update caches
-    m_last_layer_z = static_cast<float>(print_z);
-    m_last_height = height;
-#endif // ENABLE_GCODE_VIEWER
+// Create the distance field for a layer below, used by the seam placer to avoid the overhangs.
+static std::unique_ptr<EdgeGrid::Grid> make_lower_layer_edge_grid(const Layer &lower_layer)
+{
+    const coord_t distance_field_resolution = coord_t(scale_(1.) + 0.5);
+    auto grid = make_unique<EdgeGrid::Grid>();
+    grid->create(lower_layer.lslices, distance_field_resolution);
+    grid->calculate_sdf();
+    return grid;
+}
 
-    // Set new layer - this will change Z and force a retraction if retract_layer_change is enabled.
-    if (! print.config().before_layer_gcode.value.empty()) {
-        DynamicConfig config;
-        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index + 1));
-        config.set_key_value("layer_z",   new ConfigOptionFloat(print_z));
-        gcode += this->placeholder_parser_process("before_layer_gcode",
-            print.config().before_layer_gcode.value, m_writer.extruder()->id(), &config)
-            + "\n";
-    }
-    gcode += this->change_layer(print_z);  // this will increase m_layer_index
-    m_layer = &layer;
-    if (! print.config().layer_gcode.value.empty()) {
-        DynamicConfig config;
-        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
-        config.set_key_value("layer_z",   new ConfigOptionFloat(print_z));
-        gcode += this->placeholder_parser_process("layer_gcode",
-            print.config().layer_gcode.value, m_writer.extruder()->id(), &config)
-            + "\n";
-    }
+// Extruder printing the extrusions of a region on a layer if they are not overridden for wiping.
+static int region_extruder(const LayerTools &layer_tools, const ExtrusionEntityCollection &extrusions, const PrintRegion &region)
+{
+    int extruder_id = layer_tools.extruder(extrusions, region);
+    // If the extruder is not in layer_tools, the extrusions are printed by the last extruder on this layer
+    // (could happen e.g. when a wiping object is taller than others - dontcare extruders are eradicated from layer_tools).
+    return layer_tools.has_extruder(extruder_id) ? extruder_id : int(layer_tools.extruders.back());
+}
 
-    if (! first_layer && ! m_second_layer_things_done) {
-        // Transition from 1st to 2nd layer. Adjust nozzle temperatures as prescribed by the nozzle dependent
-        // first_layer_temperature vs. temperature settings.
-        for (const Extruder &extruder : m_writer.extruders()) {
-            if (print.config().single_extruder_multi_material.value && extruder.id() != m_writer.extruder()->id())
-                // In single extruder multi material mode, set the temperature for the current extruder only.
+// Replace the "print as usual" entries of the extruder overrides of the wiping extrusions with the extruders printing the extrusions,
+// see WipingExtrusions::get_extruder_overrides(). Called serially before the layers are planned in parallel, so that plan_layer()
+// only reads the overrides.
+void GCode::resolve_extruder_overrides(const Print &print, const std::vector<LayerToPrint> &layers, LayerTools &layer_tools)
+{
+    if (layer_tools.extruders.empty() || ! layer_tools.wiping_extrusions().is_anything_overridden())
+        return;
+    for (const LayerToPrint &layer_to_print : layers) {
+        if (layer_to_print.object_layer == nullptr)
+            continue;
+        const Layer &layer = *layer_to_print.object_layer;
+        for (size_t region_id = 0; region_id < layer.regions().size(); ++ region_id) {
+            const LayerRegion *layerm = layer.regions()[region_id];
+            if (layerm == nullptr)
                 continue;
-            int temperature = print.config().temperature.get_at(extruder.id());
-            if (temperature > 0 && temperature != print.config().first_layer_temperature.get_at(extruder.id()))
-                gcode += m_writer.set_temperature(temperature, false, extruder.id());
+            const PrintRegion &region = *print.regions()[region_id];
+            for (const ExtrusionEntityCollection *collection : { &layerm->fills, &layerm->perimeters })
+                for (const ExtrusionEntity *ee : collection->entities) {
+                    const auto *extrusions = static_cast<const ExtrusionEntityCollection*>(ee);
+                    if (! extrusions->entities.empty())
+                        layer_tools.wiping_extrusions().get_extruder_overrides(extrusions, region_extruder(layer_tools, *extrusions, region), layer_to_print.object()->instances().size());
+                }
         }
-        gcode += m_writer.set_bed_temperature(print.config().bed_temperature.get_at(first_extruder_id));
-        // Mark the temperature transition from 1st to 2nd layer to be finished.
-        m_second_layer_things_done = true;
     }
+}
 
-    // Map from extruder ID to <begin, end> index of skirt loops to be extruded with that extruder.
-    std::map<unsigned int, std::pair<size_t, size_t>> skirt_loops_per_extruder;
+// Group the extrusions of the layers printed at a single print_z by an extruder, then by an object, an island and a region.
+// Called in parallel for the layers to be printed, the G-code generator is not accessed.
+GCode::LayerPlan GCode::plan_layer(
+    const Print                    			&print,
+    // Set of object & print layers of the same PrintObject and with the same print_z.
+    const std::vector<LayerToPrint> 		&layers,
+    const LayerTools        		        &layer_tools)
+{
+    LayerPlan plan;
+    if (layer_tools.extruders.empty())
+        // Nothing to extrude.
+        return plan;
 
-    if (single_object_instance_idx == size_t(-1)) {
-        // Normal (non-sequential) print.
-        gcode += ProcessLayer::emit_custom_gcode_per_print_z(layer_tools.custom_gcode, first_extruder_id, print.config());
-    }
-    // Extrude skirt at the print_z of the raft layers and normal object layers
-    // not at the print_z of the interlaced support material layers.
-    skirt_loops_per_extruder = first_layer ?
-        Skirt::make_skirt_loops_per_extruder_1st_layer(print, layers, layer_tools, m_skirt_done) :
-        Skirt::make_skirt_loops_per_extruder_other_layers(print, layers, layer_tools, support_layer, m_skirt_done);
+    unsigned int first_extruder_id = layer_tools.extruders.front();
 
     // Group extrusions by an extruder, then by an object, an island and a region.
-    std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
-    bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
+    std::map<unsigned int, std::vector<ObjectByExtruder>> &by_extruder = plan.by_extruder;
+    const bool is_anything_overridden = plan.is_anything_overridden = layer_tools.wiping_extrusions().is_anything_overridden();
     for (const LayerToPrint &layer_to_print : layers) {
         if (layer_to_print.support_layer != nullptr) {
             const SupportLayer &support_layer = *layer_to_print.support_layer;
@@ -2245,18 +2347,15 @@ void GCode::process_layer(
                             continue;
 
                         // This extrusion is part of certain Region, which tells us which extruder should be used for it:
-                        int correct_extruder_id = layer_tools.extruder(*extrusions, region);
+                        int correct_extruder_id = region_extruder(layer_tools, *extrusions, region);
 
-                        // Let's recover vector of extruder overrides:
+                        // Let's recover vector of extruder overrides, resolved by resolve_extruder_overrides() before the layers were planned:
                         const WipingExtrusions::ExtruderPerCopy *entity_overrides = nullptr;
-                        if (! layer_tools.has_extruder(correct_extruder_id)) {
-                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
-                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare extruders are eradicated from layer_tools)
-                            correct_extruder_id = layer_tools.extruders.back();
-                        }
                         printing_extruders.clear();
                         if (is_anything_overridden) {
-                            entity_overrides = const_cast<LayerTools&>(layer_tools).wiping_extrusions().get_extruder_overrides(extrusions, correct_extruder_id, layer_to_print.object()->instances().size());
+                            entity_overrides = layer_tools.wiping_extrusions().resolved_extruder_overrides(extrusions);
+                            assert(entity_overrides == nullptr || (entity_overrides->size() == layer_to_print.object()->instances().size() &&
+                                std::find(entity_overrides->begin(), entity_overrides->end(), -1) == entity_overrides->end()));
                             if (entity_overrides == nullptr) {
                                 printing_extruders.emplace_back(correct_extruder_id);
                             } else {
@@ -2300,8 +2399,161 @@ void GCode::process_layer(
         }
     } // for objects
 
+    // Distance fields over the lower layers for the seam placement, otherwise created by extrude_loop() on the first perimeter of a layer.
+    // They are not needed for the random seam and for the spiral vase.
+    plan.lower_layer_edge_grids.resize(layers.size());
+    if (! print.config().spiral_vase)
+        for (const LayerToPrint &layer_to_print : layers) {
+            const Layer *layer = layer_to_print.object_layer;
+            if (layer != nullptr && layer->lower_layer != nullptr && layer->object()->config().seam_position != spRandom &&
+                std::any_of(layer->regions().begin(), layer->regions().end(), [](const LayerRegion *layerm) { return ! layerm->perimeters.empty(); }))
+                plan.lower_layer_edge_grids[&layer_to_print - layers.data()] = make_lower_layer_edge_grid(*layer->lower_layer);
+        }
+
+    if (print.config().avoid_crossing_perimeters) {
+        plan.islands.reserve(layers.size());
+        for (const LayerToPrint &layer_to_print : layers)
+            plan.islands.emplace_back(union_ex(layer_to_print.layer()->lslices, true));
+    }
+
+    return plan;
+}
+
+// In sequential mode, process_layer is called once per each object and its copy,
+// therefore layers will contain a single entry and single_object_instance_idx will point to the copy of the object.
+// In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
+// For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
+// and performing the extruder specific extrusions together.
+GCode::LayerResult GCode::process_layer(
+    const Print                    			&print,
+    // Set of object & print layers of the same PrintObject and with the same print_z.
+    const std::vector<LayerToPrint> 		&layers,
+    const LayerTools        		        &layer_tools,
+    // Extrusions of the layers grouped by plan_layer().
+    LayerPlan                               &plan,
+    // Pairs of PrintObject index and its instance index.
+    const std::vector<const PrintInstance*> *ordering,
+    // If set to size_t(-1), then print all copies of all objects.
+    // Otherwise print a single copy of a single object.
+    const size_t                     		 single_object_instance_idx)
+{
+    assert(! layers.empty());
+    // Either printing all copies of all objects, or just a single copy of a single object.
+    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
+
+    if (layer_tools.extruders.empty())
+        // Nothing to extrude.
+        return LayerResult::make_nop_layer_result();
+
+    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
+    const Layer         *object_layer  = nullptr;
+    const SupportLayer  *support_layer = nullptr;
+    for (const LayerToPrint &l : layers) {
+        if (l.object_layer != nullptr && object_layer == nullptr)
+            object_layer = l.object_layer;
+        if (l.support_layer != nullptr && support_layer == nullptr)
+            support_layer = l.support_layer;
+    }
+    const Layer         &layer         = (object_layer != nullptr) ? *object_layer : *support_layer;
+    coordf_t             print_z       = layer.print_z;
+    bool                 first_layer   = layer.id() == 0;
+    unsigned int         first_extruder_id = layer_tools.extruders.front();
+
+    // Initialize config with the 1st object to be printed at this layer.
+    m_config.apply(layer.object()->config(), true);
+
+    // Check whether it is possible to apply the spiral vase logic for this layer.
+    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
+    if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
+        bool enable = (layer.id() > 0 || print.config().brim_width.value == 0.) && (layer.id() >= (size_t)print.config().skirt_height.value && ! print.has_infinite_skirt());
+        if (enable) {
+            for (const LayerRegion *layer_region : layer.regions())
+                if (size_t(layer_region->region()->config().bottom_solid_layers.value) > layer.id() ||
+                    layer_region->perimeters.items_count() > 1u ||
+                    layer_region->fills.items_count() > 0) {
+                    enable = false;
+                    break;
+                }
+        }
+        // If we're going to apply spiralvase to this layer, disable loop clipping.
+        // The spiral vase state is kept for the following layers, which are not evaluated.
+        m_enable_loop_clipping = ! enable;
+    }
+
+    LayerResult  result { {}, layer.id(), m_spiral_vase && ! m_enable_loop_clipping };
+    std::string &gcode = result.gcode;
+
+#if ENABLE_GCODE_VIEWER
+    // add tag for processor
+    gcode += "; " + GCodeProcessor::Layer_Change_Tag + "\n";
+    // export layer z
+    char buf[64];
+    sprintf(buf, ";Z:%g\n", print_z);
+    gcode += buf;
+    // export layer height
+    float height = first_layer ? static_cast<float>(print_z) : static_cast<float>(print_z) - m_last_layer_z;
+    sprintf(buf, ";%s%g\n", GCodeProcessor::Height_Tag.c_str(), height);
+    gcode += buf;
+    // update caches
+    m_last_layer_z = static_cast<float>(print_z);
+    m_last_height = height;
+#endif // ENABLE_GCODE_VIEWER
+
+    // Set new layer - this will change Z and force a retraction if retract_layer_change is enabled.
+    if (! print.config().before_layer_gcode.value.empty()) {
+        DynamicConfig config;
+        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index + 1));
+        config.set_key_value("layer_z",   new ConfigOptionFloat(print_z));
+        gcode += this->placeholder_parser_process("before_layer_gcode",
+            print.config().before_layer_gcode.value, m_writer.extruder()->id(), &config)
+            + "\n";
+    }
+    gcode += this->change_layer(print_z);  // this will increase m_layer_index
+    m_layer = &layer;
+    if (! print.config().layer_gcode.value.empty()) {
+        DynamicConfig config;
+        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
+        config.set_key_value("layer_z",   new ConfigOptionFloat(print_z));
+        gcode += this->placeholder_parser_process("layer_gcode",
+            print.config().layer_gcode.value, m_writer.extruder()->id(), &config)
+            + "\n";
+    }
+
+    if (! first_layer && ! m_second_layer_things_done) {
+        // Transition from 1st to 2nd layer. Adjust nozzle temperatures as prescribed by the nozzle dependent
+        // first_layer_temperature vs. temperature settings.
+        for (const Extruder &extruder : m_writer.extruders()) {
+            if (print.config().single_extruder_multi_material.value && extruder.id() != m_writer.extruder()->id())
+                // In single extruder multi material mode, set the temperature for the current extruder only.
+                continue;
+            int temperature = print.config().temperature.get_at(extruder.id());
+            if (temperature > 0 && temperature != print.config().first_layer_temperature.get_at(extruder.id()))
+                gcode += m_writer.set_temperature(temperature, false, extruder.id());
+        }
+        gcode += m_writer.set_bed_temperature(print.config().bed_temperature.get_at(first_extruder_id));
+        // Mark the temperature transition from 1st to 2nd layer to be finished.
+        m_second_layer_things_done = true;
+    }
+
+    // Map from extruder ID to <begin, end> index of skirt loops to be extruded with that extruder.
+    std::map<unsigned int, std::pair<size_t, size_t>> skirt_loops_per_extruder;
+
+    if (single_object_instance_idx == size_t(-1)) {
+        // Normal (non-sequential) print.
+        gcode += ProcessLayer::emit_custom_gcode_per_print_z(layer_tools.custom_gcode, first_extruder_id, print.config());
+    }
+    // Extrude skirt at the print_z of the raft layers and normal object layers
+    // not at the print_z of the interlaced support material layers.
+    skirt_loops_per_extruder = first_layer ?
+        Skirt::make_skirt_loops_per_extruder_1st_layer(print, layers, layer_tools, m_skirt_done) :
+        Skirt::make_skirt_loops_per_extruder_other_layers(print, layers, layer_tools, support_layer, m_skirt_done);
+
+    std::map<unsigned int, std::vector<ObjectByExtruder>> &by_extruder = plan.by_extruder;
+    const bool is_anything_overridden = plan.is_anything_overridden;
+
+    std::vector<std::unique_ptr<EdgeGrid::Grid>> &lower_layer_edge_grids = plan.lower_layer_edge_grids;
+
     // Extrude the skirt, brim, support, perimeters, infill ordered by the extruders.
-    std::vector<std::unique_ptr<EdgeGrid::Grid>> lower_layer_edge_grids(layers.size());
     for (unsigned int extruder_id : layer_tools.extruders)
     {
         gcode += (layer_tools.has_wipe_tower && m_wipe_tower) ?
@@ -2371,7 +2623,7 @@ void GCode::process_layer(
                 m_config.apply(instance_to_print.print_object.config(), true);
                 m_layer = layers[instance_to_print.layer_id].layer();
                 if (m_config.avoid_crossing_perimeters)
-                    m_avoid_crossing_perimeters.init_layer_mp(union_ex(m_layer->lslices, true));
+                    m_avoid_crossing_perimeters.init_layer_mp(plan.islands[instance_to_print.layer_id]);
 
                 if (this->config().gcode_label_objects)
                     gcode += std::string("; printing object ") + instance_to_print.print_object.model_object()->name + " id:" + std::to_string(instance_to_print.layer_id) + " copy " + std::to_string(instance_to_print.instance_id) + "\n";
@@ -2408,46 +2660,10 @@ void GCode::process_layer(
         }
     }
 
-    // Apply spiral vase post-processing if this layer contains suitable geometry
-    // (we must feed all the G-code into the post-processor, including the first
-    // bottom non-spiral layers otherwise it will mess with positions)
-    // we apply spiral vase at this stage because it requires a full layer.
-    // Just a reminder: A spiral vase mode is allowed for a single object per layer, single material print only.
-    if (m_spiral_vase)
-        gcode = m_spiral_vase->process_layer(gcode);
-
-    // Apply cooling logic; this may alter speeds.
-    if (m_cooling_buffer)
-        gcode = m_cooling_buffer->process_layer(gcode, layer.id());
-
-#if !ENABLE_GCODE_VIEWER
-    // add tag for analyzer
-    if (gcode.find(GCodeAnalyzer::Pause_Print_Tag) != gcode.npos)
-        gcode += "\n; " + GCodeAnalyzer::End_Pause_Print_Or_Custom_Code_Tag + "\n";
-    else if (gcode.find(GCodeAnalyzer::Custom_Code_Tag) != gcode.npos)
-        gcode += "\n; " + GCodeAnalyzer::End_Pause_Print_Or_Custom_Code_Tag + "\n";
-#endif // !ENABLE_GCODE_VIEWER
-
-#ifdef HAS_PRESSURE_EQUALIZER
-    // Apply pressure equalization if enabled;
-    // printf("G-code before filter:\n%s\n", gcode.c_str());
-    if (m_pressure_equalizer)
-        gcode = m_pressure_equalizer->process(gcode.c_str(), false);
-    // printf("G-code after filter:\n%s\n", out.c_str());
-#endif /* HAS_PRESSURE_EQUALIZER */
-
-    _write(file, gcode);
-#if ENABLE_GCODE_VIEWER
-    BOOST_LOG_TRIVIAL(trace) << "Exported layer " << layer.id() << " print_z " << print_z <<
-        log_memory_info();
-#else
     BOOST_LOG_TRIVIAL(trace) << "Exported layer " << layer.id() << " print_z " << print_z <<
-        ", time estimator memory: " <<
-        format_memsize_MB(m_normal_time_estimator.memory_used() + (m_silent_time_estimator_enabled ? m_silent_time_estimator.memory_used() : 0)) <<
-        ", analyzer memory: " <<
-        format_memsize_MB(m_analyzer.memory_used()) <<
         log_memory_info();
-#endif // ENABLE_GCODE_VIEWER
+
+    return result;
 }
 
 void GCode::apply_print_config(const PrintConfig &print_config)
@@ -2546,11 +2762,8 @@ std::string GCode::extrude_loop(ExtrusionLoop loop, std::string description, dou
 
     if (m_layer->lower_layer != nullptr && lower_layer_edge_grid != nullptr) {
         if (! *lower_layer_edge_grid) {
-            // Create the distance field for a layer below.
-            const coord_t distance_field_resolution = coord_t(scale_(1.) + 0.5);
-            *lower_layer_edge_grid = make_unique<EdgeGrid::Grid>();
-            (*lower_layer_edge_grid)->create(m_layer->lower_layer->lslices, distance_field_resolution);
-            (*lower_layer_edge_grid)->calculate_sdf();
+            // Not precomputed by plan_layer().
+            *lower_layer_edge_grid = make_lower_layer_edge_grid(*m_layer->lower_layer);
             #if 0
             {
                 static int iRun = 0;
@@ -2774,65 +2987,182 @@ std::string GCode::extrude_support(const ExtrusionEntityCollection &support_fill
     return gcode;
 }
 
-void GCode::_write(FILE* file, const char *what)
+void GCode::_write(GCodeOutputStream &file, std::string_view what)
 {
-    if (what != nullptr) {
 #if ENABLE_GCODE_VIEWER
-        const char* gcode = what;
+    // writes string to file
+    file.write(what);
 #else
-        // apply analyzer, if enabled
-        const char* gcode = m_enable_analyzer ? m_analyzer.process_gcode(what).c_str() : what;
-#endif // !ENABLE_GCODE_VIEWER
-
-        // writes string to file
-        fwrite(gcode, 1, ::strlen(gcode), file);
-#if !ENABLE_GCODE_VIEWER
-        // updates time estimator and gcode lines vector
-        m_normal_time_estimator.add_gcode_block(gcode);
-        if (m_silent_time_estimator_enabled)
-            m_silent_time_estimator.add_gcode_block(gcode);
-#endif // !ENABLE_GCODE_VIEWER
-    }
+    std::string str(what);
+    // apply analyzer, if enabled
+    const std::string &gcode = m_enable_analyzer ? m_analyzer.process_gcode(str) : str;
+
+    // writes string to file
+    file.write(gcode);
+    // updates time estimator and gcode lines vector
+    m_normal_time_estimator.add_gcode_block(gcode);
+    if (m_silent_time_estimator_enabled)
+        m_silent_time_estimator.add_gcode_block(gcode);
+#endif // ENABLE_GCODE_VIEWER
 }
 
-void GCode::_writeln(FILE* file, const std::string &what)
+void GCode::_writeln(GCodeOutputStream &file, const std::string &what)
 {
-    if (! what.empty())
+    if (! what.empty()) {
+#if ENABLE_GCODE_VIEWER
+        file.writeln(what);
+#else
         _write(file, (what.back() == '\n') ? what : (what + '\n'));
+#endif // ENABLE_GCODE_VIEWER
+    }
 }
 
-void GCode::_write_format(FILE* file, const char* format, ...)
+void GCode::_write_format(GCodeOutputStream &file, const char* format, ...)
 {
     va_list args;
     va_start(args, format);
+#if ENABLE_GCODE_VIEWER
+    // Nothing to post-process, format directly into the output buffer.
+    file.vwrite_format(format, args);
+#else
+    va_list args2;
+    va_copy(args2, args);
+    int buflen = ::vsnprintf(nullptr, 0, format, args2);
+    va_end(args2);
+    if (buflen > 0) {
+        std::string buffer(size_t(buflen), '\0');
+        ::vsnprintf(buffer.data(), size_t(buflen) + 1, format, args);
+        _write(file, buffer);
+    }
+#endif // ENABLE_GCODE_VIEWER
+    va_end(args);
+}
 
-    int buflen;
-    {
-        va_list args2;
-        va_copy(args2, args);
-        buflen =
-    #ifdef _MSC_VER
-            ::_vscprintf(format, args2)
-    #else
-            ::vsnprintf(nullptr, 0, format, args2)
-    #endif
-            + 1;
-        va_end(args2);
+bool GCodeOutputStream::is_error()
+{
+    this->flush_buffer();
+    return ::ferror(m_file) != 0;
+}
+
+void GCodeOutputStream::flush()
+{
+    this->flush_buffer();
+    ::fflush(m_file);
+}
+
+void GCodeOutputStream::close()
+{
+    if (m_file != nullptr) {
+#if ENABLE_GCODE_VIEWER
+        // Closing before release_blocks() means the export failed, don't bother processing the rest.
+        m_processor = nullptr;
+#endif // ENABLE_GCODE_VIEWER
+        this->flush_buffer();
+        ::fclose(m_file);
+        m_file = nullptr;
     }
+}
 
-    char buffer[1024];
-    bool buffer_dynamic = buflen > 1024;
-    char *bufptr = buffer_dynamic ? (char*)malloc(buflen) : buffer;
-    int res = ::vsnprintf(bufptr, buflen, format, args);
-    if (res > 0)
-        _write(file, bufptr);
+void GCodeOutputStream::flush_buffer()
+{
+    if (m_size > 0) {
+        this->output(std::string_view(m_buffer.get(), m_size));
+        m_size = 0;
+    }
+}
 
-    if (buffer_dynamic)
-        free(bufptr);
+void GCodeOutputStream::output(std::string_view what)
+{
+#if ENABLE_GCODE_VIEWER
+    if (m_processor != nullptr)
+        m_processor->process_buffer(what);
+    if (m_keep_in_memory) {
+        m_blocks.emplace_back(what);
+        m_blocks_size += what.size();
+        if (m_blocks_size <= m_memory_limit)
+            return;
+        // Too much G-code to be kept in memory, write it into the file to be post processed in place.
+        for (const std::string &block : m_blocks)
+            ::fwrite(block.data(), 1, block.size(), m_file);
+        std::vector<std::string>().swap(m_blocks);
+        m_blocks_size    = 0;
+        m_keep_in_memory = false;
+        m_spilled        = true;
+        return;
+    }
+#endif // ENABLE_GCODE_VIEWER
+    ::fwrite(what.data(), 1, what.size(), m_file);
+}
 
+#if ENABLE_GCODE_VIEWER
+void GCodeOutputStream::set_processor(GCodeProcessor *processor, bool keep_in_memory)
+{
+    this->flush_buffer();
+    m_processor      = processor;
+    m_keep_in_memory = keep_in_memory && ! m_spilled;
+}
+
+std::vector<std::string> GCodeOutputStream::release_blocks()
+{
+    this->flush_buffer();
+    m_processor      = nullptr;
+    m_keep_in_memory = false;
+    m_blocks_size    = 0;
+    return std::move(m_blocks);
+}
+#endif // ENABLE_GCODE_VIEWER
+
+void GCodeOutputStream::write(std::string_view what)
+{
+    if (what.size() > m_capacity - m_size) {
+        this->flush_buffer();
+        if (what.size() >= m_capacity) {
+            // Too long to be buffered, write it directly.
+            this->output(what);
+            return;
+        }
+    }
+    memcpy(m_buffer.get() + m_size, what.data(), what.size());
+    m_size += what.size();
+}
+
+void GCodeOutputStream::write_format(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    this->vwrite_format(format, args);
     va_end(args);
 }
 
+void GCodeOutputStream::vwrite_format(const char* format, va_list args)
+{
+    // Format directly into the free space of the buffer. Only if the free space is not sufficient,
+    // the buffer is flushed and the formatting is repeated.
+    for (bool flushed = false;; flushed = true) {
+        size_t  free_space = m_capacity - m_size;
+        va_list args2;
+        va_copy(args2, args);
+        int res = ::vsnprintf(m_buffer.get() + m_size, free_space, format, args2);
+        va_end(args2);
+        if (res < 0)
+            return;
+        if (size_t(res) < free_space) {
+            m_size += size_t(res);
+            return;
+        }
+        if (flushed || size_t(res) >= m_capacity) {
+            // The formatted string does not fit the buffer at all.
+            std::string buffer(size_t(res), '\0');
+            va_copy(args2, args);
+            ::vsnprintf(buffer.data(), size_t(res) + 1, format, args2);
+            va_end(args2);
+            this->write(buffer);
+            return;
+        }
+        this->flush_buffer();
+    }
+}
+
 std::string GCode::_extrude(const ExtrusionPath &path, std::string description, double speed)
 {
     std::string gcode;
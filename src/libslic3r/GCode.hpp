@@ -23,8 +23,12 @@
 #include "EdgeGrid.hpp"
 #include "GCode/ThumbnailData.hpp"
 
+#include <cstdarg>
+#include <cstdio>
+#include <limits>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #ifdef HAS_PRESSURE_EQUALIZER
 #include "GCode/PressureEqualizer.hpp"
@@ -155,6 +159,69 @@ public:
 };
 #endif // ENABLE_GCODE_VIEWER
 
+// Buffered output of the G-code into a file.
+// The G-code is collected into a fixed size buffer, which is written into the file once full and on flush(),
+// so that the G-code export does not pay for a library call for each of the small strings emitted.
+class GCodeOutputStream {
+public:
+    GCodeOutputStream(FILE *f, size_t buffer_size = 256 * 1024) : m_file(f), m_buffer(new char[std::max<size_t>(buffer_size, 1)]), m_capacity(std::max<size_t>(buffer_size, 1)) {}
+    ~GCodeOutputStream() { this->close(); }
+
+    bool is_open() const { return m_file != nullptr; }
+    // Flushes the buffer and checks the error flag of the file.
+    bool is_error();
+    void flush();
+    void close();
+
+    // Write a string into a file.
+    void write(const std::string &what) { this->write(std::string_view(what)); }
+    void write(const char *what) { if (what != nullptr) this->write(std::string_view(what)); }
+    void write(std::string_view what);
+    void write(char c) { if (m_size == m_capacity) this->flush_buffer(); m_buffer[m_size ++] = c; }
+
+    // Write a string into a file. 
+    // Add a newline, if the string does not end with a newline already.
+    // Used to export a custom G-code section processed by the PlaceholderParser.
+    void writeln(std::string_view what) { if (! what.empty()) { this->write(what); if (what.back() != '\n') this->write('\n'); } }
+
+    // Formats and write into a file the given data. 
+    void write_format(const char* format, ...);
+    void vwrite_format(const char* format, va_list args);
+
+#if ENABLE_GCODE_VIEWER
+    // Pass the G-code to the processor block by block as it is being written, so that the G-code does not need to be read back.
+    // If keep_in_memory, the G-code is collected in memory instead of being written into the file,
+    // to be written later by GCodeProcessor::post_process() in a single pass, see release_blocks().
+    void set_processor(GCodeProcessor *processor, bool keep_in_memory);
+    // Maximum size of the G-code collected in memory. Once exceeded, the G-code collected so far is written into the file
+    // and so is the G-code written from now on, thus the file needs to be post processed in place, see spilled().
+    void set_memory_limit(size_t limit) { m_memory_limit = limit; }
+    // Was the G-code collected in memory written into the file, because it exceeded the memory limit?
+    bool spilled() const { return m_spilled; }
+    // Detaches the processor and returns the G-code collected in memory. The G-code written from now on goes into the file.
+    std::vector<std::string> release_blocks();
+
+    static constexpr size_t Default_Memory_Limit = 32 * 1024 * 1024;
+#endif // ENABLE_GCODE_VIEWER
+
+private:
+    void flush_buffer();
+    void output(std::string_view what);
+
+    FILE                    *m_file = nullptr;
+    std::unique_ptr<char[]>  m_buffer;
+    size_t                   m_size = 0;
+    size_t                   m_capacity;
+#if ENABLE_GCODE_VIEWER
+    GCodeProcessor          *m_processor = nullptr;
+    bool                     m_keep_in_memory = false;
+    bool                     m_spilled = false;
+    std::vector<std::string> m_blocks;
+    size_t                   m_blocks_size = 0;
+    size_t                   m_memory_limit = Default_Memory_Limit;
+#endif // ENABLE_GCODE_VIEWER
+};
+
 class GCode {
 public:        
     GCode() : 
@@ -239,18 +306,47 @@ public:
         coordf_t            print_z() const { return (object_layer != nullptr && support_layer != nullptr) ? 0.5 * (object_layer->print_z + support_layer->print_z) : this->layer()->print_z; }
     };
 
+    // G-code of a single layer produced by process_layer(), to be passed through the post-processing stages of process_layers().
+    struct LayerResult {
+        std::string gcode;
+        size_t      layer_id;
+        // Is spiral vase post processing enabled for this layer?
+        bool        spiral_vase_enable { false };
+        static LayerResult make_nop_layer_result() { return { {}, std::numeric_limits<size_t>::max(), false }; }
+        bool is_nop_layer_result() const { return layer_id == std::numeric_limits<size_t>::max(); }
+    };
+
 private:
-    void            _do_export(Print &print, FILE *file, ThumbnailsGeneratorCallback thumbnail_cb);
+    void            _do_export(Print &print, GCodeOutputStream &file, ThumbnailsGeneratorCallback thumbnail_cb);
+
+    struct LayerPlan;
 
     static std::vector<LayerToPrint>        		                   collect_layers_to_print(const PrintObject &object);
     static std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>> collect_layers_to_print(const Print &print);
-    void            process_layer(
-        // Write into the output file.
-        FILE                            *file,
+    // Generate the G-code of the layers, post-process it and write it into the output file.
+    // The layer generation and the serial post-processing stages are pipelined, thus the G-code of
+    // a layer is being post-processed and written while the following layer is being generated.
+    void            process_layers(
+        GCodeOutputStream                                                   &file,
+        const Print                                                         &print,
+        ToolOrdering                                                        &tool_ordering,
+        const std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>>   &layers_to_print,
+        // Pairs of PrintObject index and its instance index.
+        const std::vector<const PrintInstance*>                             &ordering);
+    // Sequential print: Generate the G-code of the layers of a single object instance.
+    void            process_layers(
+        GCodeOutputStream                                                   &file,
+        const Print                                                         &print,
+        ToolOrdering                                                        &tool_ordering,
+        const std::vector<LayerToPrint>                                     &layers_to_print,
+        const size_t                                                         single_object_idx);
+    LayerResult     process_layer(
         const Print                     &print,
         // Set of object & print layers of the same PrintObject and with the same print_z.
         const std::vector<LayerToPrint> &layers,
         const LayerTools  				&layer_tools,
+        // Extrusions of the layers grouped by plan_layer().
+        LayerPlan                       &plan,
 		// Pairs of PrintObject index and its instance index.
 		const std::vector<const PrintInstance*> *ordering,
         // If set to size_t(-1), then print all copies of all objects.
@@ -330,6 +426,28 @@ private:
 		// For sequential print, the instance of the object to be printing has to be defined.
 		const size_t                     				 single_object_instance_idx);
 
+    // Extrusions of the layers printed at a single print_z grouped by an extruder, then by an object, an island and a region.
+    struct LayerPlan
+    {
+        std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
+        bool                                                   is_anything_overridden { false };
+        // Islands of each of the layers for the motion planner of avoid_crossing_perimeters, empty if disabled.
+        std::vector<ExPolygons>                                islands;
+        // Distance fields over the lower layers of each of the layers for the seam placement, released with the plan once the layer is exported.
+        std::vector<std::unique_ptr<EdgeGrid::Grid>>           lower_layer_edge_grids;
+    };
+    // The plan depends on the layers and on the tool ordering only, not on the state of the G-code generator,
+    // therefore the layers are planned in parallel ahead of process_layer(), which generates their G-code in order.
+    static LayerPlan plan_layer(
+        const Print                     &print,
+        const std::vector<LayerToPrint> &layers,
+        const LayerTools                &layer_tools);
+    // Resolves the extruder overrides of the wiping extrusions of the layers in layer_tools, to be read by plan_layer().
+    static void resolve_extruder_overrides(
+        const Print                     &print,
+        const std::vector<LayerToPrint> &layers,
+        LayerTools                      &layer_tools);
+
     std::string     extrude_perimeters(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, std::unique_ptr<EdgeGrid::Grid> &lower_layer_edge_grid);
     std::string     extrude_infill(const Print &print, const std::vector<ObjectByExtruder::Island::Region> &by_region, bool ironing);
     std::string     extrude_support(const ExtrusionEntityCollection &support_fills);
@@ -434,21 +552,22 @@ private:
 #endif // ENABLE_GCODE_VIEWER
 
     // Write a string into a file.
-    void _write(FILE* file, const std::string& what) { this->_write(file, what.c_str()); }
-    void _write(FILE* file, const char *what);
+    void _write(GCodeOutputStream &file, const std::string& what) { this->_write(file, std::string_view(what)); }
+    void _write(GCodeOutputStream &file, const char *what) { if (what != nullptr) this->_write(file, std::string_view(what)); }
+    void _write(GCodeOutputStream &file, std::string_view what);
 
     // Write a string into a file. 
     // Add a newline, if the string does not end with a newline already.
     // Used to export a custom G-code section processed by the PlaceholderParser.
-    void _writeln(FILE* file, const std::string& what);
+    void _writeln(GCodeOutputStream &file, const std::string& what);
 
     // Formats and write into a file the given data. 
-    void _write_format(FILE* file, const char* format, ...);
+    void _write_format(GCodeOutputStream &file, const char* format, ...);
 
     std::string _extrude(const ExtrusionPath &path, std::string description = "", double speed = -1);
-    void print_machine_envelope(FILE *file, Print &print);
-    void _print_first_layer_bed_temperature(FILE *file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait);
-    void _print_first_layer_extruder_temperatures(FILE *file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait);
+    void print_machine_envelope(GCodeOutputStream &file, Print &print);
+    void _print_first_layer_bed_temperature(GCodeOutputStream &file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait);
+    void _print_first_layer_extruder_temperatures(GCodeOutputStream &file, Print &print, const std::string &gcode, unsigned int first_printing_extruder_id, bool wait);
     // this flag triggers first layer speeds
     bool                                on_first_layer() const { return m_layer != nullptr && m_layer->id() == 0; }
 
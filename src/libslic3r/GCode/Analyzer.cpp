@@ -183,7 +183,7 @@ void GCodeAnalyzer::_process_gcode_line(GCodeReader&, const GCodeReader::GCodeLi
     {
 #if 0
         // DEBUG ONLY: puts the line back into the gcode
-        m_process_output += line.raw() + "\n";
+        m_process_output += std::string(line.raw()) + "\n";
 #endif
         return;
     }
@@ -193,7 +193,7 @@ void GCodeAnalyzer::_process_gcode_line(GCodeReader&, const GCodeReader::GCodeLi
     _set_start_extrusion(_get_axis_position(E));
 
     // processes 'normal' gcode lines
-    std::string cmd = line.cmd();
+    std::string_view cmd = line.cmd();
     if (cmd.length() > 1)
     {
         switch (::toupper(cmd[0]))
@@ -306,7 +306,7 @@ void GCodeAnalyzer::_process_gcode_line(GCodeReader&, const GCodeReader::GCodeLi
     }
 
     // puts the line back into the gcode
-    m_process_output += line.raw() + "\n";
+    m_process_output += std::string(line.raw()) + "\n";
 }
 
 void GCodeAnalyzer::_processG1(const GCodeReader::GCodeLine& line)
@@ -495,7 +495,7 @@ void GCodeAnalyzer::_processM108orM135(const GCodeReader::GCodeLine& line)
     if ((code == 108 && m_gcode_flavor == gcfSailfish)
         || (code == 135 && m_gcode_flavor == gcfMakerWare)) {
 
-        std::string cmd = line.raw();
+        std::string cmd(line.raw());
         size_t T_pos = cmd.find("T");
         if (T_pos != std::string::npos) {
             cmd = cmd.substr(T_pos);
@@ -604,12 +604,12 @@ void GCodeAnalyzer::_processT(const std::string& cmd)
 
 void GCodeAnalyzer::_processT(const GCodeReader::GCodeLine& line)
 {
-    _processT(line.cmd());
+    _processT(std::string(line.cmd()));
 }
 
 bool GCodeAnalyzer::_process_tags(const GCodeReader::GCodeLine& line)
 {
-    std::string comment = line.comment();
+    std::string comment(line.comment());
 
     // extrusion role tag
     size_t pos = comment.find(Extrusion_Role_Tag);
@@ -1,10 +1,11 @@
 #include "../GCode.hpp"
 #include "CoolingBuffer.hpp"
-#include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/log/trivial.hpp>
 #include <iostream>
+#include <cctype>
 #include <float.h>
+#include <string_view>
 
 #if 0
     #define DEBUG
@@ -286,6 +287,40 @@ std::string CoolingBuffer::process_layer(const std::string &gcode, size_t layer_
     return this->apply_layer_cooldown(gcode, layer_id, layer_time_stretched, per_extruder_adjustments);
 }
 
+static inline bool starts_with(std::string_view str, std::string_view prefix)
+{
+    return str.size() >= prefix.size() && memcmp(str.data(), prefix.data(), prefix.size()) == 0;
+}
+
+double CoolingBuffer::parse_value(const char *c, const char *eol)
+{
+    static constexpr const double pow10[] = { 1., 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+    for (; c != eol && (*c == ' ' || *c == '\t'); ++ c);
+    // Fast path for the plain decimal numbers emitted by GCodeWriter. Up to 15 digits, the integer mantissa and the power of ten
+    // are exact, thus their quotient is correctly rounded, the same as the result of strtod().
+    const char *p        = c;
+    bool        negative = p != eol && *p == '-';
+    if (p != eol && (*p == '-' || *p == '+'))
+        ++ p;
+    uint64_t    mantissa = 0;
+    int         digits   = 0;
+    int         decimals = 0;
+    for (; p != eol && *p >= '0' && *p <= '9'; ++ p, ++ digits)
+        mantissa = mantissa * 10 + (*p - '0');
+    if (p != eol && *p == '.')
+        for (++ p; p != eol && *p >= '0' && *p <= '9'; ++ p, ++ digits, ++ decimals)
+            mantissa = mantissa * 10 + (*p - '0');
+    if (digits > 0 && digits <= 15 && (p == eol || (*p != 'e' && *p != 'E' && *p != 'x' && *p != 'X'))) {
+        double value = double(mantissa) / pow10[decimals];
+        return negative ? - value : value;
+    }
+    // Exponents, hexadecimal numbers, infinities or too many digits.
+    // strtod() skips newlines, therefore the parameter value is tested to start on this line.
+    if (c == eol || ! (std::isalnum(static_cast<unsigned char>(*c)) || *c == '-' || *c == '+' || *c == '.'))
+        return 0.;
+    return strtod(c, nullptr);
+}
+
 // Parse the layer G-code for the moves, which could be adjusted.
 // Return the list of parsed lines, bucketed by an extruder.
 std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::string &gcode, std::vector<float> &current_pos) const
@@ -311,44 +346,44 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
     const std::string toolchange_prefix = m_gcodegen.writer().toolchange_prefix();
     unsigned int      current_extruder  = m_current_extruder;
     PerExtruderAdjustments *adjustment  = &per_extruder_adjustments[map_extruder_to_per_extruder_adjustment[current_extruder]];
-    const char       *line_start = gcode.c_str();
-    const char       *line_end   = line_start;
     const char        extrusion_axis = config.get_extrusion_axis()[0];
     // Index of an existing CoolingLine of the current adjustment, which holds the feedrate setting command
     // for a sequence of extrusion moves.
     size_t            active_speed_modifier = size_t(-1);
+    // Position after the current line. Parsed into a fixed array, the lines are not allocated.
+    float             new_pos[5];
 
-    for (; *line_start != 0; line_start = line_end) 
+    // The lines are parsed in place: sline views the source G-code without the trailing '\n'.
+    for (const char *line_start = gcode.c_str(), *gcode_end = line_start + gcode.size(), *line_end; line_start != gcode_end; line_start = line_end)
     {
-        while (*line_end != '\n' && *line_end != 0)
-            ++ line_end;
-        // sline will not contain the trailing '\n'.
-        std::string sline(line_start, line_end);
+        const char *eol = static_cast<const char*>(memchr(line_start, '\n', gcode_end - line_start));
+        if (eol == nullptr)
+            eol = gcode_end;
+        std::string_view sline(line_start, eol - line_start);
         // CoolingLine will contain the trailing '\n'.
-        if (*line_end == '\n')
-            ++ line_end;
+        line_end = (eol == gcode_end) ? eol : eol + 1;
         CoolingLine line(0, line_start - gcode.c_str(), line_end - gcode.c_str());
-        if (boost::starts_with(sline, "G0 "))
+        if (starts_with(sline, "G0 "))
             line.type = CoolingLine::TYPE_G0;
-        else if (boost::starts_with(sline, "G1 "))
+        else if (starts_with(sline, "G1 "))
             line.type = CoolingLine::TYPE_G1;
-        else if (boost::starts_with(sline, "G92 "))
+        else if (starts_with(sline, "G92 "))
             line.type = CoolingLine::TYPE_G92;
         if (line.type) {
             // G0, G1 or G92
             // Parse the G-code line.
-            std::vector<float> new_pos(current_pos);
+            std::copy(current_pos.begin(), current_pos.end(), new_pos);
             const char *c = sline.data() + 3;
             for (;;) {
                 // Skip whitespaces.
-                for (; *c == ' ' || *c == '\t'; ++ c);
-                if (*c == 0 || *c == ';')
+                for (; c != eol && (*c == ' ' || *c == '\t'); ++ c);
+                if (c == eol || *c == ';')
                     break;
                 // Parse the axis.
                 size_t axis = (*c >= 'X' && *c <= 'Z') ? (*c - 'X') :
                               (*c == extrusion_axis) ? 3 : (*c == 'F') ? 4 : size_t(-1);
                 if (axis != size_t(-1)) {
-                    new_pos[axis] = float(atof(++c));
+                    new_pos[axis] = float(parse_value(++ c, eol));
                     if (axis == 4) {
                         // Convert mm/min to mm/sec.
                         new_pos[4] /= 60.f;
@@ -358,15 +393,17 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                     }
                 }
                 // Skip this word.
-                for (; *c != ' ' && *c != '\t' && *c != 0; ++ c);
+                for (; c != eol && *c != ' ' && *c != '\t'; ++ c);
             }
-            bool external_perimeter = boost::contains(sline, ";_EXTERNAL_PERIMETER");
-            bool wipe               = boost::contains(sline, ";_WIPE");
+            // The markers are comments, look for them past the first ';' only.
+            std::string_view comment = sline.substr(std::min(sline.find(';'), sline.size()));
+            bool external_perimeter = comment.find(";_EXTERNAL_PERIMETER") != std::string_view::npos;
+            bool wipe               = comment.find(";_WIPE") != std::string_view::npos;
             if (external_perimeter)
                 line.type |= CoolingLine::TYPE_EXTERNAL_PERIMETER;
             if (wipe)
                 line.type |= CoolingLine::TYPE_WIPE;
-            if (boost::contains(sline, ";_EXTRUDE_SET_SPEED") && ! wipe) {
+            if (comment.find(";_EXTRUDE_SET_SPEED") != std::string_view::npos && ! wipe) {
                 line.type |= CoolingLine::TYPE_ADJUSTABLE;
                 active_speed_modifier = adjustment->lines.size();
             }
@@ -411,12 +448,12 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                     line.type = 0;
                 }
             }
-            current_pos = std::move(new_pos);
-        } else if (boost::starts_with(sline, ";_EXTRUDE_END")) {
+            std::copy(new_pos, new_pos + 5, current_pos.begin());
+        } else if (starts_with(sline, ";_EXTRUDE_END")) {
             line.type = CoolingLine::TYPE_EXTRUDE_END;
             active_speed_modifier = size_t(-1);
-        } else if (boost::starts_with(sline, toolchange_prefix)) {
-            unsigned int new_extruder = (unsigned int)atoi(sline.c_str() + toolchange_prefix.size());
+        } else if (starts_with(sline, toolchange_prefix)) {
+            unsigned int new_extruder = (unsigned int)atoi(sline.data() + toolchange_prefix.size());
             // Only change extruder in case the number is meaningful. User could provide an out-of-range index through custom gcodes - those shall be ignored.
             if (new_extruder < map_extruder_to_per_extruder_adjustment.size()) {
                 if (new_extruder != current_extruder) {
@@ -429,21 +466,21 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
             else {
                 // Only log the error in case of MM printer. Single extruder printers likely ignore any T anyway.
                 if (map_extruder_to_per_extruder_adjustment.size() > 1)
-                    BOOST_LOG_TRIVIAL(error) << "CoolingBuffer encountered an invalid toolchange, maybe from a custom gcode: " << sline;
+                    BOOST_LOG_TRIVIAL(error) << "CoolingBuffer encountered an invalid toolchange, maybe from a custom gcode: " << std::string(sline);
             }
 
-        } else if (boost::starts_with(sline, ";_BRIDGE_FAN_START")) {
+        } else if (starts_with(sline, ";_BRIDGE_FAN_START")) {
             line.type = CoolingLine::TYPE_BRIDGE_FAN_START;
-        } else if (boost::starts_with(sline, ";_BRIDGE_FAN_END")) {
+        } else if (starts_with(sline, ";_BRIDGE_FAN_END")) {
             line.type = CoolingLine::TYPE_BRIDGE_FAN_END;
-        } else if (boost::starts_with(sline, "G4 ")) {
+        } else if (starts_with(sline, "G4 ")) {
             // Parse the wait time.
             line.type = CoolingLine::TYPE_G4;
             size_t pos_S = sline.find('S', 3);
             size_t pos_P = sline.find('P', 3);
             line.time = line.time_max = float(
-                (pos_S > 0) ? atof(sline.c_str() + pos_S + 1) :
-                (pos_P > 0) ? atof(sline.c_str() + pos_P + 1) * 0.001 : 0.);
+                (pos_S != std::string_view::npos) ? parse_value(sline.data() + pos_S + 1, eol) :
+                (pos_P != std::string_view::npos) ? parse_value(sline.data() + pos_P + 1, eol) * 0.001 : 0.);
         }
         if (line.type != 0)
             adjustment->lines.emplace_back(std::move(line));
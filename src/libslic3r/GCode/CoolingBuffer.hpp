@@ -27,6 +27,9 @@ public:
     void        set_current_extruder(unsigned int extruder_id) { m_current_extruder = extruder_id; }
     std::string process_layer(const std::string &gcode, size_t layer_id);
     GCode* 	    gcodegen() { return &m_gcodegen; }
+    // Parse a G-code parameter value starting at c, not reading past the end of the line eol.
+    // Returns zero if there is no number, as atof() does, otherwise the same value as strtod().
+    static double parse_value(const char *c, const char *eol);
 
 private:
 	CoolingBuffer& operator=(const CoolingBuffer&) = delete;
@@ -0,0 +1,192 @@
+#include "libslic3r/libslic3r.h"
+#include "GCodeIndex.hpp"
+#include "libslic3r/FileContents.hpp"
+
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/utility.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <tbb/parallel_for.h>
+
+#include <cstring>
+#include <istream>
+#include <sstream>
+
+#if ENABLE_GCODE_VIEWER
+
+namespace Slic3r {
+
+template<class Archive> void serialize(Archive &ar, PrintEstimatedTimeStatistics::Mode &mode)
+{
+    ar(mode.time, mode.custom_gcode_times, mode.moves_times, mode.roles_times, mode.layers_times);
+}
+
+template<class Archive> void serialize(Archive &ar, GCodeProcessor::Result &result)
+{
+    ar(result.moves, result.bed_shape, result.printer_settings_id, result.extruder_colors, result.time_statistics.modes);
+}
+
+namespace GCodeIndex {
+
+// "PSGCIDX" followed by a zero
+static const uint64_t Magic   = 0x0058444943475350ull;
+// to be incremented whenever the layout of the index or of the serialized result changes
+static const uint32_t Version = 3;
+// magic, version, size and hash of the G-code, size and hash of the serialized result following the header
+static const size_t   Header_Size = sizeof(uint64_t) + sizeof(uint32_t) + 4 * sizeof(uint64_t);
+
+static const std::string Extension = ".idx";
+
+static const size_t Hash_Chunk_Size = 1024 * 1024;
+
+static const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV1A_PRIME = 1099511628211ull;
+
+// Stream reading the memory mapped index in place.
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const char *data, size_t size) { char *begin = const_cast<char*>(data); this->setg(begin, begin, begin + size); }
+};
+
+// Hash of the G-code or of the serialized result, not a cryptographic one: it detects a G-code modified after its index
+// was written and a truncated or corrupted index.
+// The chunks of Hash_Chunk_Size bytes are hashed in parallel, 8 bytes at a time, then their hashes are combined.
+static uint64_t hash_data(const char *data, size_t size)
+{
+    const size_t chunks = (size + Hash_Chunk_Size - 1) / Hash_Chunk_Size;
+    std::vector<uint64_t> hashes(chunks);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks), [data, size, &hashes](const tbb::blocked_range<size_t> &range) {
+        for (size_t chunk = range.begin(); chunk < range.end(); ++ chunk) {
+            const char *begin = data + chunk * Hash_Chunk_Size;
+            const char *end   = data + std::min(size, (chunk + 1) * Hash_Chunk_Size);
+            uint64_t hash = FNV1A_OFFSET_BASIS;
+            const char *ptr = begin;
+            for (; ptr + sizeof(uint64_t) <= end; ptr += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, ptr, sizeof(uint64_t));
+                hash = (hash ^ word) * FNV1A_PRIME;
+                hash ^= hash >> 32;
+            }
+            for (; ptr < end; ++ ptr)
+                hash = (hash ^ static_cast<unsigned char>(*ptr)) * FNV1A_PRIME;
+            hashes[chunk] = hash;
+        }
+    });
+
+    uint64_t hash = FNV1A_OFFSET_BASIS ^ uint64_t(size);
+    for (uint64_t chunk_hash : hashes)
+        hash = (hash ^ chunk_hash) * FNV1A_PRIME;
+    return hash;
+}
+
+std::string path(const std::string &gcode_path)
+{
+    return gcode_path + Extension;
+}
+
+bool save(const std::string &gcode_path, const std::string &index_path, const GCodeProcessor::Result &result)
+{
+    FileContents gcode;
+    if (! gcode.open(gcode_path)) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to write the G-code index " << index_path << ": cannot read " << gcode_path;
+        return false;
+    }
+    const uint64_t hash = hash_data(gcode.data(), gcode.size());
+
+    try {
+        // The result is serialized first to be hashed, the hash is verified by load() before the result is deserialized.
+        std::ostringstream payload_stream(std::ios::out | std::ios::binary);
+        {
+            cereal::BinaryOutputArchive ar(payload_stream);
+            ar(result);
+        }
+        const std::string payload = payload_stream.str();
+        boost::nowide::ofstream file(index_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (! file)
+            throw Slic3r::RuntimeError("Cannot open the file for writing");
+        {
+            cereal::BinaryOutputArchive ar(file);
+            ar(Magic, Version, uint64_t(gcode.size()), hash, uint64_t(payload.size()), hash_data(payload.data(), payload.size()));
+        }
+        file.write(payload.data(), payload.size());
+        file.close();
+        if (file.fail())
+            throw Slic3r::RuntimeError("Error while writing the file");
+    } catch (const std::exception &ex) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to write the G-code index " << index_path << ": " << ex.what();
+        boost::nowide::remove(index_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load(const std::string &gcode_path, GCodeProcessor::Result &result)
+{
+    FileContents index;
+    if (! index.open(path(gcode_path)) || index.size() < Header_Size)
+        return false;
+    FileContents gcode;
+    if (! gcode.open(gcode_path))
+        return false;
+
+    try {
+        uint64_t magic;
+        uint32_t version;
+        uint64_t gcode_size;
+        uint64_t gcode_hash;
+        uint64_t payload_size;
+        uint64_t payload_hash;
+        {
+            MemoryStreamBuf buffer(index.data(), Header_Size);
+            std::istream    stream(&buffer);
+            cereal::BinaryInputArchive ar(stream);
+            ar(magic, version, gcode_size, gcode_hash, payload_size, payload_hash);
+        }
+        if (magic != Magic || version != Version)
+            return false;
+        if (gcode_size != gcode.size() || gcode_hash != hash_data(gcode.data(), gcode.size())) {
+            BOOST_LOG_TRIVIAL(info) << "The G-code index of " << gcode_path << " does not match the G-code, the G-code was modified";
+            return false;
+        }
+        // The serialized result is not trusted until it matches its hash: cereal would allocate the vectors
+        // for the sizes it reads, and the viewer would read the moves out of bounds of inconsistent columns.
+        const char *payload = index.data() + Header_Size;
+        if (payload_size != index.size() - Header_Size || payload_hash != hash_data(payload, size_t(payload_size))) {
+            BOOST_LOG_TRIVIAL(error) << "The G-code index of " << gcode_path << " is truncated or corrupted";
+            return false;
+        }
+        GCodeProcessor::Result loaded;
+        {
+            MemoryStreamBuf buffer(payload, size_t(payload_size));
+            std::istream    stream(&buffer);
+            cereal::BinaryInputArchive ar(stream);
+            ar(loaded);
+        }
+        if (! loaded.moves.is_valid()) {
+            BOOST_LOG_TRIVIAL(error) << "The G-code index of " << gcode_path << " contains inconsistent moves";
+            return false;
+        }
+        result.moves               = std::move(loaded.moves);
+        result.bed_shape           = std::move(loaded.bed_shape);
+        result.printer_settings_id = std::move(loaded.printer_settings_id);
+        result.extruder_colors     = std::move(loaded.extruder_colors);
+        result.time_statistics     = std::move(loaded.time_statistics);
+    } catch (const std::exception &ex) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to read the G-code index of " << gcode_path << ": " << ex.what();
+        return false;
+    }
+    return true;
+}
+
+} // namespace GCodeIndex
+
+} // namespace Slic3r
+
+#endif // ENABLE_GCODE_VIEWER
@@ -0,0 +1,36 @@
+#ifndef slic3r_GCodeIndex_hpp_
+#define slic3r_GCodeIndex_hpp_
+
+#if ENABLE_GCODE_VIEWER
+#include "GCodeProcessor.hpp"
+
+#include <string>
+
+namespace Slic3r {
+
+// Binary index written next to an exported G-code file, if enabled by GCodeConfig::gcode_binary_index.
+// It contains the GCodeProcessor::Result of the G-code (the moves and the time statistics), so that the G-code viewer
+// loads a G-code file without processing it.
+// The index stores the size and the hash of the G-code it was written for, it is ignored if the G-code does not match,
+// for example if the G-code was modified by a post-processing script. The index is ignored as well if the serialized result
+// does not match its stored size and hash, or if the deserialized moves are inconsistent.
+namespace GCodeIndex {
+    // Path of the index of the G-code file.
+    std::string path(const std::string &gcode_path);
+
+    // Hashes the G-code file, then writes its index into index_path.
+    // Returns false if the index could not be written, in that case no index is left at index_path.
+    bool save(const std::string &gcode_path, const std::string &index_path, const GCodeProcessor::Result &result);
+
+    // Loads the result from the index of the G-code file. The G-code and the index are memory mapped, the result is
+    // deserialized from the mapped index into a copy owned by result.
+    // Returns false if there is no index, if the index does not match the G-code file or if it is corrupted, result is left unchanged.
+    // The id of the loaded result is not set, see GCodeProcessor::load_index().
+    bool load(const std::string &gcode_path, GCodeProcessor::Result &result);
+} // namespace GCodeIndex
+
+} // namespace Slic3r
+
+#endif // ENABLE_GCODE_VIEWER
+
+#endif // slic3r_GCodeIndex_hpp_
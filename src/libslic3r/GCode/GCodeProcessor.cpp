@@ -2,6 +2,7 @@
 #include "libslic3r/Utils.hpp"
 #include "libslic3r/Print.hpp"
 #include "GCodeProcessor.hpp"
+#include "GCodeIndex.hpp"
 
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/fstream.hpp>
@@ -9,6 +10,8 @@
 
 #include <float.h>
 #include <assert.h>
+#include <algorithm>
+#include <limits>
 
 #if ENABLE_GCODE_VIEWER
 #include <chrono>
@@ -18,6 +21,10 @@ static const float MMMIN_TO_MMSEC = 1.0f / 60.0f;
 
 static const float DEFAULT_ACCELERATION = 1500.0f; // Prusa Firmware 1_75mm_MK2
 
+// FNV-1a, to hash the gcode incrementally
+static const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV1A_PRIME = 1099511628211ull;
+
 namespace Slic3r {
 
 const std::string GCodeProcessor::Extrusion_Role_Tag = "TYPE:";
@@ -170,20 +177,32 @@ void GCodeProcessor::TimeMachine::reset()
     prev.reset();
     gcode_time.reset();
     blocks = std::vector<TimeBlock>();
+    new_blocks = std::vector<TimeBlock>();
+    blocks_kept = 0;
+    blocks_time = std::vector<float>();
     g1_times_cache = std::vector<float>();
     std::fill(moves_time.begin(), moves_time.end(), 0.0f);
     std::fill(roles_time.begin(), roles_time.end(), 0.0f);
     layers_time = std::vector<float>();
 }
 
+void GCodeProcessor::TimeMachine::take_new_blocks()
+{
+    blocks.insert(blocks.end(), new_blocks.begin(), new_blocks.end());
+    new_blocks.clear();
+    blocks_kept = blocks.size();
+}
+
 void GCodeProcessor::TimeMachine::simulate_st_synchronize(float additional_time)
 {
     if (!enabled)
         return;
 
+    assert(new_blocks.empty());
     time += additional_time;
     gcode_time.cache += additional_time;
     calculate_time();
+    blocks_kept = blocks.size();
 }
 
 static void planner_forward_pass_kernel(GCodeProcessor::TimeBlock& prev, GCodeProcessor::TimeBlock& curr)
@@ -224,35 +243,45 @@ void planner_reverse_pass_kernel(GCodeProcessor::TimeBlock& curr, GCodeProcessor
 
 static void recalculate_trapezoids(std::vector<GCodeProcessor::TimeBlock>& blocks)
 {
-    GCodeProcessor::TimeBlock* curr = nullptr;
-    GCodeProcessor::TimeBlock* next = nullptr;
-
-    for (size_t i = 0; i < blocks.size(); ++i) {
-        GCodeProcessor::TimeBlock& b = blocks[i];
-
-        curr = next;
-        next = &b;
-
-        if (curr != nullptr) {
-            // Recalculate if current block entry or exit junction speed has changed.
-            if (curr->flags.recalculate || next->flags.recalculate) {
-                // NOTE: Entry and exit factors always > 0 by all previous logic operations.
-                GCodeProcessor::TimeBlock block = *curr;
-                block.feedrate_profile.exit = next->feedrate_profile.entry;
-                block.calculate_trapezoid();
-                curr->trapezoid = block.trapezoid;
-                curr->flags.recalculate = false; // Reset current only to ensure next trapezoid is computed
-            }
+    assert(! blocks.empty());
+    size_t last = blocks.size() - 1;
+
+    // Recalculate if current block entry or exit junction speed has changed.
+    // NOTE: Entry and exit factors always > 0 by all previous logic operations.
+    for (size_t i = 0; i < last; ++i) {
+        GCodeProcessor::TimeBlock& curr = blocks[i];
+        const GCodeProcessor::TimeBlock& next = blocks[i + 1];
+        if (curr.flags.recalculate || next.flags.recalculate) {
+            curr.feedrate_profile.exit = next.feedrate_profile.entry;
+            curr.calculate_trapezoid();
         }
     }
 
     // Last/newest block in buffer. Always recalculated.
-    if (next != nullptr) {
-        GCodeProcessor::TimeBlock block = *next;
-        block.feedrate_profile.exit = next->safe_feedrate;
-        block.calculate_trapezoid();
-        next->trapezoid = block.trapezoid;
-        next->flags.recalculate = false;
+    GCodeProcessor::TimeBlock& newest = blocks[last];
+    newest.feedrate_profile.exit = newest.safe_feedrate;
+    newest.calculate_trapezoid();
+
+    for (GCodeProcessor::TimeBlock& block : blocks)
+        block.flags.recalculate = false;
+}
+
+// Evaluates the times of the blocks with the same arithmetic as TimeBlock::time(), but in a loop without calls and dependencies
+// between the iterations, which the compiler is able to vectorize.
+static void calculate_blocks_time(const GCodeProcessor::TimeBlock* blocks, size_t count, float* times)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const GCodeProcessor::TimeBlock& block = blocks[i];
+        const GCodeProcessor::Trapezoid& trapezoid = block.trapezoid;
+        float entry = block.feedrate_profile.entry;
+        float cruise = trapezoid.cruise_feedrate;
+        float acceleration = block.acceleration;
+        float acceleration_time = (acceleration != 0.0f) ?
+            (::sqrt(std::max(0.0f, sqr(entry) + 2.0f * acceleration * trapezoid.accelerate_until)) - entry) / acceleration : 0.0f;
+        float cruise_time = (cruise != 0.0f) ? (trapezoid.decelerate_after - trapezoid.accelerate_until) / cruise : 0.0f;
+        float deceleration_time = (acceleration != 0.0f) ?
+            (::sqrt(std::max(0.0f, sqr(cruise) + 2.0f * -acceleration * (block.distance - trapezoid.decelerate_after))) - cruise) / -acceleration : 0.0f;
+        times[i] = acceleration_time + cruise_time + deceleration_time;
     }
 }
 
@@ -275,9 +304,14 @@ void GCodeProcessor::TimeMachine::calculate_time(size_t keep_last_n_blocks)
     recalculate_trapezoids(blocks);
 
     size_t n_blocks_process = blocks.size() - keep_last_n_blocks;
+    blocks_time.resize(n_blocks_process);
+    calculate_blocks_time(blocks.data(), n_blocks_process, blocks_time.data());
+
+    size_t g1_times_cache_size = g1_times_cache.size();
+    g1_times_cache.resize(g1_times_cache_size + n_blocks_process);
     for (size_t i = 0; i < n_blocks_process; ++i) {
         const TimeBlock& block = blocks[i];
-        float block_time = block.time();
+        float block_time = blocks_time[i];
         time += block_time;
         gcode_time.cache += block_time;
         moves_time[static_cast<size_t>(block.move_type)] += block_time;
@@ -292,7 +326,7 @@ void GCodeProcessor::TimeMachine::calculate_time(size_t keep_last_n_blocks)
             }
             layers_time[block.layer_id - 1] += block_time;
         }
-        g1_times_cache.push_back(time);
+        g1_times_cache[g1_times_cache_size + i] = time;
     }
 
     if (keep_last_n_blocks)
@@ -317,16 +351,49 @@ void GCodeProcessor::TimeProcessor::reset()
 
 void GCodeProcessor::TimeProcessor::post_process(const std::string& filename)
 {
-    boost::nowide::ifstream in(filename);
-    if (!in.good())
+    FILE* in = boost::nowide::fopen(filename.c_str(), "rb");
+    if (in == nullptr)
         throw Slic3r::RuntimeError(std::string("Time estimator post process export failed.\nCannot open file for reading.\n"));
 
     // temporary file to contain modified gcode
     std::string out_path = filename + ".postprocess";
     FILE* out = boost::nowide::fopen(out_path.c_str(), "wb");
-    if (out == nullptr)
+    if (out == nullptr) {
+        fclose(in);
         throw Slic3r::RuntimeError(std::string("Time estimator post process export failed.\nCannot open file for writing.\n"));
+    }
+
+    std::vector<char> buffer(65536);
+    try {
+        post_process(
+            [in, &buffer]() {
+                size_t cnt = fread(buffer.data(), 1, buffer.size(), in);
+                if (ferror(in))
+                    throw Slic3r::RuntimeError(std::string("Time estimator post process export failed.\nError while reading from file.\n"));
+                return std::string_view(buffer.data(), cnt);
+            },
+            [out](const std::string& str) {
+                fwrite((const void*)str.c_str(), 1, str.length(), out);
+                if (ferror(out))
+                    throw Slic3r::RuntimeError(std::string("Time estimator post process export failed.\nIs the disk full?\n"));
+            });
+    } catch (...) {
+        fclose(in);
+        fclose(out);
+        boost::nowide::remove(out_path.c_str());
+        throw;
+    }
+
+    fclose(out);
+    fclose(in);
+
+    if (rename_file(out_path, filename))
+        throw Slic3r::RuntimeError(std::string("Failed to rename the output G-code file from ") + out_path + " to " + filename + '\n' +
+            "Is " + out_path + " locked?" + '\n');
+}
 
+void GCodeProcessor::TimeProcessor::post_process(const std::function<std::string_view()>& next_block, const std::function<void(const std::string&)>& write)
+{
     auto time_in_minutes = [](float time_in_seconds) {
         return int(::roundf(time_in_seconds / 60.0f));
     };
@@ -339,8 +406,6 @@ void GCodeProcessor::TimeProcessor::post_process(const std::string& filename)
         return std::string(line_M73);
     };
 
-    GCodeReader parser;
-    std::string gcode_line;
     size_t g1_lines_counter = 0;
     // keeps track of last exported pair <percent, remaining time>
     std::array<std::pair<int, int>, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> last_exported;
@@ -352,10 +417,7 @@ void GCodeProcessor::TimeProcessor::post_process(const std::string& filename)
     std::string export_line;
 
     // replace placeholder lines with the proper final value
-    auto process_placeholders = [&](const std::string& gcode_line) {
-        // remove trailing '\n'
-        std::string line = gcode_line.substr(0, gcode_line.length() - 1);
-
+    auto process_placeholders = [&](std::string_view line) {
         std::string ret;
 
         if (line == First_Line_M73_Placeholder_Tag || line == Last_Line_M73_Placeholder_Tag) {
@@ -381,17 +443,24 @@ void GCodeProcessor::TimeProcessor::post_process(const std::string& filename)
             }
         }
 
-        return std::make_pair(!ret.empty(), ret.empty() ? gcode_line : ret);
+        return ret;
     };
 
     // check for temporary lines
-    auto is_temporary_decoration = [](const std::string& gcode_line) {
-        // remove trailing '\n'
-        std::string line = gcode_line.substr(0, gcode_line.length() - 1);
-        if (line == "; " + Layer_Change_Tag)
-            return true;
-        else
+    const std::string layer_change_line = "; " + Layer_Change_Tag;
+    auto is_temporary_decoration = [&layer_change_line](std::string_view line) {
+        return line == layer_change_line;
+    };
+
+    // check for lines G1, the same way as GCodeReader::GCodeLine::cmd_is("G1")
+    auto is_line_G1 = [](std::string_view line) {
+        size_t cmd = line.find_first_not_of(" \t");
+        if (cmd == std::string_view::npos || line.size() < cmd + 2 || line[cmd] != 'G' || line[cmd + 1] != '1')
             return false;
+        if (line.size() == cmd + 2)
+            return true;
+        char c = line[cmd + 2];
+        return c == ' ' || c == '\t' || c == ';' || c == '\r' || c == '\n' || c == 0;
     };
 
     // add lines M73 to exported gcode
@@ -411,57 +480,264 @@ void GCodeProcessor::TimeProcessor::post_process(const std::string& filename)
         }
     };
 
-    // helper function to write to disk
-    auto write_string = [&](const std::string& str) {
-        fwrite((const void*)export_line.c_str(), 1, export_line.length(), out);
-        if (ferror(out)) {
-            in.close();
-            fclose(out);
-            boost::nowide::remove(out_path.c_str());
-            throw Slic3r::RuntimeError(std::string("Time estimator post process export failed.\nIs the disk full?\n"));
+    // process a single line, without the trailing '\n'
+    auto process_line = [&](std::string_view line) {
+        // replace placeholder lines
+        std::string placeholder = process_placeholders(line);
+        if (! placeholder.empty())
+            export_line += placeholder;
+        else {
+            // remove temporary lines
+            if (is_temporary_decoration(line))
+                return;
+            // add lines M73 where needed
+            if (is_line_G1(line)) {
+                process_line_G1();
+                ++g1_lines_counter;
+            }
+            export_line += line;
+            export_line += '\n';
+        }
+        if (export_line.length() > 65535) {
+            write(export_line);
+            export_line.clear();
         }
-        export_line.clear();
     };
 
-    while (std::getline(in, gcode_line)) {
-        if (!in.good()) {
-            fclose(out);
-            throw Slic3r::RuntimeError(std::string("Time estimator post process export failed.\nError while reading from file.\n"));
+    // the lines are not aligned with the blocks, the beginning of a line split between blocks is kept here
+    std::string partial_line;
+    for (std::string_view block = next_block(); ! block.empty(); block = next_block()) {
+        for (size_t eol = block.find('\n'); eol != std::string_view::npos; eol = block.find('\n')) {
+            if (partial_line.empty())
+                process_line(block.substr(0, eol));
+            else {
+                partial_line.append(block.data(), eol);
+                process_line(partial_line);
+                partial_line.clear();
+            }
+            block.remove_prefix(eol + 1);
         }
+        partial_line.append(block.data(), block.size());
+    }
+    if (! partial_line.empty())
+        process_line(partial_line);
 
-        gcode_line += "\n";
-        // replace placeholder lines
-        auto [processed, result] = process_placeholders(gcode_line);
-        gcode_line = result;
-        if (!processed) {
-            // remove temporary lines
-            if (is_temporary_decoration(gcode_line))
-                continue;
-
-            // add lines M73 where needed
-            parser.parse_line(gcode_line,
-                [&](GCodeReader& reader, const GCodeReader::GCodeLine& line) {
-                    if (line.cmd_is("G1")) {
-                        process_line_G1();
-                        ++g1_lines_counter;
+    if (!export_line.empty())
+        write(export_line);
+}
+
+// bytes per position delta, indexed by the 2 bits per axis of MoveVertices::m_position_widths
+static const size_t position_delta_bytes[4] = { 0, 1, 2, 4 };
+
+GCodeProcessor::MoveVertex GCodeProcessor::MoveVertices::operator[](size_t id) const
+{
+    assert(id < m_size);
+    MoveVertex move;
+    uint32_t kind = m_kind.get(id);
+    move.type = static_cast<EMoveType>(kind & 0xFF);
+    move.extrusion_role = static_cast<ExtrusionRole>((kind >> 8) & 0xFF);
+    move.extruder_id = static_cast<unsigned char>((kind >> 16) & 0xFF);
+    move.cp_color_id = static_cast<unsigned char>(kind >> 24);
+    move.feedrate = m_feedrate.get(id);
+    move.fan_speed = m_fan_speed.get(id);
+    move.height = static_cast<float>(m_height.get(id)) / size_scale;
+    move.width = static_cast<float>(m_width[id]) / size_scale;
+    move.mm3_per_mm = m_mm3_per_mm[id];
+    move.delta_extruder = m_delta_extruder[id];
+    move.time = static_cast<float>(id);
+    move.position = (quantized_position(id).cast<double>() / double(position_scale)).cast<float>();
+    return move;
+}
+
+Vec3i GCodeProcessor::MoveVertices::quantized_position(size_t id) const
+{
+    size_t block = id / key_position_interval;
+    size_t index = id % key_position_interval;
+    Vec3i position;
+    if (block < m_key_positions.size()) {
+        position = m_key_positions[block];
+        if (index > 0) {
+            uint8_t widths = m_position_widths[block];
+            size_t stride = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                stride += position_delta_bytes[(widths >> (2 * axis)) & 3];
+            }
+            const uint8_t* delta = m_position_deltas.data() + m_position_offsets[block] + (index - 1) * stride;
+            for (int axis = 0; axis < 3; ++axis) {
+                size_t bytes = position_delta_bytes[(widths >> (2 * axis)) & 3];
+                if (bytes > 0) {
+                    uint32_t value = 0;
+                    for (size_t i = 0; i < bytes; ++i) {
+                        value |= static_cast<uint32_t>(delta[i]) << (8 * i);
                     }
-                });
+                    // sign extend
+                    uint32_t sign = uint32_t(1) << (8 * bytes - 1);
+                    position[axis] += static_cast<int32_t>((value ^ sign) - sign);
+                    delta += bytes;
+                }
+            }
         }
+    }
+    else
+        position = m_last_positions[index];
+    return position;
+}
+
+void GCodeProcessor::MoveVertices::emplace_back(const MoveVertex& move)
+{
+    auto quantize_size = [](float value) {
+        return static_cast<uint16_t>(std::clamp<long>(::lround(value * size_scale), 0, std::numeric_limits<uint16_t>::max()));
+    };
+
+    size_t id = m_size++;
+    m_kind.push(id, static_cast<uint32_t>(move.type) | (static_cast<uint32_t>(move.extrusion_role) << 8) |
+        (static_cast<uint32_t>(move.extruder_id) << 16) | (static_cast<uint32_t>(move.cp_color_id) << 24));
+    m_feedrate.push(id, move.feedrate);
+    m_fan_speed.push(id, move.fan_speed);
+    m_height.push(id, quantize_size(move.height));
+    m_width.emplace_back(quantize_size(move.width));
+    m_mm3_per_mm.emplace_back(move.mm3_per_mm);
+    m_delta_extruder.emplace_back(move.delta_extruder);
 
-        export_line += gcode_line;
-        if (export_line.length() > 65535)
-            write_string(export_line);
+    Vec3i position;
+    for (int axis = 0; axis < 3; ++axis) {
+        position[axis] = static_cast<int>(::lround(static_cast<double>(move.position[axis]) * position_scale));
     }
+    m_last_positions.emplace_back(position);
+    if (m_last_positions.size() == key_position_interval)
+        encode_last_positions();
+}
 
-    if (!export_line.empty())
-        write_string(export_line);
+void GCodeProcessor::MoveVertices::truncate(size_t size)
+{
+    if (size >= m_size)
+        return;
 
-    fclose(out);
-    in.close();
+    // the positions of the moves of the last incomplete block are not encoded
+    size_t blocks = size / key_position_interval;
+    std::vector<Vec3i> last_positions;
+    for (size_t id = blocks * key_position_interval; id < size; ++id) {
+        last_positions.emplace_back(quantized_position(id));
+    }
+
+    m_size = size;
+    m_kind.truncate(size);
+    m_feedrate.truncate(size);
+    m_fan_speed.truncate(size);
+    m_height.truncate(size);
+    m_width.resize(size);
+    m_mm3_per_mm.resize(size);
+    m_delta_extruder.resize(size);
+    if (blocks < m_key_positions.size()) {
+        m_position_deltas.resize(m_position_offsets[blocks]);
+        m_key_positions.resize(blocks);
+        m_position_offsets.resize(blocks);
+        m_position_widths.resize(blocks);
+    }
+    m_last_positions = std::move(last_positions);
+}
+
+void GCodeProcessor::MoveVertices::encode_last_positions()
+{
+    const Vec3i& key = m_last_positions.front();
+    uint8_t widths = 0;
+    size_t width_ids[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        int32_t max_delta = 0;
+        for (const Vec3i& position : m_last_positions) {
+            max_delta = std::max(max_delta, std::abs(position[axis] - key[axis]));
+        }
+        width_ids[axis] = (max_delta == 0) ? 0 : (max_delta < 0x80) ? 1 : (max_delta < 0x8000) ? 2 : 3;
+        widths |= static_cast<uint8_t>(width_ids[axis] << (2 * axis));
+    }
+
+    m_key_positions.emplace_back(key);
+    m_position_offsets.emplace_back(static_cast<uint32_t>(m_position_deltas.size()));
+    m_position_widths.emplace_back(widths);
+    for (size_t i = 1; i < m_last_positions.size(); ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            uint32_t value = static_cast<uint32_t>(m_last_positions[i][axis] - key[axis]);
+            for (size_t j = 0; j < position_delta_bytes[width_ids[axis]]; ++j) {
+                m_position_deltas.emplace_back(static_cast<uint8_t>(value >> (8 * j)));
+            }
+        }
+    }
+    m_last_positions.clear();
+}
 
-    if (rename_file(out_path, filename))
-        throw Slic3r::RuntimeError(std::string("Failed to rename the output G-code file from ") + out_path + " to " + filename + '\n' +
-            "Is " + out_path + " locked?" + '\n');
+void GCodeProcessor::MoveVertices::shrink_to_fit()
+{
+    m_kind.shrink_to_fit();
+    m_feedrate.shrink_to_fit();
+    m_fan_speed.shrink_to_fit();
+    m_height.shrink_to_fit();
+    m_width.shrink_to_fit();
+    m_mm3_per_mm.shrink_to_fit();
+    m_delta_extruder.shrink_to_fit();
+    m_key_positions.shrink_to_fit();
+    m_position_offsets.shrink_to_fit();
+    m_position_widths.shrink_to_fit();
+    m_position_deltas.shrink_to_fit();
+}
+
+size_t GCodeProcessor::MoveVertices::memory_size() const
+{
+    return m_kind.memory_size() + m_feedrate.memory_size() + m_fan_speed.memory_size() + m_height.memory_size() +
+        m_width.capacity() * sizeof(uint16_t) + m_mm3_per_mm.capacity() * sizeof(float) + m_delta_extruder.capacity() * sizeof(float) +
+        m_key_positions.capacity() * sizeof(Vec3i) + m_position_offsets.capacity() * sizeof(uint32_t) + m_position_widths.capacity() * sizeof(uint8_t) +
+        m_position_deltas.capacity() * sizeof(uint8_t) + m_last_positions.capacity() * sizeof(Vec3i);
+}
+
+bool GCodeProcessor::MoveVertices::is_valid() const
+{
+    const size_t blocks = m_size / key_position_interval;
+    if (! m_kind.is_valid(m_size) || ! m_feedrate.is_valid(m_size) || ! m_fan_speed.is_valid(m_size) || ! m_height.is_valid(m_size) ||
+        m_width.size() != m_size || m_mm3_per_mm.size() != m_size || m_delta_extruder.size() != m_size ||
+        m_key_positions.size() != blocks || m_position_offsets.size() != blocks || m_position_widths.size() != blocks ||
+        m_last_positions.size() != m_size % key_position_interval)
+        return false;
+    // the move types and the extrusion roles index the buffers of the viewer
+    for (uint32_t kind : m_kind.values) {
+        if ((kind & 0xFF) >= static_cast<uint32_t>(EMoveType::Count) || ((kind >> 8) & 0xFF) >= static_cast<uint32_t>(erCount))
+            return false;
+    }
+    // the deltas of each block follow the deltas of the previous block
+    size_t offset = 0;
+    for (size_t block = 0; block < blocks; ++block) {
+        if (m_position_offsets[block] != offset)
+            return false;
+        for (int axis = 0; axis < 3; ++axis) {
+            offset += (key_position_interval - 1) * position_delta_bytes[(m_position_widths[block] >> (2 * axis)) & 3];
+        }
+    }
+    return offset == m_position_deltas.size();
+}
+
+void GCodeProcessor::Checkpoints::clear()
+{
+    m_complete = false;
+    m_skipped_size = 0;
+    m_configuration.clear();
+    m_checkpoints.clear();
+    m_moves.clear();
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+        m_g1_times[i] = std::vector<float>();
+        m_layers_time[i] = std::vector<float>();
+    }
+}
+
+size_t GCodeProcessor::Checkpoints::memory_size() const
+{
+    size_t size = m_moves.memory_size() + m_configuration.capacity() + m_checkpoints.capacity() * sizeof(Checkpoint);
+    for (const Checkpoint& checkpoint : m_checkpoints) {
+        for (const TimeMachine& machine : checkpoint.machines) {
+            size += machine.blocks.capacity() * sizeof(TimeBlock) + machine.layers_time.capacity() * sizeof(float);
+        }
+    }
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+        size += (m_g1_times[i].capacity() + m_layers_time[i].capacity()) * sizeof(float);
+    }
+    return size;
 }
 
 const std::vector<std::pair<GCodeProcessor::EProducer, std::string>> GCodeProcessor::Producers = {
@@ -481,6 +757,12 @@ GCodeProcessor::GCodeProcessor()
     m_time_processor.machines[static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Stealth)].line_m73_mask = "M73 Q%s S%s\n";
 }
 
+GCodeProcessor::~GCodeProcessor()
+{
+    // the processing may have been interrupted by an exception
+    m_time_planner.wait();
+}
+
 void GCodeProcessor::apply_config(const PrintConfig& config)
 {
     m_parser.apply_config(config);
@@ -717,8 +999,17 @@ void GCodeProcessor::reset()
     m_producer = EProducer::Unknown;
     m_producers_enabled = false;
 
+    m_time_planner.wait();
     m_time_processor.reset();
 
+    m_unprocessed.clear();
+    m_processed_size = 0;
+    m_gcode_hash = FNV1A_OFFSET_BASIS;
+    m_hashed_size = 0;
+    m_checkpoints = nullptr;
+    m_replaying = false;
+    m_next_checkpoint = 0;
+
     m_result.reset();
     m_result.id = ++s_result_id;
 
@@ -741,9 +1032,9 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
     // parse the gcode file to detect its producer
     if (m_producers_enabled) {
         m_parser.parse_file(filename, [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) {
-            std::string cmd = line.cmd();
+            std::string_view cmd = line.cmd();
             if (cmd.length() == 0) {
-                std::string comment = line.comment();
+                std::string_view comment = line.comment();
                 if (comment.length() > 1 && detect_producer(comment))
                     m_parser.quit_parsing_file();
             }
@@ -760,9 +1051,7 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
     }
 
     // process gcode
-    m_result.id = ++s_result_id;
-    // 1st move must be a dummy move
-    m_result.moves.emplace_back(MoveVertex());
+    begin_process();
     m_parser.parse_file(filename, [this, cancel_callback, &last_cancel_callback_time](GCodeReader& reader, const GCodeReader::GCodeLine& line) {
         if (cancel_callback != nullptr) {
             // call the cancel callback every 100 ms
@@ -774,8 +1063,107 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
         }
         process_gcode_line(line);
         });
+    end_process();
+
+    // post-process to add M73 lines into the gcode
+    if (m_time_processor.export_remaining_time_enabled)
+        m_time_processor.post_process(filename);
+
+#if ENABLE_GCODE_VIEWER_STATISTICS
+    m_result.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
+#endif // ENABLE_GCODE_VIEWER_STATISTICS
+}
+
+bool GCodeProcessor::load_index(const std::string& filename)
+{
+#if ENABLE_GCODE_VIEWER_STATISTICS
+    auto start_time = std::chrono::high_resolution_clock::now();
+#endif // ENABLE_GCODE_VIEWER_STATISTICS
+
+    if (! GCodeIndex::load(filename, m_result))
+        return false;
+    m_result.id = ++s_result_id;
+
+#if ENABLE_GCODE_VIEWER_STATISTICS
+    m_result.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
+#endif // ENABLE_GCODE_VIEWER_STATISTICS
+    return true;
+}
+
+void GCodeProcessor::begin_process(Checkpoints* checkpoints)
+{
+    m_result.id = ++s_result_id;
+    // 1st move must be a dummy move
+    m_result.moves.emplace_back(MoveVertex());
+    m_unprocessed.clear();
+    m_processed_size = 0;
+    m_gcode_hash = FNV1A_OFFSET_BASIS;
+    m_hashed_size = 0;
+    m_replaying = false;
+
+    m_checkpoints = (checkpoints != nullptr && checkpoints->is_enabled()) ? checkpoints : nullptr;
+    if (m_checkpoints != nullptr) {
+        std::string configuration = configuration_key();
+        if (m_checkpoints->size() > 1 && m_checkpoints->m_configuration == configuration) {
+            // the 1st checkpoint is the state after begin_process()
+            m_replaying = true;
+            m_next_checkpoint = 1;
+        }
+        else {
+            m_checkpoints->clear();
+            m_checkpoints->m_configuration = std::move(configuration);
+            m_checkpoints->m_checkpoints.emplace_back();
+            save_checkpoint(m_checkpoints->m_checkpoints.back());
+        }
+        // valid again once end_process() keeps the moves and the times of this gcode
+        m_checkpoints->m_complete = false;
+        m_checkpoints->m_skipped_size = 0;
+    }
+}
+
+void GCodeProcessor::process_buffer(std::string_view buffer)
+{
+    if (m_replaying) {
+        replay_buffer(buffer);
+        return;
+    }
+
+    // Only the complete lines are processed, the rest is kept until the next call.
+    size_t last_eol = buffer.rfind('\n');
+    if (last_eol == std::string_view::npos) {
+        m_unprocessed.append(buffer.data(), buffer.size());
+        return;
+    }
+    m_unprocessed.append(buffer.data(), last_eol + 1);
+    if (m_checkpoints == nullptr)
+        m_parser.parse_buffer(m_unprocessed, [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) { process_gcode_line(line); });
+    else {
+        m_parser.parse_buffer(m_unprocessed, [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) {
+            unsigned int layer_id = m_layer_id;
+            process_gcode_line(line);
+            if (m_layer_id != layer_id)
+                add_checkpoint(line);
+            });
+        hash_processed(m_unprocessed.size());
+    }
+    m_processed_size += m_unprocessed.size();
+    m_unprocessed.assign(buffer.data() + last_eol + 1, buffer.size() - last_eol - 1);
+}
+
+void GCodeProcessor::end_process()
+{
+    if (m_replaying)
+        // the gcode matches up to its end, or the end follows the last matched checkpoint
+        stop_replaying();
+
+    // the last line may not be terminated by a newline
+    if (! m_unprocessed.empty()) {
+        m_parser.parse_buffer(m_unprocessed, [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) { process_gcode_line(line); });
+        m_unprocessed.clear();
+    }
 
     // process the time blocks
+    synchronize_time_machines();
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
         TimeMachine& machine = m_time_processor.machines[i];
         TimeMachine::CustomGCodeTime& gcode_time = machine.gcode_time;
@@ -786,9 +1174,19 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
 
     update_estimated_times_stats();
 
-    // post-process to add M73 lines into the gcode
-    if (m_time_processor.export_remaining_time_enabled)
-        m_time_processor.post_process(filename);
+    // release the slack of the columns of the moves
+    m_result.moves.shrink_to_fit();
+
+    if (m_checkpoints != nullptr) {
+        // keep the moves and the times to restore the result up to the checkpoints, see restore_checkpoint()
+        m_checkpoints->m_moves = m_result.moves;
+        for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+            m_checkpoints->m_g1_times[i] = m_time_processor.machines[i].g1_times_cache;
+            m_checkpoints->m_layers_time[i] = m_time_processor.machines[i].layers_time;
+        }
+        m_checkpoints->m_complete = true;
+        m_checkpoints = nullptr;
+    }
 
 #if ENABLE_GCODE_VIEWER_DATA_CHECKING
     std::cout << "\n";
@@ -796,10 +1194,23 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
     m_height_compare.output();
     m_width_compare.output();
 #endif // ENABLE_GCODE_VIEWER_DATA_CHECKING
+}
 
-#if ENABLE_GCODE_VIEWER_STATISTICS
-    m_result.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
-#endif // ENABLE_GCODE_VIEWER_STATISTICS
+void GCodeProcessor::post_process(std::vector<std::string>&& gcode_blocks, const std::function<void(const std::string&)>& write)
+{
+    // the blocks are released as soon as they are exported
+    std::vector<std::string> blocks = std::move(gcode_blocks);
+    size_t next = 0;
+    m_time_processor.post_process(
+        [&blocks, &next]() {
+            if (next > 0)
+                std::string().swap(blocks[next - 1]);
+            // an empty block would terminate the post processing
+            while (next < blocks.size() && blocks[next].empty())
+                ++ next;
+            return next < blocks.size() ? std::string_view(blocks[next ++]) : std::string_view();
+        },
+        write);
 }
 
 float GCodeProcessor::get_time(PrintEstimatedTimeStatistics::ETimeMode mode) const
@@ -867,7 +1278,7 @@ void GCodeProcessor::process_gcode_line(const GCodeReader::GCodeLine& line)
     // update start position
     m_start_position = m_end_position;
 
-    std::string cmd = line.cmd();
+    std::string_view cmd = line.cmd();
     if (cmd.length() > 1) {
         // process command lines
         switch (::toupper(cmd[0]))
@@ -925,14 +1336,14 @@ void GCodeProcessor::process_gcode_line(const GCodeReader::GCodeLine& line)
         }
     }
     else {
-        std::string comment = line.comment();
+        std::string_view comment = line.comment();
         if (comment.length() > 1)
             // process tags embedded into comments
             process_tags(comment);
     }
 }
 
-void GCodeProcessor::process_tags(const std::string& comment)
+void GCodeProcessor::process_tags(std::string_view comment)
 {
     // producers tags
     if (m_producers_enabled) {
@@ -954,7 +1365,7 @@ void GCodeProcessor::process_tags(const std::string& comment)
         pos = comment.find(Height_Tag);
         if (pos != comment.npos) {
             try {
-                m_height = std::stof(comment.substr(pos + Height_Tag.length()));
+                m_height = std::stof(std::string(comment.substr(pos + Height_Tag.length())));
             }
             catch (...) {
                 BOOST_LOG_TRIVIAL(error) << "GCodeProcessor encountered an invalid value for Height (" << comment << ").";
@@ -968,7 +1379,7 @@ void GCodeProcessor::process_tags(const std::string& comment)
     pos = comment.find(Width_Tag);
     if (pos != comment.npos) {
         try {
-            m_width_compare.last_tag_value = std::stof(comment.substr(pos + Width_Tag.length()));
+            m_width_compare.last_tag_value = std::stof(std::string(comment.substr(pos + Width_Tag.length())));
         }
         catch (...) {
             BOOST_LOG_TRIVIAL(error) << "GCodeProcessor encountered an invalid value for Width (" << comment << ").";
@@ -982,7 +1393,7 @@ void GCodeProcessor::process_tags(const std::string& comment)
     if (pos != comment.npos) {
         pos = comment.find_last_of(",T");
         try {
-            unsigned char extruder_id = (pos == comment.npos) ? 0 : static_cast<unsigned char>(std::stoi(comment.substr(pos + 1)));
+            unsigned char extruder_id = (pos == comment.npos) ? 0 : static_cast<unsigned char>(std::stoi(std::string(comment.substr(pos + 1))));
 
             m_extruder_colors[extruder_id] = static_cast<unsigned char>(m_extruder_offsets.size()) + m_cp_color.counter; // color_change position in list of color for preview
             ++m_cp_color.counter;
@@ -1023,7 +1434,7 @@ void GCodeProcessor::process_tags(const std::string& comment)
     pos = comment.find(Mm3_Per_Mm_Tag);
     if (pos != comment.npos) {
         try {
-            m_mm3_per_mm_compare.last_tag_value = std::stof(comment.substr(pos + Mm3_Per_Mm_Tag.length()));
+            m_mm3_per_mm_compare.last_tag_value = std::stof(std::string(comment.substr(pos + Mm3_Per_Mm_Tag.length())));
         }
         catch (...) {
             BOOST_LOG_TRIVIAL(error) << "GCodeProcessor encountered an invalid value for Mm3_Per_Mm (" << comment << ").";
@@ -1040,7 +1451,7 @@ void GCodeProcessor::process_tags(const std::string& comment)
     }
 }
 
-bool GCodeProcessor::process_producers_tags(const std::string& comment)
+bool GCodeProcessor::process_producers_tags(std::string_view comment)
 {
     switch (m_producer)
     {
@@ -1053,18 +1464,18 @@ bool GCodeProcessor::process_producers_tags(const std::string& comment)
     }
 }
 
-bool GCodeProcessor::process_prusaslicer_tags(const std::string& comment)
+bool GCodeProcessor::process_prusaslicer_tags(std::string_view comment)
 {
     return false;
 }
 
-bool GCodeProcessor::process_cura_tags(const std::string& comment)
+bool GCodeProcessor::process_cura_tags(std::string_view comment)
 {
     // TYPE -> extrusion role
-    std::string tag = "TYPE:";
+    std::string_view tag = "TYPE:";
     size_t pos = comment.find(tag);
     if (pos != comment.npos) {
-        std::string type = comment.substr(pos + tag.length());
+        std::string_view type = comment.substr(pos + tag.length());
         if (type == "SKIRT")
             m_extrusion_role = erSkirt;
         else if (type == "WALL-OUTER")
@@ -1093,7 +1504,7 @@ bool GCodeProcessor::process_cura_tags(const std::string& comment)
     tag = "FLAVOR:";
     pos = comment.find(tag);
     if (pos != comment.npos) {
-        std::string flavor = comment.substr(pos + tag.length());
+        std::string_view flavor = comment.substr(pos + tag.length());
         if (flavor == "BFB")
             m_flavor = gcfMarlin; // << ???????????????????????
         else if (flavor == "Mach3")
@@ -1121,7 +1532,7 @@ bool GCodeProcessor::process_cura_tags(const std::string& comment)
     return false;
 }
 
-bool GCodeProcessor::process_simplify3d_tags(const std::string& comment)
+bool GCodeProcessor::process_simplify3d_tags(std::string_view comment)
 {
     // extrusion roles
 
@@ -1206,10 +1617,10 @@ bool GCodeProcessor::process_simplify3d_tags(const std::string& comment)
     // geometry
 
     // ; tool
-    std::string tag = " tool";
+    std::string_view tag = " tool";
     pos = comment.find(tag);
     if (pos == 0) {
-        std::string data = comment.substr(pos + tag.length());
+        std::string data(comment.substr(pos + tag.length()));
         std::string h_tag = "H";
         size_t h_start = data.find(h_tag);
         size_t h_end = data.find_first_of(' ', h_start);
@@ -1240,13 +1651,13 @@ bool GCodeProcessor::process_simplify3d_tags(const std::string& comment)
     return false;
 }
 
-bool GCodeProcessor::process_craftware_tags(const std::string& comment)
+bool GCodeProcessor::process_craftware_tags(std::string_view comment)
 {
     // segType -> extrusion role
-    std::string tag = "segType:";
+    std::string_view tag = "segType:";
     size_t pos = comment.find(tag);
     if (pos != comment.npos) {
-        std::string type = comment.substr(pos + tag.length());
+        std::string_view type = comment.substr(pos + tag.length());
         if (type == "Skirt")
             m_extrusion_role = erSkirt;
         else if (type == "Perimeter")
@@ -1280,13 +1691,13 @@ bool GCodeProcessor::process_craftware_tags(const std::string& comment)
     return false;
 }
 
-bool GCodeProcessor::process_ideamaker_tags(const std::string& comment)
+bool GCodeProcessor::process_ideamaker_tags(std::string_view comment)
 {
     // TYPE -> extrusion role
-    std::string tag = "TYPE:";
+    std::string_view tag = "TYPE:";
     size_t pos = comment.find(tag);
     if (pos != comment.npos) {
-        std::string type = comment.substr(pos + tag.length());
+        std::string_view type = comment.substr(pos + tag.length());
         if (type == "RAFT")
             m_extrusion_role = erSkirt;
         else if (type == "WALL-OUTER")
@@ -1316,7 +1727,7 @@ bool GCodeProcessor::process_ideamaker_tags(const std::string& comment)
     pos = comment.find(tag);
     if (pos != comment.npos) {
         try {
-            m_width_compare.last_tag_value = std::stof(comment.substr(pos + tag.length()));
+            m_width_compare.last_tag_value = std::stof(std::string(comment.substr(pos + tag.length())));
         }
         catch (...) {
             BOOST_LOG_TRIVIAL(error) << "GCodeProcessor encountered an invalid value for Width (" << comment << ").";
@@ -1329,7 +1740,7 @@ bool GCodeProcessor::process_ideamaker_tags(const std::string& comment)
     pos = comment.find(tag);
     if (pos != comment.npos) {
         try {
-            m_height_compare.last_tag_value = std::stof(comment.substr(pos + tag.length()));
+            m_height_compare.last_tag_value = std::stof(std::string(comment.substr(pos + tag.length())));
         }
         catch (...) {
             BOOST_LOG_TRIVIAL(error) << "GCodeProcessor encountered an invalid value for Height (" << comment << ").";
@@ -1341,7 +1752,7 @@ bool GCodeProcessor::process_ideamaker_tags(const std::string& comment)
     return false;
 }
 
-bool GCodeProcessor::detect_producer(const std::string& comment)
+bool GCodeProcessor::detect_producer(std::string_view comment)
 {
     for (const auto& [id, search_string] : Producers) {
         size_t pos = comment.find(search_string);
@@ -1480,6 +1891,7 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line)
     assert(distance != 0.0f);
     float inv_distance = 1.0f / distance;
 
+    bool refresh_planner = false;
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
         TimeMachine& machine = m_time_processor.machines[i];
         if (!machine.enabled)
@@ -1487,7 +1899,6 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line)
 
         TimeMachine::State& curr = machine.curr;
         TimeMachine::State& prev = machine.prev;
-        std::vector<TimeBlock>& blocks = machine.blocks;
 
         curr.feedrate = (delta_pos[E] == 0.0f) ?
             minimum_travel_feedrate(static_cast<PrintEstimatedTimeStatistics::ETimeMode>(i), m_feedrate) :
@@ -1551,7 +1962,7 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line)
 
         // calculates block entry feedrate
         float vmax_junction = curr.safe_feedrate;
-        if (!blocks.empty() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
+        if (machine.blocks_count() > 0 && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
             bool prev_speed_larger = prev.feedrate > block.feedrate_profile.cruise;
             float smaller_speed_factor = prev_speed_larger ? (block.feedrate_profile.cruise / prev.feedrate) : (prev.feedrate / block.feedrate_profile.cruise);
             // Pick the smaller of the nominal speeds. Higher speed shall not be achieved at the junction during coasting.
@@ -1621,12 +2032,14 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line)
         // updates previous
         prev = curr;
 
-        blocks.push_back(block);
-
-        if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
-            machine.calculate_time(TimeProcessor::Planner::queue_size);
+        machine.new_blocks.push_back(block);
+        if (machine.blocks_count() > TimeProcessor::Planner::refresh_threshold)
+            refresh_planner = true;
     }
 
+    if (refresh_planner)
+        schedule_time_calculation();
+
     // store move
     store_move_vertex(type);
 }
@@ -1754,7 +2167,7 @@ void GCodeProcessor::process_M108(const GCodeReader::GCodeLine& line)
     if (m_flavor != gcfSailfish)
         return;
 
-    std::string cmd = line.raw();
+    std::string cmd(line.raw());
     size_t pos = cmd.find("T");
     if (pos != std::string::npos)
         process_T(cmd.substr(pos));
@@ -1788,7 +2201,7 @@ void GCodeProcessor::process_M135(const GCodeReader::GCodeLine& line)
     if (m_flavor != gcfMakerWare)
         return;
 
-    std::string cmd = line.raw();
+    std::string cmd(line.raw());
     size_t pos = cmd.find("T");
     if (pos != std::string::npos)
         process_T(cmd.substr(pos));
@@ -1990,7 +2403,7 @@ void GCodeProcessor::process_M702(const GCodeReader::GCodeLine& line)
 
 void GCodeProcessor::process_T(const GCodeReader::GCodeLine& line)
 {
-    process_T(line.cmd());
+    process_T(std::string(line.cmd()));
 }
 
 void GCodeProcessor::process_T(const std::string& command)
@@ -2135,6 +2548,7 @@ float GCodeProcessor::get_filament_unload_time(size_t extruder_id)
 
 void GCodeProcessor::process_custom_gcode_time(CustomGCode::Type code)
 {
+    synchronize_time_machines();
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
         TimeMachine& machine = m_time_processor.machines[i];
         if (!machine.enabled)
@@ -2154,11 +2568,34 @@ void GCodeProcessor::process_custom_gcode_time(CustomGCode::Type code)
 
 void GCodeProcessor::simulate_st_synchronize(float additional_time)
 {
+    synchronize_time_machines();
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
         m_time_processor.machines[i].simulate_st_synchronize(additional_time);
     }
 }
 
+void GCodeProcessor::schedule_time_calculation()
+{
+    // The planner of each machine processes its blocks in the same order and at the same queue sizes as if it was run inline,
+    // thus the estimated times do not depend on the threads timing. At most one calculate_time() runs per machine.
+    synchronize_time_machines();
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+        TimeMachine& machine = m_time_processor.machines[i];
+        if (machine.enabled && machine.blocks.size() > TimeProcessor::Planner::refresh_threshold) {
+            machine.blocks_kept = TimeProcessor::Planner::queue_size;
+            m_time_planner.run([&machine]() { machine.calculate_time(TimeProcessor::Planner::queue_size); });
+        }
+    }
+}
+
+void GCodeProcessor::synchronize_time_machines()
+{
+    m_time_planner.wait();
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+        m_time_processor.machines[i].take_new_blocks();
+    }
+}
+
 void GCodeProcessor::update_estimated_times_stats()
 {
     auto update_mode = [this](PrintEstimatedTimeStatistics::ETimeMode mode) {
@@ -2177,6 +2614,203 @@ void GCodeProcessor::update_estimated_times_stats()
         m_result.time_statistics.modes[static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Stealth)].reset();
 }
 
+void GCodeProcessor::hash_processed(size_t end)
+{
+    uint64_t hash = m_gcode_hash;
+    for (size_t i = m_hashed_size - m_processed_size; i < end; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(m_unprocessed[i])) * FNV1A_PRIME;
+    }
+    m_gcode_hash = hash;
+    m_hashed_size = m_processed_size + end;
+}
+
+std::string GCodeProcessor::configuration_key() const
+{
+    std::string key;
+    auto append = [&key](const void* data, size_t size) {
+        key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        key.append(reinterpret_cast<const char*>(data), size);
+    };
+    append(&m_flavor, sizeof(m_flavor));
+    append(m_extruder_offsets.data(), m_extruder_offsets.size() * sizeof(Vec3f));
+    append(m_extruder_colors.data(), m_extruder_colors.size());
+    append(m_filament_diameters.data(), m_filament_diameters.size() * sizeof(float));
+    append(&m_producers_enabled, sizeof(m_producers_enabled));
+    for (const std::string& opt_key : m_time_processor.machine_limits.keys()) {
+        key += opt_key + "=" + m_time_processor.machine_limits.opt_serialize(opt_key) + "\n";
+    }
+    append(m_time_processor.filament_load_times.data(), m_time_processor.filament_load_times.size() * sizeof(float));
+    append(m_time_processor.filament_unload_times.data(), m_time_processor.filament_unload_times.size() * sizeof(float));
+    append(&m_time_processor.export_remaining_time_enabled, sizeof(bool));
+    append(&m_time_processor.machine_envelope_processing_enabled, sizeof(bool));
+    for (const TimeMachine& machine : m_time_processor.machines) {
+        append(&machine.enabled, sizeof(bool));
+        append(&machine.acceleration, sizeof(float));
+        append(&machine.max_acceleration, sizeof(float));
+    }
+    return key;
+}
+
+void GCodeProcessor::add_checkpoint(const GCodeReader::GCodeLine& line)
+{
+    // end of the line in m_unprocessed, including the newline, see GCodeReader::parse_line_internal()
+    std::string_view raw = line.raw();
+    size_t end = raw.data() + raw.size() - m_unprocessed.data();
+    if (end < m_unprocessed.size() && m_unprocessed[end] == '\r')
+        ++end;
+    if (end < m_unprocessed.size() && m_unprocessed[end] == '\n')
+        ++end;
+    if (m_processed_size + end < m_checkpoints->m_checkpoints.back().gcode_size + Checkpoints::Min_Interval)
+        return;
+
+    hash_processed(end);
+    // the planner queues are part of the checkpoint
+    synchronize_time_machines();
+    Checkpoints::Checkpoint& checkpoint = m_checkpoints->m_checkpoints.emplace_back();
+    checkpoint.gcode_size = m_hashed_size;
+    checkpoint.gcode_hash = m_gcode_hash;
+    save_checkpoint(checkpoint);
+}
+
+void GCodeProcessor::save_checkpoint(Checkpoints::Checkpoint& checkpoint)
+{
+    checkpoint.moves_count = m_result.moves.size();
+    checkpoint.units = m_units;
+    checkpoint.global_positioning_type = m_global_positioning_type;
+    checkpoint.e_local_positioning_type = m_e_local_positioning_type;
+    checkpoint.start_position = m_start_position;
+    checkpoint.end_position = m_end_position;
+    checkpoint.origin = m_origin;
+    checkpoint.cached_position = m_cached_position;
+    checkpoint.feedrate = m_feedrate;
+    checkpoint.width = m_width;
+    checkpoint.height = m_height;
+    checkpoint.mm3_per_mm = m_mm3_per_mm;
+    checkpoint.fan_speed = m_fan_speed;
+    checkpoint.extrusion_role = m_extrusion_role;
+    checkpoint.extruder_id = m_extruder_id;
+    checkpoint.extruder_colors = m_extruder_colors;
+    checkpoint.extruded_last_z = m_extruded_last_z;
+    checkpoint.layer_id = m_layer_id;
+    checkpoint.cp_color = m_cp_color;
+    checkpoint.producer = m_producer;
+    checkpoint.parser_position = { m_parser.x(), m_parser.y(), m_parser.z(), m_parser.e(), m_parser.f() };
+    checkpoint.extruder_unloaded = m_time_processor.extruder_unloaded;
+    checkpoint.machine_limits = m_time_processor.machine_limits;
+
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+        TimeMachine& machine = m_time_processor.machines[i];
+        assert(machine.new_blocks.empty());
+        checkpoint.g1_times_count[i] = machine.g1_times_cache.size();
+        checkpoint.layers_count[i] = machine.layers_time.size();
+        size_t first_open_layer = machine.layers_time.size();
+        for (const TimeBlock& block : machine.blocks) {
+            if (block.layer_id > 0)
+                first_open_layer = std::min<size_t>(first_open_layer, block.layer_id - 1);
+        }
+        checkpoint.first_open_layer[i] = first_open_layer;
+
+        // copy the machine without the vectors growing with the gcode
+        std::vector<float> g1_times_cache = std::move(machine.g1_times_cache);
+        std::vector<float> layers_time = std::move(machine.layers_time);
+        std::vector<float> blocks_time = std::move(machine.blocks_time);
+        checkpoint.machines[i] = machine;
+        machine.g1_times_cache = std::move(g1_times_cache);
+        machine.layers_time = std::move(layers_time);
+        machine.blocks_time = std::move(blocks_time);
+        checkpoint.machines[i].layers_time.assign(machine.layers_time.begin() + first_open_layer, machine.layers_time.end());
+    }
+}
+
+void GCodeProcessor::restore_checkpoint(const Checkpoints::Checkpoint& checkpoint)
+{
+    m_time_planner.wait();
+
+    // the moves and the times kept by end_process() are truncated to the checkpoint
+    m_result.moves = std::move(m_checkpoints->m_moves);
+    m_checkpoints->m_moves.clear();
+    m_result.moves.truncate(checkpoint.moves_count);
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count); ++i) {
+        TimeMachine& machine = m_time_processor.machines[i];
+        const TimeMachine& saved = checkpoint.machines[i];
+        std::vector<float> g1_times_cache = std::move(m_checkpoints->m_g1_times[i]);
+        g1_times_cache.resize(checkpoint.g1_times_count[i]);
+        std::vector<float> layers_time = std::move(m_checkpoints->m_layers_time[i]);
+        layers_time.resize(checkpoint.layers_count[i]);
+        std::copy(saved.layers_time.begin(), saved.layers_time.end(), layers_time.begin() + checkpoint.first_open_layer[i]);
+        machine = saved;
+        machine.g1_times_cache = std::move(g1_times_cache);
+        machine.layers_time = std::move(layers_time);
+        machine.blocks_kept = machine.blocks.size();
+    }
+
+    m_units = checkpoint.units;
+    m_global_positioning_type = checkpoint.global_positioning_type;
+    m_e_local_positioning_type = checkpoint.e_local_positioning_type;
+    m_start_position = checkpoint.start_position;
+    m_end_position = checkpoint.end_position;
+    m_origin = checkpoint.origin;
+    m_cached_position = checkpoint.cached_position;
+    m_feedrate = checkpoint.feedrate;
+    m_width = checkpoint.width;
+    m_height = checkpoint.height;
+    m_mm3_per_mm = checkpoint.mm3_per_mm;
+    m_fan_speed = checkpoint.fan_speed;
+    m_extrusion_role = checkpoint.extrusion_role;
+    m_extruder_id = checkpoint.extruder_id;
+    m_extruder_colors = checkpoint.extruder_colors;
+    m_extruded_last_z = checkpoint.extruded_last_z;
+    m_layer_id = checkpoint.layer_id;
+    m_cp_color = checkpoint.cp_color;
+    m_producer = checkpoint.producer;
+    m_parser.x() = checkpoint.parser_position[0];
+    m_parser.y() = checkpoint.parser_position[1];
+    m_parser.z() = checkpoint.parser_position[2];
+    m_parser.e() = checkpoint.parser_position[3];
+    m_parser.f() = checkpoint.parser_position[4];
+    m_time_processor.extruder_unloaded = checkpoint.extruder_unloaded;
+    m_time_processor.machine_limits = checkpoint.machine_limits;
+
+    m_gcode_hash = checkpoint.gcode_hash;
+    m_hashed_size = checkpoint.gcode_size;
+}
+
+void GCodeProcessor::replay_buffer(std::string_view buffer)
+{
+    m_unprocessed.append(buffer.data(), buffer.size());
+    const std::vector<Checkpoints::Checkpoint>& checkpoints = m_checkpoints->m_checkpoints;
+    while (m_next_checkpoint < checkpoints.size()) {
+        const Checkpoints::Checkpoint& checkpoint = checkpoints[m_next_checkpoint];
+        size_t available = m_processed_size + m_unprocessed.size();
+        hash_processed(std::min(available, checkpoint.gcode_size) - m_processed_size);
+        if (available < checkpoint.gcode_size)
+            // wait for more gcode
+            return;
+        if (m_gcode_hash != checkpoint.gcode_hash)
+            break;
+        // the gcode up to the checkpoint did not change, it does not need to be processed
+        m_unprocessed.erase(0, checkpoint.gcode_size - m_processed_size);
+        m_processed_size = checkpoint.gcode_size;
+        ++m_next_checkpoint;
+    }
+    // the gcode does not match the next checkpoint, or it matches all of them
+    stop_replaying();
+}
+
+void GCodeProcessor::stop_replaying()
+{
+    m_replaying = false;
+    std::vector<Checkpoints::Checkpoint>& checkpoints = m_checkpoints->m_checkpoints;
+    // the checkpoints following the last matched one will be taken again
+    checkpoints.erase(checkpoints.begin() + m_next_checkpoint, checkpoints.end());
+    assert(m_processed_size == checkpoints.back().gcode_size);
+    restore_checkpoint(checkpoints.back());
+    m_checkpoints->m_skipped_size = checkpoints.back().gcode_size;
+    std::string gcode = std::move(m_unprocessed);
+    m_unprocessed.clear();
+    process_buffer(gcode);
+}
+
 } /* namespace Slic3r */
 
 #endif // ENABLE_GCODE_VIEWER
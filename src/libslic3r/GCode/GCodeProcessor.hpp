@@ -11,6 +11,10 @@
 #include <array>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <functional>
+
+#include <tbb/task_group.h>
 
 namespace Slic3r {
 
@@ -192,7 +196,15 @@ namespace Slic3r {
             State curr;
             State prev;
             CustomGCodeTime gcode_time;
+            // Planner queue, processed by calculate_time(), which may run on a worker thread, see GCodeProcessor::schedule_time_calculation().
             std::vector<TimeBlock> blocks;
+            // Blocks added by process_G1() since they were last moved to the planner queue by take_new_blocks().
+            std::vector<TimeBlock> new_blocks;
+            // Number of blocks left in the planner queue once calculate_time() finishes, known in advance
+            // so that process_G1() does not need to wait for the planner.
+            size_t blocks_kept;
+            // Times of the blocks being processed by calculate_time(), kept to avoid reallocations.
+            std::vector<float> blocks_time;
             std::vector<float> g1_times_cache;
             std::array<float, static_cast<size_t>(EMoveType::Count)> moves_time;
             std::array<float, static_cast<size_t>(ExtrusionRole::erCount)> roles_time;
@@ -200,7 +212,11 @@ namespace Slic3r {
 
             void reset();
 
-            // Simulates firmware st_synchronize() call
+            // Number of blocks in the planner queue, including the new blocks not yet moved there.
+            size_t blocks_count() const { return blocks_kept + new_blocks.size(); }
+            // Moves new_blocks to the planner queue. Must not be called while calculate_time() runs.
+            void take_new_blocks();
+            // Simulates firmware st_synchronize() call. Must not be called while calculate_time() runs.
             void simulate_st_synchronize(float additional_time = 0.0f);
             void calculate_time(size_t keep_last_n_blocks = 0);
         };
@@ -235,6 +251,9 @@ namespace Slic3r {
 
             // post process the file with the given filename to add remaining time lines M73
             void post_process(const std::string& filename);
+            // post process the gcode returned in blocks by next_block() (an empty block marks the end) to add remaining time lines M73,
+            // the processed gcode is passed to write()
+            void post_process(const std::function<std::string_view()>& next_block, const std::function<void(const std::string&)>& write);
         };
 
     public:
@@ -256,10 +275,130 @@ namespace Slic3r {
             float volumetric_rate() const { return feedrate * mm3_per_mm; }
         };
 
+        // Compact columnar storage of the moves, less than half of the size of std::vector<MoveVertex>.
+        // The attributes shared by runs of consecutive moves (type, role, extruder, color, feedrate, height and fan speed)
+        // are run-length encoded, width and height are quantized to 1um. The positions are rounded to 1um, which keeps them exact
+        // only if they have at most 3 decimal digits in mm, as in the G-code exported by PrusaSlicer. Positions with more decimal
+        // digits (G-code of other slicers, moves in inches, relative moves) are stored with an error of up to 0.5um per axis.
+        // The positions are stored in blocks of key_position_interval moves as an absolute key position
+        // and the deltas of the other moves of the block against the key, packed to 0, 1, 2 or 4 bytes per axis and block.
+        // MoveVertex::time is not stored, it is the index of the move.
+        // The moves are returned by value, random access by move index is constant time: it visits the runs starting
+        // within the last 64 moves.
+        class MoveVertices
+        {
+        public:
+            static constexpr size_t key_position_interval = 16;
+            // 1um
+            static constexpr float  position_scale = 1000.0f;
+            static constexpr float  size_scale = 1000.0f;
+
+            size_t size() const { return m_size; }
+            bool empty() const { return m_size == 0; }
+            MoveVertex operator[](size_t id) const;
+            MoveVertex back() const { return (*this)[m_size - 1]; }
+
+            void emplace_back(const MoveVertex& move);
+            // Removes the moves from the given index on.
+            void truncate(size_t size);
+            void clear() { *this = MoveVertices(); }
+            void shrink_to_fit();
+            // memory occupied by the moves, in bytes
+            size_t memory_size() const;
+            // Checks that the columns are consistent with the count of moves, so that no move is read out of bounds.
+            // To be called on the moves deserialized from a GCodeIndex.
+            bool is_valid() const;
+
+        private:
+            template<typename T>
+            struct RunColumn
+            {
+                static constexpr size_t sample_shift = 6;
+
+                // first move and value of each run
+                std::vector<uint32_t> starts;
+                std::vector<T> values;
+                // run containing each (1 << sample_shift)-th move
+                std::vector<uint32_t> samples;
+
+                void push(size_t id, const T& value) {
+                    if (values.empty() || values.back() != value) {
+                        starts.emplace_back(static_cast<uint32_t>(id));
+                        values.emplace_back(value);
+                    }
+                    if ((id & ((size_t(1) << sample_shift) - 1)) == 0)
+                        samples.emplace_back(static_cast<uint32_t>(values.size() - 1));
+                }
+                void truncate(size_t size) {
+                    while (! starts.empty() && starts.back() >= size) {
+                        starts.pop_back();
+                        values.pop_back();
+                    }
+                    samples.resize((size + (size_t(1) << sample_shift) - 1) >> sample_shift);
+                }
+                const T& get(size_t id) const {
+                    size_t run = samples[id >> sample_shift];
+                    while (run + 1 < starts.size() && starts[run + 1] <= id)
+                        ++run;
+                    return values[run];
+                }
+                // the runs start at the first move and increase, the samples point to a run starting at or before their move
+                bool is_valid(size_t size) const {
+                    if (starts.size() != values.size() || starts.empty() != (size == 0) || (! starts.empty() && starts.front() != 0) ||
+                        samples.size() != ((size + (size_t(1) << sample_shift) - 1) >> sample_shift))
+                        return false;
+                    for (size_t i = 1; i < starts.size(); ++i) {
+                        if (starts[i] <= starts[i - 1] || starts[i] >= size)
+                            return false;
+                    }
+                    for (size_t i = 0; i < samples.size(); ++i) {
+                        if (samples[i] >= starts.size() || starts[samples[i]] > (i << sample_shift))
+                            return false;
+                    }
+                    return true;
+                }
+                void shrink_to_fit() { starts.shrink_to_fit(); values.shrink_to_fit(); samples.shrink_to_fit(); }
+                size_t memory_size() const {
+                    return starts.capacity() * sizeof(uint32_t) + values.capacity() * sizeof(T) + samples.capacity() * sizeof(uint32_t);
+                }
+                template<class Archive> void serialize(Archive& ar) { ar(starts, values, samples); }
+            };
+
+            size_t m_size{ 0 };
+            // type, extrusion role, extruder id and color id packed into a single value
+            RunColumn<uint32_t> m_kind;
+            RunColumn<float> m_feedrate;
+            RunColumn<float> m_fan_speed;
+            RunColumn<uint16_t> m_height;
+            std::vector<uint16_t> m_width;
+            std::vector<float> m_mm3_per_mm;
+            std::vector<float> m_delta_extruder;
+            // quantized position of the first move of each complete block
+            std::vector<Vec3i> m_key_positions;
+            // offset into m_position_deltas of the deltas of the other moves of each complete block
+            std::vector<uint32_t> m_position_offsets;
+            // bytes per delta of each axis of each complete block, 2 bits per axis: 0, 1, 2 or 4 bytes
+            std::vector<uint8_t> m_position_widths;
+            // deltas against the key position, little endian
+            std::vector<uint8_t> m_position_deltas;
+            // quantized positions of the moves of the last incomplete block
+            std::vector<Vec3i> m_last_positions;
+
+            Vec3i quantized_position(size_t id) const;
+            void encode_last_positions();
+
+            // see GCodeIndex
+            friend class cereal::access;
+            template<class Archive> void serialize(Archive& ar) {
+                ar(m_size, m_kind, m_feedrate, m_fan_speed, m_height, m_width, m_mm3_per_mm, m_delta_extruder,
+                    m_key_positions, m_position_offsets, m_position_widths, m_position_deltas, m_last_positions);
+            }
+        };
+
         struct Result
         {
             unsigned int id;
-            std::vector<MoveVertex> moves;
+            MoveVertices moves;
             Pointfs bed_shape;
             std::string printer_settings_id;
             std::vector<std::string> extruder_colors;
@@ -270,20 +409,58 @@ namespace Slic3r {
             void reset()
             {
                 time = 0;
-                moves = std::vector<MoveVertex>();
+                moves.clear();
                 bed_shape = Pointfs();
                 extruder_colors = std::vector<std::string>();
             }
 #else
             void reset()
             {
-                moves = std::vector<MoveVertex>();
+                moves.clear();
                 bed_shape = Pointfs();
                 extruder_colors = std::vector<std::string>();
             }
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
         };
 
+        // Snapshots of the state of the processor taken at the layer changes of the gcode passed to process_buffer(),
+        // at least Min_Interval bytes of gcode apart, see begin_process().
+        // When the gcode is exported again after a change affecting only its last layers (for example a custom gcode
+        // or a color change inserted at a layer), the gcode is only hashed up to the first snapshot it does not match,
+        // then the processing restarts from the previous snapshot. The moves and the times of the last processed gcode
+        // are kept to restore the result up to the snapshot.
+        class Checkpoints
+        {
+        public:
+            static constexpr size_t Min_Interval = 512 * 1024;
+
+            // Disabled by default, the kept moves take about as much memory as the result.
+            void set_enabled(bool enabled) { m_enabled = enabled; if (! enabled) clear(); }
+            bool is_enabled() const { return m_enabled; }
+            // Count of snapshots usable by the next processing, zero if the last processing did not finish.
+            size_t size() const { return m_complete ? m_checkpoints.size() : 0; }
+            // Size of the G-code not processed by the last processing, as it matched the snapshots.
+            size_t skipped_size() const { return m_skipped_size; }
+            void clear();
+            // memory occupied by the snapshots and by the kept moves and times, in bytes
+            size_t memory_size() const;
+
+        private:
+            friend class GCodeProcessor;
+            struct Checkpoint;
+
+            bool m_enabled{ false };
+            // set by end_process()
+            bool m_complete{ false };
+            size_t m_skipped_size{ 0 };
+            // state set by apply_config(), the snapshots are valid for this configuration only
+            std::string m_configuration;
+            std::vector<Checkpoint> m_checkpoints;
+            MoveVertices m_moves;
+            std::array<std::vector<float>, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> m_g1_times;
+            std::array<std::vector<float>, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> m_layers_time;
+        };
+
 #if ENABLE_GCODE_VIEWER_DATA_CHECKING
         struct DataChecker
         {
@@ -354,6 +531,19 @@ namespace Slic3r {
 
     private:
         GCodeReader m_parser;
+        // the last incomplete line passed to process_buffer(), or while replaying, the gcode passed since the last matched checkpoint
+        std::string m_unprocessed;
+        // size of the gcode passed to process_buffer() preceding m_unprocessed
+        size_t m_processed_size;
+        // FNV-1a hash of the first m_hashed_size bytes of the gcode passed to process_buffer()
+        uint64_t m_gcode_hash;
+        size_t m_hashed_size;
+        // see begin_process(Checkpoints*)
+        Checkpoints* m_checkpoints;
+        // the gcode matches the gcode the checkpoints were taken from, it is hashed, not processed
+        bool m_replaying;
+        // index of the checkpoint to be matched next while replaying
+        size_t m_next_checkpoint;
 
         EUnits m_units;
         EPositioningType m_global_positioning_type;
@@ -394,6 +584,8 @@ namespace Slic3r {
         bool m_producers_enabled;
 
         TimeProcessor m_time_processor;
+        // Runs TimeMachine::calculate_time() of the machines concurrently with each other and with the processing of the gcode.
+        tbb::task_group m_time_planner;
 
         Result m_result;
         static unsigned int s_result_id;
@@ -406,6 +598,7 @@ namespace Slic3r {
 
     public:
         GCodeProcessor();
+        ~GCodeProcessor();
 
         void apply_config(const PrintConfig& config);
         void apply_config(const DynamicPrintConfig& config);
@@ -423,6 +616,24 @@ namespace Slic3r {
         // Process the gcode contained in the file with the given filename
         // throws CanceledException through print->throw_if_canceled() (sent by the caller as callback).
         void process_file(const std::string& filename, std::function<void()> cancel_callback = nullptr);
+        // Load the result from the binary index written next to the gcode file by the export, see GCodeIndex.
+        // Returns false if there is no index matching the file, then the file needs to be processed by process_file().
+        bool load_index(const std::string& filename);
+
+        // Process the gcode while it is being generated, see GCode::do_export():
+        // begin_process(), then process_buffer() for each block of gcode, then end_process().
+        // The blocks do not need to be aligned with the lines.
+        // If checkpoints are passed and enabled, the processing starts from the last checkpoint matching the gcode,
+        // then the checkpoints are updated for the processed gcode. They are valid for the same configuration only.
+        void begin_process(Checkpoints* checkpoints = nullptr);
+        void process_buffer(std::string_view buffer);
+        void end_process();
+        bool is_post_process_needed() const { return m_time_processor.export_remaining_time_enabled; }
+        // Post process the gcode passed to process_buffer() and kept in memory by the caller
+        // to add remaining time lines M73, the processed gcode is passed to write(), see TimeProcessor::post_process()
+        void post_process(std::vector<std::string>&& gcode_blocks, const std::function<void(const std::string&)>& write);
+        // Post process in place the file with the gcode passed to process_buffer(), if the gcode was too big to be kept in memory.
+        void post_process(const std::string& filename) { m_time_processor.post_process(filename); }
 
         float get_time(PrintEstimatedTimeStatistics::ETimeMode mode) const;
         std::string get_time_dhm(PrintEstimatedTimeStatistics::ETimeMode mode) const;
@@ -436,15 +647,15 @@ namespace Slic3r {
         void process_gcode_line(const GCodeReader::GCodeLine& line);
 
         // Process tags embedded into comments
-        void process_tags(const std::string& comment);
-        bool process_producers_tags(const std::string& comment);
-        bool process_prusaslicer_tags(const std::string& comment);
-        bool process_cura_tags(const std::string& comment);
-        bool process_simplify3d_tags(const std::string& comment);
-        bool process_craftware_tags(const std::string& comment);
-        bool process_ideamaker_tags(const std::string& comment);
+        void process_tags(std::string_view comment);
+        bool process_producers_tags(std::string_view comment);
+        bool process_prusaslicer_tags(std::string_view comment);
+        bool process_cura_tags(std::string_view comment);
+        bool process_simplify3d_tags(std::string_view comment);
+        bool process_craftware_tags(std::string_view comment);
+        bool process_ideamaker_tags(std::string_view comment);
 
-        bool detect_producer(const std::string& comment);
+        bool detect_producer(std::string_view comment);
 
         // Move
         void process_G0(const GCodeReader::GCodeLine& line);
@@ -550,9 +761,64 @@ namespace Slic3r {
         // Simulates firmware st_synchronize() call
         void simulate_st_synchronize(float additional_time = 0.0f);
 
+        // Hands the planner queues grown over the refresh threshold to TimeMachine::calculate_time() running on worker threads.
+        void schedule_time_calculation();
+        // Waits for the running TimeMachine::calculate_time() and moves the new blocks to the planner queues.
+        void synchronize_time_machines();
+
         void update_estimated_times_stats();
+
+        // Hashes m_unprocessed up to the given position.
+        void hash_processed(size_t end);
+        std::string configuration_key() const;
+        // Takes a checkpoint at the end of the given line, if far enough from the last one.
+        void add_checkpoint(const GCodeReader::GCodeLine& line);
+        void save_checkpoint(Checkpoints::Checkpoint& checkpoint);
+        void restore_checkpoint(const Checkpoints::Checkpoint& checkpoint);
+        // Hashes the gcode while it matches the checkpoints.
+        void replay_buffer(std::string_view buffer);
+        // Restores the last matched checkpoint and processes the gcode passed since.
+        void stop_replaying();
    };
 
+    struct GCodeProcessor::Checkpoints::Checkpoint
+    {
+        // the gcode processed up to the end of the line of a layer change tag
+        size_t gcode_size{ 0 };
+        uint64_t gcode_hash{ 0 };
+        size_t moves_count{ 0 };
+
+        EUnits units;
+        EPositioningType global_positioning_type;
+        EPositioningType e_local_positioning_type;
+        AxisCoords start_position;
+        AxisCoords end_position;
+        AxisCoords origin;
+        CachedPosition cached_position;
+        float feedrate;
+        float width;
+        float height;
+        float mm3_per_mm;
+        float fan_speed;
+        ExtrusionRole extrusion_role;
+        unsigned char extruder_id;
+        ExtruderColors extruder_colors;
+        float extruded_last_z;
+        unsigned int layer_id;
+        CpColor cp_color;
+        EProducer producer;
+        std::array<float, 5> parser_position;
+        bool extruder_unloaded;
+        MachineEnvelopeConfig machine_limits;
+
+        // The machines without g1_times_cache, whose layers_time holds the times of the layers from first_open_layer on only,
+        // the times of the blocks in the planner queue are still to be added to them.
+        std::array<TimeMachine, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> machines;
+        std::array<size_t, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> g1_times_count;
+        std::array<size_t, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> layers_count;
+        std::array<size_t, static_cast<size_t>(PrintEstimatedTimeStatistics::ETimeMode::Count)> first_open_layer;
+    };
+
 } /* namespace Slic3r */
 
 #endif // ENABLE_GCODE_VIEWER
@@ -57,7 +57,7 @@ std::string SpiralVase::process_layer(const std::string &gcode)
                 // If this is the initial Z move of the layer, replace it with a
                 // (redundant) move to the last Z of previous layer.
                 line.set(reader, Z, z);
-                new_gcode += line.raw() + '\n';
+                new_gcode += std::string(line.raw()) + '\n';
                 return;
             } else {
                 float dist_XY = line.dist_XY(reader);
@@ -66,7 +66,7 @@ std::string SpiralVase::process_layer(const std::string &gcode)
                     if (line.extruding(reader)) {
                         z += dist_XY * layer_height / total_layer_length;
                         line.set(reader, Z, z);
-                        new_gcode += line.raw() + '\n';
+                        new_gcode += std::string(line.raw()) + '\n';
                     }
                     return;
                 
@@ -78,7 +78,7 @@ std::string SpiralVase::process_layer(const std::string &gcode)
                 }
             }
         }
-        new_gcode += line.raw() + '\n';
+        new_gcode += std::string(line.raw()) + '\n';
     });
     
     return new_gcode;
@@ -740,7 +740,7 @@ void WipingExtrusions::ensure_perimeters_infills_order(const Print& print)
     }
 }
 
-// Following function is called from GCode::process_layer and returns pointer to vector with information about which extruders should be used for given copy of this entity.
+// Following function is called from GCode::resolve_extruder_overrides and returns pointer to vector with information about which extruders should be used for given copy of this entity.
 // If this extrusion does not have any override, nullptr is returned.
 // Otherwise it modifies the vector in place and changes all -1 to correct_extruder_id (at the time the overrides were created, correct extruders were not known,
 // so -1 was used as "print as usual").
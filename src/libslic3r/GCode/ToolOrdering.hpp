@@ -32,8 +32,13 @@ public:
     // When allocating extruder overrides of an object's ExtrusionEntity, overrides for maximum 3 copies are allocated in place.
     typedef boost::container::small_vector<int32_t, 3> ExtruderPerCopy;
 
-    // This is called from GCode::process_layer - see implementation for further comments:
+    // This is called from GCode::resolve_extruder_overrides - see implementation for further comments:
     const ExtruderPerCopy* get_extruder_overrides(const ExtrusionEntity* entity, int correct_extruder_id, size_t num_of_copies);
+    // Returns the overrides of an entity already resolved by get_extruder_overrides(), nullptr if the entity is not overridden.
+    const ExtruderPerCopy* resolved_extruder_overrides(const ExtrusionEntity* entity) const {
+        auto it = entity_map.find(entity);
+        return it == entity_map.end() ? nullptr : &it->second;
+    }
 
     // This function goes through all infill entities, decides which ones will be used for wiping and
     // marks them by the extruder id. Returns volume that remains to be wiped on the wipe tower:
@@ -114,6 +119,7 @@ public:
         m_wiping_extrusions.set_layer_tools_ptr(this);
         return m_wiping_extrusions;
     }
+    const WipingExtrusions& wiping_extrusions() const { return m_wiping_extrusions; }
 
 private:
     // This object holds list of extrusion that will be used for extruder wiping
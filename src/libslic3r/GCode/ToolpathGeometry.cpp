@@ -0,0 +1,576 @@
+#include "libslic3r/libslic3r.h"
+
+#if ENABLE_GCODE_VIEWER
+#include "ToolpathGeometry.hpp"
+
+#include <tbb/parallel_for.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace Slic3r {
+
+static float round_to_nearest(float value, unsigned int decimals)
+{
+    float res = 0.0f;
+    if (decimals == 0)
+        res = std::round(value);
+    else {
+        char buf[64];
+        sprintf(buf, "%.*g", decimals, value);
+        res = std::stof(buf);
+    }
+    return res;
+}
+
+bool ToolpathGeometry::Path::matches(const GCodeProcessor::MoveVertex& move) const
+{
+    switch (move.type)
+    {
+    case EMoveType::Tool_change:
+    case EMoveType::Color_change:
+    case EMoveType::Pause_Print:
+    case EMoveType::Custom_GCode:
+    case EMoveType::Retract:
+    case EMoveType::Unretract:
+    case EMoveType::Extrude:
+    {
+        // use rounding to reduce the number of generated paths
+        return type == move.type && role == move.extrusion_role && height == round_to_nearest(move.height, 2) &&
+            width == round_to_nearest(move.width, 2) && feedrate == move.feedrate && fan_speed == move.fan_speed &&
+            volumetric_rate == round_to_nearest(move.volumetric_rate(), 2) && extruder_id == move.extruder_id &&
+            cp_color_id == move.cp_color_id;
+    }
+    case EMoveType::Travel:
+    {
+        return type == move.type && feedrate == move.feedrate && extruder_id == move.extruder_id && cp_color_id == move.cp_color_id;
+    }
+    default: { return false; }
+    }
+}
+
+static ToolpathGeometry::Path make_path(const GCodeProcessor::MoveVertex& move, size_t i_id, size_t s_id)
+{
+    ToolpathGeometry::Path::Endpoint endpoint = { 0, i_id, s_id, move.position };
+    // use rounding to reduce the number of generated paths
+    return { move.type, move.extrusion_role, endpoint, endpoint, move.delta_extruder,
+        round_to_nearest(move.height, 2), round_to_nearest(move.width, 2), move.feedrate, move.fan_speed,
+        round_to_nearest(move.volumetric_rate(), 2), move.extruder_id, move.cp_color_id };
+}
+
+size_t ToolpathGeometry::Buffer::vertex_size_floats(EPrimitive primitive)
+{
+    switch (primitive)
+    {
+    case EPrimitive::Point:    { return 3; }
+    case EPrimitive::Line:     { return 4; }
+    case EPrimitive::Triangle: { return 6; }
+    default:                   { return 0; }
+    }
+}
+
+unsigned int ToolpathGeometry::Buffer::indices_per_segment(EPrimitive primitive)
+{
+    switch (primitive)
+    {
+    case EPrimitive::Point:    { return 1; }
+    case EPrimitive::Line:     { return 2; }
+    case EPrimitive::Triangle: { return 42; } // 3 indices x 14 triangles
+    default:                   { return 0; }
+    }
+}
+
+size_t ToolpathGeometry::Buffer::memory_size() const
+{
+    size_t size = 0;
+    for (const VertexBlock& block : vertex_blocks)
+        size += block.vertices.capacity() * sizeof(float);
+    for (const IndexBlock& block : index_blocks)
+        size += block.indices.capacity() * sizeof(unsigned int);
+    return size;
+}
+
+ToolpathGeometry::EPrimitive ToolpathGeometry::primitive(EMoveType type)
+{
+    switch (type)
+    {
+    case EMoveType::Extrude: { return EPrimitive::Triangle; }
+    case EMoveType::Travel:  { return EPrimitive::Line; }
+    default:                 { return EPrimitive::Point; }
+    }
+}
+
+void ToolpathGeometry::clear()
+{
+    for (Buffer& buffer : m_buffers)
+        buffer = Buffer();
+    m_batches.clear();
+}
+
+size_t ToolpathGeometry::memory_size() const
+{
+    size_t size = 0;
+    for (const Buffer& buffer : m_buffers)
+        size += buffer.memory_size();
+    return size;
+}
+
+namespace {
+
+// Continuity of a path made of triangles between its segments
+struct SolidState
+{
+    Vec3f prev_dir;
+    Vec3f prev_up;
+    float prev_length;
+};
+
+} // namespace
+
+void ToolpathGeometry::count_batch(const GCodeProcessor::MoveVertices& moves, Batch& batch, std::array<std::vector<Path>, Buffers_Count>& batch_paths) const
+{
+    GCodeProcessor::MoveVertex prev = moves[batch.begin - 1];
+    for (size_t move_id = batch.begin; move_id < batch.end; ++move_id) {
+        GCodeProcessor::MoveVertex curr = moves[move_id];
+        if (curr.type != EMoveType::Noop) {
+            size_t id = buffer_id(curr.type);
+            EPrimitive primitive = m_buffers[id].primitive;
+            Batch::BufferData& data = batch.buffers[id];
+            std::vector<Path>& paths = batch_paths[id];
+            switch (primitive)
+            {
+            case EPrimitive::Point:
+            {
+                paths.emplace_back(make_path(curr, data.indices_count, move_id));
+                data.vertices_count += 1;
+                data.indices_count += 1;
+                break;
+            }
+            case EPrimitive::Line:
+            case EPrimitive::Triangle:
+            {
+                // the first move of each batch starts a new path, so that no path spans two index buffers
+                bool new_path = prev.type != curr.type || paths.empty() || !paths.back().matches(curr);
+                if (new_path) {
+                    paths.emplace_back(make_path(curr, data.indices_count, move_id - 1));
+                    paths.back().first.position = prev.position;
+                }
+                if (primitive == EPrimitive::Line)
+                    data.vertices_count += 2;
+                else
+                    data.vertices_count += new_path ? 8 : 6;
+                data.indices_count += Buffer::indices_per_segment(primitive);
+                paths.back().last = { 0, data.indices_count - 1, move_id, curr.position };
+                break;
+            }
+            }
+        }
+        prev = curr;
+    }
+    for (size_t id = 0; id < Buffers_Count; ++id) {
+        batch.buffers[id].paths_count = batch_paths[id].size();
+    }
+}
+
+static void store_vertex(float*& vertices, const Vec3f& position, const Vec3f& normal)
+{
+    for (int j = 0; j < 3; ++j) {
+        *vertices++ = position[j];
+    }
+    for (int j = 0; j < 3; ++j) {
+        *vertices++ = normal[j];
+    }
+}
+
+static void store_triangle(unsigned int*& indices, unsigned int i1, unsigned int i2, unsigned int i3)
+{
+    *indices++ = i1;
+    *indices++ = i2;
+    *indices++ = i3;
+}
+
+// Stores the vertices and indices of a segment rendered as solid.
+// vertices_begin points to the first vertex of the batch, whose id is first_vertex_id,
+// vertices points to the next vertex to be stored.
+static void add_solid_segment(const GCodeProcessor::MoveVertex& prev, const GCodeProcessor::MoveVertex& curr, const ToolpathGeometry::Path& path, bool first_segment,
+    SolidState& state, float* vertices_begin, float*& vertices, size_t first_vertex_id, unsigned int*& indices)
+{
+    static const size_t vertex_size = ToolpathGeometry::Buffer::vertex_size_floats(ToolpathGeometry::EPrimitive::Triangle);
+
+    auto extract_position_at = [vertices_begin](size_t id) {
+        return Vec3f(vertices_begin[id + 0], vertices_begin[id + 1], vertices_begin[id + 2]);
+    };
+    auto update_position_at = [vertices_begin](size_t id, const Vec3f& position) {
+        vertices_begin[id + 0] = position[0];
+        vertices_begin[id + 1] = position[1];
+        vertices_begin[id + 2] = position[2];
+    };
+    auto append_dummy_cap = [&indices](unsigned int id) {
+        store_triangle(indices, id, id, id);
+        store_triangle(indices, id, id, id);
+    };
+
+    // id of the first vertex of this segment, relative to the batch and absolute
+    size_t starting_local_id = (vertices - vertices_begin) / vertex_size;
+    unsigned int starting_vertices_size = static_cast<unsigned int>(first_vertex_id + starting_local_id);
+
+    Vec3f dir = (curr.position - prev.position).normalized();
+    Vec3f right = (std::abs(std::abs(dir.dot(Vec3f::UnitZ())) - 1.0f) < EPSILON) ? -Vec3f::UnitY() : Vec3f(dir[1], -dir[0], 0.0f).normalized();
+    Vec3f left = -right;
+    Vec3f up = right.cross(dir);
+    Vec3f down = -up;
+
+    float half_width = 0.5f * path.width;
+    float half_height = 0.5f * path.height;
+
+    Vec3f prev_pos = prev.position - half_height * up;
+    Vec3f curr_pos = curr.position - half_height * up;
+
+    float length = (curr_pos - prev_pos).norm();
+    if (first_segment) {
+        // vertices 1st endpoint
+        store_vertex(vertices, prev_pos + half_height * up, up);
+        store_vertex(vertices, prev_pos + half_width * right, right);
+        store_vertex(vertices, prev_pos + half_height * down, down);
+        store_vertex(vertices, prev_pos + half_width * left, left);
+
+        // vertices 2nd endpoint
+        store_vertex(vertices, curr_pos + half_height * up, up);
+        store_vertex(vertices, curr_pos + half_width * right, right);
+        store_vertex(vertices, curr_pos + half_height * down, down);
+        store_vertex(vertices, curr_pos + half_width * left, left);
+
+        // triangles starting cap
+        store_triangle(indices, starting_vertices_size + 0, starting_vertices_size + 2, starting_vertices_size + 1);
+        store_triangle(indices, starting_vertices_size + 0, starting_vertices_size + 3, starting_vertices_size + 2);
+
+        // dummy triangles outer corner cap
+        append_dummy_cap(starting_vertices_size);
+
+        // triangles sides
+        store_triangle(indices, starting_vertices_size + 0, starting_vertices_size + 1, starting_vertices_size + 4);
+        store_triangle(indices, starting_vertices_size + 1, starting_vertices_size + 5, starting_vertices_size + 4);
+        store_triangle(indices, starting_vertices_size + 1, starting_vertices_size + 2, starting_vertices_size + 5);
+        store_triangle(indices, starting_vertices_size + 2, starting_vertices_size + 6, starting_vertices_size + 5);
+        store_triangle(indices, starting_vertices_size + 2, starting_vertices_size + 3, starting_vertices_size + 6);
+        store_triangle(indices, starting_vertices_size + 3, starting_vertices_size + 7, starting_vertices_size + 6);
+        store_triangle(indices, starting_vertices_size + 3, starting_vertices_size + 0, starting_vertices_size + 7);
+        store_triangle(indices, starting_vertices_size + 0, starting_vertices_size + 4, starting_vertices_size + 7);
+
+        // triangles ending cap
+        store_triangle(indices, starting_vertices_size + 4, starting_vertices_size + 6, starting_vertices_size + 7);
+        store_triangle(indices, starting_vertices_size + 4, starting_vertices_size + 5, starting_vertices_size + 6);
+    }
+    else {
+        // any other segment
+        float displacement = 0.0f;
+        float cos_dir = state.prev_dir.dot(dir);
+        if (cos_dir > -0.9998477f) {
+            // if the angle between adjacent segments is smaller than 179 degrees
+            Vec3f med_dir = (state.prev_dir + dir).normalized();
+            displacement = half_width * ::tan(::acos(std::clamp(dir.dot(med_dir), -1.0f, 1.0f)));
+        }
+
+        Vec3f displacement_vec = displacement * state.prev_dir;
+        bool can_displace = displacement > 0.0f && displacement < state.prev_length && displacement < length;
+
+        // the previous segment belongs to the same path, thus to the same batch
+        assert(starting_local_id >= 3);
+        size_t prev_right_id = (starting_local_id - 3) * vertex_size;
+        size_t prev_left_id = (starting_local_id - 1) * vertex_size;
+        Vec3f prev_right_pos = extract_position_at(prev_right_id);
+        Vec3f prev_left_pos = extract_position_at(prev_left_id);
+
+        bool is_right_turn = state.prev_up.dot(state.prev_dir.cross(dir)) <= 0.0f;
+        // whether the angle between adjacent segments is greater than 45 degrees
+        bool is_sharp = cos_dir < 0.7071068f;
+
+        bool right_displaced = false;
+        bool left_displaced = false;
+
+        // displace the vertex (inner with respect to the corner) of the previous segment 2nd enpoint, if possible
+        if (can_displace) {
+            if (is_right_turn) {
+                prev_right_pos -= displacement_vec;
+                update_position_at(prev_right_id, prev_right_pos);
+                right_displaced = true;
+            }
+            else {
+                prev_left_pos -= displacement_vec;
+                update_position_at(prev_left_id, prev_left_pos);
+                left_displaced = true;
+            }
+        }
+
+        // whether the outer corner is closed by the displaced vertices
+        bool outer_displaced = false;
+        if (!is_sharp) {
+            // displace the vertex (outer with respect to the corner) of the previous segment 2nd enpoint, if possible
+            if (can_displace) {
+                if (is_right_turn) {
+                    prev_left_pos += displacement_vec;
+                    update_position_at(prev_left_id, prev_left_pos);
+                    left_displaced = true;
+                }
+                else {
+                    prev_right_pos += displacement_vec;
+                    update_position_at(prev_right_id, prev_right_pos);
+                    right_displaced = true;
+                }
+                outer_displaced = true;
+            }
+
+            // vertices 1st endpoint (top and bottom are from previous segment 2nd endpoint)
+            // vertices position matches that of the previous segment 2nd endpoint, if displaced
+            store_vertex(vertices, right_displaced ? prev_right_pos : prev_pos + half_width * right, right);
+            store_vertex(vertices, left_displaced ? prev_left_pos : prev_pos + half_width * left, left);
+        }
+        else {
+            // vertices 1st endpoint (top and bottom are from previous segment 2nd endpoint)
+            // the inner corner vertex position matches that of the previous segment 2nd endpoint, if displaced
+            if (is_right_turn) {
+                store_vertex(vertices, right_displaced ? prev_right_pos : prev_pos + half_width * right, right);
+                store_vertex(vertices, prev_pos + half_width * left, left);
+            }
+            else {
+                store_vertex(vertices, prev_pos + half_width * right, right);
+                store_vertex(vertices, left_displaced ? prev_left_pos : prev_pos + half_width * left, left);
+            }
+        }
+
+        // vertices 2nd endpoint
+        store_vertex(vertices, curr_pos + half_height * up, up);
+        store_vertex(vertices, curr_pos + half_width * right, right);
+        store_vertex(vertices, curr_pos + half_height * down, down);
+        store_vertex(vertices, curr_pos + half_width * left, left);
+
+        // triangles starting cap
+        store_triangle(indices, starting_vertices_size - 4, starting_vertices_size - 2, starting_vertices_size + 0);
+        store_triangle(indices, starting_vertices_size - 4, starting_vertices_size + 1, starting_vertices_size - 2);
+
+        // triangles outer corner cap
+        if (outer_displaced)
+            // dummy triangles
+            append_dummy_cap(starting_vertices_size);
+        else if (is_right_turn) {
+            store_triangle(indices, starting_vertices_size - 4, starting_vertices_size + 1, starting_vertices_size - 1);
+            store_triangle(indices, starting_vertices_size + 1, starting_vertices_size - 2, starting_vertices_size - 1);
+        }
+        else {
+            store_triangle(indices, starting_vertices_size - 4, starting_vertices_size - 3, starting_vertices_size + 0);
+            store_triangle(indices, starting_vertices_size - 3, starting_vertices_size - 2, starting_vertices_size + 0);
+        }
+
+        // triangles sides
+        store_triangle(indices, starting_vertices_size - 4, starting_vertices_size + 0, starting_vertices_size + 2);
+        store_triangle(indices, starting_vertices_size + 0, starting_vertices_size + 3, starting_vertices_size + 2);
+        store_triangle(indices, starting_vertices_size + 0, starting_vertices_size - 2, starting_vertices_size + 3);
+        store_triangle(indices, starting_vertices_size - 2, starting_vertices_size + 4, starting_vertices_size + 3);
+        store_triangle(indices, starting_vertices_size - 2, starting_vertices_size + 1, starting_vertices_size + 4);
+        store_triangle(indices, starting_vertices_size + 1, starting_vertices_size + 5, starting_vertices_size + 4);
+        store_triangle(indices, starting_vertices_size + 1, starting_vertices_size - 4, starting_vertices_size + 5);
+        store_triangle(indices, starting_vertices_size - 4, starting_vertices_size + 2, starting_vertices_size + 5);
+
+        // triangles ending cap
+        store_triangle(indices, starting_vertices_size + 2, starting_vertices_size + 4, starting_vertices_size + 5);
+        store_triangle(indices, starting_vertices_size + 2, starting_vertices_size + 3, starting_vertices_size + 4);
+    }
+
+    state.prev_dir = dir;
+    state.prev_up = up;
+    state.prev_length = length;
+}
+
+void ToolpathGeometry::generate_batch(const GCodeProcessor::MoveVertices& moves, const Batch& batch,
+    const std::array<float*, Buffers_Count>& vertices_begin, const std::array<unsigned int*, Buffers_Count>& indices_begin) const
+{
+    // cursors into the blocks of the batch and into its paths
+    std::array<float*, Buffers_Count> vertices = vertices_begin;
+    std::array<unsigned int*, Buffers_Count> indices = indices_begin;
+    std::array<size_t, Buffers_Count> next_path;
+    std::array<SolidState, Buffers_Count> solid_states;
+    for (size_t id = 0; id < Buffers_Count; ++id) {
+        next_path[id] = batch.buffers[id].first_path_id;
+    }
+
+    GCodeProcessor::MoveVertex prev = moves[batch.begin - 1];
+    for (size_t move_id = batch.begin; move_id < batch.end; ++move_id) {
+        GCodeProcessor::MoveVertex curr = moves[move_id];
+        if (curr.type != EMoveType::Noop) {
+            size_t id = buffer_id(curr.type);
+            const Batch::BufferData& data = batch.buffers[id];
+            const Buffer& buffer = m_buffers[id];
+            const std::vector<Path>& paths = buffer.paths;
+            switch (buffer.primitive)
+            {
+            case EPrimitive::Point:
+            {
+                unsigned int vertex_id = static_cast<unsigned int>(data.first_vertex_id + (vertices[id] - vertices_begin[id]) / 3);
+                for (int j = 0; j < 3; ++j) {
+                    *vertices[id]++ = curr.position[j];
+                }
+                *indices[id]++ = vertex_id;
+                ++next_path[id];
+                break;
+            }
+            case EPrimitive::Line:
+            {
+                unsigned int vertex_id = static_cast<unsigned int>(data.first_vertex_id + (vertices[id] - vertices_begin[id]) / 4);
+                // x component of the normal to the current segment (the normal is parallel to the XY plane)
+                float normal_x = (curr.position - prev.position).normalized()[1];
+                for (const GCodeProcessor::MoveVertex* vertex : { &prev, &curr }) {
+                    for (int j = 0; j < 3; ++j) {
+                        *vertices[id]++ = vertex->position[j];
+                    }
+                    *vertices[id]++ = normal_x;
+                }
+                *indices[id]++ = vertex_id;
+                *indices[id]++ = vertex_id + 1;
+                if (next_path[id] < paths.size() && paths[next_path[id]].first.s_id == move_id - 1)
+                    ++next_path[id];
+                break;
+            }
+            case EPrimitive::Triangle:
+            {
+                bool first_segment = next_path[id] < paths.size() && paths[next_path[id]].first.s_id == move_id - 1;
+                if (first_segment)
+                    ++next_path[id];
+                assert(next_path[id] > data.first_path_id);
+                add_solid_segment(prev, curr, paths[next_path[id] - 1], first_segment, solid_states[id], vertices_begin[id], vertices[id], data.first_vertex_id, indices[id]);
+                break;
+            }
+            }
+        }
+        prev = curr;
+    }
+
+#ifndef NDEBUG
+    for (size_t id = 0; id < Buffers_Count; ++id) {
+        const Batch::BufferData& data = batch.buffers[id];
+        assert(vertices[id] == vertices_begin[id] + data.vertices_count * m_buffers[id].vertex_size_floats());
+        assert(indices[id] == indices_begin[id] + data.indices_count);
+        assert(next_path[id] == data.first_path_id + data.paths_count);
+    }
+#endif // NDEBUG
+}
+
+void ToolpathGeometry::build(const GCodeProcessor::MoveVertices& moves, size_t batch_size)
+{
+    clear();
+
+    for (size_t id = 0; id < Buffers_Count; ++id) {
+        m_buffers[id].primitive = primitive(buffer_type(id));
+    }
+
+    // skip the first (dummy) move
+    if (moves.size() < 2)
+        return;
+
+    // split the moves into batches ending where the move type changes, so that no path spans two batches,
+    // unless a run of moves of the same type would not fit into a single index buffer
+    for (size_t begin = 1; begin < moves.size();) {
+        size_t end = std::min(begin + std::max<size_t>(batch_size, 1), moves.size());
+        if (end < moves.size()) {
+            EMoveType type = moves[end - 1].type;
+            while (end < moves.size() && moves[end].type == type)
+                ++end;
+        }
+        // each move of a batch adds at most indices_per_segment() indices to the buffer of its type
+        size_t max_end = begin + Max_Index_Buffer_Size / size_t(Buffer::indices_per_segment(EPrimitive::Triangle));
+        end = std::min(end, std::max(max_end, begin + 1));
+        m_batches.push_back({ begin, end });
+        begin = end;
+    }
+
+    // counting pass
+    std::vector<std::array<std::vector<Path>, Buffers_Count>> batches_paths(m_batches.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_batches.size()),
+        [this, &moves, &batches_paths](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i < range.end(); ++i) {
+                count_batch(moves, m_batches[i], batches_paths[i]);
+            }
+        });
+
+    // placement of the batches into the buffers, the paths are concatenated
+    for (size_t id = 0; id < Buffers_Count; ++id) {
+        Buffer& buffer = m_buffers[id];
+        size_t paths_count = 0;
+        for (const Batch& batch : m_batches) {
+            paths_count += batch.buffers[id].paths_count;
+        }
+        buffer.paths.reserve(paths_count);
+
+        for (size_t i = 0; i < m_batches.size(); ++i) {
+            Batch::BufferData& data = m_batches[i].buffers[id];
+            if (data.indices_count == 0)
+                continue;
+
+            if (buffer.index_buffers_sizes.empty() || (buffer.index_buffers_sizes.back() > 0 && buffer.index_buffers_sizes.back() + data.indices_count > Max_Index_Buffer_Size))
+                buffer.index_buffers_sizes.emplace_back(0);
+
+            data.first_vertex_id = buffer.vertices_count;
+            data.index_buffer_id = static_cast<unsigned int>(buffer.index_buffers_sizes.size() - 1);
+            data.first_index_id = buffer.index_buffers_sizes.back();
+            data.first_path_id = buffer.paths.size();
+            for (Path& path : batches_paths[i][id]) {
+                path.first.b_id = data.index_buffer_id;
+                path.first.i_id += data.first_index_id;
+                path.last.b_id = data.index_buffer_id;
+                path.last.i_id += data.first_index_id;
+                buffer.paths.emplace_back(path);
+            }
+            std::vector<Path>().swap(batches_paths[i][id]);
+
+            buffer.vertices_count += data.vertices_count;
+            buffer.index_buffers_sizes.back() += data.indices_count;
+        }
+    }
+}
+
+void ToolpathGeometry::generate(const GCodeProcessor::MoveVertices& moves, size_t begin, size_t end)
+{
+    assert(begin <= end && end <= m_batches.size());
+
+    // allocation of the blocks
+    std::vector<std::array<float*, Buffers_Count>> vertices(end - begin);
+    std::vector<std::array<unsigned int*, Buffers_Count>> indices(end - begin);
+    for (size_t id = 0; id < Buffers_Count; ++id) {
+        Buffer& buffer = m_buffers[id];
+        buffer.vertex_blocks.clear();
+        buffer.index_blocks.clear();
+        for (size_t i = begin; i < end; ++i) {
+            const Batch::BufferData& data = m_batches[i].buffers[id];
+            if (data.indices_count > 0) {
+                buffer.vertex_blocks.push_back({ data.first_vertex_id, std::vector<float>(data.vertices_count * buffer.vertex_size_floats()) });
+                buffer.index_blocks.push_back({ data.index_buffer_id, data.first_index_id, IndexBuffer(data.indices_count) });
+            }
+        }
+        // the blocks do not move anymore
+        size_t block_id = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (m_batches[i].buffers[id].indices_count > 0) {
+                vertices[i - begin][id] = buffer.vertex_blocks[block_id].vertices.data();
+                indices[i - begin][id] = buffer.index_blocks[block_id].indices.data();
+                ++block_id;
+            }
+            else {
+                vertices[i - begin][id] = nullptr;
+                indices[i - begin][id] = nullptr;
+            }
+        }
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(begin, end),
+        [this, &moves, begin, &vertices, &indices](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i < range.end(); ++i) {
+                generate_batch(moves, m_batches[i], vertices[i - begin], indices[i - begin]);
+            }
+        });
+}
+
+} // namespace Slic3r
+
+#endif // ENABLE_GCODE_VIEWER
@@ -0,0 +1,166 @@
+#ifndef slic3r_ToolpathGeometry_hpp_
+#define slic3r_ToolpathGeometry_hpp_
+
+#if ENABLE_GCODE_VIEWER
+#include "GCodeProcessor.hpp"
+
+#include <array>
+#include <vector>
+
+namespace Slic3r {
+
+// Vertices and indices of the toolpaths rendered by the G-code preview (GUI::GCodeViewer), generated from GCodeProcessor::Result
+// without any dependency on the GUI or on OpenGL, so that the generation may be unit tested and benchmarked without a GPU.
+// The moves are split into batches processed in parallel. build() counts the vertices and indices of each batch, which places
+// the geometry of each batch into the buffers. generate() then writes the geometry of a range of batches into blocks allocated
+// to their final size, so that the caller may send the geometry to the gpu and release it a range of batches at a time.
+class ToolpathGeometry
+{
+public:
+    using IndexBuffer = std::vector<unsigned int>;
+
+    enum class EPrimitive : unsigned char
+    {
+        // vertex format: 3 floats -> position.x|position.y|position.z
+        Point,
+        // vertex format: 4 floats -> position.x|position.y|position.z|normal.x
+        Line,
+        // vertex format: 6 floats -> position.x|position.y|position.z|normal.x|normal.y|normal.z
+        Triangle
+    };
+
+    // Used to identify different toolpath sub-types inside an index buffer
+    struct Path
+    {
+        struct Endpoint
+        {
+            // index of the index buffer
+            unsigned int b_id{ 0 };
+            // index into the index buffer
+            size_t i_id{ 0 };
+            // sequential id (index of the move)
+            size_t s_id{ 0 };
+            Vec3f position{ Vec3f::Zero() };
+        };
+
+        EMoveType type{ EMoveType::Noop };
+        ExtrusionRole role{ erNone };
+        Endpoint first;
+        Endpoint last;
+        float delta_extruder{ 0.0f };
+        float height{ 0.0f };
+        float width{ 0.0f };
+        float feedrate{ 0.0f };
+        float fan_speed{ 0.0f };
+        float volumetric_rate{ 0.0f };
+        unsigned char extruder_id{ 0 };
+        unsigned char cp_color_id{ 0 };
+
+        bool matches(const GCodeProcessor::MoveVertex& move) const;
+        size_t vertices_count() const { return last.s_id - first.s_id + 1; }
+        bool contains(size_t id) const { return first.s_id <= id && id <= last.s_id; }
+    };
+
+    // Vertices generated by a batch of moves
+    struct VertexBlock
+    {
+        // id of the first vertex in the vertex buffer
+        size_t first_vertex_id{ 0 };
+        std::vector<float> vertices;
+    };
+
+    // Indices generated by a batch of moves
+    struct IndexBlock
+    {
+        unsigned int index_buffer_id{ 0 };
+        // position of the first index in the index buffer
+        size_t first_index_id{ 0 };
+        IndexBuffer indices;
+    };
+
+    // Geometry of the moves of one type
+    struct Buffer
+    {
+        EPrimitive primitive{ EPrimitive::Point };
+        size_t vertices_count{ 0 };
+        // count of indices of each index buffer, the indices are the ids of the vertices.
+        // A path never spans two index buffers.
+        std::vector<size_t> index_buffers_sizes;
+        std::vector<Path> paths;
+        // geometry generated by the last call to generate(), in the order of the moves
+        std::vector<VertexBlock> vertex_blocks;
+        std::vector<IndexBlock> index_blocks;
+
+        size_t vertex_size_floats() const { return vertex_size_floats(primitive); }
+        unsigned int indices_per_segment() const { return indices_per_segment(primitive); }
+        // memory occupied by the generated blocks, in bytes
+        size_t memory_size() const;
+
+        static size_t vertex_size_floats(EPrimitive primitive);
+        static unsigned int indices_per_segment(EPrimitive primitive);
+    };
+
+    static constexpr size_t Buffers_Count = static_cast<size_t>(EMoveType::Count) - static_cast<size_t>(EMoveType::Retract);
+    // Minimum count of moves of a batch, a batch ends where the move type changes, so that no path spans two batches.
+    // A batch is split when its moves could exceed Max_Index_Buffer_Size indices, the path crossing the split is split too.
+    static constexpr size_t Default_Batch_Size = 16384;
+    // An index buffer is closed before the batch which would make it exceed this count of indices.
+    static constexpr size_t Max_Index_Buffer_Size = 1024 * 1024 * 128;
+
+    static size_t buffer_id(EMoveType type) { return static_cast<size_t>(type) - static_cast<size_t>(EMoveType::Retract); }
+    static EMoveType buffer_type(size_t id) { return static_cast<EMoveType>(static_cast<size_t>(EMoveType::Retract) + id); }
+    static EPrimitive primitive(EMoveType type);
+
+    // Splits the moves into batches, counts their vertices and indices and collects the paths.
+    // The first move is a dummy move, see GCodeProcessor::begin_process().
+    void build(const GCodeProcessor::MoveVertices& moves, size_t batch_size = Default_Batch_Size);
+    size_t batches_count() const { return m_batches.size(); }
+    // Replaces the blocks of the buffers with the geometry of the batches [begin, end), generated in parallel.
+    // moves must be the moves passed to build().
+    void generate(const GCodeProcessor::MoveVertices& moves, size_t begin, size_t end);
+    void generate(const GCodeProcessor::MoveVertices& moves) { this->generate(moves, 0, m_batches.size()); }
+    void clear();
+
+    const Buffer& buffer(EMoveType type) const { return m_buffers[buffer_id(type)]; }
+    Buffer& buffer(EMoveType type) { return m_buffers[buffer_id(type)]; }
+    const std::array<Buffer, Buffers_Count>& buffers() const { return m_buffers; }
+    std::array<Buffer, Buffers_Count>& buffers() { return m_buffers; }
+    // memory occupied by the generated blocks, in bytes
+    size_t memory_size() const;
+
+private:
+    // Consecutive moves processed by a single task
+    struct Batch
+    {
+        struct BufferData
+        {
+            size_t vertices_count{ 0 };
+            size_t indices_count{ 0 };
+            size_t paths_count{ 0 };
+            // placement of the geometry of the batch into the buffer
+            size_t first_vertex_id{ 0 };
+            unsigned int index_buffer_id{ 0 };
+            size_t first_index_id{ 0 };
+            size_t first_path_id{ 0 };
+        };
+
+        size_t begin;
+        size_t end;
+        std::array<BufferData, Buffers_Count> buffers;
+    };
+
+    // Counts the vertices and indices generated by the moves of the batch and collects its paths.
+    void count_batch(const GCodeProcessor::MoveVertices& moves, Batch& batch, std::array<std::vector<Path>, Buffers_Count>& paths) const;
+    // Writes the vertices and indices generated by the moves of the batch.
+    void generate_batch(const GCodeProcessor::MoveVertices& moves, const Batch& batch,
+        const std::array<float*, Buffers_Count>& vertices, const std::array<unsigned int*, Buffers_Count>& indices) const;
+
+    std::array<Buffer, Buffers_Count> m_buffers;
+    std::vector<Batch> m_batches;
+};
+
+} // namespace Slic3r
+
+#endif // ENABLE_GCODE_VIEWER
+
+#endif // slic3r_ToolpathGeometry_hpp_
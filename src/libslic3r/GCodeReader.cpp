@@ -1,12 +1,14 @@
 #include "GCodeReader.hpp"
+#include "FileContents.hpp"
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
-#if ENABLE_GCODE_VIEWER
-#include <boost/nowide/fstream.hpp>
-#endif // ENABLE_GCODE_VIEWER
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <vector>
+
+#include <tbb/pipeline.h>
 
 #include <Shiny/Shiny.h>
 
@@ -24,14 +26,11 @@ void GCodeReader::apply_config(const DynamicPrintConfig &config)
     m_extrusion_axis = m_config.get_extrusion_axis()[0];
 }
 
-const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline, std::pair<const char*, const char*> &command)
+const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline, std::pair<const char*, const char*> &command) const
 {
-    PROFILE_FUNC();
-    
     // command and args
     const char *c = ptr;
     {
-        PROFILE_BLOCK(command_and_args);
         // Skip the whitespaces.
         command.first = skip_whitespaces(c);
         // Skip the command.
@@ -57,8 +56,9 @@ const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline,
                 	axis = UNKNOWN_AXIS;
                 break;
             }
-            if (axis != NUM_AXES_WITH_UNKNOWN) {
+            if (axis != NUM_AXES_WITH_UNKNOWN && ! is_end_of_line(*skip_whitespaces(c + 1))) {
                 // Try to parse the numeric value.
+                // strtod() skips newlines, thus the test above, so that the parser never reads past the current line.
                 char   *pend = nullptr;
                 double  v = strtod(++ c, &pend);
                 if (pend != nullptr && is_end_of_word(*pend)) {
@@ -76,17 +76,11 @@ const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline,
         }
     }
     
-    if (gline.has(E) && m_config.use_relative_e_distances)
-        m_position[E] = 0;
-
     // Skip the rest of the line.
     for (; ! is_end_of_line(*c); ++ c);
 
-    // Copy the raw string including the comment, without the trailing newlines.
-    if (c > ptr) {
-        PROFILE_BLOCK(copy_raw_string);
-        gline.m_raw.assign(ptr, c);
-    }
+    // Reference the raw string including the comment, without the trailing newlines.
+    gline.m_raw = std::string_view(ptr, c - ptr);
 
     // Skip the trailing newlines.
 	if (*c == '\r')
@@ -94,10 +88,16 @@ const char* GCodeReader::parse_line_internal(const char *ptr, GCodeLine &gline,
 	if (*c == '\n')
 		++ c;
 
+    return c;
+}
+
+void GCodeReader::prepare_line(const GCodeLine &gline)
+{
+    if (gline.has(E) && m_config.use_relative_e_distances)
+        m_position[E] = 0;
+
     if (m_verbose)
         std::cout << gline.m_raw << std::endl;
-
-    return c;
 }
 
 void GCodeReader::update_coordinates(GCodeLine &gline, std::pair<const char*, const char*> &command)
@@ -116,24 +116,101 @@ void GCodeReader::update_coordinates(GCodeLine &gline, std::pair<const char*, co
 
 void GCodeReader::parse_file(const std::string &file, callback_t callback)
 {
+    FileContents contents;
+    if (! contents.open(file))
+        return;
+
+    // The lines up to the last newline are parsed in place. The parser stops at the newlines, so it never reads
+    // past the end of the mapping. The last line, if not terminated by a newline, is copied to be zero terminated.
+    const char *data = contents.data();
+    const char *data_end = data + contents.size();
+    const char *body_end = data_end;
+    while (body_end > data && body_end[-1] != '\n')
+        -- body_end;
+    const std::string tail(body_end, data_end);
+
+    struct Chunk {
+        const char                                       *begin = nullptr;
+        const char                                       *end   = nullptr;
+        std::vector<GCodeLine>                            lines;
+        std::vector<std::pair<const char*, const char*>>  commands;
+    };
+
+    // Tokenize the lines of a chunk. Independent of the reader state, thus run in parallel.
+    auto tokenize = [this](Chunk &chunk) {
+        chunk.lines.reserve((chunk.end - chunk.begin) / 24);
+        chunk.commands.reserve(chunk.lines.capacity());
+        for (const char *ptr = chunk.begin; ptr < chunk.end;) {
+            chunk.lines.emplace_back();
+            chunk.commands.emplace_back();
+            ptr = this->parse_line_internal(ptr, chunk.lines.back(), chunk.commands.back());
+            if (*ptr == 0 && ptr < chunk.end)
+                // Zero character in the middle of a line: ignore the rest of the line as if it was read with getline().
+                while (*ptr ++ != '\n') ;
+        }
+    };
+
 #if ENABLE_GCODE_VIEWER
-    boost::nowide::ifstream f(file);
-#else
-    std::ifstream f(file);
+    m_parsing_file = true;
 #endif // ENABLE_GCODE_VIEWER
-    std::string line;
+    // Set by the serial stage if the callback requested to stop parsing.
+    std::atomic<bool> stop { false };
+    // Process the tokenized lines in the order of the file: the stateful part of parsing and the callback.
+    auto process = [this, &callback, &stop](Chunk &chunk) {
+        for (size_t i = 0; i < chunk.lines.size() && ! stop; ++ i) {
+            GCodeLine &gline = chunk.lines[i];
+            this->prepare_line(gline);
+            callback(*this, gline);
+            this->update_coordinates(gline, chunk.commands[i]);
 #if ENABLE_GCODE_VIEWER
-    m_parsing_file = true;
-    while (m_parsing_file && std::getline(f, line))
-#else
-    while (std::getline(f, line))
+            if (! m_parsing_file)
+                stop = true;
 #endif // ENABLE_GCODE_VIEWER
-        this->parse_line(line, callback);
+        }
+    };
+
+    // Chunks of about 256kB split at line boundaries, at most 16 of them in flight to limit the memory consumption.
+    static constexpr size_t chunk_size = 256 * 1024;
+    const char *next = data;
+    tbb::parallel_pipeline(16,
+        tbb::make_filter<void, Chunk>(tbb::filter::serial_in_order,
+            [&next, body_end, &stop](tbb::flow_control &fc) -> Chunk {
+                Chunk chunk;
+                if (next == body_end || stop) {
+                    fc.stop();
+                    return chunk;
+                }
+                chunk.begin = next;
+                chunk.end   = (size_t(body_end - next) <= chunk_size) ? body_end :
+                    // body_end[-1] is a newline, thus the search terminates.
+                    static_cast<const char*>(memchr(next + chunk_size - 1, '\n', body_end - next - chunk_size + 1)) + 1;
+                next = chunk.end;
+                return chunk;
+            }) &
+        tbb::make_filter<Chunk, Chunk>(tbb::filter::parallel,
+            [&tokenize](Chunk chunk) -> Chunk { tokenize(chunk); return chunk; }) &
+        tbb::make_filter<Chunk, void>(tbb::filter::serial_in_order,
+            [&process](Chunk chunk) { process(chunk); }));
+
+    if (! tail.empty() && ! stop) {
+        GCodeLine gline;
+        this->parse_line(tail.c_str(), gline, callback);
+    }
+}
+
+GCodeReader::GCodeLine& GCodeReader::GCodeLine::operator=(const GCodeLine &rhs)
+{
+    m_raw_storage = rhs.m_raw_storage;
+    // A line modified by set() points into its own storage.
+    m_raw  = rhs.m_raw_storage.empty() ? rhs.m_raw : std::string_view(m_raw_storage);
+    memcpy(m_axis, rhs.m_axis, sizeof(m_axis));
+    m_mask = rhs.m_mask;
+    return *this;
 }
 
 bool GCodeReader::GCodeLine::has(char axis) const
 {
-    const char *c = m_raw.c_str();
+    const char *c = m_raw.data();
     // Skip the whitespaces.
     c = skip_whitespaces(c);
     // Skip the command.
@@ -155,7 +232,7 @@ bool GCodeReader::GCodeLine::has(char axis) const
 
 bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
 {
-    const char *c = m_raw.c_str();
+    const char *c = m_raw.data();
     // Skip the whitespaces.
     c = skip_whitespaces(c);
     // Skip the command.
@@ -167,7 +244,7 @@ bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
         if (is_end_of_gcode_line(*c))
             break;
         // Check the name of the axis.
-        if (*c == axis) {
+        if (*c == axis && ! is_end_of_line(*skip_whitespaces(c + 1))) {
             // Try to parse the numeric value.
             char   *pend = nullptr;
             double  v = strtod(++ c, &pend);
@@ -198,17 +275,20 @@ void GCodeReader::GCodeLine::set(const GCodeReader &reader, const Axis axis, con
         match[1] = reader.extrusion_axis();
     }
 
+    std::string raw(m_raw);
     if (this->has(axis)) {
-        size_t pos = m_raw.find(match)+2;
-        size_t end = m_raw.find(' ', pos+1);
-        m_raw = m_raw.replace(pos, end-pos, ss.str());
+        size_t pos = raw.find(match)+2;
+        size_t end = raw.find(' ', pos+1);
+        raw = raw.replace(pos, end-pos, ss.str());
     } else {
-        size_t pos = m_raw.find(' ');
+        size_t pos = raw.find(' ');
         if (pos == std::string::npos)
-            m_raw += std::string(match) + ss.str();
+            raw += std::string(match) + ss.str();
         else
-            m_raw = m_raw.replace(pos, 0, std::string(match) + ss.str());
+            raw = raw.replace(pos, 0, std::string(match) + ss.str());
     }
+    m_raw_storage = std::move(raw);
+    m_raw = m_raw_storage;
     m_axis[axis] = new_value;
     m_mask |= 1 << int(axis);
 }
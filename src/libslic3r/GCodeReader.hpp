@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <functional>
 #include <string>
+#include <string_view>
 #include "PrintConfig.hpp"
 
 namespace Slic3r {
@@ -15,15 +16,20 @@ public:
     class GCodeLine {
     public:
         GCodeLine() { reset(); }
-        void reset() { m_mask = 0; memset(m_axis, 0, sizeof(m_axis)); m_raw.clear(); }
-
-        const std::string&  raw() const { return m_raw; }
-        const std::string   cmd() const { 
-            const char *cmd = GCodeReader::skip_whitespaces(m_raw.c_str());
-            return std::string(cmd, GCodeReader::skip_word(cmd));
+        GCodeLine(const GCodeLine &rhs) { *this = rhs; }
+        GCodeLine& operator=(const GCodeLine &rhs);
+        void reset() { m_mask = 0; memset(m_axis, 0, sizeof(m_axis)); m_raw = ""; m_raw_storage.clear(); }
+
+        // The line without the trailing newline. The line is not copied, it points into the parsed buffer
+        // and it is valid until the callback returns, unless the line has been modified by set().
+        // The text following the view is always terminated by a newline or by a zero character.
+        std::string_view    raw() const { return m_raw; }
+        std::string_view    cmd() const { 
+            const char *cmd = GCodeReader::skip_whitespaces(m_raw.data());
+            return std::string_view(cmd, GCodeReader::skip_word(cmd) - cmd);
         }
-        const std::string   comment() const
-            { size_t pos = m_raw.find(';'); return (pos == std::string::npos) ? "" : m_raw.substr(pos + 1); }
+        std::string_view    comment() const
+            { size_t pos = m_raw.find(';'); return (pos == std::string_view::npos) ? std::string_view() : m_raw.substr(pos + 1); }
 
         bool  has(Axis axis) const { return (m_mask & (1 << int(axis))) != 0; }
         float value(Axis axis) const { return m_axis[axis]; }
@@ -44,7 +50,7 @@ public:
             return sqrt(x*x + y*y);
         }
         bool cmd_is(const char *cmd_test) const {
-            const char *cmd = GCodeReader::skip_whitespaces(m_raw.c_str());
+            const char *cmd = GCodeReader::skip_whitespaces(m_raw.data());
             size_t len = strlen(cmd_test); 
             return strncmp(cmd, cmd_test, len) == 0 && GCodeReader::is_end_of_word(cmd[len]);
         }
@@ -66,7 +72,9 @@ public:
         float f() const { return m_axis[F]; }
 
     private:
-        std::string      m_raw;
+        std::string_view m_raw;
+        // Only filled in by set(), m_raw then points here.
+        std::string      m_raw_storage;
         float            m_axis[NUM_AXES];
         uint32_t         m_mask;
         friend class GCodeReader;
@@ -97,6 +105,7 @@ public:
     {
         std::pair<const char*, const char*> cmd;
         const char *end = parse_line_internal(ptr, gline, cmd);
+        prepare_line(gline);
         callback(*this, gline);
         update_coordinates(gline, cmd);
         return end;
@@ -106,6 +115,8 @@ public:
     void parse_line(const std::string &line, Callback callback)
         { GCodeLine gline; this->parse_line(line.c_str(), gline, callback); }
 
+    // The file is memory mapped and its lines are tokenized in parallel, the callback is called in the order of the lines
+    // from a single thread at a time.
     void parse_file(const std::string &file, callback_t callback);
 #if ENABLE_GCODE_VIEWER
     void quit_parsing_file() { m_parsing_file = false; }
@@ -126,7 +137,10 @@ public:
     void   set_extrusion_axis(char axis) { m_extrusion_axis = axis; }
 
 private:
-    const char* parse_line_internal(const char *ptr, GCodeLine &gline, std::pair<const char*, const char*> &command);
+    // Tokenizes a single line. Stateless, thus it may be called from multiple threads.
+    const char* parse_line_internal(const char *ptr, GCodeLine &gline, std::pair<const char*, const char*> &command) const;
+    // Stateful part of the parsing to be called in the order of the lines: before and after the callback.
+    void        prepare_line(const GCodeLine &gline);
     void        update_coordinates(GCodeLine &gline, std::pair<const char*, const char*> &command);
 
     static bool         is_whitespace(char c)           { return c == ' ' || c == '\t'; }
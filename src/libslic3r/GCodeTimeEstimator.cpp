@@ -838,7 +838,7 @@ namespace Slic3r {
         if (_process_tags(line))
             return;
 
-        std::string cmd = line.cmd();
+        std::string_view cmd = line.cmd();
         if (cmd.length() > 1)
         {
             switch (::toupper(cmd[0]))
@@ -1449,7 +1449,7 @@ namespace Slic3r {
 
     void GCodeTimeEstimator::_processT(const GCodeReader::GCodeLine& line)
     {
-        std::string cmd = line.cmd();
+        std::string cmd(line.cmd());
         if (cmd.length() > 1)
         {
             unsigned int id = (unsigned int)::strtol(cmd.substr(1).c_str(), nullptr, 10);
@@ -1467,7 +1467,7 @@ namespace Slic3r {
 
     bool GCodeTimeEstimator::_process_tags(const GCodeReader::GCodeLine& line)
     {
-        std::string comment = line.comment();
+        std::string comment(line.comment());
 
         // Color_Change_Tag
         size_t pos = comment.find(Color_Change_Tag);
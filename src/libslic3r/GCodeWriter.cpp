@@ -1,6 +1,9 @@
 #include "GCodeWriter.hpp"
 #include "CustomGCode.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -8,13 +11,102 @@
 
 #define FLAVOR_IS(val) this->config.gcode_flavor == val
 #define FLAVOR_IS_NOT(val) this->config.gcode_flavor != val
-#define COMMENT(comment) if (this->config.gcode_comments && !comment.empty()) gcode << " ; " << comment;
-#define PRECISION(val, precision) std::fixed << std::setprecision(precision) << val
-#define XYZF_NUM(val) PRECISION(val, 3)
-#define E_NUM(val) PRECISION(val, 5)
+#define XYZF_EXPORT_DIGITS 3
+#define E_EXPORT_DIGITS 5
 
 namespace Slic3r {
 
+char* to_chars_fixed(char *first, char *last, double value, int precision)
+{
+    static constexpr const double   pow10d[] = { 1., 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    static constexpr const uint64_t pow10i[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+    if (precision >= 0 && precision <= 9 && std::isfinite(value)) {
+        double scaled = std::abs(value) * pow10d[precision];
+        if (scaled < 1e15) {
+            // The multiplication is exact up to half an ulp of the result, and so is the rounding decision,
+            // unless the scaled value is too close to a tie. Ties and near ties are left to snprintf(),
+            // which rounds the exact binary value of the input.
+            double n    = std::floor(scaled);
+            double frac = scaled - n;
+            if (std::abs(frac - 0.5) > scaled * 4.5e-16) {
+                uint64_t rounded = uint64_t(n) + (frac > 0.5 ? 1 : 0);
+                uint64_t ipart   = rounded / pow10i[precision];
+                uint64_t fpart   = rounded % pow10i[precision];
+                // Integer part in reverse order.
+                char     digits[24];
+                char    *d = digits;
+                do {
+                    *d ++ = char('0' + ipart % 10);
+                    ipart /= 10;
+                } while (ipart > 0);
+                // std::fixed prints the sign of negative values rounded to zero and of a negative zero.
+                size_t len = size_t(std::signbit(value)) + size_t(d - digits) + (precision > 0 ? size_t(precision) + 1 : 0);
+                if (size_t(last - first) < len)
+                    return nullptr;
+                if (std::signbit(value))
+                    *first ++ = '-';
+                while (d != digits)
+                    *first ++ = *(-- d);
+                if (precision > 0) {
+                    *first ++ = '.';
+                    for (int i = precision - 1; i >= 0; -- i) {
+                        first[i] = char('0' + fpart % 10);
+                        fpart /= 10;
+                    }
+                    first += precision;
+                }
+                return first;
+            }
+        }
+    }
+    // Slow path, let the C library format the number. The G-code is exported with the "C" locale.
+    int len = ::snprintf(first, size_t(last - first), "%.*f", precision, value);
+    return (len < 0 || len >= last - first) ? nullptr : first + len;
+}
+
+void append_fixed(std::string &out, double value, int precision)
+{
+    char  buf[64];
+    char *end = to_chars_fixed(buf, buf + sizeof(buf), value, precision);
+    if (end != nullptr)
+        out.append(buf, end);
+    else {
+        // Very large numbers.
+        std::vector<char> big(size_t(std::max(precision, 0)) + 400);
+        end = to_chars_fixed(big.data(), big.data() + big.size(), value, precision);
+        if (end != nullptr)
+            out.append(big.data(), end);
+    }
+}
+
+// Builds a single G1 line without the overhead of the locale aware std::ostringstream.
+class GCodeG1Formatter {
+public:
+    GCodeG1Formatter() { m_gcode.reserve(64); m_gcode = "G1"; }
+    void emit_axis(const char axis, double value, int precision) { m_gcode += ' '; m_gcode += axis; append_fixed(m_gcode, value, precision); }
+    void emit_axis(const std::string &axis, double value, int precision) { m_gcode += ' '; m_gcode += axis; append_fixed(m_gcode, value, precision); }
+    void emit_xy(const Vec2d &point) { this->emit_axis('X', point.x(), XYZF_EXPORT_DIGITS); this->emit_axis('Y', point.y(), XYZF_EXPORT_DIGITS); }
+    void emit_xyz(const Vec3d &point) { this->emit_axis('X', point.x(), XYZF_EXPORT_DIGITS); this->emit_axis('Y', point.y(), XYZF_EXPORT_DIGITS); this->emit_axis('Z', point.z(), XYZF_EXPORT_DIGITS); }
+    void emit_f(double speed) { this->emit_axis('F', speed, XYZF_EXPORT_DIGITS); }
+    // The retract speeds are exported as std::ostream << float formats them by default, that is with 6 significant digits
+    // in the "%g" format. Extruder::retract_speed() is integral, thus the feed rates below 1e6 are formatted without snprintf().
+    void emit_retract_f(float speed) {
+        m_gcode += " F";
+        if (speed == std::floor(speed) && std::abs(speed) < 1e6f)
+            append_fixed(m_gcode, speed, 0);
+        else {
+            char buf[32];
+            int  len = ::snprintf(buf, sizeof(buf), "%g", double(speed));
+            m_gcode.append(buf, buf + len);
+        }
+    }
+    void emit_comment(bool allow_comments, const std::string &comment) { if (allow_comments && ! comment.empty()) { m_gcode += " ; "; m_gcode += comment; } }
+    void emit_string(const std::string &s) { m_gcode += s; }
+    std::string string() { m_gcode += '\n'; return std::move(m_gcode); }
+private:
+    std::string m_gcode;
+};
+
 void GCodeWriter::apply_print_config(const PrintConfig &print_config)
 {
     this->config.apply(print_config, true);
@@ -270,12 +362,11 @@ std::string GCodeWriter::set_speed(double F, const std::string &comment, const s
 {
     assert(F > 0.);
     assert(F < 100000.);
-    std::ostringstream gcode;
-    gcode << "G1 F" << XYZF_NUM(F);
-    COMMENT(comment);
-    gcode << cooling_marker;
-    gcode << "\n";
-    return gcode.str();
+    GCodeG1Formatter w;
+    w.emit_f(F);
+    w.emit_comment(this->config.gcode_comments, comment);
+    w.emit_string(cooling_marker);
+    return w.string();
 }
 
 std::string GCodeWriter::travel_to_xy(const Vec2d &point, const std::string &comment)
@@ -283,13 +374,11 @@ std::string GCodeWriter::travel_to_xy(const Vec2d &point, const std::string &com
     m_pos(0) = point(0);
     m_pos(1) = point(1);
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point(0))
-          <<   " Y" << XYZF_NUM(point(1))
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    GCodeG1Formatter w;
+    w.emit_xy(point);
+    w.emit_f(this->config.travel_speed.value * 60.0);
+    w.emit_comment(this->config.gcode_comments, comment);
+    return w.string();
 }
 
 std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &comment)
@@ -313,14 +402,11 @@ std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &co
     m_lifted = 0;
     m_pos = point;
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point(0))
-          <<   " Y" << XYZF_NUM(point(1))
-          <<   " Z" << XYZF_NUM(point(2))
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    GCodeG1Formatter w;
+    w.emit_xyz(point);
+    w.emit_f(this->config.travel_speed.value * 60.0);
+    w.emit_comment(this->config.gcode_comments, comment);
+    return w.string();
 }
 
 std::string GCodeWriter::travel_to_z(double z, const std::string &comment)
@@ -346,12 +432,11 @@ std::string GCodeWriter::_travel_to_z(double z, const std::string &comment)
 {
     m_pos(2) = z;
     
-    std::ostringstream gcode;
-    gcode << "G1 Z" << XYZF_NUM(z)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    GCodeG1Formatter w;
+    w.emit_axis('Z', z, XYZF_EXPORT_DIGITS);
+    w.emit_f(this->config.travel_speed.value * 60.0);
+    w.emit_comment(this->config.gcode_comments, comment);
+    return w.string();
 }
 
 bool GCodeWriter::will_move_z(double z) const
@@ -372,13 +457,11 @@ std::string GCodeWriter::extrude_to_xy(const Vec2d &point, double dE, const std:
     m_pos(1) = point(1);
     m_extruder->extrude(dE);
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point(0))
-          <<   " Y" << XYZF_NUM(point(1))
-          <<    " " << m_extrusion_axis << E_NUM(m_extruder->E());
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    GCodeG1Formatter w;
+    w.emit_xy(point);
+    w.emit_axis(m_extrusion_axis, m_extruder->E(), E_EXPORT_DIGITS);
+    w.emit_comment(this->config.gcode_comments, comment);
+    return w.string();
 }
 
 std::string GCodeWriter::extrude_to_xyz(const Vec3d &point, double dE, const std::string &comment)
@@ -387,14 +470,11 @@ std::string GCodeWriter::extrude_to_xyz(const Vec3d &point, double dE, const std
     m_lifted = 0;
     m_extruder->extrude(dE);
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point(0))
-          <<   " Y" << XYZF_NUM(point(1))
-          <<   " Z" << XYZF_NUM(point(2))
-          <<    " " << m_extrusion_axis << E_NUM(m_extruder->E());
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    GCodeG1Formatter w;
+    w.emit_xyz(point);
+    w.emit_axis(m_extrusion_axis, m_extruder->E(), E_EXPORT_DIGITS);
+    w.emit_comment(this->config.gcode_comments, comment);
+    return w.string();
 }
 
 std::string GCodeWriter::retract(bool before_wipe)
@@ -421,7 +501,7 @@ std::string GCodeWriter::retract_for_toolchange(bool before_wipe)
 
 std::string GCodeWriter::_retract(double length, double restart_extra, const std::string &comment)
 {
-    std::ostringstream gcode;
+    std::string gcode;
     
     /*  If firmware retraction is enabled, we use a fake value of 1
         since we ignore the actual configured retract_length which 
@@ -440,48 +520,50 @@ std::string GCodeWriter::_retract(double length, double restart_extra, const std
     if (dE != 0) {
         if (this->config.use_firmware_retraction) {
             if (FLAVOR_IS(gcfMachinekit))
-                gcode << "G22 ; retract\n";
+                gcode += "G22 ; retract\n";
             else
-                gcode << "G10 ; retract\n";
+                gcode += "G10 ; retract\n";
         } else {
-            gcode << "G1 " << m_extrusion_axis << E_NUM(m_extruder->E())
-                           << " F" << float(m_extruder->retract_speed() * 60.);
-            COMMENT(comment);
-            gcode << "\n";
+            GCodeG1Formatter w;
+            w.emit_axis(m_extrusion_axis, m_extruder->E(), E_EXPORT_DIGITS);
+            w.emit_retract_f(float(m_extruder->retract_speed() * 60.));
+            w.emit_comment(this->config.gcode_comments, comment);
+            gcode += w.string();
         }
     }
     
     if (FLAVOR_IS(gcfMakerWare))
-        gcode << "M103 ; extruder off\n";
+        gcode += "M103 ; extruder off\n";
     
-    return gcode.str();
+    return gcode;
 }
 
 std::string GCodeWriter::unretract()
 {
-    std::ostringstream gcode;
+    std::string gcode;
     
     if (FLAVOR_IS(gcfMakerWare))
-        gcode << "M101 ; extruder on\n";
+        gcode += "M101 ; extruder on\n";
     
     double dE = m_extruder->unretract();
     if (dE != 0) {
         if (this->config.use_firmware_retraction) {
             if (FLAVOR_IS(gcfMachinekit))
-                 gcode << "G23 ; unretract\n";
+                 gcode += "G23 ; unretract\n";
             else
-                 gcode << "G11 ; unretract\n";
-            gcode << this->reset_e();
+                 gcode += "G11 ; unretract\n";
+            gcode += this->reset_e();
         } else {
             // use G1 instead of G0 because G0 will blend the restart with the previous travel move
-            gcode << "G1 " << m_extrusion_axis << E_NUM(m_extruder->E())
-                           << " F" << float(m_extruder->deretract_speed() * 60.);
-            if (this->config.gcode_comments) gcode << " ; unretract";
-            gcode << "\n";
+            GCodeG1Formatter w;
+            w.emit_axis(m_extrusion_axis, m_extruder->E(), E_EXPORT_DIGITS);
+            w.emit_retract_f(float(m_extruder->deretract_speed() * 60.));
+            w.emit_comment(this->config.gcode_comments, "unretract");
+            gcode += w.string();
         }
     }
     
-    return gcode.str();
+    return gcode;
 }
 
 /*  If this method is called more than once before calling unlift(),
@@ -88,6 +88,15 @@ private:
     std::string _retract(double length, double restart_extra, const std::string &comment);
 };
 
+// Format a floating point number with a fixed number of decimal digits into a caller provided buffer [first, last),
+// producing the very same characters as std::ostream << std::fixed << std::setprecision(precision) << value
+// with the classic locale, but without the overhead of the locale aware iostreams.
+// Similar to std::to_chars(), returns a pointer past the last character written
+// or nullptr if the buffer is too small to hold the result.
+char*       to_chars_fixed(char *first, char *last, double value, int precision);
+// Append a floating point number formatted by to_chars_fixed() to a string.
+void        append_fixed(std::string &out, double value, int precision);
+
 } /* namespace Slic3r */
 
 #endif /* slic3r_GCodeWriter_hpp_ */
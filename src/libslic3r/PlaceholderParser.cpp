@@ -6,6 +6,9 @@
 #include <iomanip>
 #include <sstream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #ifdef _MSC_VER
     #include <stdlib.h>  // provides **_environ
 #else
@@ -1309,6 +1312,204 @@ static std::string process_macro(const std::string &templ, client::MyContext &co
     return output;
 }
 
+// Most of the custom G-code templates consist of a free-form text and of simple variable references only.
+// Such templates are parsed once into a sequence of segments, which is cached and evaluated without running the macro processor.
+// The other templates and the templates failing to evaluate are passed to process_macro(), which processes them or reports the error.
+namespace compiled_template {
+
+    struct Segment {
+        enum Type {
+            // Free-form text.
+            Text,
+            // [variable], vector variable is indexed by the current extruder.
+            Legacy,
+            // {variable}
+            Scalar,
+            // {variable[index]}, indexed by an integer literal or by an integer variable.
+            Vector,
+        };
+        Type        type;
+        // Free-form text or a variable name.
+        std::string text;
+        // Name of the integer variable indexing a vector variable, empty if indexed by an integer literal.
+        std::string index_variable;
+        int         index = 0;
+    };
+
+    // Null if the template is not a simple one.
+    using Segments = std::shared_ptr<const std::vector<Segment>>;
+
+    // White space as skipped by the macro processor, ASCII only.
+    static inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+    static inline bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    static const char* skip_space(const char *ptr, const char *end)
+    {
+        while (ptr != end && is_space(*ptr))
+            ++ ptr;
+        return ptr;
+    }
+
+    // Parse an identifier, which is not a keyword of the macro language. Returns null if not an identifier.
+    static const char* parse_identifier(const char *ptr, const char *end, std::string &out)
+    {
+        static const char *keywords[] = { "and", "if", "int", "else", "elsif", "endif", "false", "min", "max", "not", "or", "true" };
+        if (ptr == end || ! (is_alpha(*ptr) || *ptr == '_'))
+            return nullptr;
+        const char *begin = ptr;
+        for (++ ptr; ptr != end && (is_alpha(*ptr) || is_digit(*ptr) || *ptr == '_'); ++ ptr) ;
+        out.assign(begin, ptr);
+        for (const char *keyword : keywords)
+            if (out == keyword)
+                return nullptr;
+        return ptr;
+    }
+
+    static Segments compile(const std::string &templ)
+    {
+        auto        segments = std::make_shared<std::vector<Segment>>();
+        const char *end      = templ.data() + templ.size();
+        // The macro processor skips the leading white space of the template.
+        const char *ptr      = skip_space(templ.data(), end);
+        while (ptr != end) {
+            Segment segment;
+            if (*ptr != '[' && *ptr != '{') {
+                const char *begin = ptr;
+                for (; ptr != end && *ptr != '[' && *ptr != '{'; ++ ptr)
+                    if (static_cast<unsigned char>(*ptr) >= 0x80)
+                        // Let the macro processor validate the UTF-8 text.
+                        return nullptr;
+                segment.type = Segment::Text;
+                segment.text.assign(begin, ptr);
+                segments->emplace_back(std::move(segment));
+                continue;
+            }
+            bool legacy = *ptr == '[';
+            if ((ptr = parse_identifier(skip_space(ptr + 1, end), end, segment.text)) == nullptr)
+                return nullptr;
+            ptr = skip_space(ptr, end);
+            if (legacy) {
+                if (ptr == end || *ptr != ']')
+                    return nullptr;
+                segment.type = Segment::Legacy;
+            } else {
+                segment.type = Segment::Scalar;
+                if (ptr != end && *ptr == '[') {
+                    segment.type = Segment::Vector;
+                    ptr = skip_space(ptr + 1, end);
+                    if (ptr != end && is_digit(*ptr)) {
+                        const char *begin = ptr;
+                        for (; ptr != end && is_digit(*ptr); ++ ptr) ;
+                        if (ptr - begin > 9)
+                            return nullptr;
+                        segment.index = atoi(std::string(begin, ptr).c_str());
+                    } else if ((ptr = parse_identifier(ptr, end, segment.index_variable)) == nullptr)
+                        return nullptr;
+                    ptr = skip_space(ptr, end);
+                    if (ptr == end || *ptr != ']')
+                        return nullptr;
+                    ptr = skip_space(ptr + 1, end);
+                }
+                if (ptr == end || *ptr != '}')
+                    return nullptr;
+            }
+            ++ ptr;
+            segments->emplace_back(std::move(segment));
+        }
+        return segments;
+    }
+
+    // Lookup the compiled template, compile it if not cached yet. The compiled template does not depend on the config.
+    static Segments lookup(const std::string &templ)
+    {
+        static std::mutex                                mutex;
+        static std::unordered_map<std::string, Segments> cache;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(templ);
+        if (it == cache.end()) {
+            // Templates are few, the limit is just a safety net.
+            if (cache.size() >= 1024)
+                cache.clear();
+            it = cache.emplace(templ, compile(templ)).first;
+        }
+        return it->second;
+    }
+
+    // Formatting of a double by the macro processor, see expr::to_string().
+    static void append_double(std::string &out, double value)
+    {
+        std::ostringstream ss;
+        ss << value;
+        out += ss.str();
+    }
+
+    // Returns false if the template has to be processed by the macro processor, for example to report an error.
+    static bool evaluate(const std::vector<Segment> &segments, const client::MyContext &context, std::string &out)
+    {
+        for (const Segment &segment : segments) {
+            if (segment.type == Segment::Text) {
+                out += segment.text;
+                continue;
+            }
+            const ConfigOption *opt = context.resolve_symbol(segment.text);
+            if (opt == nullptr)
+                // Either a legacy vector indexing [variable_index] or an error.
+                return false;
+            switch (segment.type) {
+            case Segment::Legacy:
+                if (opt->is_scalar())
+                    out += opt->serialize();
+                else {
+                    const ConfigOptionVectorBase *vec = static_cast<const ConfigOptionVectorBase*>(opt);
+                    if (vec->empty())
+                        return false;
+                    out += vec->vserialize()[(context.current_extruder_id >= vec->size()) ? 0 : context.current_extruder_id];
+                }
+                break;
+            case Segment::Scalar:
+                switch (opt->type()) {
+                case coFloat:
+                case coPercent: append_double(out, opt->getFloat()); break;
+                case coInt:     out += std::to_string(opt->getInt()); break;
+                case coString:  out += static_cast<const ConfigOptionString*>(opt)->value; break;
+                case coPoint:   out += opt->serialize(); break;
+                case coBool:    out += opt->getBool() ? "true" : "false"; break;
+                // Vector variable referenced as scalar is an error, FloatOrPercent requires resolving the "ratio_over" dependencies.
+                default:        return false;
+                }
+                break;
+            case Segment::Vector:
+            {
+                int index = segment.index;
+                if (! segment.index_variable.empty()) {
+                    const ConfigOption *opt_index = context.resolve_symbol(segment.index_variable);
+                    if (opt_index == nullptr || opt_index->type() != coInt)
+                        return false;
+                    index = opt_index->getInt();
+                }
+                if (opt->is_scalar() || static_cast<const ConfigOptionVectorBase*>(opt)->empty())
+                    return false;
+                size_t idx = (index < 0 || index >= int(static_cast<const ConfigOptionVectorBase*>(opt)->size())) ? 0 : size_t(index);
+                switch (opt->type()) {
+                case coFloats:   append_double(out, static_cast<const ConfigOptionFloats*>(opt)->values[idx]); break;
+                case coInts:     out += std::to_string(static_cast<const ConfigOptionInts*>(opt)->values[idx]); break;
+                case coStrings:  out += static_cast<const ConfigOptionStrings*>(opt)->values[idx]; break;
+                case coPercents: append_double(out, static_cast<const ConfigOptionPercents*>(opt)->values[idx]); break;
+                case coBools:    out += static_cast<const ConfigOptionBools*>(opt)->values[idx] != 0 ? "true" : "false"; break;
+                default:         return false;
+                }
+                break;
+            }
+            default:
+                assert(false);
+            }
+        }
+        return true;
+    }
+
+} // namespace compiled_template
+
 std::string PlaceholderParser::process(const std::string &templ, unsigned int current_extruder_id, const DynamicConfig *config_override) const
 {
     client::MyContext context;
@@ -1316,6 +1517,12 @@ std::string PlaceholderParser::process(const std::string &templ, unsigned int cu
     context.config              = &this->config();
     context.config_override     = config_override;
     context.current_extruder_id = current_extruder_id;
+    compiled_template::Segments segments = compiled_template::lookup(templ);
+    if (segments) {
+        std::string output;
+        if (compiled_template::evaluate(*segments, context, output))
+            return output;
+    }
     return process_macro(templ, context);
 }
 
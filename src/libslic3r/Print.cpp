@@ -20,11 +20,14 @@
 
 #include <algorithm>
 #include <limits>
+#include <mutex>
 #include <unordered_set>
 #include <boost/filesystem/path.hpp>
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
 
+#include <tbb/parallel_for.h>
+
 // Mark string for localization and translate.
 #define L(s) Slic3r::I18N::translate(s)
 
@@ -45,6 +48,9 @@ void Print::clear()
         delete region;
     m_regions.clear();
     m_model.clear_objects();
+#if ENABLE_GCODE_VIEWER
+    m_gcode_processor_checkpoints.clear();
+#endif // ENABLE_GCODE_VIEWER
 }
 
 PrintRegion* Print::add_region()
@@ -100,6 +106,7 @@ bool Print::invalidate_state_by_config_options(const std::vector<t_config_option
         "first_layer_acceleration",
         "first_layer_bed_temperature",
         "first_layer_speed",
+        "gcode_binary_index",
         "gcode_comments",
         "gcode_label_objects",
         "infill_acceleration",
@@ -540,7 +547,7 @@ void Print::config_diffs(
     {
 	    const std::vector<std::string> &extruder_retract_keys = print_config_def.extruder_retract_keys();
 	    const std::string               filament_prefix       = "filament_";
-	    for (const t_config_option_key &opt_key : m_config.keys()) {
+	    for (const t_config_option_key &opt_key : m_config.keys_ref()) {
 	        const ConfigOption *opt_old = m_config.option(opt_key);
 	        assert(opt_old != nullptr);
 	        const ConfigOption *opt_new = new_full_config.option(opt_key);
@@ -1595,15 +1602,44 @@ void Print::auto_assign_extruders(ModelObject* model_object) const
 void Print::process()
 {
     BOOST_LOG_TRIVIAL(info) << "Starting the slicing process." << log_memory_info();
-    for (PrintObject *obj : m_objects)
-        obj->make_perimeters();
-    this->set_status(70, L("Infilling layers"));
-    for (PrintObject *obj : m_objects)
-        obj->infill();
-    for (PrintObject *obj : m_objects)
-        obj->ironing();
-    for (PrintObject *obj : m_objects)
-        obj->generate_support_material();
+    // The PrintObject steps are independent of the other PrintObjects, therefore each PrintObject
+    // runs its chain of steps (slicing -> perimeters -> infill -> ironing -> support) as a separate task.
+    // With many small objects of a few layers each, the layer parallel loops inside the steps
+    // are too short to keep all the cores busy, while now the steps of the other objects fill the gaps.
+    // The per object set_started() / set_done() state machine is kept, the steps of a single object
+    // are still executed in order and a CanceledException thrown by any task cancels all of them.
+    // As the objects are processed concurrently, the progress is reported here from the number of the finished
+    // object steps and objects, not by the object steps themselves. It is reported under a mutex to keep it monotonic.
+    static constexpr size_t num_object_steps = 5;
+    std::mutex              status_mutex;
+    size_t                  num_steps_done   = 0;
+    size_t                  num_objects_done = 0;
+    auto                    object_step_done = [this, &status_mutex, &num_steps_done, &num_objects_done](bool object_done) {
+        std::lock_guard<std::mutex> lock(status_mutex);
+        ++ num_steps_done;
+        if (object_done)
+            ++ num_objects_done;
+        this->set_status(int(10 + 75 * num_steps_done / (num_object_steps * m_objects.size())),
+            (boost::format(L("Processing objects: %1% of %2% done")) % num_objects_done % m_objects.size()).str());
+    };
+    this->set_status(10, (boost::format(L("Processing objects: %1% of %2% done")) % 0 % m_objects.size()).str());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, m_objects.size(), 1),
+        [this, &object_step_done](const tbb::blocked_range<size_t>& range) {
+            for (size_t idx_object = range.begin(); idx_object < range.end(); ++ idx_object) {
+                PrintObject *obj = m_objects[idx_object];
+                obj->slice();
+                object_step_done(false);
+                obj->make_perimeters();
+                object_step_done(false);
+                obj->infill();
+                object_step_done(false);
+                obj->ironing();
+                object_step_done(false);
+                obj->generate_support_material();
+                object_step_done(true);
+            }
+        });
     if (this->set_started(psWipeTower)) {
         m_wipe_tower_data.clear();
         m_tool_ordering.clear();
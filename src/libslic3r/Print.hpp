@@ -192,6 +192,10 @@ public:
     // Called when slicing to SVG (see Print.pm sub export_svg), and used by perimeters.t
     void slice();
 
+    // Layers per band of discover_vertical_shells(). Zero by default, the band size is then derived from the count
+    // of the neighbor layers accessed. Set by the unit tests to place the band boundaries inside a small object.
+    static size_t discover_vertical_shells_band_size;
+
     // Helpers to slice support enforcer / blocker meshes by the support generator.
     std::vector<ExPolygons>     slice_support_volumes(const ModelVolumeType &model_volume_type) const;
     std::vector<ExPolygons>     slice_support_blockers() const { return this->slice_support_volumes(ModelVolumeType::SUPPORT_BLOCKER); }
@@ -236,6 +240,8 @@ private:
     void detect_surfaces_type();
     void process_external_surfaces();
     void discover_vertical_shells();
+    // Number of layers below / above a layer accessed by discover_vertical_shells().
+    std::pair<size_t, size_t> discover_vertical_shells_radius() const;
     void bridge_over_infill();
     void clip_fill_surfaces();
     void discover_horizontal_shells();
@@ -436,6 +442,11 @@ public:
 
     const PrintStatistics&      print_statistics() const { return m_print_statistics; }
     PrintStatistics&            print_statistics() { return m_print_statistics; }
+#if ENABLE_GCODE_VIEWER
+    // State of the G-code processing saved by the last G-code export, so that the next export only processes the G-code that changed.
+    // Disabled by default, enabled by the UI which exports the same print repeatedly.
+    GCodeProcessor::Checkpoints&    gcode_processor_checkpoints() { return m_gcode_processor_checkpoints; }
+#endif // ENABLE_GCODE_VIEWER
 
     // Wipe tower support.
     bool                        has_wipe_tower() const;
@@ -502,6 +513,9 @@ private:
 
     // Estimated print time, filament consumed.
     PrintStatistics                         m_print_statistics;
+#if ENABLE_GCODE_VIEWER
+    GCodeProcessor::Checkpoints             m_gcode_processor_checkpoints;
+#endif // ENABLE_GCODE_VIEWER
 
     // To allow GCode to set the Print's GCodeExport step status.
     friend class GCode;
@@ -973,6 +973,14 @@ void PrintConfigDef::init_fff_params()
     def->mode = comAdvanced;
     def->set_default_value(new ConfigOptionFloat(20));
 
+    def = this->add("gcode_binary_index", coBool);
+    def->label = L("G-code viewer index");
+    def->tooltip = L("Enable this to write a binary index next to the G-code file, with the .idx suffix added to the file name. "
+                   "The G-code viewer loads a G-code file with its index much faster, as the G-code does not need to be processed. "
+                   "The index is ignored if the G-code is modified after the export, for example by a post-processing script.");
+    def->mode = comExpert;
+    def->set_default_value(new ConfigOptionBool(0));
+
     def = this->add("gcode_comments", coBool);
     def->label = L("Verbose G-code");
     def->tooltip = L("Enable this to get a commented G-code file, with each line explained by a descriptive text. "
@@ -3714,6 +3722,27 @@ CLIMiscConfigDef::CLIMiscConfigDef()
                      "For example. loglevel=2 logs fatal, error and warning level messages.");
     def->min = 0;
 
+    def = this->add("slice_cache_memory", coInt);
+    def->label = L("Slice cache memory limit");
+    def->tooltip = L("Keep the slices of the objects in memory up to this size in MB, so that re-slicing an object "
+                     "with unchanged geometry and layer heights is skipped. Zero disables the in-memory slice cache.");
+    def->sidetext = L("MB");
+    def->min = 0;
+    def->set_default_value(new ConfigOptionInt(0));
+
+    def = this->add("slice_cache_dir", coString);
+    def->label = L("Slice cache directory");
+    def->tooltip = L("Store the slices of the objects into this directory, so that they are shared between runs. "
+                     "An empty path disables the on-disk slice cache.");
+    def->set_default_value(new ConfigOptionString(""));
+
+    def = this->add("slice_cache_disk", coInt);
+    def->label = L("Slice cache disk limit");
+    def->tooltip = L("Maximum size of the files in the slice cache directory in MB, the least recently used files are deleted above it.");
+    def->sidetext = L("MB");
+    def->min = 0;
+    def->set_default_value(new ConfigOptionInt(1024));
+
 #if (defined(_MSC_VER) || defined(__MINGW32__)) && defined(SLIC3R_GUI)
     def = this->add("sw_renderer", coBool);
     def->label = L("Render with a software renderer");
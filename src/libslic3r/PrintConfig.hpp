@@ -19,6 +19,7 @@
 
 #include "libslic3r.h"
 #include "Config.hpp"
+#include <unordered_map>
 
 // #define HAS_PRESSURE_EQUALIZER
 
@@ -318,7 +319,7 @@ protected:
         }
 
     protected:
-        std::map<std::string, ptrdiff_t>    m_map_name_to_offset;
+        std::unordered_map<std::string, ptrdiff_t> m_map_name_to_offset;
     };
 
     // Parametrized by the type of the topmost class owning the options.
@@ -344,9 +345,47 @@ protected:
             return (it == m_map_name_to_offset.end()) ? nullptr : reinterpret_cast<const ConfigOption*>((const char*)owner + it->second);
         }
 
+        // Option of the idx-th key of keys().
+        const ConfigOption* optptr(size_t idx, const T *owner) const
+            { return reinterpret_cast<const ConfigOption*>((const char*)owner + m_offsets[idx]); }
+
         const std::vector<std::string>& keys()      const { return m_keys; }
         const T&                        defaults()  const { return *m_defaults; }
 
+        // Keys of the options of owner differing from the options of other, walking the options by their indices.
+        t_config_option_keys diff(const T *owner, const T &other) const
+        {
+            t_config_option_keys diff;
+            for (size_t i = 0; i < m_keys.size(); ++ i)
+                if (*this->optptr(i, owner) != *this->optptr(i, &other))
+                    diff.emplace_back(m_keys[i]);
+            return diff;
+        }
+
+        bool equals(const T *owner, const T &other) const
+        {
+            for (size_t i = 0; i < m_keys.size(); ++ i)
+                if (*this->optptr(i, owner) != *this->optptr(i, &other))
+                    return false;
+            return true;
+        }
+
+        // Keys of the options of owner differing from the options present in other, the same as ConfigBase::diff().
+        // Both the keys and the options of the DynamicConfig are sorted, thus they are merged instead of looked up.
+        t_config_option_keys diff(const T *owner, const DynamicConfig &other) const
+        {
+            t_config_option_keys diff;
+            auto it_other = other.cbegin();
+            for (size_t i = 0; i < m_keys.size() && it_other != other.cend(); ++ i) {
+                const std::string &key = m_keys[i];
+                while (it_other != other.cend() && it_other->first < key)
+                    ++ it_other;
+                if (it_other != other.cend() && it_other->first == key && *this->optptr(i, owner) != *it_other->second)
+                    diff.emplace_back(key);
+            }
+            return diff;
+        }
+
         // To be called during the StaticCache setup.
         // Collect option keys from m_map_name_to_offset,
         // assign default values to m_defaults.
@@ -356,13 +395,18 @@ protected:
             m_defaults = defaults;
             m_keys.clear();
             m_keys.reserve(m_map_name_to_offset.size());
+            m_offsets.clear();
+            m_offsets.reserve(m_map_name_to_offset.size());
+            // The keys are sorted, as they are collected from a std::map.
             for (const auto &kvp : defs->options) {
                 // Find the option given the option name kvp.first by an offset from (char*)m_defaults.
-                ConfigOption *opt = this->optptr(kvp.first, m_defaults);
-                if (opt == nullptr)
+                const auto it = m_map_name_to_offset.find(kvp.first);
+                if (it == m_map_name_to_offset.end())
                     // This option is not defined by the ConfigBase of type T.
                     continue;
                 m_keys.emplace_back(kvp.first);
+                m_offsets.emplace_back(it->second);
+                ConfigOption *opt = reinterpret_cast<ConfigOption*>((char*)m_defaults + it->second);
                 const ConfigOptionDef *def = defs->get(kvp.first);
                 assert(def != nullptr);
                 if (def->default_value)
@@ -373,6 +417,8 @@ protected:
     private:
         T                                  *m_defaults;
         std::vector<std::string>            m_keys;
+        // Offsets of the options from the owner, indexed the same as m_keys.
+        std::vector<ptrdiff_t>              m_offsets;
     };
 };
 
@@ -387,6 +433,12 @@ public: \
     /* Overrides ConfigBase::keys(). Collect names of all configuration values maintained by this configuration store. */ \
     t_config_option_keys     keys() const override { return s_cache_##CLASS_NAME.keys(); } \
     const t_config_option_keys& keys_ref() const override { return s_cache_##CLASS_NAME.keys(); } \
+    /* Overloads of ConfigBase::diff() and ConfigBase::equals() walking the options by their indices instead of looking them up by their names. */ \
+    using ConfigBase::diff; \
+    using ConfigBase::equals; \
+    t_config_option_keys     diff(const CLASS_NAME &other) const { return s_cache_##CLASS_NAME.diff(this, other); } \
+    t_config_option_keys     diff(const DynamicConfig &other) const { return s_cache_##CLASS_NAME.diff(this, other); } \
+    bool                     equals(const CLASS_NAME &other) const { return s_cache_##CLASS_NAME.equals(this, other); } \
     static const CLASS_NAME& defaults() { initialize_cache(); return s_cache_##CLASS_NAME.defaults(); } \
 private: \
     static void initialize_cache() \
@@ -693,6 +745,7 @@ public:
     ConfigOptionFloats              filament_minimal_purge_on_wipe_tower;
     ConfigOptionFloats              filament_cooling_final_speed;
     ConfigOptionStrings             filament_ramming_parameters;
+    ConfigOptionBool                gcode_binary_index;
     ConfigOptionBool                gcode_comments;
     ConfigOptionEnum<GCodeFlavor>   gcode_flavor;
     ConfigOptionBool                gcode_label_objects;
@@ -769,6 +822,7 @@ protected:
         OPT_PTR(filament_minimal_purge_on_wipe_tower);
         OPT_PTR(filament_cooling_final_speed);
         OPT_PTR(filament_ramming_parameters);
+        OPT_PTR(gcode_binary_index);
         OPT_PTR(gcode_comments);
         OPT_PTR(gcode_flavor);
         OPT_PTR(gcode_label_objects);
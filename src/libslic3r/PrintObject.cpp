@@ -8,6 +8,7 @@
 #include "Layer.hpp"
 #include "SupportMaterial.hpp"
 #include "Surface.hpp"
+#include "SliceCache.hpp"
 #include "Slicing.hpp"
 #include "Tesselate.hpp"
 #include "Utils.hpp"
@@ -15,6 +16,7 @@
 #include "Fill/FillAdaptive.hpp"
 #include "Format/STL.hpp"
 
+#include <limits>
 #include <utility>
 #include <boost/log/trivial.hpp>
 #include <float.h>
@@ -46,6 +48,8 @@
 
 namespace Slic3r {
 
+size_t PrintObject::discover_vertical_shells_band_size = 0;
+
 // Constructor is called from the main thread, therefore all Model / ModelObject / ModelIntance data are valid.
 PrintObject::PrintObject(Print* print, ModelObject* model_object, const Transform3d& trafo, PrintInstances&& instances) :
     PrintObjectBaseWithState(print, model_object),
@@ -111,7 +115,6 @@ void PrintObject::slice()
 {
     if (! this->set_started(posSlice))
         return;
-    m_print->set_status(10, L("Processing triangulated mesh"));
     std::vector<coordf_t> layer_height_profile;
     this->update_layer_height_profile(*this->model_object(), m_slicing_params, layer_height_profile);
     m_print->throw_if_canceled();
@@ -155,7 +158,6 @@ void PrintObject::make_perimeters()
     if (! this->set_started(posPerimeters))
         return;
 
-    m_print->set_status(20, L("Generating perimeters"));
     BOOST_LOG_TRIVIAL(info) << "Generating perimeters..." << log_memory_info();
     
     // merge slices if they were split into types
@@ -258,8 +260,6 @@ void PrintObject::prepare_infill()
     if (! this->set_started(posPrepareInfill))
         return;
 
-    m_print->set_status(30, L("Preparing infill"));
-
     // This will assign a type (top/bottom/internal) to $layerm->slices.
     // Then the classifcation of $layerm->slices is transfered onto 
     // the $layerm->fill_surfaces by clipping $layerm->fill_surfaces
@@ -419,7 +419,6 @@ void PrintObject::generate_support_material()
     if (this->set_started(posSupportMaterial)) {
         this->clear_support_layers();
         if ((m_config.support_material || m_config.raft_layers > 0) && m_layers.size() > 1) {
-            m_print->set_status(85, L("Generating support material"));    
             this->_generate_support_material();
             m_print->throw_if_canceled();
         } else {
@@ -1004,7 +1003,6 @@ void PrintObject::discover_vertical_shells()
         // Collected polygons, offsetted
         Polygons    top_surfaces;
         Polygons    bottom_surfaces;
-        Polygons    holes;
     };
     bool     spiral_vase      = this->print()->config().spiral_vase.value;
     size_t   num_layers       = spiral_vase ? first_printing_region(*this)->config().bottom_solid_layers : m_layers.size();
@@ -1021,390 +1019,442 @@ void PrintObject::discover_vertical_shells()
     	return num_extra_layers(config.top_solid_layers, config.top_solid_min_thickness) +
 	    	   num_extra_layers(config.bottom_solid_layers, config.bottom_solid_min_thickness) > 0;
     };
-    std::vector<DiscoverVerticalShellsCacheEntry> cache_top_botom_regions(num_layers, DiscoverVerticalShellsCacheEntry());
     bool top_bottom_surfaces_all_regions = this->region_volumes.size() > 1 && ! m_config.interface_shells.value;
-    if (top_bottom_surfaces_all_regions) {
-        // This is a multi-material print and interface_shells are disabled, meaning that the vertical shell thickness
-        // is calculated over all materials.
-        // Is the "ensure vertical wall thickness" applicable to any region?
-        bool has_extra_layers = false;
-        for (size_t idx_region = 0; idx_region < this->region_volumes.size(); ++idx_region) {
-            const PrintRegionConfig &config = m_print->get_region(idx_region)->config();
-            if (config.ensure_vertical_shell_thickness.value && has_extra_layers_fn(config)) {
-                has_extra_layers = true;
-                break;
-            }
-        }
-        if (! has_extra_layers)
-            // The "ensure vertical wall thickness" feature is not applicable to any of the regions. Quit.
-            return;
-        BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells in parallel - start : cache top / bottom";
-        //FIXME Improve the heuristics for a grain size.
-        size_t grain_size = std::max(num_layers / 16, size_t(1));
-        tbb::parallel_for(
-            tbb::blocked_range<size_t>(0, num_layers, grain_size),
-            [this, &cache_top_botom_regions](const tbb::blocked_range<size_t>& range) {
-                const SurfaceType surfaces_bottom[2] = { stBottom, stBottomBridge };
-                const size_t num_regions = this->region_volumes.size();
-                for (size_t idx_layer = range.begin(); idx_layer < range.end(); ++ idx_layer) {
-                    m_print->throw_if_canceled();
-                    const Layer                      &layer = *m_layers[idx_layer];
-                    DiscoverVerticalShellsCacheEntry &cache = cache_top_botom_regions[idx_layer];
-                    // Simulate single set of perimeters over all merged regions.
-                    float                             perimeter_offset = 0.f;
-                    float                             perimeter_min_spacing = FLT_MAX;
+    // Regions, for which the "ensure vertical wall thickness" is applicable.
+    std::vector<size_t> regions;
+    for (size_t idx_region = 0; idx_region < this->region_volumes.size(); ++ idx_region) {
+        const PrintRegionConfig &config = m_print->get_region(idx_region)->config();
+        if (config.ensure_vertical_shell_thickness.value && has_extra_layers_fn(config))
+            regions.emplace_back(idx_region);
+        // otherwise the region will be handled by discover_horizontal_shells() or
+        // there are zero or 1 layer, there is no additional vertical wall thickness enforced.
+    }
+    if (regions.empty() || num_layers == 0)
+        // The "ensure vertical wall thickness" feature is not applicable to any of the regions. Quit.
+        return;
+
+    // The layers are processed in bands. Before a band is processed, the top / bottom surfaces are cached
+    // for the band extended by the dependency radius, and the cache entries below the next band are released.
+    // Thus only the cache of a band and its neighborhood is being held in memory, not the cache of the whole object.
+    // The cache of a layer is always filled before the layer's fill_surfaces are modified, as with the cache filled
+    // for all layers at once.
+    // A band holds only a few hundred layers, thus the parallel loops over a band are not given an explicit grain size
+    // derived from the object height, which would split a band of a tall object into one or two chunks only.
+    auto [radius_below, radius_above] = this->discover_vertical_shells_radius();
+    size_t band_size  = (discover_vertical_shells_band_size > 0) ? discover_vertical_shells_band_size :
+        std::max<size_t>(256, 4 * (radius_below + radius_above));
+    // Either one cache for all regions, or one cache per region in regions.
+    std::vector<std::vector<DiscoverVerticalShellsCacheEntry>> caches(top_bottom_surfaces_all_regions ? 1 : regions.size(),
+        std::vector<DiscoverVerticalShellsCacheEntry>(num_layers, DiscoverVerticalShellsCacheEntry()));
+    // Holes are collected over all regions, they are valid for all regions.
+    std::vector<Polygons> cache_holes(num_layers);
+    size_t cached_end   = 0;
+    size_t released_end = 0;
+
+    for (size_t band_begin = 0; band_begin < num_layers;) {
+        size_t band_end  = std::min(num_layers, band_begin + band_size);
+        size_t cache_end = std::min(num_layers, band_end + radius_above);
+        if (top_bottom_surfaces_all_regions) {
+            // This is a multi-material print and interface_shells are disabled, meaning that the vertical shell thickness
+            // is calculated over all materials.
+            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells in parallel - start : cache top / bottom, layers " << cached_end << " to " << cache_end;
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(cached_end, cache_end),
+                [this, &caches, &cache_holes](const tbb::blocked_range<size_t>& range) {
+                    const SurfaceType surfaces_bottom[2] = { stBottom, stBottomBridge };
+                    const size_t num_regions = this->region_volumes.size();
+                    for (size_t idx_layer = range.begin(); idx_layer < range.end(); ++ idx_layer) {
+                        m_print->throw_if_canceled();
+                        const Layer                      &layer = *m_layers[idx_layer];
+                        DiscoverVerticalShellsCacheEntry &cache = caches.front()[idx_layer];
+                        Polygons                         &holes = cache_holes[idx_layer];
+                        // Simulate single set of perimeters over all merged regions.
+                        float                             perimeter_offset = 0.f;
+                        float                             perimeter_min_spacing = FLT_MAX;
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    static size_t debug_idx = 0;
-                    ++ debug_idx;
+                        static size_t debug_idx = 0;
+                        ++ debug_idx;
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
-                    for (size_t idx_region = 0; idx_region < num_regions; ++ idx_region) {
-                        LayerRegion &layerm                       = *layer.m_regions[idx_region];
-                        float        min_perimeter_infill_spacing = float(layerm.flow(frSolidInfill).scaled_spacing()) * 1.05f;
-                        // Top surfaces.
-                        append(cache.top_surfaces, offset(to_expolygons(layerm.slices.filter_by_type(stTop)), min_perimeter_infill_spacing));
-                        append(cache.top_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_type(stTop)), min_perimeter_infill_spacing));
-                        // Bottom surfaces.
-                        append(cache.bottom_surfaces, offset(to_expolygons(layerm.slices.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing));
-                        append(cache.bottom_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing));
-                        // Calculate the maximum perimeter offset as if the slice was extruded with a single extruder only.
-                        // First find the maxium number of perimeters per region slice.
-                        unsigned int perimeters = 0;
-                        for (Surface &s : layerm.slices.surfaces)
-                            perimeters = std::max<unsigned int>(perimeters, s.extra_perimeters);
-                        perimeters += layerm.region()->config().perimeters.value;
-                        // Then calculate the infill offset.
-                        if (perimeters > 0) {
-                            Flow extflow = layerm.flow(frExternalPerimeter);
-                            Flow flow    = layerm.flow(frPerimeter);
-                            perimeter_offset = std::max(perimeter_offset,
-                                0.5f * float(extflow.scaled_width() + extflow.scaled_spacing()) + (float(perimeters) - 1.f) * flow.scaled_spacing());
-                            perimeter_min_spacing = std::min(perimeter_min_spacing, float(std::min(extflow.scaled_spacing(), flow.scaled_spacing())));
+                        for (size_t idx_region = 0; idx_region < num_regions; ++ idx_region) {
+                            LayerRegion &layerm                       = *layer.m_regions[idx_region];
+                            float        min_perimeter_infill_spacing = float(layerm.flow(frSolidInfill).scaled_spacing()) * 1.05f;
+                            // Top surfaces.
+                            append(cache.top_surfaces, offset(to_expolygons(layerm.slices.filter_by_type(stTop)), min_perimeter_infill_spacing));
+                            append(cache.top_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_type(stTop)), min_perimeter_infill_spacing));
+                            // Bottom surfaces.
+                            append(cache.bottom_surfaces, offset(to_expolygons(layerm.slices.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing));
+                            append(cache.bottom_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing));
+                            // Calculate the maximum perimeter offset as if the slice was extruded with a single extruder only.
+                            // First find the maxium number of perimeters per region slice.
+                            unsigned int perimeters = 0;
+                            for (Surface &s : layerm.slices.surfaces)
+                                perimeters = std::max<unsigned int>(perimeters, s.extra_perimeters);
+                            perimeters += layerm.region()->config().perimeters.value;
+                            // Then calculate the infill offset.
+                            if (perimeters > 0) {
+                                Flow extflow = layerm.flow(frExternalPerimeter);
+                                Flow flow    = layerm.flow(frPerimeter);
+                                perimeter_offset = std::max(perimeter_offset,
+                                    0.5f * float(extflow.scaled_width() + extflow.scaled_spacing()) + (float(perimeters) - 1.f) * flow.scaled_spacing());
+                                perimeter_min_spacing = std::min(perimeter_min_spacing, float(std::min(extflow.scaled_spacing(), flow.scaled_spacing())));
+                            }
+                            polygons_append(holes, to_polygons(layerm.fill_expolygons));
                         }
-                        polygons_append(cache.holes, to_polygons(layerm.fill_expolygons));
-                    }
-                    // Save some computing time by reducing the number of polygons.
-                    cache.top_surfaces    = union_(cache.top_surfaces,    false);
-                    cache.bottom_surfaces = union_(cache.bottom_surfaces, false);
-                    // For a multi-material print, simulate perimeter / infill split as if only a single extruder has been used for the whole print.
-                    if (perimeter_offset > 0.) {
-                        // The layer.lslices are forced to merge by expanding them first.
-                        polygons_append(cache.holes, offset(offset_ex(layer.lslices, 0.3f * perimeter_min_spacing), - perimeter_offset - 0.3f * perimeter_min_spacing));
+                        // Save some computing time by reducing the number of polygons.
+                        cache.top_surfaces    = union_(cache.top_surfaces,    false);
+                        cache.bottom_surfaces = union_(cache.bottom_surfaces, false);
+                        // For a multi-material print, simulate perimeter / infill split as if only a single extruder has been used for the whole print.
+                        if (perimeter_offset > 0.) {
+                            // The layer.lslices are forced to merge by expanding them first.
+                            polygons_append(holes, offset(offset_ex(layer.lslices, 0.3f * perimeter_min_spacing), - perimeter_offset - 0.3f * perimeter_min_spacing));
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                        {
-                            Slic3r::SVG svg(debug_out_path("discover_vertical_shells-extra-holes-%d.svg", debug_idx), get_extents(layer.lslices));
-                            svg.draw(layer.lslices, "blue");
-                            svg.draw(union_ex(cache.holes), "red");
-                            svg.draw_outline(union_ex(cache.holes), "black", "blue", scale_(0.05));
-                            svg.Close(); 
-                        }
+                            {
+                                Slic3r::SVG svg(debug_out_path("discover_vertical_shells-extra-holes-%d.svg", debug_idx), get_extents(layer.lslices));
+                                svg.draw(layer.lslices, "blue");
+                                svg.draw(union_ex(holes), "red");
+                                svg.draw_outline(union_ex(holes), "black", "blue", scale_(0.05));
+                                svg.Close(); 
+                            }
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
+                        }
+                        holes = union_(holes, false);
                     }
-                    cache.holes = union_(cache.holes, false);
-                }
-            });
-        m_print->throw_if_canceled();
-        BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells in parallel - end : cache top / bottom";
-    }
-
-    for (size_t idx_region = 0; idx_region < this->region_volumes.size(); ++ idx_region) {
-        PROFILE_BLOCK(discover_vertical_shells_region);
-
-        const PrintRegion &region = *m_print->get_region(idx_region);
-        if (! region.config().ensure_vertical_shell_thickness.value)
-            // This region will be handled by discover_horizontal_shells().
-            continue;
-        if (! has_extra_layers_fn(region.config()))
-            // Zero or 1 layer, there is no additional vertical wall thickness enforced.
-            continue;
-
-        //FIXME Improve the heuristics for a grain size.
-        size_t grain_size = std::max(num_layers / 16, size_t(1));
-
-        if (! top_bottom_surfaces_all_regions) {
+                });
+            m_print->throw_if_canceled();
+            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells in parallel - end : cache top / bottom";
+        } else {
             // This is either a single material print, or a multi-material print and interface_shells are enabled, meaning that the vertical shell thickness
             // is calculated over a single material.
-            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells for region " << idx_region << " in parallel - start : cache top / bottom";
+            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells per region in parallel - start : cache top / bottom, layers " << cached_end << " to " << cache_end;
             tbb::parallel_for(
-                tbb::blocked_range<size_t>(0, num_layers, grain_size),
-                [this, idx_region, &cache_top_botom_regions](const tbb::blocked_range<size_t>& range) {
+                tbb::blocked_range<size_t>(cached_end, cache_end),
+                [this, &regions, &caches, &cache_holes](const tbb::blocked_range<size_t>& range) {
                     const SurfaceType surfaces_bottom[2] = { stBottom, stBottomBridge };
                     for (size_t idx_layer = range.begin(); idx_layer < range.end(); ++ idx_layer) {
                         m_print->throw_if_canceled();
-                        Layer       &layer                        = *m_layers[idx_layer];
-                        LayerRegion &layerm                       = *layer.m_regions[idx_region];
-                        float        min_perimeter_infill_spacing = float(layerm.flow(frSolidInfill).scaled_spacing()) * 1.05f;
-                        // Top surfaces.
-                        auto &cache = cache_top_botom_regions[idx_layer];
-                        cache.top_surfaces = offset(to_expolygons(layerm.slices.filter_by_type(stTop)), min_perimeter_infill_spacing);
-                        append(cache.top_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_type(stTop)), min_perimeter_infill_spacing));
-                        // Bottom surfaces.
-                        cache.bottom_surfaces = offset(to_expolygons(layerm.slices.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing);
-                        append(cache.bottom_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing));
-                        // Holes over all regions. Only collect them once, they are valid for all idx_region iterations.
-                        if (cache.holes.empty()) {
-                            for (size_t idx_region = 0; idx_region < layer.regions().size(); ++ idx_region)
-                                polygons_append(cache.holes, to_polygons(layer.regions()[idx_region]->fill_expolygons));
+                        Layer &layer = *m_layers[idx_layer];
+                        for (size_t idx_cache = 0; idx_cache < regions.size(); ++ idx_cache) {
+                            LayerRegion &layerm                       = *layer.m_regions[regions[idx_cache]];
+                            float        min_perimeter_infill_spacing = float(layerm.flow(frSolidInfill).scaled_spacing()) * 1.05f;
+                            // Top surfaces.
+                            auto &cache = caches[idx_cache][idx_layer];
+                            cache.top_surfaces = offset(to_expolygons(layerm.slices.filter_by_type(stTop)), min_perimeter_infill_spacing);
+                            append(cache.top_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_type(stTop)), min_perimeter_infill_spacing));
+                            // Bottom surfaces.
+                            cache.bottom_surfaces = offset(to_expolygons(layerm.slices.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing);
+                            append(cache.bottom_surfaces, offset(to_expolygons(layerm.fill_surfaces.filter_by_types(surfaces_bottom, 2)), min_perimeter_infill_spacing));
                         }
+                        // Holes over all regions. Only collect them once, they are valid for all the regions.
+                        for (size_t idx_region = 0; idx_region < layer.regions().size(); ++ idx_region)
+                            polygons_append(cache_holes[idx_layer], to_polygons(layer.regions()[idx_region]->fill_expolygons));
                     }
                 });
             m_print->throw_if_canceled();
-            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells for region " << idx_region << " in parallel - end : cache top / bottom";
+            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells per region in parallel - end : cache top / bottom";
         }
+        cached_end = cache_end;
 
-        BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells for region " << idx_region << " in parallel - start : ensure vertical wall thickness";
-        tbb::parallel_for(
-            tbb::blocked_range<size_t>(0, num_layers, grain_size),
-            [this, idx_region, &cache_top_botom_regions]
-            (const tbb::blocked_range<size_t>& range) {
-                // printf("discover_vertical_shells from %d to %d\n", range.begin(), range.end());
-                for (size_t idx_layer = range.begin(); idx_layer < range.end(); ++ idx_layer) {
-                    PROFILE_BLOCK(discover_vertical_shells_region_layer);
-                    m_print->throw_if_canceled();
+        for (size_t idx_cache_region = 0; idx_cache_region < regions.size(); ++ idx_cache_region) {
+            PROFILE_BLOCK(discover_vertical_shells_region);
+            size_t idx_region = regions[idx_cache_region];
+            const std::vector<DiscoverVerticalShellsCacheEntry> &cache_top_botom_regions = caches[top_bottom_surfaces_all_regions ? 0 : idx_cache_region];
+
+            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells for region " << idx_region << " in parallel - start : ensure vertical wall thickness, layers " << band_begin << " to " << band_end;
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(band_begin, band_end),
+                [this, idx_region, num_layers, &cache_top_botom_regions, &cache_holes]
+                (const tbb::blocked_range<size_t>& range) {
+                    // printf("discover_vertical_shells from %d to %d\n", range.begin(), range.end());
+                    for (size_t idx_layer = range.begin(); idx_layer < range.end(); ++ idx_layer) {
+                        PROFILE_BLOCK(discover_vertical_shells_region_layer);
+                        m_print->throw_if_canceled();
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-        			static size_t debug_idx = 0;
-        			++ debug_idx;
+            			static size_t debug_idx = 0;
+            			++ debug_idx;
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
-                    Layer       	        *layer          = m_layers[idx_layer];
-                    LayerRegion 	        *layerm         = layer->m_regions[idx_region];
-                    const PrintRegionConfig &region_config  = layerm->region()->config();
+                        Layer       	        *layer          = m_layers[idx_layer];
+                        LayerRegion 	        *layerm         = layer->m_regions[idx_region];
+                        const PrintRegionConfig &region_config  = layerm->region()->config();
 
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    layerm->export_region_slices_to_svg_debug("4_discover_vertical_shells-initial");
-                    layerm->export_region_fill_surfaces_to_svg_debug("4_discover_vertical_shells-initial");
+                        layerm->export_region_slices_to_svg_debug("4_discover_vertical_shells-initial");
+                        layerm->export_region_fill_surfaces_to_svg_debug("4_discover_vertical_shells-initial");
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
-                    Flow         solid_infill_flow   = layerm->flow(frSolidInfill);
-                    coord_t      infill_line_spacing = solid_infill_flow.scaled_spacing(); 
-                    // Find a union of perimeters below / above this surface to guarantee a minimum shell thickness.
-                    Polygons shell;
-                    Polygons holes;
+                        Flow         solid_infill_flow   = layerm->flow(frSolidInfill);
+                        coord_t      infill_line_spacing = solid_infill_flow.scaled_spacing(); 
+                        // Find a union of perimeters below / above this surface to guarantee a minimum shell thickness.
+                        Polygons shell;
+                        Polygons holes;
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    ExPolygons shell_ex;
+                        ExPolygons shell_ex;
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
-                    float min_perimeter_infill_spacing = float(infill_line_spacing) * 1.05f;
-                    {
-                        PROFILE_BLOCK(discover_vertical_shells_region_layer_collect);
-#if 0
-// #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
+                        float min_perimeter_infill_spacing = float(infill_line_spacing) * 1.05f;
                         {
-        					Slic3r::SVG svg_cummulative(debug_out_path("discover_vertical_shells-perimeters-before-union-run%d.svg", debug_idx), this->bounding_box());
-                            for (int n = (int)idx_layer - n_extra_bottom_layers; n <= (int)idx_layer + n_extra_top_layers; ++ n) {
-                                if (n < 0 || n >= (int)m_layers.size())
-                                    continue;
-                                ExPolygons &expolys = m_layers[n]->perimeter_expolygons;
-                                for (size_t i = 0; i < expolys.size(); ++ i) {
-        							Slic3r::SVG svg(debug_out_path("discover_vertical_shells-perimeters-before-union-run%d-layer%d-expoly%d.svg", debug_idx, n, i), get_extents(expolys[i]));
-                                    svg.draw(expolys[i]);
-                                    svg.draw_outline(expolys[i].contour, "black", scale_(0.05));
-                                    svg.draw_outline(expolys[i].holes, "blue", scale_(0.05));
-                                    svg.Close();
-
-                                    svg_cummulative.draw(expolys[i]);
-                                    svg_cummulative.draw_outline(expolys[i].contour, "black", scale_(0.05));
-                                    svg_cummulative.draw_outline(expolys[i].holes, "blue", scale_(0.05));
+                            PROFILE_BLOCK(discover_vertical_shells_region_layer_collect);
+#if 0
+    // #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
+                            {
+            					Slic3r::SVG svg_cummulative(debug_out_path("discover_vertical_shells-perimeters-before-union-run%d.svg", debug_idx), this->bounding_box());
+                                for (int n = (int)idx_layer - n_extra_bottom_layers; n <= (int)idx_layer + n_extra_top_layers; ++ n) {
+                                    if (n < 0 || n >= (int)m_layers.size())
+                                        continue;
+                                    ExPolygons &expolys = m_layers[n]->perimeter_expolygons;
+                                    for (size_t i = 0; i < expolys.size(); ++ i) {
+            							Slic3r::SVG svg(debug_out_path("discover_vertical_shells-perimeters-before-union-run%d-layer%d-expoly%d.svg", debug_idx, n, i), get_extents(expolys[i]));
+                                        svg.draw(expolys[i]);
+                                        svg.draw_outline(expolys[i].contour, "black", scale_(0.05));
+                                        svg.draw_outline(expolys[i].holes, "blue", scale_(0.05));
+                                        svg.Close();
+
+                                        svg_cummulative.draw(expolys[i]);
+                                        svg_cummulative.draw_outline(expolys[i].contour, "black", scale_(0.05));
+                                        svg_cummulative.draw_outline(expolys[i].holes, "blue", scale_(0.05));
+                                    }
                                 }
                             }
-                        }
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
-			        	polygons_append(holes, cache_top_botom_regions[idx_layer].holes);
-			        	if (int n_top_layers = region_config.top_solid_layers.value; n_top_layers > 0) {
-                            // Gather top regions projected to this layer.
-                            coordf_t print_z = layer->print_z;
-	                        for (int i = int(idx_layer) + 1; 
-	                        	i < int(cache_top_botom_regions.size()) && 
-	                        		(i < int(idx_layer) + n_top_layers ||
-	                        		 m_layers[i]->print_z - print_z < region_config.top_solid_min_thickness - EPSILON);
-	                        	++ i) {
-	                            const DiscoverVerticalShellsCacheEntry &cache = cache_top_botom_regions[i];
-								if (! holes.empty())
-									holes = intersection(holes, cache.holes);
-								if (! cache.top_surfaces.empty()) {
-		                            polygons_append(shell, cache.top_surfaces);
-		                            // Running the union_ using the Clipper library piece by piece is cheaper 
-		                            // than running the union_ all at once.
-	                               shell = union_(shell, false);
-	                           }
-	                        }
-	                    }
-	                    if (int n_bottom_layers = region_config.bottom_solid_layers.value; n_bottom_layers > 0) {
-                            // Gather bottom regions projected to this layer.
-                            coordf_t bottom_z = layer->bottom_z();
-	                        for (int i = int(idx_layer) - 1;
-	                        	i >= 0 &&
-	                        		(i > int(idx_layer) - n_bottom_layers ||
-	                        		 bottom_z - m_layers[i]->bottom_z() < region_config.bottom_solid_min_thickness - EPSILON);
-	                        	-- i) {
-	                            const DiscoverVerticalShellsCacheEntry &cache = cache_top_botom_regions[i];
-								if (! holes.empty())
-									holes = intersection(holes, cache.holes);
-								if (! cache.bottom_surfaces.empty()) {
-		                            polygons_append(shell, cache.bottom_surfaces);
-		                            // Running the union_ using the Clipper library piece by piece is cheaper 
-		                            // than running the union_ all at once.
-		                            shell = union_(shell, false);
-		                        }
-	                        }
-	                    }
+    			        	polygons_append(holes, cache_holes[idx_layer]);
+    			        	if (int n_top_layers = region_config.top_solid_layers.value; n_top_layers > 0) {
+                                // Gather top regions projected to this layer.
+                                coordf_t print_z = layer->print_z;
+    	                        for (int i = int(idx_layer) + 1; 
+    	                        	i < int(num_layers) && 
+    	                        		(i < int(idx_layer) + n_top_layers ||
+    	                        		 m_layers[i]->print_z - print_z < region_config.top_solid_min_thickness - EPSILON);
+    	                        	++ i) {
+    	                            const DiscoverVerticalShellsCacheEntry &cache = cache_top_botom_regions[i];
+    								if (! holes.empty())
+    									holes = intersection(holes, cache_holes[i]);
+    								if (! cache.top_surfaces.empty()) {
+    		                            polygons_append(shell, cache.top_surfaces);
+    		                            // Running the union_ using the Clipper library piece by piece is cheaper 
+    		                            // than running the union_ all at once.
+    	                               shell = union_(shell, false);
+    	                           }
+    	                        }
+    	                    }
+    	                    if (int n_bottom_layers = region_config.bottom_solid_layers.value; n_bottom_layers > 0) {
+                                // Gather bottom regions projected to this layer.
+                                coordf_t bottom_z = layer->bottom_z();
+    	                        for (int i = int(idx_layer) - 1;
+    	                        	i >= 0 &&
+    	                        		(i > int(idx_layer) - n_bottom_layers ||
+    	                        		 bottom_z - m_layers[i]->bottom_z() < region_config.bottom_solid_min_thickness - EPSILON);
+    	                        	-- i) {
+    	                            const DiscoverVerticalShellsCacheEntry &cache = cache_top_botom_regions[i];
+    								if (! holes.empty())
+    									holes = intersection(holes, cache_holes[i]);
+    								if (! cache.bottom_surfaces.empty()) {
+    		                            polygons_append(shell, cache.bottom_surfaces);
+    		                            // Running the union_ using the Clipper library piece by piece is cheaper 
+    		                            // than running the union_ all at once.
+    		                            shell = union_(shell, false);
+    		                        }
+    	                        }
+    	                    }
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                        {
-        					Slic3r::SVG svg(debug_out_path("discover_vertical_shells-perimeters-before-union-%d.svg", debug_idx), get_extents(shell));
-                            svg.draw(shell);
-                            svg.draw_outline(shell, "black", scale_(0.05));
-                            svg.Close(); 
-                        }
+                            {
+            					Slic3r::SVG svg(debug_out_path("discover_vertical_shells-perimeters-before-union-%d.svg", debug_idx), get_extents(shell));
+                                svg.draw(shell);
+                                svg.draw_outline(shell, "black", scale_(0.05));
+                                svg.Close(); 
+                            }
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 #if 0
-                        {
-                            PROFILE_BLOCK(discover_vertical_shells_region_layer_shell_);
-        //                    shell = union_(shell, true);
-                            shell = union_(shell, false); 
-                        }
+                            {
+                                PROFILE_BLOCK(discover_vertical_shells_region_layer_shell_);
+            //                    shell = union_(shell, true);
+                                shell = union_(shell, false); 
+                            }
 #endif
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                        shell_ex = union_ex(shell, true);
+                            shell_ex = union_ex(shell, true);
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
-                    }
+                        }
 
-                    //if (shell.empty())
-                    //    continue;
+                        //if (shell.empty())
+                        //    continue;
 
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    {
-                        Slic3r::SVG svg(debug_out_path("discover_vertical_shells-perimeters-after-union-%d.svg", debug_idx), get_extents(shell));
-                        svg.draw(shell_ex);
-                        svg.draw_outline(shell_ex, "black", "blue", scale_(0.05));
-                        svg.Close();  
-                    }
+                        {
+                            Slic3r::SVG svg(debug_out_path("discover_vertical_shells-perimeters-after-union-%d.svg", debug_idx), get_extents(shell));
+                            svg.draw(shell_ex);
+                            svg.draw_outline(shell_ex, "black", "blue", scale_(0.05));
+                            svg.Close();  
+                        }
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    {
-                        Slic3r::SVG svg(debug_out_path("discover_vertical_shells-internal-wshell-%d.svg", debug_idx), get_extents(shell));
-                        svg.draw(layerm->fill_surfaces.filter_by_type(stInternal), "yellow", 0.5);
-                        svg.draw_outline(layerm->fill_surfaces.filter_by_type(stInternal), "black", "blue", scale_(0.05));
-                        svg.draw(shell_ex, "blue", 0.5);
-                        svg.draw_outline(shell_ex, "black", "blue", scale_(0.05));
-                        svg.Close();
-                    } 
-                    {
-                        Slic3r::SVG svg(debug_out_path("discover_vertical_shells-internalvoid-wshell-%d.svg", debug_idx), get_extents(shell));
-                        svg.draw(layerm->fill_surfaces.filter_by_type(stInternalVoid), "yellow", 0.5);
-                        svg.draw_outline(layerm->fill_surfaces.filter_by_type(stInternalVoid), "black", "blue", scale_(0.05));
-                        svg.draw(shell_ex, "blue", 0.5);
-                        svg.draw_outline(shell_ex, "black", "blue", scale_(0.05));
-                        svg.Close();
-                    } 
-                    {
-                        Slic3r::SVG svg(debug_out_path("discover_vertical_shells-internalvoid-wshell-%d.svg", debug_idx), get_extents(shell));
-                        svg.draw(layerm->fill_surfaces.filter_by_type(stInternalVoid), "yellow", 0.5);
-                        svg.draw_outline(layerm->fill_surfaces.filter_by_type(stInternalVoid), "black", "blue", scale_(0.05));
-                        svg.draw(shell_ex, "blue", 0.5);
-                        svg.draw_outline(shell_ex, "black", "blue", scale_(0.05)); 
-                        svg.Close();
-                    } 
+                        {
+                            Slic3r::SVG svg(debug_out_path("discover_vertical_shells-internal-wshell-%d.svg", debug_idx), get_extents(shell));
+                            svg.draw(layerm->fill_surfaces.filter_by_type(stInternal), "yellow", 0.5);
+                            svg.draw_outline(layerm->fill_surfaces.filter_by_type(stInternal), "black", "blue", scale_(0.05));
+                            svg.draw(shell_ex, "blue", 0.5);
+                            svg.draw_outline(shell_ex, "black", "blue", scale_(0.05));
+                            svg.Close();
+                        } 
+                        {
+                            Slic3r::SVG svg(debug_out_path("discover_vertical_shells-internalvoid-wshell-%d.svg", debug_idx), get_extents(shell));
+                            svg.draw(layerm->fill_surfaces.filter_by_type(stInternalVoid), "yellow", 0.5);
+                            svg.draw_outline(layerm->fill_surfaces.filter_by_type(stInternalVoid), "black", "blue", scale_(0.05));
+                            svg.draw(shell_ex, "blue", 0.5);
+                            svg.draw_outline(shell_ex, "black", "blue", scale_(0.05));
+                            svg.Close();
+                        } 
+                        {
+                            Slic3r::SVG svg(debug_out_path("discover_vertical_shells-internalvoid-wshell-%d.svg", debug_idx), get_extents(shell));
+                            svg.draw(layerm->fill_surfaces.filter_by_type(stInternalVoid), "yellow", 0.5);
+                            svg.draw_outline(layerm->fill_surfaces.filter_by_type(stInternalVoid), "black", "blue", scale_(0.05));
+                            svg.draw(shell_ex, "blue", 0.5);
+                            svg.draw_outline(shell_ex, "black", "blue", scale_(0.05)); 
+                            svg.Close();
+                        } 
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
-                    // Trim the shells region by the internal & internal void surfaces.
-                    const SurfaceType surfaceTypesInternal[] = { stInternal, stInternalVoid, stInternalSolid };
-                    const Polygons    polygonsInternal = to_polygons(layerm->fill_surfaces.filter_by_types(surfaceTypesInternal, 3));
-                    shell = intersection(shell, polygonsInternal, true);
-                    polygons_append(shell, diff(polygonsInternal, holes));
-                    if (shell.empty())
-                        continue;
+                        // Trim the shells region by the internal & internal void surfaces.
+                        const SurfaceType surfaceTypesInternal[] = { stInternal, stInternalVoid, stInternalSolid };
+                        const Polygons    polygonsInternal = to_polygons(layerm->fill_surfaces.filter_by_types(surfaceTypesInternal, 3));
+                        shell = intersection(shell, polygonsInternal, true);
+                        polygons_append(shell, diff(polygonsInternal, holes));
+                        if (shell.empty())
+                            continue;
 
-                    // Append the internal solids, so they will be merged with the new ones.
-                    polygons_append(shell, to_polygons(layerm->fill_surfaces.filter_by_type(stInternalSolid)));
+                        // Append the internal solids, so they will be merged with the new ones.
+                        polygons_append(shell, to_polygons(layerm->fill_surfaces.filter_by_type(stInternalSolid)));
 
-                    // These regions will be filled by a rectilinear full infill. Currently this type of infill
-                    // only fills regions, which fit at least a single line. To avoid gaps in the sparse infill,
-                    // make sure that this region does not contain parts narrower than the infill spacing width.
+                        // These regions will be filled by a rectilinear full infill. Currently this type of infill
+                        // only fills regions, which fit at least a single line. To avoid gaps in the sparse infill,
+                        // make sure that this region does not contain parts narrower than the infill spacing width.
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    Polygons shell_before = shell;
+                        Polygons shell_before = shell;
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 #if 1
-                    // Intentionally inflate a bit more than how much the region has been shrunk, 
-                    // so there will be some overlap between this solid infill and the other infill regions (mainly the sparse infill).
-                    shell = offset(offset_ex(union_ex(shell), - 0.5f * min_perimeter_infill_spacing), 0.8f * min_perimeter_infill_spacing, ClipperLib::jtSquare);
-                    if (shell.empty())
-                        continue;
+                        // Intentionally inflate a bit more than how much the region has been shrunk, 
+                        // so there will be some overlap between this solid infill and the other infill regions (mainly the sparse infill).
+                        shell = offset(offset_ex(union_ex(shell), - 0.5f * min_perimeter_infill_spacing), 0.8f * min_perimeter_infill_spacing, ClipperLib::jtSquare);
+                        if (shell.empty())
+                            continue;
 #else
-                    // Ensure each region is at least 3x infill line width wide, so it could be filled in.
-        //            float margin = float(infill_line_spacing) * 3.f;
-                    float margin = float(infill_line_spacing) * 1.5f;
-                    // we use a higher miterLimit here to handle areas with acute angles
-                    // in those cases, the default miterLimit would cut the corner and we'd
-                    // get a triangle in $too_narrow; if we grow it below then the shell
-                    // would have a different shape from the external surface and we'd still
-                    // have the same angle, so the next shell would be grown even more and so on.
-                    Polygons too_narrow = diff(shell, offset2(shell, -margin, margin, ClipperLib::jtMiter, 5.), true);
-                    if (! too_narrow.empty()) {
-                        // grow the collapsing parts and add the extra area to  the neighbor layer 
-                        // as well as to our original surfaces so that we support this 
-                        // additional area in the next shell too
-                        // make sure our grown surfaces don't exceed the fill area
-                        polygons_append(shell, intersection(offset(too_narrow, margin), polygonsInternal));
-                    }
+                        // Ensure each region is at least 3x infill line width wide, so it could be filled in.
+            //            float margin = float(infill_line_spacing) * 3.f;
+                        float margin = float(infill_line_spacing) * 1.5f;
+                        // we use a higher miterLimit here to handle areas with acute angles
+                        // in those cases, the default miterLimit would cut the corner and we'd
+                        // get a triangle in $too_narrow; if we grow it below then the shell
+                        // would have a different shape from the external surface and we'd still
+                        // have the same angle, so the next shell would be grown even more and so on.
+                        Polygons too_narrow = diff(shell, offset2(shell, -margin, margin, ClipperLib::jtMiter, 5.), true);
+                        if (! too_narrow.empty()) {
+                            // grow the collapsing parts and add the extra area to  the neighbor layer 
+                            // as well as to our original surfaces so that we support this 
+                            // additional area in the next shell too
+                            // make sure our grown surfaces don't exceed the fill area
+                            polygons_append(shell, intersection(offset(too_narrow, margin), polygonsInternal));
+                        }
 #endif
-                    ExPolygons new_internal_solid = intersection_ex(polygonsInternal, shell, false);
+                        ExPolygons new_internal_solid = intersection_ex(polygonsInternal, shell, false);
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    {
-                        Slic3r::SVG svg(debug_out_path("discover_vertical_shells-regularized-%d.svg", debug_idx), get_extents(shell_before));
-                        // Source shell.
-                        svg.draw(union_ex(shell_before, true));
-                        // Shell trimmed to the internal surfaces.
-                        svg.draw_outline(union_ex(shell, true), "black", "blue", scale_(0.05));
-                        // Regularized infill region.
-                        svg.draw_outline(new_internal_solid, "red", "magenta", scale_(0.05));
-                        svg.Close();  
-                    }
+                        {
+                            Slic3r::SVG svg(debug_out_path("discover_vertical_shells-regularized-%d.svg", debug_idx), get_extents(shell_before));
+                            // Source shell.
+                            svg.draw(union_ex(shell_before, true));
+                            // Shell trimmed to the internal surfaces.
+                            svg.draw_outline(union_ex(shell, true), "black", "blue", scale_(0.05));
+                            // Regularized infill region.
+                            svg.draw_outline(new_internal_solid, "red", "magenta", scale_(0.05));
+                            svg.Close();  
+                        }
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
-                    // Trim the internal & internalvoid by the shell.
-                    Slic3r::ExPolygons new_internal = diff_ex(
-                        to_polygons(layerm->fill_surfaces.filter_by_type(stInternal)),
-                        shell,
-                        false
-                    );
-                    Slic3r::ExPolygons new_internal_void = diff_ex(
-                        to_polygons(layerm->fill_surfaces.filter_by_type(stInternalVoid)),
-                        shell,
-                        false
-                    );
+                        // Trim the internal & internalvoid by the shell.
+                        Slic3r::ExPolygons new_internal = diff_ex(
+                            to_polygons(layerm->fill_surfaces.filter_by_type(stInternal)),
+                            shell,
+                            false
+                        );
+                        Slic3r::ExPolygons new_internal_void = diff_ex(
+                            to_polygons(layerm->fill_surfaces.filter_by_type(stInternalVoid)),
+                            shell,
+                            false
+                        );
 
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
-                    {
-                        SVG::export_expolygons(debug_out_path("discover_vertical_shells-new_internal-%d.svg", debug_idx), get_extents(shell), new_internal, "black", "blue", scale_(0.05));
-        				SVG::export_expolygons(debug_out_path("discover_vertical_shells-new_internal_void-%d.svg", debug_idx), get_extents(shell), new_internal_void, "black", "blue", scale_(0.05));
-        				SVG::export_expolygons(debug_out_path("discover_vertical_shells-new_internal_solid-%d.svg", debug_idx), get_extents(shell), new_internal_solid, "black", "blue", scale_(0.05));
-                    }
+                        {
+                            SVG::export_expolygons(debug_out_path("discover_vertical_shells-new_internal-%d.svg", debug_idx), get_extents(shell), new_internal, "black", "blue", scale_(0.05));
+            				SVG::export_expolygons(debug_out_path("discover_vertical_shells-new_internal_void-%d.svg", debug_idx), get_extents(shell), new_internal_void, "black", "blue", scale_(0.05));
+            				SVG::export_expolygons(debug_out_path("discover_vertical_shells-new_internal_solid-%d.svg", debug_idx), get_extents(shell), new_internal_solid, "black", "blue", scale_(0.05));
+                        }
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
 
-                    // Assign resulting internal surfaces to layer.
-                    const SurfaceType surfaceTypesKeep[] = { stTop, stBottom, stBottomBridge };
-                    layerm->fill_surfaces.keep_types(surfaceTypesKeep, sizeof(surfaceTypesKeep)/sizeof(SurfaceType));
-                    layerm->fill_surfaces.append(new_internal,       stInternal);
-                    layerm->fill_surfaces.append(new_internal_void,  stInternalVoid);
-                    layerm->fill_surfaces.append(new_internal_solid, stInternalSolid);
-                } // for each layer
-            });
-        m_print->throw_if_canceled();
-        BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells for region " << idx_region << " in parallel - end";
+                        // Assign resulting internal surfaces to layer.
+                        const SurfaceType surfaceTypesKeep[] = { stTop, stBottom, stBottomBridge };
+                        layerm->fill_surfaces.keep_types(surfaceTypesKeep, sizeof(surfaceTypesKeep)/sizeof(SurfaceType));
+                        layerm->fill_surfaces.append(new_internal,       stInternal);
+                        layerm->fill_surfaces.append(new_internal_void,  stInternalVoid);
+                        layerm->fill_surfaces.append(new_internal_solid, stInternalSolid);
+                    } // for each layer
+                });
+            m_print->throw_if_canceled();
+            BOOST_LOG_TRIVIAL(debug) << "Discovering vertical shells for region " << idx_region << " in parallel - end";
+        } // for each region
+
+        // Release the cache entries, which will not be accessed by the following bands.
+        band_begin = band_end;
+        for (size_t release_end = (band_begin > radius_below) ? band_begin - radius_below : 0; released_end < release_end; ++ released_end) {
+            for (std::vector<DiscoverVerticalShellsCacheEntry> &cache : caches)
+                cache[released_end] = DiscoverVerticalShellsCacheEntry();
+            Polygons().swap(cache_holes[released_end]);
+        }
+    } // for each band
 
 #ifdef SLIC3R_DEBUG_SLICE_PROCESSING
+    for (size_t idx_region : regions)
 		for (size_t idx_layer = 0; idx_layer < m_layers.size(); ++idx_layer) {
 			LayerRegion *layerm = m_layers[idx_layer]->get_region(idx_region);
 			layerm->export_region_slices_to_svg_debug("4_discover_vertical_shells-final");
 			layerm->export_region_fill_surfaces_to_svg_debug("4_discover_vertical_shells-final");
 		}
 #endif /* SLIC3R_DEBUG_SLICE_PROCESSING */
-    } // for each region
 
     // Write the profiler measurements to file
 //    PROFILE_UPDATE();
 //    PROFILE_OUTPUT(debug_out_path("discover_vertical_shells-profile.txt").c_str());
 }
 
+// Number of layers below / above a layer, which discover_vertical_shells() reads when processing that layer.
+// The top surfaces are projected from the layers above, the bottom surfaces from the layers below.
+// The number of layers is bounded by the number of solid layers and by the minimum shell thickness
+// divided by the thinnest layer of this object.
+std::pair<size_t, size_t> PrintObject::discover_vertical_shells_radius() const
+{
+    coordf_t min_layer_height = std::numeric_limits<coordf_t>::max();
+    for (const Layer *layer : m_layers)
+        min_layer_height = std::min(min_layer_height, layer->height);
+    auto radius = [this, min_layer_height](int num_solid_layers, coordf_t min_shell_thickness) -> size_t {
+        if (num_solid_layers <= 0)
+            return 0;
+        size_t n = size_t(num_solid_layers - 1);
+        if (min_shell_thickness > 0.)
+            n = (min_layer_height > EPSILON) ? 
+                std::max(n, size_t(ceil(min_shell_thickness / min_layer_height))) :
+                // Degenerate layers, the radius is not bounded.
+                m_layers.size();
+        return std::min(n, m_layers.size());
+    };
+    size_t radius_below = 0;
+    size_t radius_above = 0;
+    for (size_t idx_region = 0; idx_region < this->region_volumes.size(); ++ idx_region) {
+        const PrintRegionConfig &config = m_print->get_region(idx_region)->config();
+        if (config.ensure_vertical_shell_thickness.value) {
+            radius_below = std::max(radius_below, radius(config.bottom_solid_layers.value, config.bottom_solid_min_thickness.value));
+            radius_above = std::max(radius_above, radius(config.top_solid_layers.value,    config.top_solid_min_thickness.value));
+        }
+    }
+    return { radius_below, radius_above };
+}
+
 /* This method applies bridge flow to the first internal solid layer above
    sparse infill */
 void PrintObject::bridge_over_infill()
@@ -2150,6 +2200,12 @@ std::vector<ExPolygons> PrintObject::slice_volumes(const std::vector<float> &z,
             mesh.transform(m_trafo, true);
             // apply XY shift
             mesh.translate(- unscale<float>(m_center_offset.x()), - unscale<float>(m_center_offset.y()), 0);
+            SliceCacheKey cache_key;
+            if (SliceCache::instance().enabled()) {
+                cache_key = SliceCacheKey(mesh, z, mode, float(m_config.slice_closing_radius.value));
+                if (SliceCache::instance().find(cache_key, layers))
+                    return layers;
+            }
             // perform actual slicing
             const Print *print = this->print();
             auto callback = TriangleMeshSlicer::throw_on_cancel_callback_type([print](){print->throw_if_canceled();});
@@ -2159,6 +2215,8 @@ std::vector<ExPolygons> PrintObject::slice_volumes(const std::vector<float> &z,
             mslicer.init(&mesh, callback);
 			mslicer.slice(z, mode, float(m_config.slice_closing_radius.value), &layers, callback);
             m_print->throw_if_canceled();
+            if (SliceCache::instance().enabled())
+                SliceCache::instance().insert(cache_key, layers);
         }
     }
     return layers;
@@ -2180,6 +2238,12 @@ std::vector<ExPolygons> PrintObject::slice_volume(const std::vector<float> &z, S
 	        mesh.transform(m_trafo, true);
 	        // apply XY shift
 	        mesh.translate(- unscale<float>(m_center_offset.x()), - unscale<float>(m_center_offset.y()), 0);
+	        SliceCacheKey cache_key;
+	        if (SliceCache::instance().enabled()) {
+	            cache_key = SliceCacheKey(mesh, z, mode, float(m_config.slice_closing_radius.value));
+	            if (SliceCache::instance().find(cache_key, layers))
+	                return layers;
+	        }
 	        // perform actual slicing
 	        TriangleMeshSlicer mslicer;
 	        const Print *print = this->print();
@@ -2189,6 +2253,8 @@ std::vector<ExPolygons> PrintObject::slice_volume(const std::vector<float> &z, S
 	        mslicer.init(&mesh, callback);
 	        mslicer.slice(z, mode, float(m_config.slice_closing_radius.value), &layers, callback);
 	        m_print->throw_if_canceled();
+	        if (SliceCache::instance().enabled())
+	            SliceCache::instance().insert(cache_key, layers);
 	    }
 	}
     return layers;
@@ -0,0 +1,425 @@
+#include "SliceCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/fstream.hpp>
+
+namespace Slic3r {
+
+// Mixing step of MurmurHash64A.
+static inline uint64_t hash_mix(uint64_t h, uint64_t v)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    v *= m;
+    v ^= v >> 47;
+    v *= m;
+    h ^= v;
+    return h * m;
+}
+
+static inline uint64_t floats_bits(float a, float b)
+{
+    uint32_t ia, ib;
+    memcpy(&ia, &a, sizeof(float));
+    memcpy(&ib, &b, sizeof(float));
+    return (uint64_t(ia) << 32) | ib;
+}
+
+static inline uint64_t hash_mix(uint64_t h, float a, float b)
+{
+    return hash_mix(h, floats_bits(a, b));
+}
+
+// Round step of xxHash64, structured differently from hash_mix(), so that the two hashes do not collide together.
+static inline uint64_t hash_mix2(uint64_t h, float a, float b)
+{
+    h += floats_bits(a, b) * 0xc2b2ae3d27d4eb4fULL;
+    h  = (h << 31) | (h >> 33);
+    return h * 0x9e3779b185ebca87ULL;
+}
+
+SliceCacheKey::SliceCacheKey(const TriangleMesh &mesh, const std::vector<float> &z, SlicingMode mode, float closing_radius) :
+    num_facets(uint32_t(mesh.stl.facet_start.size())), mode(mode), closing_radius(closing_radius), z(z)
+{
+    uint64_t h  = 0;
+    uint64_t h2 = 0x27d4eb2f165667c5ULL;
+    for (const stl_facet &facet : mesh.stl.facet_start) {
+        h  = hash_mix (h,  facet.normal.x(),    facet.normal.y());
+        h  = hash_mix (h,  facet.normal.z(),    facet.vertex[0].x());
+        h  = hash_mix (h,  facet.vertex[0].y(), facet.vertex[0].z());
+        h  = hash_mix (h,  facet.vertex[1].x(), facet.vertex[1].y());
+        h  = hash_mix (h,  facet.vertex[1].z(), facet.vertex[2].x());
+        h  = hash_mix (h,  facet.vertex[2].y(), facet.vertex[2].z());
+        h2 = hash_mix2(h2, facet.normal.x(),    facet.normal.y());
+        h2 = hash_mix2(h2, facet.normal.z(),    facet.vertex[0].x());
+        h2 = hash_mix2(h2, facet.vertex[0].y(), facet.vertex[0].z());
+        h2 = hash_mix2(h2, facet.vertex[1].x(), facet.vertex[1].y());
+        h2 = hash_mix2(h2, facet.vertex[1].z(), facet.vertex[2].x());
+        h2 = hash_mix2(h2, facet.vertex[2].y(), facet.vertex[2].z());
+    }
+    this->mesh_hash  = h;
+    this->mesh_hash2 = h2;
+}
+
+uint64_t SliceCacheKey::hash() const
+{
+    uint64_t h = hash_mix(this->mesh_hash, this->mesh_hash2);
+    h = hash_mix(h, this->num_facets);
+    h = hash_mix(h, uint64_t(this->mode));
+    h = hash_mix(h, this->closing_radius, float(this->z.size()));
+    for (size_t i = 0; i < this->z.size(); i += 2)
+        h = hash_mix(h, this->z[i], i + 1 < this->z.size() ? this->z[i + 1] : 0.f);
+    return h;
+}
+
+bool SliceCacheKey::operator==(const SliceCacheKey &rhs) const
+{
+    return this->mesh_hash == rhs.mesh_hash && this->mesh_hash2 == rhs.mesh_hash2 && this->num_facets == rhs.num_facets && this->mode == rhs.mode &&
+           this->closing_radius == rhs.closing_radius && this->z == rhs.z;
+}
+
+// Approximate memory footprint of the slices.
+static size_t slices_memory_size(const std::vector<ExPolygons> &slices)
+{
+    size_t size = slices.size() * sizeof(ExPolygons);
+    for (const ExPolygons &expolygons : slices)
+        for (const ExPolygon &expolygon : expolygons) {
+            size += sizeof(ExPolygon) + expolygon.contour.points.size() * sizeof(Point) + expolygon.holes.size() * sizeof(Polygon);
+            for (const Polygon &hole : expolygon.holes)
+                size += hole.points.size() * sizeof(Point);
+        }
+    return size;
+}
+
+// On-disk format: magic, version of the format, SLIC3R_VERSION and TriangleMeshSlicer::revision of the build which stored the slices,
+// the complete key to be verified on load, then the slices.
+// A file is only loaded by a build with the same format version, SLIC3R_VERSION and slicer revision. Any other file is a miss
+// and it is overwritten, thus the slices produced by a former slicer implementation are never reused, and neither are the slices
+// of another PrusaSlicer version sharing the directory: their files are named by a hash including the version and the revision.
+// Bump SLICE_CACHE_VERSION with each change of the format, and TriangleMeshSlicer::revision with each change of the slicer.
+static const char     SLICE_CACHE_MAGIC[4] = { 'P', 'S', 'S', 'C' };
+static const uint32_t SLICE_CACHE_VERSION  = 2;
+
+template<typename T> static void write_value(std::ostream &os, const T &value) { os.write((const char*)&value, sizeof(T)); }
+
+static void write_points(std::ostream &os, const Points &points)
+{
+    write_value(os, uint32_t(points.size()));
+    os.write((const char*)points.data(), points.size() * sizeof(Point));
+}
+
+// Reads a cache file, which may be truncated or corrupted. The counts read are checked against the bytes left in the file
+// before anything is allocated, thus a corrupted count fails the read instead of requesting a huge allocation.
+class SliceCacheReader
+{
+public:
+    SliceCacheReader(std::istream &is, size_t size) : m_is(is), m_left(size) {}
+
+    bool read(char *data, size_t size) {
+        if (size > m_left || ! m_is.read(data, size))
+            return false;
+        m_left -= size;
+        return true;
+    }
+    template<typename T> bool read_value(T &value) { return this->read((char*)&value, sizeof(T)); }
+    // Reads the count of the items following, each item being stored in at least min_item_size bytes.
+    bool read_count(uint32_t &count, size_t min_item_size) { return this->read_value(count) && size_t(count) * min_item_size <= m_left; }
+    bool read_points(Points &points) {
+        uint32_t n;
+        if (! this->read_count(n, sizeof(Point)))
+            return false;
+        points.assign(n, Point());
+        return this->read((char*)points.data(), n * sizeof(Point));
+    }
+
+private:
+    std::istream &m_is;
+    size_t        m_left;
+};
+
+static void write_slices(std::ostream &os, const SliceCacheKey &key, const std::vector<ExPolygons> &slices)
+{
+    os.write(SLICE_CACHE_MAGIC, 4);
+    write_value(os, SLICE_CACHE_VERSION);
+    write_value(os, uint32_t(strlen(SLIC3R_VERSION)));
+    os.write(SLIC3R_VERSION, strlen(SLIC3R_VERSION));
+    write_value(os, TriangleMeshSlicer::revision);
+    write_value(os, key.mesh_hash);
+    write_value(os, key.mesh_hash2);
+    write_value(os, key.num_facets);
+    write_value(os, uint32_t(key.mode));
+    write_value(os, key.closing_radius);
+    write_value(os, uint32_t(key.z.size()));
+    os.write((const char*)key.z.data(), key.z.size() * sizeof(float));
+    write_value(os, uint32_t(slices.size()));
+    for (const ExPolygons &expolygons : slices) {
+        write_value(os, uint32_t(expolygons.size()));
+        for (const ExPolygon &expolygon : expolygons) {
+            write_points(os, expolygon.contour.points);
+            write_value(os, uint32_t(expolygon.holes.size()));
+            for (const Polygon &hole : expolygon.holes)
+                write_points(os, hole.points);
+        }
+    }
+}
+
+// Returns false if the file does not match the key or if it is truncated or corrupted, slices are then left partially filled.
+static bool read_slices(std::istream &is, size_t file_size, const SliceCacheKey &key, std::vector<ExPolygons> &slices)
+{
+    SliceCacheReader reader(is, file_size);
+    char     magic[4];
+    uint32_t version, slic3r_version_len, slicer_revision, mode, num_z, num_slices;
+    std::string slic3r_version;
+    SliceCacheKey file_key;
+    if (! reader.read(magic, 4) || memcmp(magic, SLICE_CACHE_MAGIC, 4) != 0 || ! reader.read_value(version) || version != SLICE_CACHE_VERSION ||
+        ! reader.read_value(slic3r_version_len) || slic3r_version_len != strlen(SLIC3R_VERSION))
+        return false;
+    slic3r_version.assign(slic3r_version_len, 0);
+    if (! reader.read(&slic3r_version.front(), slic3r_version_len) || slic3r_version != SLIC3R_VERSION ||
+        ! reader.read_value(slicer_revision) || slicer_revision != TriangleMeshSlicer::revision ||
+        ! reader.read_value(file_key.mesh_hash) || ! reader.read_value(file_key.mesh_hash2) || ! reader.read_value(file_key.num_facets) ||
+        ! reader.read_value(mode) || ! reader.read_value(file_key.closing_radius) || ! reader.read_value(num_z) || num_z != key.z.size())
+        return false;
+    file_key.mode = SlicingMode(mode);
+    file_key.z.assign(num_z, 0.f);
+    // A layer is stored as its count of expolygons, an expolygon as the counts of its contour points and of its holes, a hole as its count of points.
+    if (! reader.read((char*)file_key.z.data(), num_z * sizeof(float)) || file_key != key || ! reader.read_count(num_slices, sizeof(uint32_t)))
+        return false;
+    slices.assign(num_slices, ExPolygons());
+    for (ExPolygons &expolygons : slices) {
+        uint32_t num_expolygons;
+        if (! reader.read_count(num_expolygons, 2 * sizeof(uint32_t)))
+            return false;
+        expolygons.assign(num_expolygons, ExPolygon());
+        for (ExPolygon &expolygon : expolygons) {
+            uint32_t num_holes;
+            if (! reader.read_points(expolygon.contour.points) || ! reader.read_count(num_holes, sizeof(uint32_t)))
+                return false;
+            expolygon.holes.assign(num_holes, Polygon());
+            for (Polygon &hole : expolygon.holes)
+                if (! reader.read_points(hole.points))
+                    return false;
+        }
+    }
+    return true;
+}
+
+SliceCache& SliceCache::instance()
+{
+    static SliceCache cache;
+    return cache;
+}
+
+void SliceCache::set_memory_limit(size_t limit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memory_limit = limit;
+    m_enabled      = m_memory_limit > 0 || ! m_disk_dir.empty();
+    this->shrink_memory();
+}
+
+void SliceCache::set_disk_cache(const std::string &dir, size_t size_limit)
+{
+    namespace fs = boost::filesystem;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_disk_dir   = dir;
+    m_disk_limit = size_limit;
+    m_enabled    = m_memory_limit > 0 || ! m_disk_dir.empty();
+    m_stats.disk_used = 0;
+    if (! m_disk_dir.empty()) {
+        boost::system::error_code ec;
+        fs::create_directories(m_disk_dir, ec);
+        for (fs::directory_iterator it(m_disk_dir, ec), end; ! ec && it != end; it.increment(ec))
+            if (it->path().extension() == ".slices")
+                m_stats.disk_used += size_t(fs::file_size(it->path(), ec));
+        this->shrink_disk();
+    }
+}
+
+std::string SliceCache::file_path(const SliceCacheKey &key) const
+{
+    // Name the files of another PrusaSlicer version or of another slicer revision differently, so that they do not overwrite each other.
+    uint64_t h = hash_mix(key.hash(), TriangleMeshSlicer::revision);
+    for (const char *c = SLIC3R_VERSION; *c != 0; ++ c)
+        h = hash_mix(h, uint64_t(*c));
+    char name[32];
+    sprintf(name, "%016llx.slices", (unsigned long long)h);
+    return (boost::filesystem::path(m_disk_dir) / name).string();
+}
+
+bool SliceCache::find(const SliceCacheKey &key, std::vector<ExPolygons> &slices)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_map.find(key.hash());
+        if (it != m_map.end() && it->second->key == key) {
+            // Move to the front of the LRU list.
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            slices = it->second->slices;
+            ++ m_stats.hits;
+            return true;
+        }
+        if (m_disk_dir.empty()) {
+            ++ m_stats.misses;
+            return false;
+        }
+        path = this->file_path(key);
+    }
+
+    // Read the file outside of the lock.
+    bool found = false;
+    {
+        boost::system::error_code ec;
+        size_t file_size = size_t(boost::filesystem::file_size(path, ec));
+        boost::nowide::ifstream is(path, std::ios::in | std::ios::binary);
+        found = ! ec && is.good() && read_slices(is, file_size, key, slices);
+    }
+    if (found) {
+        // Mark the file as recently used.
+        boost::system::error_code ec;
+        boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+    } else
+        slices.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (found) {
+        ++ m_stats.disk_hits;
+        this->insert_memory(key, slices);
+    } else
+        ++ m_stats.misses;
+    BOOST_LOG_TRIVIAL(debug) << "SliceCache: " << path << (found ? " loaded" : " not found");
+    return found;
+}
+
+void SliceCache::insert(const SliceCacheKey &key, const std::vector<ExPolygons> &slices)
+{
+    namespace fs = boost::filesystem;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->insert_memory(key, slices);
+        if (m_disk_dir.empty())
+            return;
+        path = this->file_path(key);
+    }
+
+    // Write into a temporary file first and rename it, so that other processes sharing the directory never read a partial file.
+    boost::system::error_code ec;
+    fs::path path_tmp = fs::path(path).parent_path() / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp", ec);
+    {
+        boost::nowide::ofstream os(path_tmp.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+        write_slices(os, key, slices);
+        os.close();
+        if (os.fail()) {
+            BOOST_LOG_TRIVIAL(error) << "SliceCache: Failed to write " << path_tmp.string();
+            fs::remove(path_tmp, ec);
+            return;
+        }
+    }
+    size_t file_size     = size_t(fs::file_size(path_tmp, ec));
+    size_t file_size_old = fs::exists(path, ec) ? size_t(fs::file_size(path, ec)) : 0;
+    fs::rename(path_tmp, path, ec);
+    if (ec) {
+        BOOST_LOG_TRIVIAL(error) << "SliceCache: Failed to rename " << path_tmp.string() << " to " << path << ": " << ec.message();
+        fs::remove(path_tmp, ec);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.disk_used += file_size;
+    m_stats.disk_used -= std::min(file_size_old, m_stats.disk_used);
+    this->shrink_disk();
+}
+
+void SliceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_map.clear();
+    m_stats.memory_used = 0;
+}
+
+SliceCache::Stats SliceCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void SliceCache::reset_stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.hits      = 0;
+    m_stats.disk_hits = 0;
+    m_stats.misses    = 0;
+    m_stats.evictions = 0;
+}
+
+// Called with m_mutex locked.
+void SliceCache::insert_memory(const SliceCacheKey &key, const std::vector<ExPolygons> &slices)
+{
+    size_t size = slices_memory_size(slices);
+    if (size > m_memory_limit)
+        return;
+    uint64_t hash = key.hash();
+    auto it = m_map.find(hash);
+    if (it != m_map.end()) {
+        // Replace the entry with the same hash.
+        m_stats.memory_used -= it->second->size;
+        m_entries.erase(it->second);
+        m_map.erase(it);
+    }
+    m_entries.push_front(Entry{ key, slices, size });
+    m_map[hash] = m_entries.begin();
+    m_stats.memory_used += size;
+    this->shrink_memory();
+}
+
+// Called with m_mutex locked.
+void SliceCache::shrink_memory()
+{
+    while (m_stats.memory_used > m_memory_limit && ! m_entries.empty()) {
+        const Entry &entry = m_entries.back();
+        m_stats.memory_used -= entry.size;
+        m_map.erase(entry.key.hash());
+        m_entries.pop_back();
+        ++ m_stats.evictions;
+    }
+}
+
+// Called with m_mutex locked.
+void SliceCache::shrink_disk()
+{
+    namespace fs = boost::filesystem;
+    if (m_disk_dir.empty() || m_stats.disk_used <= m_disk_limit)
+        return;
+    // Delete the least recently used files until below the size limit.
+    boost::system::error_code ec;
+    struct File {
+        fs::path    path;
+        std::time_t time;
+        size_t      size;
+    };
+    std::vector<File> files;
+    size_t            disk_used = 0;
+    for (fs::directory_iterator it(m_disk_dir, ec), end; ! ec && it != end; it.increment(ec))
+        if (it->path().extension() == ".slices") {
+            File file { it->path(), fs::last_write_time(it->path(), ec), size_t(fs::file_size(it->path(), ec)) };
+            disk_used += file.size;
+            files.emplace_back(std::move(file));
+        }
+    std::sort(files.begin(), files.end(), [](const File &l, const File &r) { return l.time < r.time; });
+    for (const File &file : files) {
+        if (disk_used <= m_disk_limit)
+            break;
+        if (fs::remove(file.path, ec))
+            disk_used -= file.size;
+    }
+    m_stats.disk_used = disk_used;
+}
+
+} // namespace Slic3r
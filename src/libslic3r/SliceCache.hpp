@@ -0,0 +1,106 @@
+#ifndef slic3r_SliceCache_hpp_
+#define slic3r_SliceCache_hpp_
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ExPolygon.hpp"
+#include "TriangleMesh.hpp"
+
+namespace Slic3r {
+
+// Identification of the slices of a mesh: the mesh content after it has been transformed to the PrintObject's coordinate system
+// (thus including the transformation), the list of slicing heights, the slicing mode and the closing radius.
+struct SliceCacheKey
+{
+    SliceCacheKey() = default;
+    SliceCacheKey(const TriangleMesh &mesh, const std::vector<float> &z, SlicingMode mode, float closing_radius);
+
+    // Two independent hashes of the normals and vertices of mesh.stl.facet_start, so that a lookup does not rely on a single 64 bit hash.
+    uint64_t            mesh_hash      = 0;
+    uint64_t            mesh_hash2     = 0;
+    uint32_t            num_facets     = 0;
+    SlicingMode         mode           = SlicingMode::Regular;
+    float               closing_radius = 0.f;
+    std::vector<float>  z;
+
+    // Hash of all the above, naming the cache entry.
+    uint64_t            hash() const;
+    bool                operator==(const SliceCacheKey &rhs) const;
+    bool                operator!=(const SliceCacheKey &rhs) const { return ! (*this == rhs); }
+};
+
+// Cache of the results of TriangleMeshSlicer::slice() consulted by PrintObject when slicing its volumes, so that
+// re-slicing an object with unchanged geometry and layer heights (for example when only non-geometric options changed,
+// which still invalidate posSlice) skips the slicing.
+// The cache is disabled by default. It keeps the most recently used slices in memory up to the memory limit,
+// and optionally stores all slices into a directory, so that they are shared between processes and survive restarts.
+// The cache is thread safe.
+class SliceCache
+{
+public:
+    struct Stats {
+        // Found in memory.
+        size_t hits         = 0;
+        // Found on disk.
+        size_t disk_hits    = 0;
+        size_t misses       = 0;
+        // Removed from memory to stay below the memory limit.
+        size_t evictions    = 0;
+        // Currently used by the slices in memory and by the files of the on-disk cache, in bytes.
+        size_t memory_used  = 0;
+        size_t disk_used    = 0;
+    };
+
+    static SliceCache&  instance();
+
+    // Maximum size of the slices kept in memory in bytes, zero disables the in-memory cache.
+    void                set_memory_limit(size_t limit);
+    // Directory of the on-disk cache, an empty path disables it. If the files in the directory exceed size_limit bytes,
+    // the least recently used files are deleted.
+    void                set_disk_cache(const std::string &dir, size_t size_limit);
+    bool                enabled() const { return m_enabled; }
+
+    // Returns true and fills in slices if found.
+    bool                find(const SliceCacheKey &key, std::vector<ExPolygons> &slices);
+    void                insert(const SliceCacheKey &key, const std::vector<ExPolygons> &slices);
+    // Drop the slices kept in memory, the on-disk cache is left intact.
+    void                clear();
+
+    Stats               stats() const;
+    void                reset_stats();
+
+private:
+    SliceCache() = default;
+
+    struct Entry {
+        SliceCacheKey           key;
+        std::vector<ExPolygons> slices;
+        size_t                  size;
+    };
+
+    void                insert_memory(const SliceCacheKey &key, const std::vector<ExPolygons> &slices);
+    void                shrink_memory();
+    std::string         file_path(const SliceCacheKey &key) const;
+    void                shrink_disk();
+
+    mutable std::mutex  m_mutex;
+    std::atomic<bool>   m_enabled       { false };
+    size_t              m_memory_limit  = 0;
+    std::string         m_disk_dir;
+    size_t              m_disk_limit    = 0;
+    // Most recently used entry at the front.
+    std::list<Entry>    m_entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_map;
+    Stats               m_stats;
+};
+
+} // namespace Slic3r
+
+#endif /* slic3r_SliceCache_hpp_ */
@@ -8,6 +8,7 @@
 #include <libqhullcpp/QhullVertexSet.h>
 #include <cmath>
 #include <deque>
+#include <limits>
 #include <queue>
 #include <set>
 #include <vector>
@@ -20,6 +21,8 @@
 #include <boost/log/trivial.hpp>
 
 #include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/task_arena.h>
 
 #include <Eigen/Core>
 #include <Eigen/Dense>
@@ -765,6 +768,9 @@ void TriangleMeshSlicer::init(const TriangleMesh *_mesh, throw_on_cancel_callbac
         if ((i & 0x0ffff) == 0)
             throw_on_cancel();
     }
+
+    throw_on_cancel();
+    this->build_sweep(m_sweep);
 }
 
 
@@ -809,21 +815,14 @@ void TriangleMeshSlicer::slice(const std::vector<float> &z, SlicingMode mode, st
     */
     
     BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::_slice_do";
-    std::vector<IntersectionLines> lines(z.size());
-    {
-        boost::mutex lines_mutex;
-        tbb::parallel_for(
-            tbb::blocked_range<int>(0,this->mesh->stl.stats.number_of_facets),
-            [&lines, &lines_mutex, &z, throw_on_cancel, this](const tbb::blocked_range<int>& range) {
-                for (int facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx) {
-                    if ((facet_idx & 0x0ffff) == 0)
-                        throw_on_cancel();
-                    this->_slice_do(facet_idx, &lines, &lines_mutex, z);
-                }
-            }
-        );
-    }
-    throw_on_cancel();
+    std::vector<IntersectionLines> lines;
+    // The layers of the sweep are split into bands, which are sliced in parallel. A few layers make a few bands only,
+    // therefore they are sliced in parallel over the facets, and so is the mesh rotated by m_quaternion
+    // (the clipping plane of MeshClipper), for which the sweep is not built.
+    if (m_use_quaternion || z.size() < size_t(4 * tbb::this_task_arena::max_concurrency()))
+        this->slice_facets_chunked(z, lines, throw_on_cancel);
+    else
+        this->slice_facets_sweep(z, lines, throw_on_cancel);
 
     // v_scaled_shared could be freed here
     
@@ -903,42 +902,212 @@ void TriangleMeshSlicer::slice(const std::vector<float> &z, SlicingMode mode, st
 #endif
 }
 
-void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, 
-    const std::vector<float> &z) const
+template<typename EmitLine>
+void TriangleMeshSlicer::_slice_do(size_t facet_idx, float min_z, float max_z, const std::vector<float> &z, size_t layer_begin, size_t layer_end,
+    EmitLine emit_line) const
 {
     const stl_facet &facet = m_use_quaternion ? (this->mesh->stl.facet_start.data() + facet_idx)->rotated(m_quaternion) : *(this->mesh->stl.facet_start.data() + facet_idx);
     
-    // find facet extents
-    const float min_z = fminf(facet.vertex[0](2), fminf(facet.vertex[1](2), facet.vertex[2](2)));
-    const float max_z = fmaxf(facet.vertex[0](2), fmaxf(facet.vertex[1](2), facet.vertex[2](2)));
-    
     #ifdef SLIC3R_TRIANGLEMESH_DEBUG
     printf("\n==> FACET %d (%f,%f,%f - %f,%f,%f - %f,%f,%f):\n", facet_idx,
         facet.vertex[0](0), facet.vertex[0](1), facet.vertex[0](2),
         facet.vertex[1](0), facet.vertex[1](1), facet.vertex[1](2),
         facet.vertex[2](0), facet.vertex[2](1), facet.vertex[2](2));
     printf("z: min = %.2f, max = %.2f\n", min_z, max_z);
+    printf("layers: min = %d, max = %d\n", (int)layer_begin, (int)layer_end);
     #endif /* SLIC3R_TRIANGLEMESH_DEBUG */
     
-    // find layer extents
-    std::vector<float>::const_iterator min_layer, max_layer;
-    min_layer = std::lower_bound(z.begin(), z.end(), min_z); // first layer whose slice_z is >= min_z
-    max_layer = std::upper_bound(min_layer, z.end(), max_z); // first layer whose slice_z is > max_z
-    #ifdef SLIC3R_TRIANGLEMESH_DEBUG
-    printf("layers: min = %d, max = %d\n", (int)(min_layer - z.begin()), (int)(max_layer - z.begin()));
-    #endif /* SLIC3R_TRIANGLEMESH_DEBUG */
-    
-    for (std::vector<float>::const_iterator it = min_layer; it != max_layer; ++ it) {
-        std::vector<float>::size_type layer_idx = it - z.begin();
+    for (size_t layer_idx = layer_begin; layer_idx < layer_end; ++ layer_idx) {
         IntersectionLine il;
-        if (this->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &il) == TriangleMeshSlicer::Slicing) {
-            boost::lock_guard<boost::mutex> l(*lines_mutex);
+        if (this->slice_facet(z[layer_idx] / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &il) == TriangleMeshSlicer::Slicing) {
             if (il.edge_type == feHorizontal) {
                 // Ignore horizontal triangles. Any valid horizontal triangle must have a vertical triangle connected, otherwise the part has zero volume.
             } else
-                (*lines)[layer_idx].emplace_back(il);
+                emit_line(layer_idx, il);
+        }
+    }
+}
+
+void TriangleMeshSlicer::slice_facets_sweep(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const
+{
+    // The facets are swept in the order of their minimum Z. The layers are split into bands, each band
+    // slices the facets touching its layers and owns the intersection lines of its layers, so the bands
+    // are processed in parallel without any locking, and the facets of a band are visited while in cache.
+    // The facets starting inside a band form a continuous range of the sweep, the facets starting below
+    // the band and reaching into it are collected into a short list per band.
+    const FacetsSweep &sweep = m_sweep;
+    const size_t num_facets = sweep.facets.size();
+    const size_t num_layers = z.size();
+    const size_t band_size  = std::max<size_t>(1, (num_layers + 255) / 256);
+    const size_t num_bands  = (num_layers + band_size - 1) / band_size;
+
+    // Range of layers sliced by each facet of the sweep. The first layers are sorted, as the sweep is sorted by minimum Z.
+    std::vector<std::pair<uint32_t, uint32_t>> facets_layers(num_facets);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_facets),
+        [&facets_layers, &sweep, &z](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i) {
+                // first layer whose slice_z is >= min_z
+                auto min_layer = std::lower_bound(z.begin(), z.end(), sweep.min_z[i]);
+                // first layer whose slice_z is > max_z
+                auto max_layer = std::upper_bound(min_layer, z.end(), sweep.max_z[i]);
+                facets_layers[i] = std::make_pair(uint32_t(min_layer - z.begin()), uint32_t(max_layer - z.begin()));
+            }
         }
+    );
+    throw_on_cancel();
+
+    std::vector<size_t>                band_facets_begin(num_bands + 1, num_facets);
+    std::vector<std::vector<uint32_t>> band_facets_crossing(num_bands);
+    for (size_t band_idx = 0; band_idx < num_bands; ++ band_idx)
+        band_facets_begin[band_idx] = std::lower_bound(facets_layers.begin(), facets_layers.end(), band_idx * band_size,
+            [](const std::pair<uint32_t, uint32_t> &layers, size_t layer_idx) { return layers.first < layer_idx; }) - facets_layers.begin();
+    for (size_t i = 0; i < num_facets; ++ i) {
+        const std::pair<uint32_t, uint32_t> &layers = facets_layers[i];
+        if (layers.first < layers.second)
+            for (size_t band_idx = layers.first / band_size + 1; band_idx <= (layers.second - 1) / band_size; ++ band_idx)
+                band_facets_crossing[band_idx].emplace_back(uint32_t(i));
     }
+
+    lines.assign(num_layers, IntersectionLines());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_bands, 1),
+        [&lines, &sweep, &facets_layers, &band_facets_begin, &band_facets_crossing, &z, band_size, num_layers, throw_on_cancel, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t band_idx = range.begin(); band_idx < range.end(); ++ band_idx) {
+                throw_on_cancel();
+                const size_t layer_begin = band_idx * band_size;
+                const size_t layer_end   = std::min(num_layers, layer_begin + band_size);
+                auto slice_sweep_facet = [&](size_t i) {
+                    const std::pair<uint32_t, uint32_t> &layers = facets_layers[i];
+                    this->_slice_do(sweep.facets[i], sweep.min_z[i], sweep.max_z[i], z,
+                        std::max<size_t>(layers.first, layer_begin), std::min<size_t>(layers.second, layer_end),
+                        [&lines](size_t layer_idx, const IntersectionLine &il) { lines[layer_idx].emplace_back(il); });
+                };
+                for (uint32_t i : band_facets_crossing[band_idx])
+                    slice_sweep_facet(i);
+                for (size_t i = band_facets_begin[band_idx]; i < band_facets_begin[band_idx + 1]; ++ i)
+                    slice_sweep_facet(i);
+            }
+        }
+    );
+    throw_on_cancel();
+}
+
+void TriangleMeshSlicer::slice_facets_chunked(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const
+{
+    // The facets are split into chunks, each chunk collects its intersection lines into its own vector,
+    // so the intersection pass runs without any locking. The lines are then distributed into the layers
+    // by a count-then-fill pass, which keeps them in the order of the facets independently of the scheduling.
+    // The mesh not rotated by m_quaternion is sliced in the order of m_sweep, thus the intersection lines of a layer
+    // are ordered the same way as by slice_facets_sweep() and both produce the same slices.
+    const size_t num_facets = this->mesh->stl.stats.number_of_facets;
+    const size_t num_layers = z.size();
+    const size_t chunk_size = std::max<size_t>(256, (num_facets + 255) / 256);
+    const size_t num_chunks = (num_facets + chunk_size - 1) / chunk_size;
+    std::vector<std::vector<std::pair<size_t, IntersectionLine>>> chunk_lines(num_chunks);
+    // Number of lines of a chunk in a layer, later the position of the chunk's first line in the layer.
+    std::vector<uint32_t> chunk_layer_offsets(num_chunks * num_layers, 0);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_chunks, 1),
+        [&chunk_lines, &chunk_layer_offsets, &z, num_facets, num_layers, chunk_size, throw_on_cancel, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t chunk_idx = range.begin(); chunk_idx < range.end(); ++ chunk_idx) {
+                std::vector<std::pair<size_t, IntersectionLine>> &lines = chunk_lines[chunk_idx];
+                for (size_t i = chunk_idx * chunk_size; i < std::min(num_facets, (chunk_idx + 1) * chunk_size); ++ i) {
+                    if ((i & 0x0ffff) == 0)
+                        throw_on_cancel();
+                    size_t facet_idx;
+                    float  min_z, max_z;
+                    if (m_use_quaternion) {
+                        // find facet extents
+                        const stl_facet facet = this->mesh->stl.facet_start[i].rotated(m_quaternion);
+                        facet_idx = i;
+                        min_z     = fminf(facet.vertex[0](2), fminf(facet.vertex[1](2), facet.vertex[2](2)));
+                        max_z     = fmaxf(facet.vertex[0](2), fmaxf(facet.vertex[1](2), facet.vertex[2](2)));
+                    } else {
+                        facet_idx = m_sweep.facets[i];
+                        min_z     = m_sweep.min_z[i];
+                        max_z     = m_sweep.max_z[i];
+                    }
+                    // first layer whose slice_z is >= min_z
+                    auto min_layer = std::lower_bound(z.begin(), z.end(), min_z);
+                    // first layer whose slice_z is > max_z
+                    auto max_layer = std::upper_bound(min_layer, z.end(), max_z);
+                    this->_slice_do(facet_idx, min_z, max_z, z, min_layer - z.begin(), max_layer - z.begin(),
+                        [&lines](size_t layer_idx, const IntersectionLine &il) { lines.emplace_back(layer_idx, il); });
+                }
+                uint32_t *counts = chunk_layer_offsets.data() + chunk_idx * num_layers;
+                for (const std::pair<size_t, IntersectionLine> &line : lines)
+                    ++ counts[line.first];
+            }
+        }
+    );
+    throw_on_cancel();
+
+    lines.assign(num_layers, IntersectionLines());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_layers),
+        [&lines, &chunk_layer_offsets, num_chunks, num_layers](const tbb::blocked_range<size_t>& range) {
+            for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
+                uint32_t offset = 0;
+                for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++ chunk_idx) {
+                    uint32_t &count = chunk_layer_offsets[chunk_idx * num_layers + layer_idx];
+                    uint32_t  next  = offset + count;
+                    count  = offset;
+                    offset = next;
+                }
+                lines[layer_idx].resize(offset);
+            }
+        }
+    );
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_chunks, 1),
+        [&lines, &chunk_lines, &chunk_layer_offsets, num_layers](const tbb::blocked_range<size_t>& range) {
+            for (size_t chunk_idx = range.begin(); chunk_idx < range.end(); ++ chunk_idx) {
+                uint32_t *offsets = chunk_layer_offsets.data() + chunk_idx * num_layers;
+                for (std::pair<size_t, IntersectionLine> &line : chunk_lines[chunk_idx])
+                    lines[line.first][offsets[line.first] ++] = std::move(line.second);
+                chunk_lines[chunk_idx] = std::vector<std::pair<size_t, IntersectionLine>>();
+            }
+        }
+    );
+    throw_on_cancel();
+}
+
+void TriangleMeshSlicer::build_sweep(FacetsSweep &sweep) const
+{
+    const size_t num_facets = this->mesh->stl.stats.number_of_facets;
+    std::vector<std::pair<float, uint32_t>> facets_min_z(num_facets);
+    std::vector<float>                      facets_max_z(num_facets);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_facets),
+        [&facets_min_z, &facets_max_z, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx) {
+                const stl_facet &facet = this->mesh->stl.facet_start[facet_idx];
+                float min_z = fminf(facet.vertex[0](2), fminf(facet.vertex[1](2), facet.vertex[2](2)));
+                float max_z = fmaxf(facet.vertex[0](2), fmaxf(facet.vertex[1](2), facet.vertex[2](2)));
+                if (std::isnan(min_z) || std::isnan(max_z))
+                    // Invalid facet, it will not slice any layer.
+                    min_z = max_z = std::numeric_limits<float>::max();
+                facets_min_z[facet_idx] = std::make_pair(min_z, uint32_t(facet_idx));
+                facets_max_z[facet_idx] = max_z;
+            }
+        }
+    );
+    // Ties are resolved by the facet index, so that the order of the intersection lines is deterministic.
+    tbb::parallel_sort(facets_min_z.begin(), facets_min_z.end());
+    sweep.facets.assign(num_facets, 0);
+    sweep.min_z.assign(num_facets, 0.f);
+    sweep.max_z.assign(num_facets, 0.f);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_facets),
+        [&sweep, &facets_min_z, &facets_max_z](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i) {
+                sweep.facets[i] = facets_min_z[i].second;
+                sweep.min_z[i]  = facets_min_z[i].first;
+                sweep.max_z[i]  = facets_max_z[facets_min_z[i].second];
+            }
+        }
+    );
 }
 
 void TriangleMeshSlicer::slice(const std::vector<float> &z, SlicingMode mode, const float closing_radius, std::vector<ExPolygons>* layers, throw_on_cancel_callback_type throw_on_cancel) const
@@ -176,6 +176,9 @@ class TriangleMeshSlicer
 {
 public:
     typedef std::function<void()> throw_on_cancel_callback_type;
+    // Revision of the slicing algorithm, stored with the slices cached on disk by SliceCache.
+    // Bump it with any change which may change the slices of a mesh, so that the slices of the former revision are not loaded.
+    static constexpr uint32_t revision = 1;
     TriangleMeshSlicer() : mesh(nullptr) {}
 	TriangleMeshSlicer(const TriangleMesh* mesh) { this->init(mesh, [](){}); }
     void init(const TriangleMesh *mesh, throw_on_cancel_callback_type throw_on_cancel);
@@ -201,8 +204,26 @@ private:
     Eigen::Quaternion<float, Eigen::DontAlign> m_quaternion;
     // Whether or not the above quaterion should be used
     bool                     m_use_quaternion = false;
+    // Facets sorted by their minimum Z (ties by the facet index) for the sweep of slice(), stored as structure of arrays.
+    struct FacetsSweep {
+        std::vector<uint32_t> facets;
+        // Minimum and maximum Z of the facets in the sweep order.
+        std::vector<float>    min_z;
+        std::vector<float>    max_z;
+    };
+    // Sweep of the mesh not rotated by m_quaternion, built by init(), so that slicing the same mesh
+    // with multiple lists of layers does not sort the facets again. A rotated mesh is not swept.
+    FacetsSweep              m_sweep;
 
-    void _slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, const std::vector<float> &z) const;
+    void build_sweep(FacetsSweep &sweep) const;
+    // Slice the mesh by sweeping m_sweep in bands of layers, the bands are sliced in parallel.
+    void slice_facets_sweep(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const;
+    // Slice the mesh in parallel over chunks of facets, the facets are rotated by m_quaternion if m_use_quaternion is set.
+    void slice_facets_chunked(const std::vector<float> &z, std::vector<IntersectionLines> &lines, throw_on_cancel_callback_type throw_on_cancel) const;
+    // Slice a single facet with the layers <layer_begin, layer_end), pass the layer index and the intersection line to emit_line.
+    template<typename EmitLine>
+    void _slice_do(size_t facet_idx, float min_z, float max_z, const std::vector<float> &z, size_t layer_begin, size_t layer_end,
+        EmitLine emit_line) const;
     void make_loops(std::vector<IntersectionLine> &lines, Polygons* loops) const;
     void make_expolygons(const Polygons &loops, const float closing_radius, ExPolygons* slices) const;
     void make_expolygons_simple(std::vector<IntersectionLine> &lines, ExPolygons* slices) const;
@@ -19,9 +19,11 @@
 #include "libslic3r/SLAPrint.hpp"
 #include "libslic3r/Utils.hpp"
 #include "libslic3r/GCode/PostProcessor.hpp"
-#if !ENABLE_GCODE_VIEWER
+#if ENABLE_GCODE_VIEWER
+#include "libslic3r/GCode/GCodeIndex.hpp"
+#else
 #include "libslic3r/GCode/PreviewData.hpp"
-#endif // !ENABLE_GCODE_VIEWER
+#endif // ENABLE_GCODE_VIEWER
 #include "libslic3r/Format/SL1.hpp"
 #include "libslic3r/libslic3r.h"
 
@@ -83,6 +85,9 @@ BackgroundSlicingProcess::~BackgroundSlicingProcess()
 	this->stop();
 	this->join_background_thread();
 	boost::nowide::remove(m_temp_output_path.c_str());
+#if ENABLE_GCODE_VIEWER
+	boost::nowide::remove(GCodeIndex::path(m_temp_output_path).c_str());
+#endif // ENABLE_GCODE_VIEWER
 }
 
 bool BackgroundSlicingProcess::select_technology(PrinterTechnology tech)
@@ -157,6 +162,12 @@ void BackgroundSlicingProcess::process_fff()
 				BOOST_LOG_TRIVIAL(warning) << "Unexpected fail code(" << (int)copy_ret_val << ") durring copy_file() to " << export_path << ".";
 				break;
 			}
+#if ENABLE_GCODE_VIEWER
+			if (m_fff_print->config().gcode_binary_index.value &&
+				// The index stores the hash of the G-code, the G-code viewer ignores it if the post-processing scripts modify the G-code.
+				copy_file(GCodeIndex::path(m_temp_output_path), GCodeIndex::path(export_path)) != SUCCESS)
+				BOOST_LOG_TRIVIAL(warning) << "Failed to copy the G-code index to " << GCodeIndex::path(export_path) << ".";
+#endif // ENABLE_GCODE_VIEWER
 			
 	    	m_print->set_status(95, _utf8(L("Running post-processing scripts")));
 	    	run_post_process_scripts(export_path, m_fff_print->config());
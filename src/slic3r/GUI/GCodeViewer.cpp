@@ -101,32 +101,6 @@ void GCodeViewer::IBuffer::reset()
     count = 0;
 }
 
-bool GCodeViewer::Path::matches(const GCodeProcessor::MoveVertex& move) const
-{
-    switch (move.type)
-    {
-    case EMoveType::Tool_change:
-    case EMoveType::Color_change:
-    case EMoveType::Pause_Print:
-    case EMoveType::Custom_GCode:
-    case EMoveType::Retract:
-    case EMoveType::Unretract:
-    case EMoveType::Extrude:
-    {
-        // use rounding to reduce the number of generated paths
-        return type == move.type && role == move.extrusion_role && height == round_to_nearest(move.height, 2) &&
-            width == round_to_nearest(move.width, 2) && feedrate == move.feedrate && fan_speed == move.fan_speed &&
-            volumetric_rate == round_to_nearest(move.volumetric_rate(), 2) && extruder_id == move.extruder_id &&
-            cp_color_id == move.cp_color_id;
-    }
-    case EMoveType::Travel:
-    {
-        return type == move.type && feedrate == move.feedrate && extruder_id == move.extruder_id && cp_color_id == move.cp_color_id;
-    }
-    default: { return false; }
-    }
-}
-
 void GCodeViewer::TBuffer::reset()
 {
     // release gpu memory
@@ -141,15 +115,6 @@ void GCodeViewer::TBuffer::reset()
     render_paths = std::vector<RenderPath>();
 }
 
-void GCodeViewer::TBuffer::add_path(const GCodeProcessor::MoveVertex& move, unsigned int b_id, size_t i_id, size_t s_id)
-{
-    Path::Endpoint endpoint = { b_id, i_id, s_id, move.position };
-    // use rounding to reduce the number of generated paths
-    paths.push_back({ move.type, move.extrusion_role, endpoint, endpoint, move.delta_extruder,
-        round_to_nearest(move.height, 2), round_to_nearest(move.width, 2), move.feedrate, move.fan_speed,
-        round_to_nearest(move.volumetric_rate(), 2), move.extruder_id, move.cp_color_id });
-}
-
 GCodeViewer::Color GCodeViewer::Extrusions::Range::get_color_at(float value) const
 {
     // Input value scaled to the colors range
@@ -901,7 +866,7 @@ void GCodeViewer::load_toolpaths(const GCodeProcessor::Result& gcode_result)
 {
 #if ENABLE_GCODE_VIEWER_STATISTICS
     auto start_time = std::chrono::high_resolution_clock::now();
-    m_statistics.results_size = SLIC3R_STDVEC_MEMSIZE(gcode_result.moves, GCodeProcessor::MoveVertex);
+    m_statistics.results_size = gcode_result.moves.memory_size();
     m_statistics.results_time = gcode_result.time;
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
 
@@ -910,8 +875,6 @@ void GCodeViewer::load_toolpaths(const GCodeProcessor::Result& gcode_result)
     if (m_moves_count == 0)
         return;
 
-    unsigned int progress_count = 0;
-    static const unsigned int progress_threshold = 1000;
     wxProgressDialog* progress_dialog = wxGetApp().is_gcode_viewer() ?
         new wxProgressDialog(_L("Generating toolpaths"), "...",
             100, wxGetApp().plater(), wxPD_AUTO_HIDE | wxPD_APP_MODAL) : nullptr;
@@ -931,549 +894,100 @@ void GCodeViewer::load_toolpaths(const GCodeProcessor::Result& gcode_result)
     m_max_bounding_box = m_paths_bounding_box;
     m_max_bounding_box.merge(m_paths_bounding_box.max + m_sequential_view.marker.get_bounding_box().size()[2] * Vec3d::UnitZ());
 
-    auto log_memory_usage = [this](const std::string& label, const std::vector<std::vector<float>>& vertices, const std::vector<MultiIndexBuffer>& indices) {
-        long long vertices_size = 0;
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            vertices_size += SLIC3R_STDVEC_MEMSIZE(vertices[i], float);
-        }
-        long long indices_size = 0;
-        for (size_t i = 0; i < indices.size(); ++i) {
-            for (size_t j = 0; j < indices[i].size(); ++j) {
-                indices_size += SLIC3R_STDVEC_MEMSIZE(indices[i][j], unsigned int);
-            }
-        }
-        log_memory_used(label, vertices_size + indices_size);
-    };
-
-    // format data into the buffers to be rendered as points
-    auto add_vertices_as_point = [](const GCodeProcessor::MoveVertex& curr, std::vector<float>& buffer_vertices) {
-        for (int j = 0; j < 3; ++j) {
-            buffer_vertices.push_back(curr.position[j]);
-        }
-    };
-    auto add_indices_as_point = [](const GCodeProcessor::MoveVertex& curr, TBuffer& buffer,
-        unsigned int index_buffer_id, IndexBuffer& buffer_indices, size_t move_id) {
-            buffer.add_path(curr, index_buffer_id, buffer_indices.size(), move_id);
-            buffer_indices.push_back(static_cast<unsigned int>(buffer_indices.size()));
-    };
-
-    // format data into the buffers to be rendered as lines
-    auto add_vertices_as_line = [](const GCodeProcessor::MoveVertex& prev, const GCodeProcessor::MoveVertex& curr,
-        TBuffer& buffer, std::vector<float>& buffer_vertices) {
-            // x component of the normal to the current segment (the normal is parallel to the XY plane)
-            float normal_x = (curr.position - prev.position).normalized()[1];
-
-            auto add_vertex = [&buffer_vertices, normal_x](const GCodeProcessor::MoveVertex& vertex) {
-                // add position
-                for (int j = 0; j < 3; ++j) {
-                    buffer_vertices.push_back(vertex.position[j]);
-                }
-                // add normal x component
-                buffer_vertices.push_back(normal_x);
-            };
-
-            // add previous vertex
-            add_vertex(prev);
-            // add current vertex
-            add_vertex(curr);
-    };
-    auto add_indices_as_line = [](const GCodeProcessor::MoveVertex& prev, const GCodeProcessor::MoveVertex& curr, TBuffer& buffer,
-        unsigned int index_buffer_id, IndexBuffer& buffer_indices, size_t move_id) {
-            // x component of the normal to the current segment (the normal is parallel to the XY plane)
-            float normal_x = (curr.position - prev.position).normalized()[1];
-
-            if (prev.type != curr.type || !buffer.paths.back().matches(curr)) {
-                // add starting index
-                buffer_indices.push_back(static_cast<unsigned int>(buffer_indices.size()));
-                buffer.add_path(curr, index_buffer_id, buffer_indices.size() - 1, move_id - 1);
-                buffer.paths.back().first.position = prev.position;
-            }
-
-            Path& last_path = buffer.paths.back();
-            if (last_path.first.i_id != last_path.last.i_id) {
-                // add previous index
-                buffer_indices.push_back(static_cast<unsigned int>(buffer_indices.size()));
-            }
-
-            // add current index
-            buffer_indices.push_back(static_cast<unsigned int>(buffer_indices.size()));
-            last_path.last = { index_buffer_id, buffer_indices.size() - 1, move_id, curr.position };
-    };
-
-    // format data into the buffers to be rendered as solid
-    auto add_vertices_as_solid = [](const GCodeProcessor::MoveVertex& prev, const GCodeProcessor::MoveVertex& curr, TBuffer& buffer,
-        std::vector<float>& buffer_vertices, size_t move_id) {
-            static Vec3f prev_dir;
-            static Vec3f prev_up;
-            static float prev_length;
-            auto store_vertex = [](std::vector<float>& buffer_vertices, const Vec3f& position, const Vec3f& normal) {
-                // append position
-                for (int j = 0; j < 3; ++j) {
-                    buffer_vertices.push_back(position[j]);
-                }
-                // append normal
-                for (int j = 0; j < 3; ++j) {
-                    buffer_vertices.push_back(normal[j]);
-                }
-            };
-            auto extract_position_at = [](const std::vector<float>& vertices, size_t id) {
-                return Vec3f(vertices[id + 0], vertices[id + 1], vertices[id + 2]);
-            };
-            auto update_position_at = [](std::vector<float>& vertices, size_t id, const Vec3f& position) {
-                vertices[id + 0] = position[0];
-                vertices[id + 1] = position[1];
-                vertices[id + 2] = position[2];
-            };
-
-            if (prev.type != curr.type || !buffer.paths.back().matches(curr)) {
-                buffer.add_path(curr, 0, 0, move_id - 1);
-                buffer.paths.back().first.position = prev.position;
-            }
-
-            unsigned int starting_vertices_size = static_cast<unsigned int>(buffer_vertices.size() / buffer.vertices.vertex_size_floats());
-
-            Vec3f dir = (curr.position - prev.position).normalized();
-            Vec3f right = (std::abs(std::abs(dir.dot(Vec3f::UnitZ())) - 1.0f) < EPSILON) ? -Vec3f::UnitY() : Vec3f(dir[1], -dir[0], 0.0f).normalized();
-            Vec3f left = -right;
-            Vec3f up = right.cross(dir);
-            Vec3f down = -up;
-
-            Path& last_path = buffer.paths.back();
-
-            float half_width = 0.5f * last_path.width;
-            float half_height = 0.5f * last_path.height;
-
-            Vec3f prev_pos = prev.position - half_height * up;
-            Vec3f curr_pos = curr.position - half_height * up;
-
-            float length = (curr_pos - prev_pos).norm();
-            if (last_path.vertices_count() == 1) {
-                // 1st segment
-
-                // vertices 1st endpoint
-                store_vertex(buffer_vertices, prev_pos + half_height * up, up);
-                store_vertex(buffer_vertices, prev_pos + half_width * right, right);
-                store_vertex(buffer_vertices, prev_pos + half_height * down, down);
-                store_vertex(buffer_vertices, prev_pos + half_width * left, left);
-
-                // vertices 2nd endpoint
-                store_vertex(buffer_vertices, curr_pos + half_height * up, up);
-                store_vertex(buffer_vertices, curr_pos + half_width * right, right);
-                store_vertex(buffer_vertices, curr_pos + half_height * down, down);
-                store_vertex(buffer_vertices, curr_pos + half_width * left, left);
-            }
-            else {
-                // any other segment
-                float displacement = 0.0f;
-                float cos_dir = prev_dir.dot(dir);
-                if (cos_dir > -0.9998477f) {
-                    // if the angle between adjacent segments is smaller than 179 degrees
-                    Vec3f med_dir = (prev_dir + dir).normalized();
-                    displacement = half_width * ::tan(::acos(std::clamp(dir.dot(med_dir), -1.0f, 1.0f)));
-                }
-
-                Vec3f displacement_vec = displacement * prev_dir;
-                bool can_displace = displacement > 0.0f && displacement < prev_length&& displacement < length;
-
-                size_t prev_right_id = (starting_vertices_size - 3) * buffer.vertices.vertex_size_floats();
-                size_t prev_left_id = (starting_vertices_size - 1) * buffer.vertices.vertex_size_floats();
-                Vec3f prev_right_pos = extract_position_at(buffer_vertices, prev_right_id);
-                Vec3f prev_left_pos = extract_position_at(buffer_vertices, prev_left_id);
-
-                bool is_right_turn = prev_up.dot(prev_dir.cross(dir)) <= 0.0f;
-                // whether the angle between adjacent segments is greater than 45 degrees
-                bool is_sharp = cos_dir < 0.7071068f;
-
-                bool right_displaced = false;
-                bool left_displaced = false;
-
-                // displace the vertex (inner with respect to the corner) of the previous segment 2nd enpoint, if possible
-                if (can_displace) {
-                    if (is_right_turn) {
-                        prev_right_pos -= displacement_vec;
-                        update_position_at(buffer_vertices, prev_right_id, prev_right_pos);
-                        right_displaced = true;
-                    }
-                    else {
-                        prev_left_pos -= displacement_vec;
-                        update_position_at(buffer_vertices, prev_left_id, prev_left_pos);
-                        left_displaced = true;
-                    }
-                }
-
-                if (!is_sharp) {
-                    // displace the vertex (outer with respect to the corner) of the previous segment 2nd enpoint, if possible
-                    if (can_displace) {
-                        if (is_right_turn) {
-                            prev_left_pos += displacement_vec;
-                            update_position_at(buffer_vertices, prev_left_id, prev_left_pos);
-                            left_displaced = true;
-                        }
-                        else {
-                            prev_right_pos += displacement_vec;
-                            update_position_at(buffer_vertices, prev_right_id, prev_right_pos);
-                            right_displaced = true;
-                        }
-                    }
-
-                    // vertices 1st endpoint (top and bottom are from previous segment 2nd endpoint)
-                    // vertices position matches that of the previous segment 2nd endpoint, if displaced
-                    store_vertex(buffer_vertices, right_displaced ? prev_right_pos : prev_pos + half_width * right, right);
-                    store_vertex(buffer_vertices, left_displaced ? prev_left_pos : prev_pos + half_width * left, left);
-                }
-                else {
-                    // vertices 1st endpoint (top and bottom are from previous segment 2nd endpoint)
-                    // the inner corner vertex position matches that of the previous segment 2nd endpoint, if displaced
-                    if (is_right_turn) {
-                        store_vertex(buffer_vertices, right_displaced ? prev_right_pos : prev_pos + half_width * right, right);
-                        store_vertex(buffer_vertices, prev_pos + half_width * left, left);
-                    }
-                    else {
-                        store_vertex(buffer_vertices, prev_pos + half_width * right, right);
-                        store_vertex(buffer_vertices, left_displaced ? prev_left_pos : prev_pos + half_width * left, left);
-                    }
-                }
-
-                // vertices 2nd endpoint
-                store_vertex(buffer_vertices, curr_pos + half_height * up, up);
-                store_vertex(buffer_vertices, curr_pos + half_width * right, right);
-                store_vertex(buffer_vertices, curr_pos + half_height * down, down);
-                store_vertex(buffer_vertices, curr_pos + half_width * left, left);
-            }
-
-            last_path.last = { 0, 0, move_id, curr.position };
-            prev_dir = dir;
-            prev_up = up;
-            prev_length = length;
-    };
-    auto add_indices_as_solid = [](const GCodeProcessor::MoveVertex& prev, const GCodeProcessor::MoveVertex& curr, TBuffer& buffer,
-        size_t& buffer_vertices_size, unsigned int index_buffer_id, IndexBuffer& buffer_indices, size_t move_id) {
-            static Vec3f prev_dir;
-            static Vec3f prev_up;
-            static float prev_length;
-            auto store_triangle = [](IndexBuffer& buffer_indices, unsigned int i1, unsigned int i2, unsigned int i3) {
-                buffer_indices.push_back(i1);
-                buffer_indices.push_back(i2);
-                buffer_indices.push_back(i3);
-            };
-            auto append_dummy_cap = [store_triangle](IndexBuffer& buffer_indices, unsigned int id) {
-                store_triangle(buffer_indices, id, id, id);
-                store_triangle(buffer_indices, id, id, id);
-            };
-
-            if (prev.type != curr.type || !buffer.paths.back().matches(curr)) {
-                buffer.add_path(curr, index_buffer_id, buffer_indices.size(), move_id - 1);
-                buffer.paths.back().first.position = prev.position;
-            }
-
-            unsigned int starting_vertices_size = static_cast<unsigned int>(buffer_vertices_size);
-
-            Vec3f dir = (curr.position - prev.position).normalized();
-            Vec3f right = (std::abs(std::abs(dir.dot(Vec3f::UnitZ())) - 1.0f) < EPSILON) ? -Vec3f::UnitY() : Vec3f(dir[1], -dir[0], 0.0f).normalized();
-            Vec3f up = right.cross(dir);
-
-            Path& last_path = buffer.paths.back();
-
-            float half_width = 0.5f * last_path.width;
-            float half_height = 0.5f * last_path.height;
-
-            Vec3f prev_pos = prev.position - half_height * up;
-            Vec3f curr_pos = curr.position - half_height * up;
-
-            float length = (curr_pos - prev_pos).norm();
-            if (last_path.vertices_count() == 1) {
-                // 1st segment
-                buffer_vertices_size += 8;
-
-                // triangles starting cap
-                store_triangle(buffer_indices, starting_vertices_size + 0, starting_vertices_size + 2, starting_vertices_size + 1);
-                store_triangle(buffer_indices, starting_vertices_size + 0, starting_vertices_size + 3, starting_vertices_size + 2);
-
-                // dummy triangles outer corner cap
-                append_dummy_cap(buffer_indices, starting_vertices_size);
-
-                // triangles sides
-                store_triangle(buffer_indices, starting_vertices_size + 0, starting_vertices_size + 1, starting_vertices_size + 4);
-                store_triangle(buffer_indices, starting_vertices_size + 1, starting_vertices_size + 5, starting_vertices_size + 4);
-                store_triangle(buffer_indices, starting_vertices_size + 1, starting_vertices_size + 2, starting_vertices_size + 5);
-                store_triangle(buffer_indices, starting_vertices_size + 2, starting_vertices_size + 6, starting_vertices_size + 5);
-                store_triangle(buffer_indices, starting_vertices_size + 2, starting_vertices_size + 3, starting_vertices_size + 6);
-                store_triangle(buffer_indices, starting_vertices_size + 3, starting_vertices_size + 7, starting_vertices_size + 6);
-                store_triangle(buffer_indices, starting_vertices_size + 3, starting_vertices_size + 0, starting_vertices_size + 7);
-                store_triangle(buffer_indices, starting_vertices_size + 0, starting_vertices_size + 4, starting_vertices_size + 7);
-
-                // triangles ending cap
-                store_triangle(buffer_indices, starting_vertices_size + 4, starting_vertices_size + 6, starting_vertices_size + 7);
-                store_triangle(buffer_indices, starting_vertices_size + 4, starting_vertices_size + 5, starting_vertices_size + 6);
-            }
-            else {
-                // any other segment
-                float displacement = 0.0f;
-                float cos_dir = prev_dir.dot(dir);
-                if (cos_dir > -0.9998477f) {
-                    // if the angle between adjacent segments is smaller than 179 degrees
-                    Vec3f med_dir = (prev_dir + dir).normalized();
-                    displacement = half_width * ::tan(::acos(std::clamp(dir.dot(med_dir), -1.0f, 1.0f)));
-                }
-
-                Vec3f displacement_vec = displacement * prev_dir;
-                bool can_displace = displacement > 0.0f && displacement < prev_length && displacement < length;
-
-                bool is_right_turn = prev_up.dot(prev_dir.cross(dir)) <= 0.0f;
-                // whether the angle between adjacent segments is greater than 45 degrees
-                bool is_sharp = cos_dir < 0.7071068f;
-
-                bool right_displaced = false;
-                bool left_displaced = false;
-
-                if (!is_sharp) {
-                    if (can_displace) {
-                        if (is_right_turn)
-                            left_displaced = true;
-                        else
-                            right_displaced = true;
-                    }
-                }
-
-                buffer_vertices_size += 6;
-
-                // triangles starting cap
-                store_triangle(buffer_indices, starting_vertices_size - 4, starting_vertices_size - 2, starting_vertices_size + 0);
-                store_triangle(buffer_indices, starting_vertices_size - 4, starting_vertices_size + 1, starting_vertices_size - 2);
-
-                // triangles outer corner cap
-                if (is_right_turn) {
-                    if (left_displaced)
-                        // dummy triangles
-                        append_dummy_cap(buffer_indices, starting_vertices_size);
-                    else {
-                        store_triangle(buffer_indices, starting_vertices_size - 4, starting_vertices_size + 1, starting_vertices_size - 1);
-                        store_triangle(buffer_indices, starting_vertices_size + 1, starting_vertices_size - 2, starting_vertices_size - 1);
-                    }
-                }
-                else {
-                    if (right_displaced)
-                        // dummy triangles
-                        append_dummy_cap(buffer_indices, starting_vertices_size);
-                    else {
-                        store_triangle(buffer_indices, starting_vertices_size - 4, starting_vertices_size - 3, starting_vertices_size + 0);
-                        store_triangle(buffer_indices, starting_vertices_size - 3, starting_vertices_size - 2, starting_vertices_size + 0);
-                    }
-                }
-
-                // triangles sides
-                store_triangle(buffer_indices, starting_vertices_size - 4, starting_vertices_size + 0, starting_vertices_size + 2);
-                store_triangle(buffer_indices, starting_vertices_size + 0, starting_vertices_size + 3, starting_vertices_size + 2);
-                store_triangle(buffer_indices, starting_vertices_size + 0, starting_vertices_size - 2, starting_vertices_size + 3);
-                store_triangle(buffer_indices, starting_vertices_size - 2, starting_vertices_size + 4, starting_vertices_size + 3);
-                store_triangle(buffer_indices, starting_vertices_size - 2, starting_vertices_size + 1, starting_vertices_size + 4);
-                store_triangle(buffer_indices, starting_vertices_size + 1, starting_vertices_size + 5, starting_vertices_size + 4);
-                store_triangle(buffer_indices, starting_vertices_size + 1, starting_vertices_size - 4, starting_vertices_size + 5);
-                store_triangle(buffer_indices, starting_vertices_size - 4, starting_vertices_size + 2, starting_vertices_size + 5);
-
-                // triangles ending cap
-                store_triangle(buffer_indices, starting_vertices_size + 2, starting_vertices_size + 4, starting_vertices_size + 5);
-                store_triangle(buffer_indices, starting_vertices_size + 2, starting_vertices_size + 3, starting_vertices_size + 4);
-            }
-
-            last_path.last = { index_buffer_id, buffer_indices.size() - 1, move_id, curr.position };
-            prev_dir = dir;
-            prev_up = up;
-            prev_length = length;
-    };
-
     wxBusyCursor busy;
 
-    // to reduce the peak in memory usage, we split the generation of the vertex and index buffers in two steps.
-    // the data are deleted as soon as they are sent to the gpu.
-    std::vector<std::vector<float>> vertices(m_buffers.size());
-    std::vector<MultiIndexBuffer> indices(m_buffers.size());
-
-    // toolpaths data -> extract vertices from result
-    for (size_t i = 0; i < m_moves_count; ++i) {
-        // skip first vertex
-        if (i == 0)
-            continue;
-
-        ++progress_count;
-        if (progress_dialog != nullptr && progress_count % progress_threshold == 0) {
-            progress_dialog->Update(int(100.0f * float(i) / (2.0f * float(m_moves_count))),
-                _L("Generating vertex buffer") + ": " + wxNumberFormatter::ToString(100.0 * double(i) / double(m_moves_count), 0, wxNumberFormatter::Style_None) + "%");
-            progress_dialog->Fit();
-            progress_count = 0;
-        }
-
-        const GCodeProcessor::MoveVertex& prev = gcode_result.moves[i - 1];
-        const GCodeProcessor::MoveVertex& curr = gcode_result.moves[i];
-
-        unsigned char id = buffer_id(curr.type);
-        TBuffer& buffer = m_buffers[id];
-        std::vector<float>& buffer_vertices = vertices[id];
-
-        switch (buffer.render_primitive_type)
-        {
-        case TBuffer::ERenderPrimitiveType::Point:
-        {
-            add_vertices_as_point(curr, buffer_vertices);
-            break;
-        }
-        case TBuffer::ERenderPrimitiveType::Line:
-        {
-            add_vertices_as_line(prev, curr, buffer, buffer_vertices);
-            break;
-        }
-        case TBuffer::ERenderPrimitiveType::Triangle:
-        {
-            add_vertices_as_solid(prev, curr, buffer, buffer_vertices, i);
-            break;
-        }
-        }
+    if (progress_dialog != nullptr) {
+        progress_dialog->Update(0, _L("Generating vertex and index buffers") + "...");
+        progress_dialog->Fit();
     }
 
-    log_memory_usage("Loaded G-code generated vertex buffers, ", vertices, indices);
+    // toolpaths data -> count vertices and indices and extract paths from result, in batches of moves processed in parallel
+    ToolpathGeometry geometry;
+    geometry.build(gcode_result.moves);
 
-    // toolpaths data -> send vertices data to gpu
+    // toolpaths data -> allocate gpu buffers
     for (size_t i = 0; i < m_buffers.size(); ++i) {
         TBuffer& buffer = m_buffers[i];
+        ToolpathGeometry::Buffer& geometry_buffer = geometry.buffers()[i];
+        assert(geometry_buffer.vertex_size_floats() == buffer.vertices.vertex_size_floats());
+        assert(geometry_buffer.indices_per_segment() == buffer.indices_per_segment());
 
-        const std::vector<float>& buffer_vertices = vertices[i];
-        buffer.vertices.count = buffer_vertices.size() / buffer.vertices.vertex_size_floats();
+        buffer.vertices.count = geometry_buffer.vertices_count;
 #if ENABLE_GCODE_VIEWER_STATISTICS
-        m_statistics.vertices_gpu_size += buffer_vertices.size() * sizeof(float);
+        m_statistics.vertices_gpu_size += buffer.vertices.data_size_bytes();
         m_statistics.max_vertices_in_vertex_buffer = std::max(m_statistics.max_vertices_in_vertex_buffer, static_cast<long long>(buffer.vertices.count));
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
 
         glsafe(::glGenBuffers(1, &buffer.vertices.id));
         glsafe(::glBindBuffer(GL_ARRAY_BUFFER, buffer.vertices.id));
-        glsafe(::glBufferData(GL_ARRAY_BUFFER, buffer_vertices.size() * sizeof(float), buffer_vertices.data(), GL_STATIC_DRAW));
+        glsafe(::glBufferData(GL_ARRAY_BUFFER, buffer.vertices.data_size_bytes(), nullptr, GL_STATIC_DRAW));
         glsafe(::glBindBuffer(GL_ARRAY_BUFFER, 0));
-    }
-
-    // dismiss vertices data, no more needed
-    std::vector<std::vector<float>>().swap(vertices);
-
-    // toolpaths data -> extract indices from result
-    // ensure that at least one index buffer is defined for each multibuffer
-    for (auto i : indices) {
-        i.push_back(IndexBuffer());
-    }
-    // paths may have been filled while extracting vertices,
-    // so reset them, they will be filled again while extracting indices
-    for (TBuffer& buffer : m_buffers) {
-        buffer.paths.clear();
-    }
-    // variable used to keep track of the current size (in vertices) of the vertex buffer
-    size_t curr_buffer_vertices_size = 0;
-    for (size_t i = 0; i < m_moves_count; ++i) {
-        // skip first vertex
-        if (i == 0)
-            continue;
-
-        ++progress_count;
-        if (progress_dialog != nullptr && progress_count % progress_threshold == 0) {
-            progress_dialog->Update(int(100.0f * float(m_moves_count + i) / (2.0f * float(m_moves_count))),
-                _L("Generating index buffers") + ": " + wxNumberFormatter::ToString(100.0 * double(i) / double(m_moves_count), 0, wxNumberFormatter::Style_None) + "%");
-            progress_dialog->Fit();
-            progress_count = 0;
-        }
-
-        const GCodeProcessor::MoveVertex& prev = gcode_result.moves[i - 1];
-        const GCodeProcessor::MoveVertex& curr = gcode_result.moves[i];
-
-        unsigned char id = buffer_id(curr.type);
-        TBuffer& buffer = m_buffers[id];
-        MultiIndexBuffer& buffer_indices = indices[id];
-        if (buffer_indices.empty())
-            buffer_indices.push_back(IndexBuffer());
-
-        static const size_t THRESHOLD = 1024 * 1024 * 128;
-        // if adding the indices for the current segment exceeds the threshold size of the current index buffer
-        // create another index buffer, and move the current path indices into it
-        if (buffer_indices.back().size() >= THRESHOLD - static_cast<size_t>(buffer.indices_per_segment())) {
-            buffer_indices.push_back(IndexBuffer());
-            if (curr.type == EMoveType::Extrude || curr.type == EMoveType::Travel) {
-                if (!(prev.type != curr.type || !buffer.paths.back().matches(curr))) {
-                    Path& last_path = buffer.paths.back();
-                    size_t delta_id = last_path.last.i_id - last_path.first.i_id;
-
-                    // move indices of the last path from the previous into the new index buffer
-                    IndexBuffer& src_buffer = buffer_indices[buffer_indices.size() - 2];
-                    IndexBuffer& dst_buffer = buffer_indices[buffer_indices.size() - 1];
-                    std::move(src_buffer.begin() + last_path.first.i_id, src_buffer.end(), std::back_inserter(dst_buffer));
-                    src_buffer.erase(src_buffer.begin() + last_path.first.i_id, src_buffer.end());
-
-                    // updates path indices
-                    last_path.first.b_id = buffer_indices.size() - 1;
-                    last_path.first.i_id = 0;
-                    last_path.last.b_id = buffer_indices.size() - 1;
-                    last_path.last.i_id = delta_id;
-                }
-            }
-        }
-
-        switch (buffer.render_primitive_type)
-        {
-        case TBuffer::ERenderPrimitiveType::Point:
-        {
-            add_indices_as_point(curr, buffer, static_cast<unsigned int>(buffer_indices.size()) - 1, buffer_indices.back(), i);
-            break;
-        }
-        case TBuffer::ERenderPrimitiveType::Line:
-        {
-            add_indices_as_line(prev, curr, buffer, static_cast<unsigned int>(buffer_indices.size()) - 1, buffer_indices.back(), i);
-            break;
-        }
-        case TBuffer::ERenderPrimitiveType::Triangle:
-        {
-            add_indices_as_solid(prev, curr, buffer, curr_buffer_vertices_size, static_cast<unsigned int>(buffer_indices.size()) - 1, buffer_indices.back(), i);
-            break;
-        }
-        }
-    }
-
-    log_memory_usage("Loaded G-code generated indices buffers, ", vertices, indices);
-
-    // toolpaths data -> send indices data to gpu
-    for (size_t i = 0; i < m_buffers.size(); ++i) {
-        TBuffer& buffer = m_buffers[i];
 
-        for (size_t j = 0; j < indices[i].size(); ++j) {
-            const IndexBuffer& buffer_indices = indices[i][j];
+        for (size_t count : geometry_buffer.index_buffers_sizes) {
             buffer.indices.push_back(IBuffer());
             IBuffer& ibuffer = buffer.indices.back();
-            ibuffer.count = buffer_indices.size();
+            ibuffer.count = count;
 #if ENABLE_GCODE_VIEWER_STATISTICS
             m_statistics.indices_gpu_size += ibuffer.count * sizeof(unsigned int);
             m_statistics.max_indices_in_index_buffer = std::max(m_statistics.max_indices_in_index_buffer, static_cast<long long>(ibuffer.count));
+            if (buffer_type(i) == EMoveType::Travel)
+                m_statistics.travel_segments_count = ibuffer.count / buffer.indices_per_segment();
+            else if (buffer_type(i) == EMoveType::Extrude)
+                m_statistics.extrude_segments_count = ibuffer.count / buffer.indices_per_segment();
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
 
             if (ibuffer.count > 0) {
                 glsafe(::glGenBuffers(1, &ibuffer.id));
                 glsafe(::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibuffer.id));
-                glsafe(::glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffer_indices.size() * sizeof(unsigned int), buffer_indices.data(), GL_STATIC_DRAW));
+                glsafe(::glBufferData(GL_ELEMENT_ARRAY_BUFFER, ibuffer.count * sizeof(unsigned int), nullptr, GL_STATIC_DRAW));
                 glsafe(::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
             }
         }
-    }
 
+        buffer.paths = std::move(geometry_buffer.paths);
 #if ENABLE_GCODE_VIEWER_STATISTICS
-    for (const TBuffer& buffer : m_buffers) {
         m_statistics.paths_size += SLIC3R_STDVEC_MEMSIZE(buffer.paths, Path);
-    }
-    unsigned int travel_buffer_id = buffer_id(EMoveType::Travel);
-    const MultiIndexBuffer& travel_buffer_indices = indices[travel_buffer_id];
-    for (size_t i = 0; i < travel_buffer_indices.size(); ++i) {
-        m_statistics.travel_segments_count = travel_buffer_indices[i].size() / m_buffers[travel_buffer_id].indices_per_segment();
-    }
-    unsigned int extrude_buffer_id = buffer_id(EMoveType::Extrude);
-    const MultiIndexBuffer& extrude_buffer_indices = indices[extrude_buffer_id];
-    for (size_t i = 0; i < extrude_buffer_indices.size(); ++i) {
-        m_statistics.extrude_segments_count = extrude_buffer_indices[i].size() / m_buffers[extrude_buffer_id].indices_per_segment();
-    }
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
+    }
+
+    // toolpaths data -> generate vertices and indices and send them to gpu
+    // to reduce the peak in memory usage, the data is generated for a window of batches at a time and deleted as soon as it is sent to the gpu
+    static const size_t batches_window = 32;
+    long long max_memory_used = 0;
+    for (size_t begin = 0; begin < geometry.batches_count(); begin += batches_window) {
+        size_t end = std::min(begin + batches_window, geometry.batches_count());
+        geometry.generate(gcode_result.moves, begin, end);
+        max_memory_used = std::max(max_memory_used, static_cast<long long>(geometry.memory_size()));
+
+        for (size_t i = 0; i < m_buffers.size(); ++i) {
+            TBuffer& buffer = m_buffers[i];
+            ToolpathGeometry::Buffer& geometry_buffer = geometry.buffers()[i];
+            if (!geometry_buffer.vertex_blocks.empty()) {
+                glsafe(::glBindBuffer(GL_ARRAY_BUFFER, buffer.vertices.id));
+                for (ToolpathGeometry::VertexBlock& block : geometry_buffer.vertex_blocks) {
+                    glsafe(::glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(block.first_vertex_id * buffer.vertices.vertex_size_bytes()),
+                        static_cast<GLsizeiptr>(block.vertices.size() * sizeof(float)), block.vertices.data()));
+                    std::vector<float>().swap(block.vertices);
+                }
+                glsafe(::glBindBuffer(GL_ARRAY_BUFFER, 0));
+            }
 
-    // dismiss indices data, no more needed
-    std::vector<MultiIndexBuffer>().swap(indices);
+            for (ToolpathGeometry::IndexBlock& block : geometry_buffer.index_blocks) {
+                glsafe(::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indices[block.index_buffer_id].id));
+                glsafe(::glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(block.first_index_id * sizeof(unsigned int)),
+                    static_cast<GLsizeiptr>(block.indices.size() * sizeof(unsigned int)), block.indices.data()));
+                IndexBuffer().swap(block.indices);
+            }
+            glsafe(::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+        }
+
+        if (progress_dialog != nullptr) {
+            progress_dialog->Update(int(100.0f * float(end) / float(geometry.batches_count())),
+                _L("Generating vertex and index buffers") + ": " + wxNumberFormatter::ToString(100.0 * double(end) / double(geometry.batches_count()), 0, wxNumberFormatter::Style_None) + "%");
+            progress_dialog->Fit();
+        }
+    }
+    log_memory_used("Loaded G-code generated vertex and index buffers, ", max_memory_used);
 
     // layers zs / roles / extruder ids / cp color ids -> extract from result
     for (size_t i = 0; i < m_moves_count; ++i) {
@@ -1516,7 +1030,7 @@ void GCodeViewer::load_toolpaths(const GCodeProcessor::Result& gcode_result)
     m_extruder_ids.erase(std::unique(m_extruder_ids.begin(), m_extruder_ids.end()), m_extruder_ids.end());
     m_extruder_ids.shrink_to_fit();
 
-    log_memory_usage("Loaded G-code generated extrusion paths, ", vertices, indices);
+    log_memory_used("Loaded G-code generated extrusion paths, ");
 
 #if ENABLE_GCODE_VIEWER_STATISTICS
     m_statistics.load_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count();
@@ -4,6 +4,7 @@
 #if ENABLE_GCODE_VIEWER
 #include "3DScene.hpp"
 #include "libslic3r/GCode/GCodeProcessor.hpp"
+#include "libslic3r/GCode/ToolpathGeometry.hpp"
 #include "GLModel.hpp"
 
 #include <float.h>
@@ -111,36 +112,7 @@ class GCodeViewer
     };
 
     // Used to identify different toolpath sub-types inside a IBuffer
-    struct Path
-    {
-        struct Endpoint
-        {
-            // index of the index buffer
-            unsigned int b_id{ 0 };
-            // index into the index buffer
-            size_t i_id{ 0 };
-            // sequential id (index into the vertex buffer)
-            size_t s_id{ 0 };
-            Vec3f position{ Vec3f::Zero() };
-        };
-
-        EMoveType type{ EMoveType::Noop };
-        ExtrusionRole role{ erNone };
-        Endpoint first;
-        Endpoint last;
-        float delta_extruder{ 0.0f };
-        float height{ 0.0f };
-        float width{ 0.0f };
-        float feedrate{ 0.0f };
-        float fan_speed{ 0.0f };
-        float volumetric_rate{ 0.0f };
-        unsigned char extruder_id{ 0 };
-        unsigned char cp_color_id{ 0 };
-
-        bool matches(const GCodeProcessor::MoveVertex& move) const;
-        size_t vertices_count() const { return last.s_id - first.s_id + 1; }
-        bool contains(size_t id) const { return first.s_id <= id && id <= last.s_id; }
-    };
+    using Path = ToolpathGeometry::Path;
 
     // Used to batch the indices needed to render paths
     struct RenderPath
@@ -172,10 +144,6 @@ class GCodeViewer
         bool visible{ false };
 
         void reset();
-        // b_id index of buffer contained in this->indices
-        // i_id index of first index contained in this->indices[b_id]
-        // s_id index of first vertex contained in this->vertices
-        void add_path(const GCodeProcessor::MoveVertex& move, unsigned int b_id, size_t i_id, size_t s_id);
         unsigned int indices_per_segment() const {
             switch (render_primitive_type)
             {
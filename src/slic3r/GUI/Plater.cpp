@@ -1835,6 +1835,8 @@ Plater::priv::priv(Plater *q, MainFrame *main_frame)
     background_process.set_sla_print(&sla_print);
 #if ENABLE_GCODE_VIEWER
     background_process.set_gcode_result(&gcode_result);
+    // the print is exported repeatedly while editing, resume the G-code processing from the last unchanged layer if enabled in the preferences
+    fff_print.gcode_processor_checkpoints().set_enabled(wxGetApp().app_config->get("gcode_processor_checkpoints") == "1");
 #else
     background_process.set_gcode_preview_data(&gcode_preview_data);
 #endif // ENABLE_GCODE_VIEWER
@@ -2144,6 +2146,15 @@ void Plater::priv::update_ui_from_settings()
     preview->get_canvas3d()->update_ui_from_settings();
 
     sidebar->update_ui_from_settings();
+
+#if ENABLE_GCODE_VIEWER
+    bool checkpoints = wxGetApp().app_config->get("gcode_processor_checkpoints") == "1";
+    if (fff_print.gcode_processor_checkpoints().is_enabled() != checkpoints) {
+        // The checkpoints are taken and restored by the G-code export running in the background thread.
+        background_process.stop();
+        fff_print.gcode_processor_checkpoints().set_enabled(checkpoints);
+    }
+#endif // ENABLE_GCODE_VIEWER
 }
 
 // Called after the print technology was changed.
@@ -4671,11 +4682,13 @@ void Plater::load_gcode(const wxString& filename)
 
     wxBusyCursor wait;
 
-    // process gcode
+    // load the index written with the gcode, if any, otherwise process the gcode
     GCodeProcessor processor;
-    processor.enable_producers(true);
-    processor.enable_machine_envelope_processing(true);
-    processor.process_file(filename.ToUTF8().data());
+    if (! processor.load_index(filename.ToUTF8().data())) {
+        processor.enable_producers(true);
+        processor.enable_machine_envelope_processing(true);
+        processor.process_file(filename.ToUTF8().data());
+    }
     p->gcode_result = std::move(processor.extract_result());
 
     // show results
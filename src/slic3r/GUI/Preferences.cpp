@@ -73,6 +73,14 @@ void PreferencesDialog::build()
 		option = Option(def, "background_processing");
 		m_optgroup_general->append_single_option_line(option);
 
+		def.label = L("Resume G-code processing of repeated exports");
+		def.type = coBool;
+		def.tooltip = L("If this is enabled, the G-code of the last export is analyzed again only from the first changed layer. "
+			"This speeds up the repeated exports of large prints, but the kept state takes about as much memory as the G-code preview.");
+		def.set_default_value(new ConfigOptionBool{ app_config->get("gcode_processor_checkpoints") == "1" });
+		option = Option(def, "gcode_processor_checkpoints");
+		m_optgroup_general->append_single_option_line(option);
+
 		// Please keep in sync with ConfigWizard
 		def.label = L("Check for application updates");
 		def.type = coBool;
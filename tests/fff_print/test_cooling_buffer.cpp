@@ -0,0 +1,160 @@
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "libslic3r/GCode.hpp"
+#include "libslic3r/GCode/CoolingBuffer.hpp"
+
+using namespace Slic3r;
+
+// Default cooling settings and print speeds of t/cooling.t.
+static DynamicPrintConfig cooling_config()
+{
+    DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+    config.set_deserialize({
+        { "bridge_fan_speed",           "100" },
+        { "cooling",                    "1" },
+        { "fan_always_on",              "0" },
+        { "fan_below_layer_time",       "60" },
+        { "max_fan_speed",              "100" },
+        { "min_print_speed",            "10" },
+        { "slowdown_below_layer_time",  "5" },
+        { "disable_fan_first_layers",   "0" },
+        { "bridge_speed",               60 },
+        { "external_perimeter_speed",   "50%" },
+        { "first_layer_speed",          30 },
+        { "gap_fill_speed",             20 },
+        { "infill_speed",               80 },
+        { "perimeter_speed",            60 },
+        { "small_perimeter_speed",      15 },
+        { "solid_infill_speed",         20 },
+        { "top_solid_infill_speed",     15 },
+        { "max_print_speed",            80 }
+        });
+    return config;
+}
+
+static std::string cool_layer(const DynamicPrintConfig &config, const std::string &gcode)
+{
+    PrintConfig print_config;
+    print_config.apply(config, true);
+    GCode gcodegen;
+    gcodegen.apply_print_config(print_config);
+    gcodegen.set_layer_count(10);
+    gcodegen.writer().set_extruders({ 0 });
+    gcodegen.writer().set_extruder(0);
+    CoolingBuffer buffer(gcodegen);
+    return buffer.process_layer(gcode, 1);
+}
+
+SCENARIO("CoolingBuffer parses the G-code parameters as strtod() does", "[CoolingBuffer]") {
+    auto parse = [](const std::string &str) { return CoolingBuffer::parse_value(str.data(), str.data() + str.size()); };
+    GIVEN("Numbers formatted as by GCodeWriter") {
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<double> dist(-1000., 1000.);
+        for (const char *format : { "%.0f", "%.3f", "%.5f", "%g", "%.15g" })
+            for (size_t i = 0; i < 1000; ++ i) {
+                char buf[64];
+                sprintf(buf, format, dist(rng));
+                std::string str(buf);
+                REQUIRE(parse(str) == strtod(str.c_str(), nullptr));
+                // The parameter value is terminated by the next parameter or by a comment.
+                REQUIRE(parse(str + " E0.1") == strtod(str.c_str(), nullptr));
+                REQUIRE(parse(str + ";_EXTRUDE_SET_SPEED") == strtod(str.c_str(), nullptr));
+            }
+    }
+    GIVEN("Numbers not formatted by GCodeWriter") {
+        for (const char *str : { "1e3", "-2.5E-2", "0x10", "1234567890.123456789", ".5", "-.5", "+3", "7.", " 42", "\t-0.25" })
+            REQUIRE(parse(str) == strtod(str, nullptr));
+    }
+    GIVEN("No number") {
+        REQUIRE(parse("") == 0.);
+        REQUIRE(parse(" ") == 0.);
+        REQUIRE(parse(";comment") == 0.);
+        REQUIRE(parse("-") == 0.);
+        // The value is not searched for past the end of the line.
+        std::string str = "\n3.5";
+        REQUIRE(CoolingBuffer::parse_value(str.data(), str.data()) == 0.);
+    }
+}
+
+SCENARIO("CoolingBuffer counts the dwell time into the layer time", "[CoolingBuffer]") {
+    // Print time of 2 seconds.
+    const std::string gcode = "G1 F3000;_EXTRUDE_SET_SPEED\nG1 X100 E1\n;_EXTRUDE_END\n";
+    DynamicPrintConfig config = cooling_config();
+    config.set_deserialize({ { "slowdown_below_layer_time", "3" } });
+    GIVEN("A layer printed faster than slowdown_below_layer_time") {
+        THEN("the print is slowed down") {
+            REQUIRE(cool_layer(config, gcode).find("F3000") == std::string::npos);
+        }
+    }
+    GIVEN("A layer with a dwell in seconds") {
+        THEN("the dwell extends the layer time") {
+            REQUIRE(cool_layer(config, gcode + "G4 S2\n").find("F3000") != std::string::npos);
+        }
+    }
+    GIVEN("A layer with a dwell in milliseconds") {
+        THEN("the dwell extends the layer time") {
+            REQUIRE(cool_layer(config, gcode + "G4 P2000\n").find("F3000") != std::string::npos);
+        }
+        THEN("a short dwell does not extend the layer time past slowdown_below_layer_time") {
+            REQUIRE(cool_layer(config, gcode + "G4 P500\n").find("F3000") == std::string::npos);
+        }
+    }
+}
+
+SCENARIO("CoolingBuffer output of a layer", "[CoolingBuffer]") {
+    GIVEN("A layer with travels, retractions, a bridge and extrusions, printed faster than slowdown_below_layer_time") {
+        const std::string gcode =
+            ";LAYER_CHANGE\n"
+            "G1 Z0.4 F7800\n"
+            "G1 X50.125 Y20.5 F7800\n"
+            "G1 F1800;_EXTRUDE_SET_SPEED;_EXTERNAL_PERIMETER\n"
+            "G1 X60.125 Y20.5 E0.41252\n"
+            "G1 X60.125 Y30.5 E0.82504\n"
+            ";_EXTRUDE_END\n"
+            "G1 E0.02504 F2100\n"
+            "G1 X10 Y10 F7800\n"
+            "G1 E0.82504 F2100\n"
+            ";_BRIDGE_FAN_START\n"
+            "G1 F3600;_EXTRUDE_SET_SPEED\n"
+            "G1 X30 Y10 E1.62504\n"
+            ";_EXTRUDE_END\n"
+            ";_BRIDGE_FAN_END\n"
+            "G92 E0\n"
+            "G1 F2400;_EXTRUDE_SET_SPEED\n"
+            "G1 X30 Y30 E0.8\n"
+            "G1 X10 Y30 E1.6\n"
+            ";_EXTRUDE_END\n"
+            "G1 X12.5 Y32.5 F7800;_WIPE\n"
+            "G4 S0.5\n";
+        THEN("the layer is cooled as before the in place parsing of the G-code") {
+            // Output of the former parser, which copied each line into a std::string.
+            const std::string expected =
+                "M106 S252.45\n"
+                ";LAYER_CHANGE\n"
+                "G1 Z0.4 F7800\n"
+                "G1 X50.125 Y20.5\n"
+                "G1 F1335\n"
+                "G1 X60.125 Y20.5 E0.41252\n"
+                "G1 X60.125 Y30.5 E0.82504\n"
+                "G1 E0.02504 F2100\n"
+                "G1 X10 Y10 F7800\n"
+                "G1 E0.82504 F2100\n"
+                "M106 S255\n"
+                "G1 F1335\n"
+                "G1 X30 Y10 E1.62504\n"
+                "M106 S252.45\n"
+                "G92 E0\n"
+                "G1\n"
+                "G1 X30 Y30 E0.8\n"
+                "G1 X10 Y30 E1.6\n"
+                "G1 X12.5 Y32.5 F7800\n"
+                "G4 S0.5\n";
+            REQUIRE(cool_layer(cooling_config(), gcode) == expected);
+        }
+    }
+}
@@ -3,10 +3,13 @@
 #include <numeric>
 #include <sstream>
 
+#include <tbb/task_arena.h>
+
 #include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/Fill/Fill.hpp"
 #include "libslic3r/Flow.hpp"
 #include "libslic3r/Geometry.hpp"
+#include "libslic3r/Layer.hpp"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/SVG.hpp"
 #include "libslic3r/libslic3r.h"
@@ -190,6 +193,110 @@ TEST_CASE("Fill: Pattern Path Length", "[Fill]") {
     }
 }
 
+// Points of the fill polylines of each LayerRegion::fills entity of a layer region.
+using RegionFills = std::vector<std::vector<Points>>;
+
+// Fills of all the layer regions of the print, in their order.
+static std::vector<RegionFills> layer_region_fills(const Print &print)
+{
+    std::vector<RegionFills> out;
+    for (const PrintObject *object : print.objects())
+        for (const Layer *layer : object->layers())
+            for (const LayerRegion *layerm : layer->regions()) {
+                out.emplace_back();
+                for (const ExtrusionEntity *fill : layerm->fills.entities) {
+                    out.back().emplace_back();
+                    for (const Polyline &polyline : fill->as_polylines())
+                        out.back().back().emplace_back(polyline.points);
+                }
+            }
+    return out;
+}
+
+SCENARIO("Layer::make_fills() output does not depend on the scheduling of the parallel fill", "[Fill]") {
+    GIVEN("An object with many small islands of sparse infill per layer") {
+        TriangleMesh islands;
+        for (int i = 0; i < 10; ++ i)
+            for (int j = 0; j < 10; ++ j) {
+                TriangleMesh island = make_cube(4., 4., 2.);
+                island.translate(float(6 * i), float(6 * j), 0.f);
+                islands.merge(island);
+            }
+        islands.repair();
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        config.set_deserialize({
+            { "perimeters",             1 },
+            { "top_solid_layers",       0 },
+            { "bottom_solid_layers",    0 },
+            { "fill_density",           "20%" },
+            { "fill_pattern",           "honeycomb" },
+            { "layer_height",           0.2 },
+            { "first_layer_height",     0.2 }
+            });
+        auto fill = [&islands, &config]() {
+            Model model;
+            Print print;
+            Test::init_print({ islands }, print, model, config);
+            print.process();
+            return layer_region_fills(print);
+        };
+        std::vector<RegionFills> fills = fill();
+        THEN("each layer has a fill per island") {
+            REQUIRE(fills.size() == 10);
+            for (const RegionFills &region_fills : fills)
+                REQUIRE(region_fills.size() >= 100);
+        }
+        THEN("the fills of repeated runs match in count, order and paths") {
+            for (size_t run = 0; run < 3; ++ run)
+                REQUIRE(fill() == fills);
+        }
+        THEN("the fills match the fills produced by a single thread") {
+            std::vector<RegionFills> fills_single_thread;
+            tbb::task_arena arena(1);
+            arena.execute([&fill, &fills_single_thread]() { fills_single_thread = fill(); });
+            REQUIRE(fills_single_thread == fills);
+        }
+    }
+}
+
+SCENARIO("Adaptive cubic and support cubic infill do not depend on the scheduling of the parallel octree build", "[Fill]") {
+    GIVEN("A sphere with sparse infill and internal bridges") {
+        TriangleMesh sphere = Test::mesh(Test::TestMesh::sphere_50mm);
+        sphere.scale(0.2f);
+        auto fill = [&sphere](const char *fill_pattern) {
+            DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+            config.set_deserialize({
+                { "fill_density",           "20%" },
+                { "fill_pattern",           fill_pattern },
+                { "layer_height",           0.3 },
+                { "first_layer_height",     0.3 }
+                });
+            Model model;
+            Print print;
+            Test::init_print({ sphere }, print, model, config);
+            print.process();
+            return layer_region_fills(print);
+        };
+        auto num_fills = [](const std::vector<RegionFills> &fills) {
+            return std::accumulate(fills.begin(), fills.end(), size_t(0), [](size_t n, const RegionFills &region_fills) { return n + region_fills.size(); });
+        };
+        for (const char *fill_pattern : { "adaptivecubic", "supportcubic" }) {
+            WHEN(std::string("filled with ") + fill_pattern) {
+                std::vector<RegionFills> fills = fill(fill_pattern);
+                THEN("the layers are filled") {
+                    REQUIRE(num_fills(fills) > fills.size());
+                }
+                THEN("the fills match the fills produced by a single thread") {
+                    std::vector<RegionFills> fills_single_thread;
+                    tbb::task_arena arena(1);
+                    arena.execute([&fill, fill_pattern, &fills_single_thread]() { fills_single_thread = fill(fill_pattern); });
+                    REQUIRE(fills_single_thread == fills);
+                }
+            }
+        }
+    }
+}
+
 /*
 {
     my $collection = Slic3r::Polyline::Collection->new(
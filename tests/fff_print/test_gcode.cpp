@@ -2,7 +2,14 @@
 
 #include <memory>
 
+#include <boost/filesystem.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <boost/nowide/fstream.hpp>
+
 #include "libslic3r/GCode.hpp"
+#include "libslic3r/GCodeReader.hpp"
+#include "libslic3r/GCode/GCodeIndex.hpp"
+#include "libslic3r/GCode/ToolpathGeometry.hpp"
 
 using namespace Slic3r;
 
@@ -20,3 +27,583 @@ SCENARIO("Origin manipulation", "[GCode]") {
     	}
     }
 }
+
+SCENARIO("GCodeReader parses a file the same way as a buffer", "[GCode]") {
+    GIVEN("A G-code file spanning multiple chunks, the last line not terminated by a newline") {
+        std::string gcode = "G21 ; set units to millimeters\r\nG92 E0\n\n";
+        for (int i = 0; i < 40000; ++ i)
+            gcode += "G1 X" + std::to_string(i % 100) + " Y" + std::to_string(i % 77) + " E" + std::to_string(i) + " ; move " + std::to_string(i) + "\n";
+        gcode += "G1 X\n5 ; a value on the next line\n";
+        gcode += "M107";
+        std::string path = boost::filesystem::unique_path().string();
+        {
+            FILE *f = boost::nowide::fopen(path.c_str(), "wb");
+            fwrite(gcode.data(), 1, gcode.size(), f);
+            fclose(f);
+        }
+        auto collect = [](std::vector<std::string> &lines, std::vector<float> &positions) {
+            return [&lines, &positions](GCodeReader &reader, const GCodeReader::GCodeLine &line) {
+                lines.emplace_back(line.raw());
+                positions.emplace_back(reader.x() + 1000.f * reader.y() + reader.e());
+            };
+        };
+        std::vector<std::string> buffer_lines, file_lines;
+        std::vector<float>       buffer_positions, file_positions;
+        GCodeReader().parse_buffer(gcode, collect(buffer_lines, buffer_positions));
+        GCodeReader().parse_file(path, collect(file_lines, file_positions));
+        boost::nowide::remove(path.c_str());
+        THEN("the lines and the coordinates match") {
+            REQUIRE(file_lines.size() == 40006);
+            REQUIRE(file_lines == buffer_lines);
+            REQUIRE(file_positions == buffer_positions);
+            REQUIRE(file_lines.front() == "G21 ; set units to millimeters");
+            REQUIRE(file_lines.back() == "M107");
+        }
+    }
+}
+
+#if ENABLE_GCODE_VIEWER
+// G-code of 50 layers with the time estimate placeholders and the layer change tags.
+static std::string gcode_with_placeholders()
+{
+    std::string gcode = GCodeProcessor::First_Line_M73_Placeholder_Tag + "\nG21\nG90\nM82\nG92 E0\n";
+    for (int layer = 0; layer < 50; ++ layer) {
+        gcode += "; " + GCodeProcessor::Layer_Change_Tag + "\n";
+        gcode += "G1 Z" + std::to_string(0.2 * (layer + 1)) + " F600\n";
+        for (int i = 0; i < 20; ++ i)
+            gcode += "G1 X" + std::to_string(10 + (i % 2) * 50) + " Y" + std::to_string(10 + i) + " E" + std::to_string(layer * 20 + i) + " F1800\n";
+    }
+    gcode += GCodeProcessor::Last_Line_M73_Placeholder_Tag + "\n";
+    gcode += GCodeProcessor::Estimated_Printing_Time_Placeholder_Tag + "\n";
+    return gcode;
+}
+
+static std::string read_file(const std::string &path)
+{
+    boost::nowide::ifstream t(path);
+    return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+}
+
+SCENARIO("GCodeProcessor processes the G-code passed in blocks", "[GCode]") {
+    GIVEN("A G-code with the time estimate placeholders") {
+        std::string gcode = gcode_with_placeholders();
+
+        PrintConfig config;
+        config.remaining_times.value = true;
+        auto init = [&config](GCodeProcessor &processor) {
+            processor.reset();
+            processor.apply_config(config);
+        };
+
+        // Reference: the G-code written into a file, then processed and post processed in place.
+        std::string path = boost::filesystem::unique_path().string();
+        {
+            FILE *f = boost::nowide::fopen(path.c_str(), "wb");
+            fwrite(gcode.data(), 1, gcode.size(), f);
+            fclose(f);
+        }
+        GCodeProcessor file_processor;
+        init(file_processor);
+        file_processor.process_file(path);
+        std::string file_result = read_file(path);
+        boost::nowide::remove(path.c_str());
+
+        WHEN("the blocks are split in the middle of the lines") {
+            GCodeProcessor processor;
+            init(processor);
+            processor.begin_process();
+            std::vector<std::string> blocks;
+            for (size_t i = 0; i < gcode.size(); i += 333)
+                blocks.emplace_back(gcode.substr(i, 333));
+            for (const std::string &block : blocks)
+                processor.process_buffer(block);
+            processor.end_process();
+            std::string result;
+            processor.post_process(std::move(blocks), [&result](const std::string &str) { result += str; });
+            THEN("the time estimate matches the G-code processed from the file") {
+                REQUIRE(processor.get_time(PrintEstimatedTimeStatistics::ETimeMode::Normal) > 0.f);
+                REQUIRE(processor.get_time(PrintEstimatedTimeStatistics::ETimeMode::Normal) == file_processor.get_time(PrintEstimatedTimeStatistics::ETimeMode::Normal));
+                REQUIRE(processor.get_result().moves.size() == file_processor.get_result().moves.size());
+            }
+            THEN("the post processed G-code matches the G-code post processed in the file") {
+                REQUIRE(result == file_result);
+                REQUIRE(result.find("M73 P0 ") != std::string::npos);
+                REQUIRE(result.find("M73 P100 ") != std::string::npos);
+                REQUIRE(result.find(GCodeProcessor::Layer_Change_Tag) == std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeProcessor estimates the normal and the stealth times concurrently", "[GCode]") {
+    GIVEN("A G-code spanning many planner refreshes and synchronizations, the stealth limits equal to the normal limits") {
+        std::string gcode = "G21\nG90\nM82\nG92 E0\n";
+        for (int layer = 0; layer < 40; ++ layer) {
+            gcode += "; " + GCodeProcessor::Layer_Change_Tag + "\n";
+            gcode += "G1 Z" + std::to_string(0.2 * (layer + 1)) + " F600\n";
+            for (int i = 0; i < 150; ++ i)
+                gcode += "G1 X" + std::to_string(10 + (i * 7) % 90) + " Y" + std::to_string(10 + (i * 13) % 70) + " E" + std::to_string(layer * 150 + i) + " F" + std::to_string(1200 + (i % 5) * 900) + "\n";
+            if (layer % 7 == 3)
+                gcode += "M1\n";
+        }
+
+        PrintConfig config;
+        for (ConfigOptionFloats *opt : { &config.machine_max_acceleration_x, &config.machine_max_acceleration_y, &config.machine_max_acceleration_z, &config.machine_max_acceleration_e,
+                                         &config.machine_max_feedrate_x, &config.machine_max_feedrate_y, &config.machine_max_feedrate_z, &config.machine_max_feedrate_e,
+                                         &config.machine_max_acceleration_extruding, &config.machine_max_acceleration_retracting,
+                                         &config.machine_max_jerk_x, &config.machine_max_jerk_y, &config.machine_max_jerk_z, &config.machine_max_jerk_e,
+                                         &config.machine_min_travel_rate, &config.machine_min_extruding_rate })
+            opt->values = { opt->values.front() };
+        auto process = [&config, &gcode](GCodeProcessor &processor, bool stealth, size_t block_size) {
+            processor.reset();
+            processor.apply_config(config);
+            processor.enable_stealth_time_estimator(stealth);
+            processor.begin_process();
+            for (size_t i = 0; i < gcode.size(); i += block_size)
+                processor.process_buffer(std::string_view(gcode).substr(i, block_size));
+            processor.end_process();
+        };
+        GCodeProcessor reference;
+        process(reference, false, gcode.size());
+
+        WHEN("both machines are enabled and the G-code is processed line by line") {
+            GCodeProcessor processor;
+            process(processor, true, 16);
+            THEN("the estimated times are identical to the normal machine estimated alone") {
+                const float time = reference.get_time(PrintEstimatedTimeStatistics::ETimeMode::Normal);
+                REQUIRE(time > 0.f);
+                REQUIRE(processor.get_time(PrintEstimatedTimeStatistics::ETimeMode::Normal) == time);
+                REQUIRE(processor.get_time(PrintEstimatedTimeStatistics::ETimeMode::Stealth) == time);
+                REQUIRE(processor.get_layers_time(PrintEstimatedTimeStatistics::ETimeMode::Normal) == reference.get_layers_time(PrintEstimatedTimeStatistics::ETimeMode::Normal));
+                REQUIRE(processor.get_layers_time(PrintEstimatedTimeStatistics::ETimeMode::Stealth) == reference.get_layers_time(PrintEstimatedTimeStatistics::ETimeMode::Normal));
+                REQUIRE(processor.get_moves_time(PrintEstimatedTimeStatistics::ETimeMode::Stealth) == reference.get_moves_time(PrintEstimatedTimeStatistics::ETimeMode::Normal));
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeProcessor stores the moves compactly", "[GCode]") {
+    GIVEN("Moves with runs of shared attributes") {
+        std::vector<GCodeProcessor::MoveVertex> moves;
+        GCodeProcessor::MoveVertices            store;
+        for (int i = 0; i < 10000; ++ i) {
+            GCodeProcessor::MoveVertex move;
+            move.type           = (i % 10 == 0) ? EMoveType::Travel : EMoveType::Extrude;
+            move.extrusion_role = (i % 10 == 0) ? erNone : ExtrusionRole(erPerimeter + (i / 500) % 4);
+            move.extruder_id    = (unsigned char)(i / 5000);
+            move.cp_color_id    = move.extruder_id;
+            move.position       = Vec3f(float(100 + (i * 37) % 1000) * 0.051f, float(100 - (i * 13) % 700) * 0.137f, 0.2f * float(1 + i / 400));
+            move.delta_extruder = (move.type == EMoveType::Extrude) ? 0.0123f * float(i % 17) : -0.8f;
+            move.feedrate       = (move.type == EMoveType::Extrude) ? 40.f : 180.f;
+            move.width          = 0.45f + 0.001f * float(i % 7);
+            move.height         = 0.2f;
+            move.mm3_per_mm     = 0.05f + 0.0001f * float(i % 11);
+            move.fan_speed      = (i < 800) ? 0.f : 100.f;
+            move.time           = float(i);
+            moves.emplace_back(move);
+            store.emplace_back(move);
+        }
+        store.shrink_to_fit();
+        THEN("the moves are restored, width, height and position up to the quantization") {
+            REQUIRE(store.size() == moves.size());
+            // Random access in both directions.
+            for (size_t j = 0; j < moves.size(); ++ j) {
+                size_t i = (j % 2 == 0) ? j : moves.size() - j;
+                const GCodeProcessor::MoveVertex &ref  = moves[i];
+                const GCodeProcessor::MoveVertex  move = store[i];
+                REQUIRE(move.type == ref.type);
+                REQUIRE(move.extrusion_role == ref.extrusion_role);
+                REQUIRE(move.extruder_id == ref.extruder_id);
+                REQUIRE(move.cp_color_id == ref.cp_color_id);
+                REQUIRE((move.position - ref.position).cwiseAbs().maxCoeff() < 1e-4f);
+                REQUIRE(move.delta_extruder == ref.delta_extruder);
+                REQUIRE(move.feedrate == ref.feedrate);
+                REQUIRE(move.width == Approx(ref.width).margin(0.0005));
+                REQUIRE(move.height == Approx(ref.height).margin(0.0005));
+                REQUIRE(move.mm3_per_mm == ref.mm3_per_mm);
+                REQUIRE(move.fan_speed == ref.fan_speed);
+                REQUIRE(move.time == ref.time);
+            }
+        }
+        THEN("the store is less than half the size of a vector of moves") {
+            REQUIRE(store.memory_size() * 2 < moves.size() * sizeof(GCodeProcessor::MoveVertex));
+        }
+        THEN("the store is consistent, also after a truncation") {
+            REQUIRE(store.is_valid());
+            for (size_t size : { 0, 1, 15, 16, 17, 64, 65, 5001 }) {
+                GCodeProcessor::MoveVertices truncated = store;
+                truncated.truncate(size);
+                REQUIRE(truncated.is_valid());
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeProcessor resumes the processing from the checkpoints of the previous G-code", "[GCode]") {
+    GIVEN("A G-code of several MB, then the same G-code modified in a late layer") {
+        auto make_gcode = [](int modified_layer) {
+            std::string gcode = GCodeProcessor::First_Line_M73_Placeholder_Tag + "\nG21\nG90\nM82\nG92 E0\n";
+            for (int layer = 0; layer < 60; ++ layer) {
+                gcode += "; " + GCodeProcessor::Layer_Change_Tag + "\n";
+                gcode += ";" + GCodeProcessor::Height_Tag + "0.2\n";
+                gcode += "G1 Z" + std::to_string(0.2 * (layer + 1)) + " F600\n";
+                gcode += (layer < 5) ? "M107\n" : "M106 S" + std::to_string(100 + layer) + "\n";
+                for (int i = 0; i < 1500; ++ i) {
+                    if (i % 300 == 0)
+                        gcode += ";" + GCodeProcessor::Extrusion_Role_Tag + ExtrusionEntity::role_to_string(ExtrusionRole(erPerimeter + (i / 300) % 4)) + "\n";
+                    gcode += "G1 X" + std::to_string(10 + (i * 7) % 90) + " Y" + std::to_string(10 + (i * 13) % 70) + " E" + std::to_string(layer * 1500 + i) +
+                        " F" + std::to_string((layer == modified_layer && i == 700) ? 600 : 1200 + (i % 5) * 900) + "\n";
+                }
+            }
+            gcode += GCodeProcessor::Last_Line_M73_Placeholder_Tag + "\n";
+            gcode += GCodeProcessor::Estimated_Printing_Time_Placeholder_Tag + "\n";
+            return gcode;
+        };
+        const std::string gcode          = make_gcode(-1);
+        const std::string modified_gcode = make_gcode(45);
+
+        PrintConfig config;
+        config.remaining_times.value = true;
+        GCodeProcessor::Checkpoints checkpoints;
+        checkpoints.set_enabled(true);
+        auto process = [&config](GCodeProcessor &processor, const std::string &gcode, GCodeProcessor::Checkpoints *checkpoints) {
+            processor.reset();
+            processor.apply_config(config);
+            processor.enable_stealth_time_estimator(true);
+            processor.begin_process(checkpoints);
+            std::vector<std::string> blocks;
+            for (size_t i = 0; i < gcode.size(); i += 100000)
+                blocks.emplace_back(gcode.substr(i, 100000));
+            for (const std::string &block : blocks)
+                processor.process_buffer(block);
+            processor.end_process();
+            std::string result;
+            processor.post_process(std::move(blocks), [&result](const std::string &str) { result += str; });
+            return result;
+        };
+        auto require_same_result = [](const GCodeProcessor &processor, const std::string &result, const GCodeProcessor &reference, const std::string &reference_result) {
+            for (PrintEstimatedTimeStatistics::ETimeMode mode : { PrintEstimatedTimeStatistics::ETimeMode::Normal, PrintEstimatedTimeStatistics::ETimeMode::Stealth }) {
+                REQUIRE(processor.get_time(mode) > 0.f);
+                REQUIRE(processor.get_time(mode) == reference.get_time(mode));
+                REQUIRE(processor.get_layers_time(mode) == reference.get_layers_time(mode));
+                REQUIRE(processor.get_moves_time(mode) == reference.get_moves_time(mode));
+            }
+            REQUIRE(result == reference_result);
+            const GCodeProcessor::MoveVertices &moves     = processor.get_result().moves;
+            const GCodeProcessor::MoveVertices &ref_moves = reference.get_result().moves;
+            REQUIRE(moves.size() == ref_moves.size());
+            for (size_t i = 0; i < moves.size(); ++ i) {
+                const GCodeProcessor::MoveVertex move = moves[i];
+                const GCodeProcessor::MoveVertex ref  = ref_moves[i];
+                REQUIRE(move.type == ref.type);
+                REQUIRE(move.extrusion_role == ref.extrusion_role);
+                REQUIRE(move.position == ref.position);
+                REQUIRE(move.delta_extruder == ref.delta_extruder);
+                REQUIRE(move.feedrate == ref.feedrate);
+                REQUIRE(move.width == ref.width);
+                REQUIRE(move.height == ref.height);
+                REQUIRE(move.mm3_per_mm == ref.mm3_per_mm);
+                REQUIRE(move.fan_speed == ref.fan_speed);
+            }
+        };
+
+        GCodeProcessor processor;
+        process(processor, gcode, &checkpoints);
+        REQUIRE(checkpoints.size() > 3);
+        REQUIRE(checkpoints.skipped_size() == 0);
+
+        WHEN("the modified G-code is processed") {
+            std::string result = process(processor, modified_gcode, &checkpoints);
+            GCodeProcessor reference;
+            std::string reference_result = process(reference, modified_gcode, nullptr);
+            THEN("the G-code preceding the modified layer is skipped") {
+                REQUIRE(checkpoints.skipped_size() > modified_gcode.size() / 2);
+                REQUIRE(checkpoints.skipped_size() < modified_gcode.size() * 45 / 60);
+            }
+            THEN("the result matches the modified G-code processed from scratch") {
+                require_same_result(processor, result, reference, reference_result);
+            }
+        }
+        WHEN("the same G-code is processed again, then the modified G-code") {
+            std::string result = process(processor, gcode, &checkpoints);
+            GCodeProcessor reference;
+            std::string reference_result = process(reference, gcode, nullptr);
+            THEN("the G-code up to the last checkpoint is skipped and the result matches the G-code processed from scratch") {
+                // the last checkpoint is less than the checkpoints interval and a layer before the end
+                REQUIRE(checkpoints.skipped_size() + GCodeProcessor::Checkpoints::Min_Interval + gcode.size() / 60 > gcode.size());
+                require_same_result(processor, result, reference, reference_result);
+            }
+            result = process(processor, modified_gcode, &checkpoints);
+            reference_result = process(reference, modified_gcode, nullptr);
+            THEN("the checkpoints taken by the replay are valid for the next G-code") {
+                REQUIRE(checkpoints.skipped_size() > 0);
+                require_same_result(processor, result, reference, reference_result);
+            }
+        }
+        WHEN("the configuration changes") {
+            config.machine_max_acceleration_extruding.values = { 500., 500. };
+            std::string result = process(processor, gcode, &checkpoints);
+            GCodeProcessor reference;
+            std::string reference_result = process(reference, gcode, nullptr);
+            THEN("the G-code is processed from scratch") {
+                REQUIRE(checkpoints.skipped_size() == 0);
+                require_same_result(processor, result, reference, reference_result);
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeIndex restores the result of the exported G-code", "[GCode]") {
+    GIVEN("A G-code with layer changes, exported with and without the remaining times") {
+        const std::string height_line = ";" + GCodeProcessor::Height_Tag + "0.2";
+        std::string gcode = GCodeProcessor::First_Line_M73_Placeholder_Tag + "\n; generated by test\nG21\nG90\nM82\nG92 E0\n";
+        for (int layer = 0; layer < 30; ++ layer) {
+            gcode += "; " + GCodeProcessor::Layer_Change_Tag + "\n" + height_line + "\n";
+            gcode += "G1 Z" + std::to_string(0.2 * (layer + 1)) + " F600\n";
+            for (int i = 0; i < 2000; ++ i)
+                gcode += "G1 X" + std::to_string(10 + (i * 7) % 90) + " Y" + std::to_string(10 + (i * 13) % 70) + " E" + std::to_string(layer * 2000 + i) + " F1800\n";
+        }
+        gcode += GCodeProcessor::Last_Line_M73_Placeholder_Tag + "\n";
+
+        for (bool remaining_times : { true, false }) {
+            PrintConfig config;
+            config.remaining_times.value = remaining_times;
+            GCodeProcessor processor;
+            processor.reset();
+            processor.apply_config(config);
+            processor.begin_process();
+            processor.process_buffer(gcode);
+            processor.end_process();
+            std::string exported = gcode;
+            if (remaining_times) {
+                exported.clear();
+                processor.post_process({ gcode }, [&exported](const std::string &str) { exported += str; });
+            }
+
+            std::string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+            {
+                FILE *f = boost::nowide::fopen(path.c_str(), "wb");
+                fwrite(exported.data(), 1, exported.size(), f);
+                fclose(f);
+            }
+            bool saved = GCodeIndex::save(path, GCodeIndex::path(path), processor.get_result());
+
+            WHEN(std::string("the G-code is loaded with its index, ") + (remaining_times ? "with" : "without") + " the remaining times") {
+                GCodeProcessor loader;
+                bool loaded = loader.load_index(path);
+                THEN("the result matches the result of the processing") {
+                    REQUIRE(saved);
+                    REQUIRE(loaded);
+                    const GCodeProcessor::Result &ref = processor.get_result();
+                    const GCodeProcessor::Result &res = loader.get_result();
+                    REQUIRE(res.id != ref.id);
+                    REQUIRE(res.moves.size() == ref.moves.size());
+                    for (size_t i = 0; i < res.moves.size(); i += 7) {
+                        REQUIRE(res.moves[i].type == ref.moves[i].type);
+                        REQUIRE(res.moves[i].position == ref.moves[i].position);
+                        REQUIRE(res.moves[i].feedrate == ref.moves[i].feedrate);
+                    }
+                    REQUIRE(res.moves.back().position == ref.moves.back().position);
+                    REQUIRE(res.bed_shape == ref.bed_shape);
+                    REQUIRE(res.extruder_colors == ref.extruder_colors);
+                    REQUIRE(res.time_statistics.modes[0].time == ref.time_statistics.modes[0].time);
+                    REQUIRE(res.time_statistics.modes[0].layers_times == ref.time_statistics.modes[0].layers_times);
+                    REQUIRE(res.time_statistics.modes[0].moves_times == ref.time_statistics.modes[0].moves_times);
+                }
+            }
+            WHEN(std::string("the G-code is modified after the export, ") + (remaining_times ? "with" : "without") + " the remaining times") {
+                {
+                    FILE *f = boost::nowide::fopen(path.c_str(), "r+b");
+                    fseek(f, long(exported.size() / 2), SEEK_SET);
+                    fputc(exported[exported.size() / 2] == '1' ? '2' : '1', f);
+                    fclose(f);
+                }
+                GCodeProcessor loader;
+                THEN("the index is ignored") {
+                    REQUIRE(saved);
+                    REQUIRE(! loader.load_index(path));
+                }
+            }
+            WHEN(std::string("the index is corrupted or truncated, ") + (remaining_times ? "with" : "without") + " the remaining times") {
+                const std::string index_path = GCodeIndex::path(path);
+                const size_t      index_size = size_t(boost::filesystem::file_size(index_path));
+                auto flip_byte = [&index_path](size_t offset) {
+                    FILE *f = boost::nowide::fopen(index_path.c_str(), "r+b");
+                    fseek(f, long(offset), SEEK_SET);
+                    int c = fgetc(f);
+                    fseek(f, long(offset), SEEK_SET);
+                    fputc(c ^ 0x5A, f);
+                    fclose(f);
+                };
+                THEN("the index is ignored") {
+                    REQUIRE(saved);
+                    // The size and the hash of the serialized result, the count of moves, the size of the first column,
+                    // the middle and the end of the serialized result.
+                    for (size_t offset : { size_t(28), size_t(36), size_t(44), size_t(52), index_size / 2, index_size - 1 }) {
+                        flip_byte(offset);
+                        REQUIRE(! GCodeProcessor().load_index(path));
+                        flip_byte(offset);
+                    }
+                    REQUIRE(GCodeProcessor().load_index(path));
+                    boost::filesystem::resize_file(index_path, index_size - 1);
+                    REQUIRE(! GCodeProcessor().load_index(path));
+                }
+            }
+            boost::nowide::remove(GCodeIndex::path(path).c_str());
+            boost::nowide::remove(path.c_str());
+        }
+    }
+}
+
+SCENARIO("ToolpathGeometry generates the G-code preview geometry in batches", "[GCode]") {
+    GIVEN("Runs of travels, extrusions and retractions") {
+        // first move is a dummy move, see GCodeProcessor::begin_process()
+        auto add_move = [](GCodeProcessor::MoveVertices &moves, EMoveType type, float x, float y, float z) {
+            GCodeProcessor::MoveVertex move;
+            move.type           = type;
+            move.extrusion_role = (type == EMoveType::Extrude) ? erPerimeter : erNone;
+            move.position       = Vec3f(x, y, z);
+            move.delta_extruder = (type == EMoveType::Extrude) ? 0.05f : 0.f;
+            move.feedrate       = (type == EMoveType::Travel) ? 180.f : 40.f;
+            move.width          = 0.45f;
+            move.height         = 0.2f;
+            move.mm3_per_mm     = 0.08f;
+            moves.emplace_back(move);
+        };
+        GCodeProcessor::MoveVertices moves;
+        moves.emplace_back(GCodeProcessor::MoveVertex());
+        for (int layer = 0; layer < 20; ++ layer) {
+            float z = 0.2f * float(layer + 1);
+            add_move(moves, EMoveType::Travel, 10.f, 10.f, z);
+            for (int i = 0; i < 30; ++ i)
+                add_move(moves, EMoveType::Extrude, 10.f + float(i % 2) * 20.f, 10.f + float(i) * 0.5f, z);
+            add_move(moves, EMoveType::Retract, 10.f, 25.f, z);
+        }
+
+        WHEN("the geometry of a travel, a straight extrusion and a retraction is generated") {
+            GCodeProcessor::MoveVertices head;
+            head.emplace_back(GCodeProcessor::MoveVertex());
+            add_move(head, EMoveType::Travel, 10.f, 10.f, 0.2f);
+            add_move(head, EMoveType::Extrude, 20.f, 10.f, 0.2f);
+            add_move(head, EMoveType::Extrude, 30.f, 10.f, 0.2f);
+            add_move(head, EMoveType::Extrude, 50.f, 10.f, 0.2f);
+            add_move(head, EMoveType::Retract, 50.f, 10.f, 0.2f);
+            ToolpathGeometry geometry;
+            geometry.build(head);
+            geometry.generate(head);
+            const ToolpathGeometry::Buffer &travel  = geometry.buffer(EMoveType::Travel);
+            const ToolpathGeometry::Buffer &extrude = geometry.buffer(EMoveType::Extrude);
+            const ToolpathGeometry::Buffer &retract = geometry.buffer(EMoveType::Retract);
+            THEN("a travel segment is a line, a retraction is a point") {
+                REQUIRE(travel.vertices_count == 2);
+                REQUIRE(travel.index_buffers_sizes == std::vector<size_t>{ 2 });
+                REQUIRE(retract.vertices_count == 1);
+                REQUIRE(retract.index_buffers_sizes == std::vector<size_t>{ 1 });
+            }
+            THEN("the first segment of an extrusion path has 8 vertices, the following segments 6") {
+                REQUIRE(extrude.paths.size() == 1);
+                REQUIRE(extrude.paths.front().first.s_id == 1);
+                REQUIRE(extrude.paths.front().last.s_id == 4);
+                REQUIRE(extrude.vertices_count == 8 + 2 * 6);
+                REQUIRE(extrude.index_buffers_sizes == std::vector<size_t>{ 3 * 42 });
+                REQUIRE(extrude.vertex_blocks.size() == 1);
+                REQUIRE(extrude.vertex_blocks.front().vertices.size() == extrude.vertices_count * extrude.vertex_size_floats());
+            }
+        }
+
+        WHEN("the geometry is generated in batches of different sizes") {
+            using Vertices = std::array<std::vector<float>, ToolpathGeometry::Buffers_Count>;
+            using Indices  = std::array<ToolpathGeometry::IndexBuffer, ToolpathGeometry::Buffers_Count>;
+            // Concatenates the blocks of each buffer, generated for a window of batches at a time.
+            auto generate = [&moves](ToolpathGeometry &geometry, size_t batch_size, size_t window, Vertices &vertices, Indices &indices) {
+                geometry.build(moves, batch_size);
+                for (size_t begin = 0; begin < geometry.batches_count(); begin += window) {
+                    geometry.generate(moves, begin, std::min(begin + window, geometry.batches_count()));
+                    for (size_t id = 0; id < ToolpathGeometry::Buffers_Count; ++ id) {
+                        for (const ToolpathGeometry::VertexBlock &block : geometry.buffers()[id].vertex_blocks)
+                            vertices[id].insert(vertices[id].end(), block.vertices.begin(), block.vertices.end());
+                        for (const ToolpathGeometry::IndexBlock &block : geometry.buffers()[id].index_blocks)
+                            indices[id].insert(indices[id].end(), block.indices.begin(), block.indices.end());
+                    }
+                }
+            };
+            ToolpathGeometry geometry, geometry_small;
+            Vertices         vertices, vertices_small;
+            Indices          indices, indices_small;
+            generate(geometry, ToolpathGeometry::Default_Batch_Size, 1, vertices, indices);
+            generate(geometry_small, 7, 3, vertices_small, indices_small);
+            THEN("the batches are split and the paths are the same") {
+                REQUIRE(geometry.batches_count() == 1);
+                REQUIRE(geometry_small.batches_count() > 20);
+                for (size_t id = 0; id < ToolpathGeometry::Buffers_Count; ++ id) {
+                    const ToolpathGeometry::Buffer &buffer       = geometry.buffers()[id];
+                    const ToolpathGeometry::Buffer &buffer_small = geometry_small.buffers()[id];
+                    REQUIRE(buffer.vertices_count == buffer_small.vertices_count);
+                    REQUIRE(buffer.index_buffers_sizes == buffer_small.index_buffers_sizes);
+                    REQUIRE(buffer.paths.size() == buffer_small.paths.size());
+                    for (size_t i = 0; i < buffer.paths.size(); ++ i) {
+                        REQUIRE(buffer.paths[i].first.s_id == buffer_small.paths[i].first.s_id);
+                        REQUIRE(buffer.paths[i].last.s_id == buffer_small.paths[i].last.s_id);
+                        REQUIRE(buffer.paths[i].first.i_id == buffer_small.paths[i].first.i_id);
+                        REQUIRE(buffer.paths[i].last.i_id == buffer_small.paths[i].last.i_id);
+                    }
+                }
+                REQUIRE(geometry.buffer(EMoveType::Extrude).paths.size() == 20);
+            }
+            THEN("the generated vertices and indices are the same") {
+                REQUIRE(vertices == vertices_small);
+                REQUIRE(indices == indices_small);
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeOutputStream writes the G-code exceeding the memory limit into the file", "[GCode]") {
+    GIVEN("A G-code with the time estimate placeholders") {
+        std::string gcode = gcode_with_placeholders();
+        PrintConfig config;
+        config.remaining_times.value = true;
+
+        // Export the G-code the way GCode::do_export() does, return the post processed G-code.
+        auto export_gcode = [&gcode, &config](size_t memory_limit, bool &spilled) {
+            GCodeProcessor processor;
+            processor.reset();
+            processor.apply_config(config);
+            processor.begin_process();
+            std::string path = boost::filesystem::unique_path().string();
+            GCodeOutputStream file(boost::nowide::fopen(path.c_str(), "wb"), 1024);
+            file.set_memory_limit(memory_limit);
+            file.set_processor(&processor, processor.is_post_process_needed());
+            for (size_t i = 0; i < gcode.size(); i += 333)
+                file.write(std::string_view(gcode).substr(i, 333));
+            file.flush();
+            processor.end_process();
+            spilled = file.spilled();
+            if (! spilled)
+                processor.post_process(file.release_blocks(), [&file](const std::string &str) { file.write(str); });
+            file.close();
+            if (spilled)
+                processor.post_process(path);
+            std::string result = read_file(path);
+            boost::nowide::remove(path.c_str());
+            return result;
+        };
+
+        bool        spilled_in_memory;
+        std::string result_in_memory = export_gcode(GCodeOutputStream::Default_Memory_Limit, spilled_in_memory);
+        WHEN("the G-code exceeds the memory limit") {
+            bool        spilled;
+            std::string result = export_gcode(4096, spilled);
+            THEN("the G-code is post processed in the file") {
+                REQUIRE(! spilled_in_memory);
+                REQUIRE(spilled);
+            }
+            THEN("the post processed G-code matches the G-code post processed in memory") {
+                REQUIRE(result.find("M73 P100 ") != std::string::npos);
+                REQUIRE(result.find(GCodeProcessor::Layer_Change_Tag) == std::string::npos);
+                REQUIRE(result == result_in_memory);
+            }
+        }
+    }
+}
+#endif // ENABLE_GCODE_VIEWER
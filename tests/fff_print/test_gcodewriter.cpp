@@ -1,6 +1,10 @@
 #include <catch2/catch.hpp>
 
+#include <cmath>
+#include <iomanip>
 #include <memory>
+#include <random>
+#include <sstream>
 
 #include "libslic3r/GCodeWriter.hpp"
 
@@ -94,3 +98,64 @@ SCENARIO("set_speed emits values with fixed-point output.", "[GCodeWriter]") {
         }
     }
 }
+
+SCENARIO("to_chars_fixed matches the fixed-point output of std::ostream.", "[GCodeWriter]") {
+
+    GIVEN("Coordinates, extrusion values and corner cases of rounding") {
+        std::vector<double> values { 0., -0., 0.0005, -0.0005, 1.0045, 0.125, 2.5, -2.5, 999.9995, 123.4565, -0.00001, 1e14, 1e20, -1e-20 };
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<double> dist(-1000., 1000.);
+        for (int i = 0; i < 10000; ++ i)
+            values.emplace_back(dist(rng));
+        // Values close to the decimal ties.
+        for (int i = 0; i < 10000; ++ i)
+            values.emplace_back(std::round(dist(rng) * 1e4) / 1e4 + 0.00005);
+        THEN("The output is byte-for-byte identical to std::fixed with std::setprecision") {
+            for (int precision : { 0, 3, 5, 9 })
+                for (double v : values) {
+                    std::ostringstream ss;
+                    ss << std::fixed << std::setprecision(precision) << v;
+                    std::string out;
+                    append_fixed(out, v, precision);
+                    REQUIRE(out == ss.str());
+                }
+        }
+        THEN("to_chars_fixed reports a buffer too small") {
+            char buf[4];
+            REQUIRE(to_chars_fixed(buf, buf + sizeof(buf), 123.456, 3) == nullptr);
+        }
+    }
+}
+
+SCENARIO("retract and unretract emit the same G-code as the former std::ostream formatting.", "[GCodeWriter]") {
+
+    GIVEN("Retract speeds with integral and fractional feed rates") {
+        for (double speed : { 40., 35., 33.3333, 0.55, 1.2345678, 25000. }) {
+            GCodeWriter writer;
+            GCodeConfig &config = writer.config;
+            config.retract_speed.values    = { speed };
+            config.deretract_speed.values  = { 0. };
+            config.retract_length.values   = { 0.8 };
+            writer.set_extruders({ 0 });
+            writer.set_extruder(0);
+            WHEN("retract() and unretract() are called at a speed of " << speed) {
+                std::string retract   = writer.retract();
+                std::string unretract = writer.unretract();
+                THEN("The E axis is exported with 5 decimal digits and the feed rate as std::ostream << float") {
+                    // Extruder::retract_speed() rounds the retract speed to an integer.
+                    float feedrate = float(std::floor(speed + 0.5) * 60.);
+                    std::ostringstream expected_retract;
+                    expected_retract << "G1 E" << std::fixed << std::setprecision(5) << -0.8;
+                    expected_retract.unsetf(std::ios_base::floatfield);
+                    expected_retract << std::setprecision(6) << " F" << feedrate << "\n";
+                    REQUIRE(retract == expected_retract.str());
+                    std::ostringstream expected_unretract;
+                    expected_unretract << "G1 E" << std::fixed << std::setprecision(5) << 0.;
+                    expected_unretract.unsetf(std::ios_base::floatfield);
+                    expected_unretract << std::setprecision(6) << " F" << feedrate << "\n";
+                    REQUIRE(unretract == expected_unretract.str());
+                }
+            }
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include <catch2/catch.hpp>
 
+#include <mutex>
+
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/Layer.hpp"
@@ -126,3 +128,36 @@ SCENARIO("Print: Brim generation", "[Print]") {
         }
     }
 }
+
+SCENARIO("Print: Progress of objects processed concurrently", "[Print]") {
+    GIVEN("Four 20mm cubes") {
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::cube_20x20x20, TestMesh::cube_20x20x20, TestMesh::cube_20x20x20}, print, model, {
+            { "support_material", 1 }
+        });
+        std::vector<PrintBase::SlicingStatus> statuses;
+        std::mutex                            statuses_mutex;
+        print.set_status_callback([&statuses, &statuses_mutex](const PrintBase::SlicingStatus &status) {
+            // Warnings are reported with a negative percent.
+            if (status.percent >= 0) {
+                std::lock_guard<std::mutex> lock(statuses_mutex);
+                statuses.emplace_back(status);
+            }
+        });
+        WHEN("the print is processed") {
+            print.process();
+            THEN("the reported progress never decreases") {
+                REQUIRE(! statuses.empty());
+                for (size_t i = 1; i < statuses.size(); ++ i)
+                    REQUIRE(statuses[i - 1].percent <= statuses[i].percent);
+            }
+            THEN("the completion of all the objects is reported") {
+                auto it = std::find_if(statuses.begin(), statuses.end(),
+                    [](const PrintBase::SlicingStatus &status) { return status.text == "Processing objects: 4 of 4 done"; });
+                REQUIRE(it != statuses.end());
+                REQUIRE(it->percent == 85);
+            }
+        }
+    }
+}
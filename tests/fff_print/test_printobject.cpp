@@ -87,3 +87,44 @@ SCENARIO("PrintObject: object layer heights", "[PrintObject]") {
 #endif
     }
 }
+
+SCENARIO("PrintObject: vertical shells do not depend on the layer bands", "[PrintObject]") {
+    GIVEN("A sloping object with thick top and bottom shells") {
+        // Surfaces of all layers of the object, printed with the given band size of discover_vertical_shells().
+        auto fill_surfaces = [](size_t band_size) {
+            PrintObject::discover_vertical_shells_band_size = band_size;
+            Print print;
+            Test::init_and_process_print({ TestMesh::slopy_cube }, print, {
+                { "ensure_vertical_shell_thickness", 1 },
+                { "top_solid_layers",                5 },
+                { "bottom_solid_layers",             5 },
+                { "fill_density",                    "20%" },
+                { "layer_height",                    0.2 },
+                { "first_layer_height",              0.2 }
+            });
+            PrintObject::discover_vertical_shells_band_size = 0;
+            std::vector<std::vector<std::pair<SurfaceType, ExPolygon>>> surfaces;
+            for (const Layer *layer : print.objects().front()->layers())
+                for (const LayerRegion *layerm : layer->regions()) {
+                    surfaces.emplace_back();
+                    for (const Surface &surface : layerm->fill_surfaces.surfaces)
+                        surfaces.back().emplace_back(surface.surface_type, surface.expolygon);
+                }
+            return surfaces;
+        };
+        // 100 layers, processed in a single band.
+        auto surfaces = fill_surfaces(0);
+        THEN("some layers get internal solid infill") {
+            REQUIRE(surfaces.size() == 100);
+            REQUIRE(std::count_if(surfaces.begin(), surfaces.end(), [](const auto &layer_surfaces) {
+                return std::any_of(layer_surfaces.begin(), layer_surfaces.end(), [](const auto &surface) { return surface.first == stInternalSolid; });
+            }) > 10);
+        }
+        for (size_t band_size : { 1, 3, 7, 32 })
+            WHEN(std::string("the layers are processed in bands of ") + std::to_string(band_size) + " layers") {
+                THEN("the fill surfaces match the surfaces produced in a single band") {
+                    REQUIRE(fill_surfaces(band_size) == surfaces);
+                }
+            }
+    }
+}
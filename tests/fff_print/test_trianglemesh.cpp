@@ -9,6 +9,9 @@
 #include <algorithm>
 #include <future>
 #include <chrono>
+#include <random>
+
+#include <tbb/task_arena.h>
 
 //#include "test_options.hpp"
 #include "test_data.hpp"
@@ -226,6 +229,45 @@ SCENARIO( "TriangleMesh: slice behavior.") {
             }
         }
     }
+    GIVEN( "A sphere with many facets") {
+        TriangleMesh sphere = make_sphere(10., 2. * PI / 200.);
+        std::vector<float> z;
+        for (float zz = -9.95f; zz < 10.f; zz += 0.1f)
+            z.emplace_back(zz);
+        WHEN("It is sliced in parallel and by a single thread") {
+            std::vector<Polygons> slices_parallel, slices_serial;
+            slice_mesh(sphere, z, slices_parallel, []{});
+            tbb::task_arena(1).execute([&sphere, &z, &slices_serial]() { slice_mesh(sphere, z, slices_serial, []{}); });
+            THEN( "Each layer contains a single contour") {
+                for (const Polygons &polygons : slices_parallel)
+                    REQUIRE(polygons.size() == 1);
+            }
+            THEN( "The contours are identical") {
+                REQUIRE(slices_parallel == slices_serial);
+            }
+        }
+        WHEN("It is sliced with the up direction set to Z") {
+            std::vector<Polygons> slices, slices_up;
+            slice_mesh(sphere, z, slices, []{});
+            TriangleMeshSlicer slicer(&sphere);
+            slicer.set_up_direction(Vec3f::UnitZ());
+            slicer.slice(z, SlicingMode::Regular, &slices_up, [](){});
+            THEN( "The contours are identical") {
+                REQUIRE(slices == slices_up);
+            }
+        }
+        WHEN("Its layers are sliced one by one") {
+            std::vector<Polygons> slices;
+            slice_mesh(sphere, z, slices, []{});
+            THEN( "The contours are identical to the contours of the layers sliced at once") {
+                for (size_t i = 0; i < z.size(); i += 10) {
+                    std::vector<Polygons> slice;
+                    slice_mesh(sphere, { z[i] }, slice, []{});
+                    REQUIRE(slice.front() == slices[i]);
+                }
+            }
+        }
+    }
 }
 
 SCENARIO( "make_xxx functions produce meshes.") {
@@ -347,6 +389,32 @@ SCENARIO( "TriangleMesh: Mesh merge functions") {
     }
 }
 
+SCENARIO( "TriangleMesh: Facet neighbors") {
+    GIVEN( "A sphere with its facets shuffled") {
+        TriangleMesh sphere = make_sphere(10., 2. * PI / 100.);
+        std::shuffle(sphere.stl.facet_start.begin(), sphere.stl.facet_start.end(), std::mt19937(0));
+        for (stl_neighbors &neighbors : sphere.stl.neighbors_start)
+            neighbors.reset();
+        WHEN( "The neighbors are recalculated") {
+            stl_check_facets_exact(&sphere.stl);
+            THEN( "All the facets are connected over all their edges.") {
+                REQUIRE(stl_validate(&sphere.stl));
+                REQUIRE(sphere.stl.stats.connected_facets_3_edge == int(sphere.stl.stats.number_of_facets));
+                REQUIRE(sphere.stl.stats.connected_edges == 3 * int(sphere.stl.stats.number_of_facets));
+            }
+        }
+        WHEN( "A facet is duplicated and the neighbors are recalculated") {
+            stl_facet facet = sphere.stl.facet_start.front();
+            stl_add_facet(&sphere.stl, &facet);
+            stl_check_facets_exact(&sphere.stl);
+            THEN( "The duplicate facet, coming last, remains unconnected.") {
+                REQUIRE(sphere.stl.neighbors_start.back().num_neighbors() == 0);
+                REQUIRE(sphere.stl.stats.connected_facets_3_edge == int(sphere.stl.stats.number_of_facets) - 1);
+            }
+        }
+    }
+}
+
 SCENARIO( "TriangleMeshSlicer: Cut behavior.") {
     GIVEN( "A 20mm cube with one corner on the origin") {
         const std::vector<Vec3d> vertices { {20,20,0}, {20,0,0}, {0,0,0}, {0,20,0}, {20,20,20}, {0,20,20}, {0,0,20}, {20,0,20} };
@@ -201,3 +201,33 @@ SCENARIO("Config ini load/save interface", "[Config]") {
         }
     }
 }
+
+SCENARIO("Static config diff interface", "[Config]") {
+    GIVEN("A region config and a full config generated from default options") {
+        PrintRegionConfig          region_config;
+        Slic3r::DynamicPrintConfig config = Slic3r::DynamicPrintConfig::full_print_config();
+        WHEN("The configs are compared") {
+            THEN("There is no difference.") {
+                REQUIRE(region_config.diff(config).empty());
+                REQUIRE(region_config.equals(PrintRegionConfig()));
+            }
+        }
+        WHEN("Some region options and a print option of the full config are modified") {
+            config.set("perimeters", 5);
+            config.set_deserialize("top_infill_extrusion_width", "0.5");
+            config.set("layer_height", 0.1);
+            THEN("The modified region options are reported in the order of their keys.") {
+                REQUIRE(region_config.diff(config) == t_config_option_keys({ "perimeters", "top_infill_extrusion_width" }));
+                REQUIRE(region_config.diff(config) == static_cast<const ConfigBase&>(region_config).diff(config));
+            }
+        }
+        WHEN("A region option of another region config is modified") {
+            PrintRegionConfig other;
+            other.infill_every_layers.value = 3;
+            THEN("The modified option is reported.") {
+                REQUIRE(region_config.diff(other) == t_config_option_keys({ "infill_every_layers" }));
+                REQUIRE(! region_config.equals(other));
+            }
+        }
+    }
+}
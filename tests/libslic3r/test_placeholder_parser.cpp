@@ -26,11 +26,22 @@ SCENARIO("Placeholder parser scripting", "[PlaceholderParser]") {
 	parser.set("foo", 0);
 	parser.set("bar", 2);
 	parser.set("num_extruders", 4);
+	parser.set("first_layer_temperature", new ConfigOptionInts({ 210, 215, 220, 225 }));
 
     SECTION("nested config options (legacy syntax)") { REQUIRE(parser.process("[temperature_[foo]]") == "357"); }
     SECTION("array reference") { REQUIRE(parser.process("{temperature[foo]}") == "357"); }
     SECTION("whitespaces and newlines are maintained") { REQUIRE(parser.process("test [ temperature_ [foo] ] \n hu") == "test 357 \n hu"); }
 
+    // Test the templates consisting of simple variable references only, which are compiled and cached.
+    SECTION("legacy vector reference by the current extruder") { REQUIRE(parser.process("M104 S[first_layer_temperature]\n", 2) == "M104 S220\n"); }
+    SECTION("legacy vector reference by an index") { REQUIRE(parser.process("[first_layer_temperature_3]") == "225"); }
+    SECTION("vector reference by an integer literal") { REQUIRE(parser.process("{ first_layer_temperature [ 1 ] }") == "215"); }
+    SECTION("vector reference out of range") { REQUIRE(parser.process("{first_layer_temperature[12]}") == "210"); }
+    SECTION("scalar reference") { REQUIRE(parser.process("G1 Z{bar} F{num_extruders}") == "G1 Z2 F4"); }
+    SECTION("leading whitespaces are skipped") { REQUIRE(parser.process(" \n {bar} \n") == "2 \n"); }
+    SECTION("repeated processing") { REQUIRE(parser.process("[foo]{nozzle_diameter[foo]}") + parser.process("[foo]{nozzle_diameter[foo]}") == "00.600.6"); }
+    SECTION("reference of a missing variable") { REQUIRE_THROWS(parser.process("{missing_variable}")); }
+
     // Test the math expressions.
     SECTION("math: 2*3") { REQUIRE(parser.process("{2*3}") == "6"); }
     SECTION("math: 2*3/6") { REQUIRE(parser.process("{2*3/6}") == "1"); }
@@ -0,0 +1,130 @@
+#include <catch2/catch.hpp>
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "libslic3r/libslic3r.h"
+#include "libslic3r/PrintConfig.hpp"
+#include "libslic3r/SliceCache.hpp"
+#include "libslic3r/TriangleMesh.hpp"
+
+using namespace Slic3r;
+
+static std::vector<ExPolygons> slice_cube(const TriangleMesh &mesh, const std::vector<float> &z)
+{
+    std::vector<ExPolygons> slices;
+    slice_mesh(mesh, z, slices, 0.f, []{});
+    return slices;
+}
+
+TEST_CASE("Slice cache key", "[SliceCache]") {
+    TriangleMesh cube = make_cube(10., 10., 10.);
+    std::vector<float> z { 1.f, 2.f, 3.f };
+    SliceCacheKey key(cube, z, SlicingMode::Regular, 0.f);
+    REQUIRE(key == SliceCacheKey(cube, z, SlicingMode::Regular, 0.f));
+    REQUIRE(key.hash() == SliceCacheKey(cube, z, SlicingMode::Regular, 0.f).hash());
+    REQUIRE(key != SliceCacheKey(cube, { 1.f, 2.f }, SlicingMode::Regular, 0.f));
+    REQUIRE(key != SliceCacheKey(cube, z, SlicingMode::Positive, 0.f));
+    REQUIRE(key != SliceCacheKey(cube, z, SlicingMode::Regular, 0.049f));
+    TriangleMesh moved = cube;
+    moved.translate(1.f, 0.f, 0.f);
+    REQUIRE(key != SliceCacheKey(moved, z, SlicingMode::Regular, 0.f));
+}
+
+TEST_CASE("Slice cache", "[SliceCache]") {
+    TriangleMesh cube = make_cube(10., 10., 10.);
+    cube.repair();
+    std::vector<float>      z { 1.f, 2.f, 3.f };
+    std::vector<ExPolygons> slices = slice_cube(cube, z);
+    SliceCacheKey           key(cube, z, SlicingMode::Regular, 0.f);
+    SliceCache             &cache = SliceCache::instance();
+    std::vector<ExPolygons> found;
+
+    SECTION("Disabled by default") {
+        REQUIRE(! cache.enabled());
+    }
+
+    SECTION("In memory") {
+        cache.set_memory_limit(1024 * 1024);
+        cache.reset_stats();
+        REQUIRE(cache.enabled());
+        REQUIRE(! cache.find(key, found));
+        cache.insert(key, slices);
+        REQUIRE(cache.find(key, found));
+        REQUIRE(found.size() == slices.size());
+        for (size_t i = 0; i < slices.size(); ++ i)
+            REQUIRE(found[i] == slices[i]);
+        SliceCache::Stats stats = cache.stats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.memory_used > 0);
+
+        // Limit the cache to a single entry.
+        cache.set_memory_limit(stats.memory_used);
+        SliceCacheKey key2(cube, { 4.f, 5.f, 6.f }, SlicingMode::Regular, 0.f);
+        cache.insert(key2, slice_cube(cube, key2.z));
+        REQUIRE(cache.find(key2, found));
+        REQUIRE(! cache.find(key, found));
+        REQUIRE(cache.stats().evictions == 1);
+    }
+
+    SECTION("On disk") {
+        boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        cache.set_disk_cache(dir.string(), 1024 * 1024);
+        cache.reset_stats();
+        cache.insert(key, slices);
+        REQUIRE(cache.stats().disk_used > 0);
+        cache.clear();
+        REQUIRE(cache.find(key, found));
+        REQUIRE(cache.stats().disk_hits == 1);
+        for (size_t i = 0; i < slices.size(); ++ i)
+            REQUIRE(found[i] == slices[i]);
+        boost::filesystem::path path = boost::filesystem::directory_iterator(dir)->path();
+        auto patch = [&path](size_t offset, uint32_t value) {
+            std::fstream file(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(offset);
+            file.write((const char*)&value, sizeof(value));
+        };
+        // A file with a corrupted count of layers, of expolygons or of contour points is a miss, nothing is allocated for the count.
+        const size_t num_slices_offset = 48 + strlen(SLIC3R_VERSION) + z.size() * sizeof(float);
+        for (size_t offset : { num_slices_offset, num_slices_offset + 4, num_slices_offset + 8 }) {
+            cache.insert(key, slices);
+            patch(offset, 0xFFFFFFFF);
+            cache.clear();
+            REQUIRE(! cache.find(key, found));
+        }
+        // A truncated file is a miss.
+        cache.insert(key, slices);
+        boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 1);
+        cache.clear();
+        REQUIRE(! cache.find(key, found));
+        cache.insert(key, slices);
+        cache.clear();
+        REQUIRE(cache.find(key, found));
+        // A file stored by another slicer revision is a miss.
+        patch(12 + strlen(SLIC3R_VERSION), TriangleMeshSlicer::revision + 1);
+        cache.clear();
+        REQUIRE(! cache.find(key, found));
+        // Size limit below a single file deletes it.
+        cache.set_disk_cache(dir.string(), 0);
+        REQUIRE(cache.stats().disk_used == 0);
+        cache.clear();
+        REQUIRE(! cache.find(key, found));
+        boost::filesystem::remove_all(dir);
+    }
+
+    cache.set_memory_limit(0);
+    cache.set_disk_cache(std::string(), 0);
+    cache.clear();
+}
+
+TEST_CASE("Slice cache command line options", "[SliceCache]") {
+    DynamicPrintAndCLIConfig config;
+    config.read_cli({ "--slice-cache-memory", "64", "--slice-cache-dir", "slices", "--slice-cache-disk", "256" }, nullptr);
+    REQUIRE(config.opt_int("slice_cache_memory") == 64);
+    REQUIRE(config.opt_string("slice_cache_dir") == "slices");
+    REQUIRE(config.opt_int("slice_cache_disk") == 256);
+    REQUIRE(cli_misc_config_def.get("slice_cache_memory")->default_value->getInt() == 0);
+    REQUIRE(cli_misc_config_def.get("slice_cache_dir")->default_value->serialize().empty());
+}
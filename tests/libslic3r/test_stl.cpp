@@ -2,6 +2,7 @@
 
 #include "libslic3r/Model.hpp"
 #include "libslic3r/Format/STL.hpp"
+#include "libslic3r/TriangleMesh.hpp"
 
 using namespace Slic3r;
 
@@ -54,4 +55,26 @@ SCENARIO("Reading an STL file", "[stl]") {
 			}
 		}
 	}
+	GIVEN("the same model stored as a binary STL and as ASCII STLs with LF and CRLF line endings") {
+		WHEN("STL files are read") {
+			TriangleMesh mesh_binary, mesh_ascii_lf, mesh_ascii_crlf;
+			REQUIRE(mesh_binary.ReadSTLFile(stl_path("Geräte/20mmbox-čřšřěá.stl").c_str()));
+			REQUIRE(mesh_ascii_lf.ReadSTLFile(stl_path("ASCII/20mmbox-LF.stl").c_str()));
+			REQUIRE(mesh_ascii_crlf.ReadSTLFile(stl_path("ASCII/20mmbox-CRLF.stl").c_str()));
+			THEN("the facets are loaded bit exact") {
+				auto same_facets = [](const stl_file &lhs, const stl_file &rhs) {
+					if (lhs.stats.number_of_facets != rhs.stats.number_of_facets)
+						return false;
+					for (size_t i = 0; i < lhs.facet_start.size(); ++ i)
+						if (memcmp(&lhs.facet_start[i], &rhs.facet_start[i], 48) != 0)
+							return false;
+					return true;
+				};
+				REQUIRE(mesh_binary.stl.stats.type == binary);
+				REQUIRE(mesh_ascii_lf.stl.stats.type == ascii);
+				REQUIRE(same_facets(mesh_binary.stl, mesh_ascii_lf.stl));
+				REQUIRE(same_facets(mesh_binary.stl, mesh_ascii_crlf.stl));
+			}
+		}
+	}
 }